@@ -0,0 +1,1013 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file arp-cache.c
+ * @brief ARP cache with aging, refresh and hold queues for arp and router
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+
+
+/* see http://www.iana.org/assignments/ethernet-numbers */
+#ifndef ETH_P_IPV4
+/**
+ * Number for IPv4
+ */
+#define ETH_P_IPV4 0x0800
+#endif
+
+#ifndef ETH_P_ARP
+/**
+ * Number for ARP
+ */
+#define ETH_P_ARP 0x0806
+#endif
+
+/**
+ * ARP hardware type for Ethernet.
+ */
+#define ARP_HTYPE_ETHERNET 1
+
+/**
+ * ARP protocol type for IPv4.
+ */
+#define ARP_PTYPE_IPV4 0x0800
+
+/**
+ * ARP operation of a request.
+ */
+#define ARP_OP_REQUEST 1
+
+/**
+ * ARP operation of a reply.
+ */
+#define ARP_OP_REPLY 2
+
+/**
+ * log2 of the number of slots of the ARP cache.  Enough for all the
+ * neighbours on a /16 network.
+ */
+#define ARP_CACHE_BITS 17
+
+/**
+ * Number of consecutive slots (starting at the hash position) in
+ * which an ARP cache entry may live.  Lookups always inspect the
+ * whole window, so freeing a slot never requires tombstones.
+ */
+#define ARP_PROBE_WINDOW 8
+
+/**
+ * How long (in ms) a neighbour is considered reachable after it
+ * confirmed its address, unless arp_cache_init() is told otherwise.
+ * The other timers below are given for this value and scale with it.
+ */
+#define ARP_REACHABLE_MS 30000
+
+/**
+ * How long (in ms) before the end of #ARP_REACHABLE_MS we ask again
+ * for the address of a neighbour that is in use.
+ */
+#define ARP_REFRESH_MS 5000
+
+/**
+ * How long (in ms) we keep the address of a neighbour that is not
+ * in use after it is no longer reachable.
+ */
+#define ARP_STALE_MS 60000
+
+/**
+ * Interval (in ms) between requests to a neighbour that did not
+ * answer yet.
+ */
+#define ARP_PROBE_MS 1000
+
+/**
+ * Number of unanswered requests after which we forget a neighbour.
+ */
+#define ARP_MAX_PROBES 3
+
+/**
+ * Maximum number of packets held for a neighbour whose address we
+ * do not know yet.  If more arrive, the oldest are dropped.
+ */
+#define ARP_QUEUE_MAX 32
+
+/**
+ * Maximum number of bytes held for all neighbours together.  Packets
+ * that would exceed it are dropped.
+ */
+#define ARP_HOLD_MAX_BYTES (4 * 1024 * 1024)
+
+
+/**
+ * gcc 4.x-ism to pack structures (to be used before structs);
+ * Using this still causes structs to be unaligned on the stack on Sparc
+ * (See #670578 from Debian).
+ */
+_Pragma("pack(push)") _Pragma("pack(1)")
+
+struct EthernetHeader
+{
+  struct MacAddress dst;
+  struct MacAddress src;
+
+  /**
+   * See ETH_P-values.
+   */
+  uint16_t tag;
+};
+
+
+/**
+ * ARP header for Ethernet-IPv4.
+ */
+struct ArpHeaderEthernetIPv4
+{
+  /**
+   * Must be #ARP_HTYPE_ETHERNET.
+   */
+  uint16_t htype;
+
+  /**
+   * Protocol type, must be #ARP_PTYPE_IPV4
+   */
+  uint16_t ptype;
+
+  /**
+   * HLEN.  Must be #MAC_ADDR_SIZE.
+   */
+  uint8_t hlen;
+
+  /**
+   * PLEN.  Must be sizeof (struct in_addr) (aka 4).
+   */
+  uint8_t plen;
+
+  /**
+   * Type of the operation.
+   */
+  uint16_t oper;
+
+  /**
+   * HW address of sender. We only support Ethernet.
+   */
+  struct MacAddress sender_ha;
+
+  /**
+   * Layer3-address of sender. We only support IPv4.
+   */
+  struct in_addr sender_pa;
+
+  /**
+   * HW address of target. We only support Ethernet.
+   */
+  struct MacAddress target_ha;
+
+  /**
+   * Layer3-address of target. We only support IPv4.
+   */
+  struct in_addr target_pa;
+};
+
+_Pragma("pack(pop)")
+
+
+/**
+ * What the ARP cache needs to know about an interface.
+ */
+struct ArpInterface
+{
+  /**
+   * MAC of interface.
+   */
+  struct MacAddress mac;
+
+  /**
+   * IPv4 address of interface.
+   */
+  struct in_addr ip;
+
+  /**
+   * Name of the interface.
+   */
+  const char *name;
+};
+
+
+/**
+ * State of an entry of the ARP cache.
+ */
+enum ArpState
+{
+  /**
+   * The slot is free.
+   */
+  ARP_STATE_FREE = 0,
+
+  /**
+   * The neighbour recently confirmed its address.
+   */
+  ARP_STATE_REACHABLE,
+
+  /**
+   * The confirmation is old; the next use of the entry sends a
+   * request, until then the address is still used.
+   */
+  ARP_STATE_STALE,
+
+  /**
+   * We sent a request and wait for the reply, the address is
+   * still used.
+   */
+  ARP_STATE_PROBE,
+
+  /**
+   * We do not know the address yet; we sent a request and hold the
+   * packets for the neighbour until the reply arrives.
+   */
+  ARP_STATE_INCOMPLETE
+};
+
+
+/**
+ * Packet held while we wait for the address of its next hop.
+ */
+struct HeldPacket
+{
+  /**
+   * Next packet for the same neighbour.
+   */
+  struct HeldPacket *next;
+
+  /**
+   * Number of bytes in @e data.
+   */
+  size_t size;
+
+  /**
+   * The IPv4 packet.
+   */
+  char data[];
+};
+
+
+/**
+ * Entry in the ARP cache.
+ */
+struct ArpEntry
+{
+  /**
+   * Timer for the next state change of the entry.
+   */
+  struct Timer timer;
+
+  /**
+   * When did the neighbour last confirm its address (see timer_now())?
+   */
+  uint64_t confirmed;
+
+  /**
+   * IPv4 address of the neighbour.
+   */
+  struct in_addr ip;
+
+  /**
+   * Packets waiting for the address, oldest first, only in
+   * #ARP_STATE_INCOMPLETE.
+   */
+  struct HeldPacket *queue_head;
+
+  /**
+   * Last packet in @e queue_head.
+   */
+  struct HeldPacket *queue_tail;
+
+  /**
+   * MAC address of the neighbour.
+   */
+  struct MacAddress mac;
+
+  /**
+   * Interface the neighbour is on.
+   */
+  uint16_t ifc_num;
+
+  /**
+   * See `enum ArpState`.
+   */
+  uint8_t state;
+
+  /**
+   * Number of requests sent in #ARP_STATE_PROBE or
+   * #ARP_STATE_INCOMPLETE.
+   */
+  uint8_t probes;
+
+  /**
+   * Number of packets in @e queue_head.
+   */
+  uint8_t queued;
+
+  /**
+   * Was the entry used since the neighbour last confirmed its address?
+   */
+  bool used;
+};
+
+
+/**
+ * The ARP cache, 2^#ARP_CACHE_BITS slots.  Open addressing with a
+ * bounded probe window: when the window is full, the entry confirmed
+ * the longest time ago is evicted.
+ */
+static struct ArpEntry *arp_cache;
+
+/**
+ * Our interfaces, indexed by interface number minus one.
+ */
+static struct ArpInterface *arp_ifcs;
+
+/**
+ * Number of entries in #arp_ifcs.
+ */
+static unsigned int arp_num_ifc;
+
+/**
+ * Timers of the cache (in ms), see #ARP_REACHABLE_MS and below.
+ */
+static struct
+{
+  uint64_t reachable;
+  uint64_t refresh;
+  uint64_t stale;
+  uint64_t probe;
+} arp_times;
+
+/**
+ * Number of bytes in the packets held for all neighbours.
+ */
+static size_t arp_held;
+
+/**
+ * Number of packets we dropped instead of holding or releasing them.
+ */
+static unsigned long long arp_dropped;
+
+
+/**
+ * Send an ARP message via @a ifc_num.
+ *
+ * @param ifc_num interface to send the message out on
+ * @param oper #ARP_OP_REQUEST or #ARP_OP_REPLY
+ * @param dst destination MAC of the frame
+ * @param target_ha MAC address of the target
+ * @param target_pa IPv4 address of the target
+ */
+static void
+send_arp (uint16_t ifc_num,
+          uint16_t oper,
+          const struct MacAddress *dst,
+          const struct MacAddress *target_ha,
+          struct in_addr target_pa)
+{
+  const struct ArpInterface *ifc = &arp_ifcs[ifc_num - 1];
+  char buf[sizeof (struct EthernetHeader)
+           + sizeof (struct ArpHeaderEthernetIPv4)];
+  struct EthernetHeader eh;
+  struct ArpHeaderEthernetIPv4 ah;
+
+  eh.dst = *dst;
+  eh.src = ifc->mac;
+  eh.tag = htons (ETH_P_ARP);
+  ah.htype = htons (ARP_HTYPE_ETHERNET);
+  ah.ptype = htons (ARP_PTYPE_IPV4);
+  ah.hlen = sizeof (struct MacAddress);
+  ah.plen = sizeof (struct in_addr);
+  ah.oper = htons (oper);
+  ah.sender_ha = ifc->mac;
+  ah.sender_pa = ifc->ip;
+  ah.target_ha = *target_ha;
+  ah.target_pa = target_pa;
+  memcpy (buf,
+          &eh,
+          sizeof (eh));
+  memcpy (&buf[sizeof (eh)],
+          &ah,
+          sizeof (ah));
+  output_frame (ifc_num,
+                buf,
+                sizeof (buf),
+                NULL,
+                0);
+}
+
+
+/**
+ * Ask for the MAC address of @a ip on @a ifc_num.
+ *
+ * @param ifc_num interface to send the request out on
+ * @param ip IPv4 address to resolve
+ * @param dst MAC to send the request to, NULL to broadcast it
+ */
+static void
+send_arp_request (uint16_t ifc_num,
+                  struct in_addr ip,
+                  const struct MacAddress *dst)
+{
+  static const struct MacAddress broadcast = {
+    .mac = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+  };
+  static const struct MacAddress unknown;
+
+  send_arp (ifc_num,
+            ARP_OP_REQUEST,
+            (NULL == dst) ? &broadcast : dst,
+            &unknown,
+            ip);
+}
+
+
+/**
+ * Compute the first slot of the probe window for @a ip on
+ * interface @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @return slot index
+ */
+static uint32_t
+arp_home (uint16_t ifc_num,
+          struct in_addr ip)
+{
+  uint64_t key = ((uint64_t) ip.s_addr << 16) | ifc_num;
+
+  return (key * 0x9E3779B97F4A7C15LLU) >> (64 - ARP_CACHE_BITS);
+}
+
+
+/**
+ * Find the ARP cache entry for @a ip on @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @return NULL if @a ip is not in the cache
+ */
+static struct ArpEntry *
+arp_find (uint16_t ifc_num,
+          struct in_addr ip)
+{
+  uint32_t home = arp_home (ifc_num,
+                            ip);
+
+  for (unsigned int i = 0; i < ARP_PROBE_WINDOW; i++)
+  {
+    struct ArpEntry *e
+      = &arp_cache[(home + i) & ((1U << ARP_CACHE_BITS) - 1)];
+
+    if ( (ARP_STATE_FREE != e->state) &&
+         (e->ip.s_addr == ip.s_addr) &&
+         (e->ifc_num == ifc_num) )
+      return e;
+  }
+  return NULL;
+}
+
+
+/**
+ * Drop the packets held for the neighbour of @a e.
+ *
+ * @param e entry to clear the queue of
+ */
+static void
+arp_drop_queue (struct ArpEntry *e)
+{
+  while (NULL != e->queue_head)
+  {
+    struct HeldPacket *hp = e->queue_head;
+
+    e->queue_head = hp->next;
+    arp_held -= hp->size;
+    free (hp);
+  }
+  e->queue_tail = NULL;
+  e->queued = 0;
+}
+
+
+/**
+ * Send a request to the neighbour of @a e (to its known MAC) to
+ * confirm its address, entering #ARP_STATE_PROBE.  The caller must
+ * schedule the timer of @a e.
+ *
+ * @param e entry to confirm
+ */
+static void
+arp_probe (struct ArpEntry *e)
+{
+  e->state = ARP_STATE_PROBE;
+  e->probes++;
+  send_arp_request (e->ifc_num,
+                    e->ip,
+                    &e->mac);
+}
+
+
+/**
+ * The timer of an ARP cache entry expired: move it on to its next
+ * state, or forget it.
+ *
+ * @param t timer of the entry
+ */
+static void
+arp_expire (struct Timer *t)
+{
+  struct ArpEntry *e
+    = (struct ArpEntry *) ((char *) t - offsetof (struct ArpEntry, timer));
+
+  switch (e->state)
+  {
+  case ARP_STATE_REACHABLE:
+    if (e->used)
+    {
+      /* refresh busy entries before they stop being reachable */
+      e->probes = 0;
+      arp_probe (e);
+      timer_schedule (t,
+                      timer_now () + arp_times.probe,
+                      &arp_expire);
+      return;
+    }
+    e->state = ARP_STATE_STALE;
+    timer_schedule (t,
+                    e->confirmed + arp_times.reachable + arp_times.stale,
+                    &arp_expire);
+    return;
+  case ARP_STATE_PROBE:
+    if (e->probes < ARP_MAX_PROBES)
+    {
+      arp_probe (e);
+      timer_schedule (t,
+                      timer_now () + arp_times.probe,
+                      &arp_expire);
+      return;
+    }
+    break;
+  case ARP_STATE_INCOMPLETE:
+    /* retry at most every probe interval, however many packets wait */
+    if (e->probes < ARP_MAX_PROBES)
+    {
+      e->probes++;
+      send_arp_request (e->ifc_num,
+                        e->ip,
+                        NULL);
+      timer_schedule (t,
+                      timer_now () + arp_times.probe,
+                      &arp_expire);
+      return;
+    }
+    arp_dropped += e->queued;
+    arp_drop_queue (e);
+    break;
+  default:
+    break;
+  }
+  e->state = ARP_STATE_FREE;
+}
+
+
+/**
+ * Find the slot for @a ip on @a ifc_num: its entry if it has one,
+ * otherwise a free slot or the slot of the entry we evict for it,
+ * marked as free.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @return the slot
+ */
+static struct ArpEntry *
+arp_slot (uint16_t ifc_num,
+          struct in_addr ip)
+{
+  uint32_t home = arp_home (ifc_num,
+                            ip);
+  struct ArpEntry *e = NULL;
+
+  for (unsigned int i = 0; i < ARP_PROBE_WINDOW; i++)
+  {
+    struct ArpEntry *s
+      = &arp_cache[(home + i) & ((1U << ARP_CACHE_BITS) - 1)];
+
+    if (ARP_STATE_FREE == s->state)
+    {
+      if ( (NULL == e) ||
+           (ARP_STATE_FREE != e->state) )
+        e = s;
+      continue;
+    }
+    if ( (s->ip.s_addr == ip.s_addr) &&
+         (s->ifc_num == ifc_num) )
+    {
+      e = s;
+      break;
+    }
+    if ( (NULL == e) ||
+         ( (ARP_STATE_FREE != e->state) &&
+           (s->confirmed < e->confirmed) ) )
+      e = s;
+  }
+  if ( (ARP_STATE_FREE != e->state) &&
+       ( (e->ip.s_addr != ip.s_addr) ||
+         (e->ifc_num != ifc_num) ) )
+  {
+    timer_cancel (&e->timer);
+    arp_dropped += e->queued;
+    arp_drop_queue (e);
+    e->state = ARP_STATE_FREE;
+  }
+  return e;
+}
+
+
+/**
+ * The neighbour @a ip on @a ifc_num told us its MAC address @a mac.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @param mac MAC address of the neighbour
+ * @return the entry of the neighbour, with the packets held for it
+ */
+static struct ArpEntry *
+arp_learn (uint16_t ifc_num,
+           struct in_addr ip,
+           const struct MacAddress *mac)
+{
+  struct ArpEntry *e = arp_slot (ifc_num,
+                                 ip);
+
+  timer_cancel (&e->timer);
+  e->confirmed = timer_now ();
+  e->ip = ip;
+  e->mac = *mac;
+  e->ifc_num = ifc_num;
+  e->state = ARP_STATE_REACHABLE;
+  e->probes = 0;
+  e->used = false;
+  timer_schedule (&e->timer,
+                  e->confirmed + arp_times.reachable - arp_times.refresh,
+                  &arp_expire);
+  return e;
+}
+
+
+/**
+ * Send all packets held for the neighbour of @a e in one burst.
+ *
+ * @param e entry of a neighbour whose address we just learned
+ */
+static void
+arp_release (struct ArpEntry *e)
+{
+  struct EthernetHeader eh;
+
+  if (NULL == e->queue_head)
+    return;
+  eh.dst = e->mac;
+  eh.src = arp_ifcs[e->ifc_num - 1].mac;
+  eh.tag = htons (ETH_P_IPV4);
+  for (const struct HeldPacket *hp = e->queue_head;
+       NULL != hp;
+       hp = hp->next)
+    output_frame (e->ifc_num,
+                  &eh,
+                  sizeof (eh),
+                  hp->data,
+                  hp->size);
+  /* the output only references the packets */
+  output_flush ();
+  arp_drop_queue (e);
+}
+
+
+/**
+ * Set up the ARP cache.
+ *
+ * @param num_ifc number of interfaces
+ * @param reachable_ms how long (in ms) a neighbour is considered
+ *        reachable after it confirmed its address, 0 for the
+ *        default; the other timers of the cache scale with it
+ * @return 0 on success, -1 if we are out of memory
+ */
+int
+arp_cache_init (unsigned int num_ifc,
+                unsigned int reachable_ms)
+{
+  if (0 == reachable_ms)
+    reachable_ms = ARP_REACHABLE_MS;
+  arp_times.reachable = reachable_ms;
+  arp_times.refresh = arp_times.reachable * ARP_REFRESH_MS / ARP_REACHABLE_MS;
+  arp_times.stale = arp_times.reachable * ARP_STALE_MS / ARP_REACHABLE_MS;
+  arp_times.probe = arp_times.reachable * ARP_PROBE_MS / ARP_REACHABLE_MS;
+  if (0 == arp_times.probe)
+    arp_times.probe = 1;
+  arp_num_ifc = num_ifc;
+  arp_ifcs = calloc (num_ifc,
+                     sizeof (struct ArpInterface));
+  arp_cache = calloc (1U << ARP_CACHE_BITS,
+                      sizeof (struct ArpEntry));
+  if ( (NULL == arp_ifcs) ||
+       (NULL == arp_cache) )
+  {
+    free (arp_ifcs);
+    free (arp_cache);
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * Tell the ARP cache about interface @a ifc_num.
+ *
+ * @param ifc_num number of the interface
+ * @param name name of the interface, must remain valid until
+ *        arp_cache_destroy()
+ * @param ip our IPv4 address on the interface
+ */
+void
+arp_cache_interface (uint16_t ifc_num,
+                     const char *name,
+                     struct in_addr ip)
+{
+  if ( (0 == ifc_num) ||
+       (ifc_num > arp_num_ifc) )
+    abort ();
+  arp_ifcs[ifc_num - 1].name = name;
+  arp_ifcs[ifc_num - 1].ip = ip;
+}
+
+
+/**
+ * Tell the ARP cache the MAC address @a mac of interface @a ifc_num.
+ *
+ * @param ifc_num number of the interface
+ * @param mac our MAC address on the interface
+ */
+void
+arp_cache_mac (uint16_t ifc_num,
+               const struct MacAddress *mac)
+{
+  if ( (0 == ifc_num) ||
+       (ifc_num > arp_num_ifc) )
+    abort ();
+  arp_ifcs[ifc_num - 1].mac = *mac;
+}
+
+
+/**
+ * Release the ARP cache and drop all held packets.
+ */
+void
+arp_cache_destroy (void)
+{
+  for (size_t i = 0; i < (1U << ARP_CACHE_BITS); i++)
+  {
+    timer_cancel (&arp_cache[i].timer);
+    arp_drop_queue (&arp_cache[i]);
+  }
+  free (arp_cache);
+  arp_cache = NULL;
+  free (arp_ifcs);
+  arp_ifcs = NULL;
+}
+
+
+/**
+ * Look up the MAC address of @a ip on @a ifc_num for sending a frame
+ * there.  Using a stale entry makes us confirm it.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @return NULL if @a ip is not in the cache
+ */
+const struct MacAddress *
+arp_resolve (uint16_t ifc_num,
+             struct in_addr ip)
+{
+  struct ArpEntry *e = arp_find (ifc_num,
+                                 ip);
+
+  if ( (NULL == e) ||
+       (ARP_STATE_INCOMPLETE == e->state) )
+    return NULL;
+  e->used = true;
+  if (ARP_STATE_STALE == e->state)
+  {
+    e->probes = 0;
+    arp_probe (e);
+    timer_schedule (&e->timer,
+                    timer_now () + arp_times.probe,
+                    &arp_expire);
+  }
+  return &e->mac;
+}
+
+
+/**
+ * Broadcast a request for the MAC address of @a ip on @a ifc_num.
+ *
+ * @param ifc_num interface to send the request out on
+ * @param ip IPv4 address to resolve
+ */
+void
+arp_request (uint16_t ifc_num,
+             struct in_addr ip)
+{
+  send_arp_request (ifc_num,
+                    ip,
+                    NULL);
+}
+
+
+/**
+ * Hold an IPv4 packet for @a ip on @a ifc_num until we know its
+ * address, then send it in an Ethernet frame.  Only the first packet
+ * for a neighbour triggers a request, further requests are sent by
+ * the timer of the entry.  If #ARP_HOLD_MAX_BYTES are held already,
+ * the packet is dropped.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @param head start of the packet
+ * @param head_size number of bytes in @a head
+ * @param data rest of the packet
+ * @param data_size number of bytes in @a data
+ */
+void
+arp_hold (uint16_t ifc_num,
+          struct in_addr ip,
+          const void *head,
+          size_t head_size,
+          const void *data,
+          size_t data_size)
+{
+  struct ArpEntry *e = arp_slot (ifc_num,
+                                 ip);
+  struct HeldPacket *hp;
+
+  if (ARP_STATE_FREE == e->state)
+  {
+    e->confirmed = timer_now ();
+    e->ip = ip;
+    e->ifc_num = ifc_num;
+    e->state = ARP_STATE_INCOMPLETE;
+    e->probes = 1;
+    e->used = false;
+    send_arp_request (ifc_num,
+                      ip,
+                      NULL);
+    timer_schedule (&e->timer,
+                    e->confirmed + arp_times.probe,
+                    &arp_expire);
+  }
+  if (e->queued == ARP_QUEUE_MAX)
+  {
+    hp = e->queue_head;
+    e->queue_head = hp->next;
+    e->queued--;
+    arp_held -= hp->size;
+    arp_dropped++;
+    free (hp);
+  }
+  if (arp_held + head_size + data_size > ARP_HOLD_MAX_BYTES)
+  {
+    /* too much is waiting already, the request is on its way anyway */
+    arp_dropped++;
+    return;
+  }
+  hp = malloc (sizeof (struct HeldPacket) + head_size + data_size);
+  if (NULL == hp)
+  {
+    arp_dropped++;
+    return;
+  }
+  hp->next = NULL;
+  hp->size = head_size + data_size;
+  memcpy (hp->data,
+          head,
+          head_size);
+  memcpy (&hp->data[head_size],
+          data,
+          data_size);
+  if (NULL == e->queue_head)
+    e->queue_head = hp;
+  else
+    e->queue_tail->next = hp;
+  e->queue_tail = hp;
+  e->queued++;
+  arp_held += hp->size;
+}
+
+
+/**
+ * Print out the ARP cache, except for the neighbours we are still
+ * resolving, and how many held packets we dropped (if any).
+ */
+void
+arp_print (void)
+{
+  for (size_t i = 0; i < (1U << ARP_CACHE_BITS); i++)
+  {
+    const struct ArpEntry *e = &arp_cache[i];
+    const uint8_t *m = e->mac.mac;
+    char ips[INET_ADDRSTRLEN];
+
+    if ( (ARP_STATE_FREE == e->state) ||
+         (ARP_STATE_INCOMPLETE == e->state) )
+      continue;
+    inet_ntop (AF_INET,
+               &e->ip,
+               ips,
+               sizeof (ips));
+    print ("%s -> %02x:%02x:%02x:%02x:%02x:%02x (%s)\n",
+           ips,
+           m[0], m[1], m[2], m[3], m[4], m[5],
+           arp_ifcs[e->ifc_num - 1].name);
+  }
+  if (0 != arp_dropped)
+    print ("%llu held packets dropped\n",
+           arp_dropped);
+}
+
+
+/**
+ * Process ARP message (request or response!) received on @a ifc_num.
+ * We answer requests for our address, and learn the address of the
+ * sender of such requests and of replies to us, sending the packets
+ * we held for it.
+ *
+ * @param ifc_num interface we received the message from
+ * @param msg the ARP message (behind the Ethernet header)
+ * @param msg_size number of bytes in @a msg
+ */
+void
+arp_handle (uint16_t ifc_num,
+            const void *msg,
+            size_t msg_size)
+{
+  const struct ArpInterface *ifc = &arp_ifcs[ifc_num - 1];
+  struct ArpHeaderEthernetIPv4 ah;
+
+  if (msg_size < sizeof (ah))
+    return;
+  memcpy (&ah,
+          msg,
+          sizeof (ah));
+  if ( (ARP_HTYPE_ETHERNET != ntohs (ah.htype)) ||
+       (ARP_PTYPE_IPV4 != ntohs (ah.ptype)) ||
+       (sizeof (struct MacAddress) != ah.hlen) ||
+       (sizeof (struct in_addr) != ah.plen) ||
+       (ah.target_pa.s_addr != ifc->ip.s_addr) )
+    return;
+  switch (ntohs (ah.oper))
+  {
+  case ARP_OP_REQUEST:
+    if (0 != ah.sender_pa.s_addr)
+      arp_release (arp_learn (ifc_num,
+                              ah.sender_pa,
+                              &ah.sender_ha));
+    send_arp (ifc_num,
+              ARP_OP_REPLY,
+              &ah.sender_ha,
+              &ah.sender_ha,
+              ah.sender_pa);
+    break;
+  case ARP_OP_REPLY:
+    if (0 != memcmp (&ah.target_ha,
+                     &ifc->mac,
+                     sizeof (struct MacAddress)))
+      break;
+    arp_release (arp_learn (ifc_num,
+                            ah.sender_pa,
+                            &ah.sender_ha));
+    break;
+  }
+}
+
+
+/* end of arp-cache.c */
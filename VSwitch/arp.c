@@ -1,496 +1,474 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file arp.c
- * @brief ARP tool
- * @author Christian Grothoff
- */
-#include "glab.h"
-
-
-/**
- * gcc 4.x-ism to pack structures (to be used before structs);
- * Using this still causes structs to be unaligned on the stack on Sparc
- * (See #670578 from Debian).
- */
-_Pragma("pack(push)") _Pragma ("pack(1)")
-
-struct EthernetHeader
-{
-  struct MacAddress dst;
-  struct MacAddress src;
-
-  /**
-   * See ETH_P-values.
-   */
-  uint16_t tag;
-};
-
-
-/**
- * ARP header for Ethernet-IPv4.
- */
-struct ArpHeaderEthernetIPv4
-{
-  /**
-   * Must be #ARP_HTYPE_ETHERNET.
-   */
-  uint16_t htype;
-
-  /**
-   * Protocol type, must be #ARP_PTYPE_IPV4
-   */
-  uint16_t ptype;
-
-  /**
-   * HLEN.  Must be #MAC_ADDR_SIZE.
-   */
-  uint8_t hlen;
-
-  /**
-   * PLEN.  Must be sizeof (struct in_addr) (aka 4).
-   */
-  uint8_t plen;
-
-  /**
-   * Type of the operation.
-   */
-  uint16_t oper;
-
-  /**
-   * HW address of sender. We only support Ethernet.
-   */
-  struct MacAddress sender_ha;
-
-  /**
-   * Layer3-address of sender. We only support IPv4.
-   */
-  struct in_addr sender_pa;
-
-  /**
-   * HW address of target. We only support Ethernet.
-   */
-  struct MacAddress target_ha;
-
-  /**
-   * Layer3-address of target. We only support IPv4.
-   */
-  struct in_addr target_pa;
-};
-
-_Pragma("pack(pop)")
-
-
-/**
- * Per-interface context.
- */
-struct Interface
-{
-  /**
-   * MAC of interface.
-   */
-  struct MacAddress mac;
-
-  /**
-   * IPv4 address of interface (we only support one IP per interface!)
-   */
-  struct in_addr ip;
-
-  /**
-   * IPv4 netmask of interface.
-   */
-  struct in_addr netmask;
-
-  /**
-   * Name of the interface.
-   */
-  char *name;
-
-  /**
-   * Interface number.
-   */
-  uint16_t ifc_num;
-
-  /**
-   * MTU to enforce for this interface.
-   */
-  uint16_t mtu;
-};
-
-
-/**
- * Number of available contexts.
- */
-static unsigned int num_ifc;
-
-/**
- * All the contexts.
- */
-static struct Interface *gifc;
-
-
-/**
- * Forward @a frame to interface @a dst.
- *
- * @param dst target interface to send the frame out on
- * @param frame the frame to forward
- * @param frame_size number of bytes in @a frame
- */
-static void
-forward_to (struct Interface *dst,
-            const void *frame,
-            size_t frame_size)
-{
-  char iob[frame_size + sizeof (struct GLAB_MessageHeader)];
-  struct GLAB_MessageHeader hdr;
-
-  if (frame_size > dst->mtu)
-    abort ();
-  hdr.size = htons (sizeof (iob));
-  hdr.type = htons (dst->ifc_num);
-  memcpy (iob,
-          &hdr,
-          sizeof (hdr));
-  memcpy (&iob[sizeof (hdr)],
-          frame,
-          frame_size);
-  write_all (STDOUT_FILENO,
-             iob,
-             sizeof (iob));
-}
-
-
-/**
- * Parse and process frame received on @a ifc.
- *
- * @param ifc interface we got the frame on
- * @param frame raw frame data
- * @param frame_size number of bytes in @a frame
- */
-static void
-parse_frame (struct Interface *ifc,
-             const void *frame,
-             size_t frame_size)
-{
-  struct EthernetHeader eh;
-  const char *cframe = frame;
-
-  if (frame_size < sizeof (eh))
-  {
-    fprintf (stderr,
-             "Malformed frame\n");
-    return;
-  }
-  memcpy (&eh,
-          frame,
-          sizeof (eh));
-  /* DO WORK HERE */
-}
-
-
-/**
- * Process frame received from @a interface.
- *
- * @param interface number of the interface on which we received @a frame
- * @param frame the frame
- * @param frame_size number of bytes in @a frame
- */
-static void
-handle_frame (uint16_t interface,
-              const void *frame,
-              size_t frame_size)
-{
-  if (interface > num_ifc)
-    abort ();
-  parse_frame (&gifc[interface - 1],
-               frame,
-               frame_size);
-}
-
-
-/**
- * The user entered an "arp" command.  The remaining
- * arguments can be obtained via 'strtok()'.
- */
-static void
-process_cmd_arp ()
-{
-  const char *tok = strtok (NULL, " ");
-  struct in_addr v4;
-  struct MacAddress mac;
-  struct Interface *ifc;
-
-  if (NULL == tok)
-  {
-    // print_arp_cache ();
-    return;
-  }
-  if (1 !=
-      inet_pton (AF_INET,
-                 tok,
-                 &v4))
-  {
-    fprintf (stderr,
-             "`%s' is not a valid IPv4 address\n",
-             tok);
-    return;
-  }
-  tok = strtok (NULL, " ");
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "No network interface provided\n");
-    return;
-  }
-  ifc = NULL;
-  for (unsigned int i = 0; i<num_ifc; i++)
-  {
-    if (0 == strcasecmp (tok,
-                         gifc[i].name))
-    {
-      ifc = &gifc[i];
-      break;
-    }
-  }
-  if (NULL == ifc)
-  {
-    fprintf (stderr,
-             "Interface `%s' unknown\n",
-             tok);
-    return;
-  }
-  /* do MAC lookup */
-}
-
-
-/**
- * Parse network specification in @a net, initializing @a ifc.
- * Format of @a net is "IPV4:IP/NETMASK".
- *
- * @param ifc[out] interface specification to initialize
- * @param arg interface specification to parse
- * @return 0 on success
- */
-static int
-parse_network (struct Interface *ifc,
-               const char *net)
-{
-  const char *tok;
-  char *ip;
-  unsigned int mask;
-
-  if (0 !=
-      strncasecmp (net,
-                   "IPV4:",
-                   strlen ("IPV4:")))
-  {
-    fprintf (stderr,
-             "Interface specification `%s' does not start with `IPV4:'\n",
-             net);
-    return 1;
-  }
-  net += strlen ("IPV4:");
-  tok = strchr (net, '/');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in interface specification `%s': lacks '/'\n",
-             net);
-    return 1;
-  }
-  ip = strndup (net,
-                tok - net);
-  if (1 !=
-      inet_pton (AF_INET,
-                 ip,
-                 &ifc->ip))
-  {
-    fprintf (stderr,
-             "IP address `%s' malformed\n",
-             ip);
-    free (ip);
-    return 1;
-  }
-  free (ip);
-  tok++;
-  if (1 !=
-      sscanf (tok,
-              "%u",
-              &mask))
-  {
-    fprintf (stderr,
-             "Netmask `%s' malformed\n",
-             tok);
-    return 1;
-  }
-  if (mask > 32)
-  {
-    fprintf (stderr,
-             "Netmask invalid (too large)\n");
-    return 1;
-  }
-  ifc->netmask.s_addr = htonl (~(uint32_t) ((1LLU << (32 - mask)) - 1LLU));
-  return 0;
-}
-
-
-/**
- * Parse interface specification @a arg and update @a ifc.  Format is
- * "IFCNAME[IPV4:IP/NETMASK]=MTU".  The "=MTU" is optional.
- *
- * @param ifc[out] interface specification to initialize
- * @param arg interface specification to parse
- * @return 0 on success
- */
-static int
-parse_cmd_arg (struct Interface *ifc,
-               const char *arg)
-{
-  const char *tok;
-  char *nspec;
-
-  ifc->mtu = 1500 + sizeof (struct EthernetHeader); /* default in case unspecified */
-  tok = strchr (arg, '[');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in interface specification: lacks '['");
-    return 1;
-  }
-  ifc->name = strndup (arg,
-                       tok - arg);
-  arg = tok + 1;
-  tok = strchr (arg, ']');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in interface specification: lacks ']'");
-    return 1;
-  }
-  nspec = strndup (arg,
-                   tok - arg);
-  if (0 !=
-      parse_network (ifc,
-                     nspec))
-  {
-    free (nspec);
-    return 1;
-  }
-  free (nspec);
-  arg = tok + 1;
-  if ('=' == arg[0])
-  {
-    unsigned int mtu;
-
-    if (1 != (sscanf (&arg[1],
-                      "%u",
-                      &mtu)))
-    {
-      fprintf (stderr,
-               "Error in interface specification: MTU not a number\n");
-      return 1;
-    }
-    if (mtu < 400)
-    {
-      fprintf (stderr,
-               "Error in interface specification: MTU too small\n");
-      return 1;
-    }
-    ifc->mtu = mtu + sizeof (struct EthernetHeader);
-  }
-  return 0;
-}
-
-
-/**
- * Handle control message @a cmd.
- *
- * @param cmd text the user entered
- * @param cmd_len length of @a cmd
- */
-static void
-handle_control (char *cmd,
-                size_t cmd_len)
-{
-  const char *tok;
-
-  cmd[cmd_len - 1] = '\0';
-  tok = strtok (cmd,
-                " ");
-  if (0 == strcasecmp (tok,
-                       "arp"))
-    process_cmd_arp ();
-  else
-    fprintf (stderr,
-             "Unsupported command `%s'\n",
-             tok);
-}
-
-
-/**
- * Handle MAC information @a mac
- *
- * @param ifc_num number of the interface with @a mac
- * @param mac the MAC address at @a ifc_num
- */
-static void
-handle_mac (uint16_t ifc_num,
-            const struct MacAddress *mac)
-{
-  if (ifc_num > num_ifc)
-    abort ();
-  gifc[ifc_num - 1].mac = *mac;
-}
-
-
-/**
- * Launches the arp tool.
- *
- * @param argc number of arguments in @a argv
- * @param argv binary name, followed by list of interfaces to switch between
- * @return not really
- */
-int
-main (int argc,
-      char **argv)
-{
-  struct Interface ifc[argc];
-
-  memset (ifc,
-          0,
-          sizeof (ifc));
-  num_ifc = argc - 1;
-  gifc = ifc;
-  for (unsigned int i = 1; i<argc; i++)
-  {
-    struct Interface *p = &ifc[i - 1];
-
-    ifc[i - 1].ifc_num = i;
-    if (0 !=
-        parse_cmd_arg (p,
-                       argv[i]))
-      abort ();
-  }
-  loop (&handle_frame,
-        &handle_control,
-        &handle_mac);
-  for (unsigned int i = 1; i<argc; i++)
-    free (ifc[i - 1].name);
-  return 0;
-}
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file arp.c
+ * @brief ARP tool
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+
+
+/* see http://www.iana.org/assignments/ethernet-numbers */
+#ifndef ETH_P_ARP
+/**
+ * Number for ARP
+ */
+#define ETH_P_ARP 0x0806
+#endif
+
+/**
+ * gcc 4.x-ism to pack structures (to be used before structs);
+ * Using this still causes structs to be unaligned on the stack on Sparc
+ * (See #670578 from Debian).
+ */
+_Pragma("pack(push)") _Pragma ("pack(1)")
+
+struct EthernetHeader
+{
+  struct MacAddress dst;
+  struct MacAddress src;
+
+  /**
+   * See ETH_P-values.
+   */
+  uint16_t tag;
+};
+
+_Pragma("pack(pop)")
+
+
+/**
+ * Per-interface context.
+ */
+struct Interface
+{
+  /**
+   * MAC of interface.
+   */
+  struct MacAddress mac;
+
+  /**
+   * IPv4 address of interface (we only support one IP per interface!)
+   */
+  struct in_addr ip;
+
+  /**
+   * IPv4 netmask of interface.
+   */
+  struct in_addr netmask;
+
+  /**
+   * Name of the interface.
+   */
+  char *name;
+
+  /**
+   * Interface number.
+   */
+  uint16_t ifc_num;
+
+  /**
+   * MTU to enforce for this interface.
+   */
+  uint16_t mtu;
+};
+
+
+/**
+ * Number of available contexts.
+ */
+static unsigned int num_ifc;
+
+/**
+ * All the contexts.
+ */
+static struct Interface *gifc;
+
+/**
+ * Parse and process frame received on @a ifc.
+ *
+ * @param ifc interface we got the frame on
+ * @param frame raw frame data
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+parse_frame (struct Interface *ifc,
+             const void *frame,
+             size_t frame_size)
+{
+  struct EthernetHeader eh;
+  const char *cframe = frame;
+
+  if (frame_size < sizeof (eh))
+  {
+    fprintf (stderr,
+             "Malformed frame\n");
+    return;
+  }
+  memcpy (&eh,
+          frame,
+          sizeof (eh));
+  if (ETH_P_ARP == ntohs (eh.tag))
+    arp_handle (ifc->ifc_num,
+                &cframe[sizeof (eh)],
+                frame_size - sizeof (eh));
+}
+
+
+/**
+ * Process frame received from @a interface.
+ *
+ * @param interface number of the interface on which we received @a frame
+ * @param frame the frame
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+handle_frame (uint16_t interface,
+              const void *frame,
+              size_t frame_size)
+{
+  if (interface > num_ifc)
+    abort ();
+  parse_frame (&gifc[interface - 1],
+               frame,
+               frame_size);
+}
+
+
+/**
+ * The user entered an "arp" command.  The remaining
+ * arguments can be obtained via 'strtok()'.
+ */
+static void
+process_cmd_arp ()
+{
+  const char *tok = strtok (NULL, " ");
+  struct in_addr v4;
+  const struct MacAddress *mac;
+  struct Interface *ifc;
+
+  if (NULL == tok)
+  {
+    arp_print ();
+    return;
+  }
+  if (1 !=
+      inet_pton (AF_INET,
+                 tok,
+                 &v4))
+  {
+    fprintf (stderr,
+             "`%s' is not a valid IPv4 address\n",
+             tok);
+    return;
+  }
+  tok = strtok (NULL, " ");
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "No network interface provided\n");
+    return;
+  }
+  ifc = NULL;
+  for (unsigned int i = 0; i<num_ifc; i++)
+  {
+    if (0 == strcasecmp (tok,
+                         gifc[i].name))
+    {
+      ifc = &gifc[i];
+      break;
+    }
+  }
+  if (NULL == ifc)
+  {
+    fprintf (stderr,
+             "Interface `%s' unknown\n",
+             tok);
+    return;
+  }
+  mac = arp_resolve (ifc->ifc_num,
+                     v4);
+  if (NULL == mac)
+  {
+    arp_request (ifc->ifc_num,
+                 v4);
+    return;
+  }
+  print ("%02x:%02x:%02x:%02x:%02x:%02x\n",
+         mac->mac[0], mac->mac[1], mac->mac[2],
+         mac->mac[3], mac->mac[4], mac->mac[5]);
+}
+
+
+/**
+ * Parse network specification in @a net, initializing @a ifc.
+ * Format of @a net is "IPV4:IP/NETMASK".
+ *
+ * @param ifc[out] interface specification to initialize
+ * @param arg interface specification to parse
+ * @return 0 on success
+ */
+static int
+parse_network (struct Interface *ifc,
+               const char *net)
+{
+  const char *tok;
+  char *ip;
+  unsigned int mask;
+
+  if (0 !=
+      strncasecmp (net,
+                   "IPV4:",
+                   strlen ("IPV4:")))
+  {
+    fprintf (stderr,
+             "Interface specification `%s' does not start with `IPV4:'\n",
+             net);
+    return 1;
+  }
+  net += strlen ("IPV4:");
+  tok = strchr (net, '/');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in interface specification `%s': lacks '/'\n",
+             net);
+    return 1;
+  }
+  ip = strndup (net,
+                tok - net);
+  if (1 !=
+      inet_pton (AF_INET,
+                 ip,
+                 &ifc->ip))
+  {
+    fprintf (stderr,
+             "IP address `%s' malformed\n",
+             ip);
+    free (ip);
+    return 1;
+  }
+  free (ip);
+  tok++;
+  if (1 !=
+      sscanf (tok,
+              "%u",
+              &mask))
+  {
+    fprintf (stderr,
+             "Netmask `%s' malformed\n",
+             tok);
+    return 1;
+  }
+  if (mask > 32)
+  {
+    fprintf (stderr,
+             "Netmask invalid (too large)\n");
+    return 1;
+  }
+  ifc->netmask.s_addr = htonl (~(uint32_t) ((1LLU << (32 - mask)) - 1LLU));
+  return 0;
+}
+
+
+/**
+ * Parse interface specification @a arg and update @a ifc.  Format is
+ * "IFCNAME[IPV4:IP/NETMASK]=MTU".  The "=MTU" is optional.
+ *
+ * @param ifc[out] interface specification to initialize
+ * @param arg interface specification to parse
+ * @return 0 on success
+ */
+static int
+parse_cmd_arg (struct Interface *ifc,
+               const char *arg)
+{
+  const char *tok;
+  char *nspec;
+
+  ifc->mtu = 1500 + sizeof (struct EthernetHeader); /* default in case unspecified */
+  tok = strchr (arg, '[');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in interface specification: lacks '['");
+    return 1;
+  }
+  ifc->name = strndup (arg,
+                       tok - arg);
+  arg = tok + 1;
+  tok = strchr (arg, ']');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in interface specification: lacks ']'");
+    return 1;
+  }
+  nspec = strndup (arg,
+                   tok - arg);
+  if (0 !=
+      parse_network (ifc,
+                     nspec))
+  {
+    free (nspec);
+    return 1;
+  }
+  free (nspec);
+  arg = tok + 1;
+  if ('=' == arg[0])
+  {
+    unsigned int mtu;
+
+    if (1 != (sscanf (&arg[1],
+                      "%u",
+                      &mtu)))
+    {
+      fprintf (stderr,
+               "Error in interface specification: MTU not a number\n");
+      return 1;
+    }
+    if (mtu < 400)
+    {
+      fprintf (stderr,
+               "Error in interface specification: MTU too small\n");
+      return 1;
+    }
+    ifc->mtu = mtu + sizeof (struct EthernetHeader);
+  }
+  return 0;
+}
+
+
+/**
+ * Handle control message @a cmd.
+ *
+ * @param cmd text the user entered
+ * @param cmd_len length of @a cmd
+ */
+static void
+handle_control (char *cmd,
+                size_t cmd_len)
+{
+  const char *tok;
+
+  cmd[cmd_len - 1] = '\0';
+  tok = strtok (cmd,
+                " ");
+  if (NULL == tok)
+    return;
+  if (0 == strcasecmp (tok,
+                       "arp"))
+    process_cmd_arp ();
+  else
+    fprintf (stderr,
+             "Unsupported command `%s'\n",
+             tok);
+}
+
+
+/**
+ * Handle MAC information @a mac
+ *
+ * @param ifc_num number of the interface with @a mac
+ * @param mac the MAC address at @a ifc_num
+ */
+static void
+handle_mac (uint16_t ifc_num,
+            const struct MacAddress *mac)
+{
+  if (ifc_num > num_ifc)
+    abort ();
+  gifc[ifc_num - 1].mac = *mac;
+  arp_cache_mac (ifc_num,
+                 mac);
+}
+
+
+/**
+ * Launches the arp tool.
+ *
+ * @param argc number of arguments in @a argv
+ * @param argv binary name, followed by options ("--arp-reachable=MS"
+ *        to keep the addresses of neighbours for MS ms, see
+ *        arp_cache_init()), followed by list of interfaces to switch
+ *        between
+ * @return not really
+ */
+int
+main (int argc,
+      char **argv)
+{
+  struct Interface ifc[argc];
+  unsigned int reachable = 0;
+  int first = 1;
+
+  while ( (first < argc) &&
+          (0 == strncmp (argv[first],
+                         "--",
+                         2)) )
+  {
+    if (0 == strncmp (argv[first],
+                      "--arp-reachable=",
+                      strlen ("--arp-reachable=")))
+    {
+      reachable = strtoul (&argv[first][strlen ("--arp-reachable=")],
+                           NULL,
+                           10);
+    }
+    else
+    {
+      fprintf (stderr,
+               "Unsupported option `%s'\n",
+               argv[first]);
+      return 1;
+    }
+    first++;
+  }
+  memset (ifc,
+          0,
+          sizeof (ifc));
+  num_ifc = argc - first;
+  gifc = ifc;
+  if (0 != arp_cache_init (num_ifc,
+                           reachable))
+  {
+    perror ("calloc");
+    return 1;
+  }
+  for (unsigned int i = 1; i<=num_ifc; i++)
+  {
+    struct Interface *p = &ifc[i - 1];
+
+    ifc[i - 1].ifc_num = i;
+    if (0 !=
+        parse_cmd_arg (p,
+                       argv[first + i - 1]))
+      abort ();
+    arp_cache_interface (i,
+                         p->name,
+                         p->ip);
+  }
+  loop (&handle_frame,
+        &handle_control,
+        &handle_mac);
+  arp_cache_destroy ();
+  for (unsigned int i = 1; i<=num_ifc; i++)
+    free (ifc[i - 1].name);
+  return 0;
+}
@@ -1,176 +1,900 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2010, 2012, 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-/**
- * @file glab.h
- * @brief Protocol definitions for network-driver
- * @author Christian Grothoff
- */
-
-#ifndef GLAB_IPC_H
-#define GLAB_IPC_H
-
-#define _GNU_SOURCE
-#include <stdarg.h>
-#include <string.h>
-#include <errno.h>
-#include <stdio.h>
-#include <unistd.h>
-#include <stddef.h>
-#include <signal.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <arpa/inet.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <time.h>
-#include <byteswap.h>
-#include <linux/if.h>
-#include <linux/if_tun.h>
-
-
-/**
- * gcc 4.x-ism to pack structures (to be used before structs);
- * Using this still causes structs to be unaligned on the stack on Sparc
- * (See #670578 from Debian).
- */
-_Pragma("pack(push)") _Pragma("pack(1)")
-
-/**
- * Header for all communications between components.
- */
-struct GLAB_MessageHeader
-{
-
-  /**
-   * The length of the struct (in bytes, including the length field itself),
-   * in big-endian format.
-   */
-  uint16_t size;
-
-  /**
-   * The type of the message. 0 for 'control' (commands, feedback for
-   * user), otherwise packets received from or to be sent to an
-   * adapter. The first control message includes the list of all MAC
-   * addresses in the body. In all other cases, type is used to
-   * specify the number of the adapter (counting from 1).
-   */
-  uint16_t type;
-
-};
-
-
-/**
- * Number of bytes in a MAC.
- */
-#define MAC_ADDR_SIZE 6
-
-
-/**
- * A MAC Address.
- */
-struct MacAddress
-{
-  uint8_t mac[MAC_ADDR_SIZE];
-};
-
-
-_Pragma("pack(pop)")
-
-
-/**
- * Process frame received from @a interface.
- *
- * @param interface number of the interface on which we received @a frame
- * @param frame the frame
- * @param frame_size number of bytes in @a frame
- */
-typedef void
-(*FrameHandler)(uint16_t interface,
-                const void *frame,
-                size_t frame_size);
-
-/**
- * Handle control message @a cmd.
- *
- * @param cmd text the user entered
- * @param cmd_len length of @a cmd
- */
-typedef void
-(*ControlHandler)(char *cmd,
-                  size_t cmd_len);
-
-/**
- * Handle MAC information @a mac
- *
- * @param ifc_num number of the interface with @a mac
- * @param mac the MAC address at @a ifc_num
- */
-typedef void
-(*MacHandler)(uint16_t ifc_num,
-              const struct MacAddress *mac);
-
-
-/**
- * Sample main loop.  Reads packets from STDIN_FILENO and calls fh(),
- * ch() or mh() on each depending on the type.
- */
-void
-loop (FrameHandler fh,
-      ControlHandler ch,
-      MacHandler mh);
-
-
-/**
- * Helper function to deal with partial writes.
- * Fails hard (calls exit() on failures)!
- *
- * @param fd where to write to
- * @param buf what to write
- * @param buf_size number of bytes in @a buf
- */
-void
-write_all (int fd,
-           const void *buf,
-           size_t buf_size);
-
-
-/**
- * Print message to the user by sending to parent.
- *
- * @param fmt format string
- * @param ... arguments for @a fmt
- */
-void
-print (const char *fmt,
-       ...)  __attribute__ ((format (gnu_printf, 1, 2)));
-
-/**
- * Calculate the checksum of a buffer in one step.
- *
- * @param buf buffer to  calculate CRC over (must be 16-bit aligned)
- * @param len number of bytes in hdr, must be multiple of 2
- * @return crc16 value
- */
-uint16_t
-GNUNET_CRYPTO_crc16_n (const void *buf, size_t len);
-
-
-#endif
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2010, 2012, 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+ * @file glab.h
+ * @brief Protocol definitions for network-driver
+ * @author Christian Grothoff
+ */
+
+#ifndef GLAB_IPC_H
+#define GLAB_IPC_H
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <byteswap.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+
+/**
+ * gcc 4.x-ism to pack structures (to be used before structs);
+ * Using this still causes structs to be unaligned on the stack on Sparc
+ * (See #670578 from Debian).
+ */
+_Pragma("pack(push)") _Pragma("pack(1)")
+
+/**
+ * Header for all communications between components.
+ */
+struct GLAB_MessageHeader
+{
+
+  /**
+   * The length of the struct (in bytes, including the length field itself),
+   * in big-endian format.
+   */
+  uint16_t size;
+
+  /**
+   * The type of the message. 0 for 'control' (commands, feedback for
+   * user), otherwise packets received from or to be sent to an
+   * adapter. The first control message includes the list of all MAC
+   * addresses in the body, optionally followed by the capabilities
+   * of the driver (see #GLAB_CAP_BATCH). In all other cases, type is
+   * used to specify the number of the adapter (counting from 1).
+   * Types from #GLAB_TYPE_RESERVED upwards are used by the protocol
+   * itself.
+   */
+  uint16_t type;
+
+};
+
+
+/**
+ * Message types from here on are not interface numbers, but
+ * reserved for the protocol between network-driver and the child.
+ */
+#define GLAB_TYPE_RESERVED 0xFF00
+
+/**
+ * Batch of messages: the body is a `struct GLAB_BatchHeader`, the
+ * descriptors of the messages and their data.  Sent without body by
+ * a child that wants to exchange batches (see #GLAB_CAP_BATCH); from
+ * then on, both sides may send batches on the pipe.
+ */
+#define GLAB_TYPE_BATCH 0xFFFE
+
+/**
+ * Shared-memory handshake.  Sent (without body) by a child that
+ * attached to the rings offered in #GLAB_SHM_ENV.  The driver replies
+ * with the same type as its last message on the pipe; all further
+ * traffic in both directions goes through the rings.
+ */
+#define GLAB_TYPE_SHM 0xFFFF
+
+/**
+ * Capability of the driver: it understands #GLAB_TYPE_BATCH.  The
+ * capabilities are a 16-bit big-endian bit field behind the MAC
+ * addresses in the first control message.  As it is shorter than a
+ * MAC address, children that do not know about it ignore it.
+ */
+#define GLAB_CAP_BATCH 0x0001
+
+
+/**
+ * Start of the body of a #GLAB_TYPE_BATCH message.
+ */
+struct GLAB_BatchHeader
+{
+
+  /**
+   * Number of messages in the batch, in big-endian format.  The
+   * descriptors of the messages follow.
+   */
+  uint16_t count;
+
+};
+
+
+/**
+ * Message in a #GLAB_TYPE_BATCH message.
+ */
+struct GLAB_BatchDescriptor
+{
+
+  /**
+   * Type of the message, as in `struct GLAB_MessageHeader` but
+   * below #GLAB_TYPE_RESERVED, in big-endian format.
+   */
+  uint16_t type;
+
+  /**
+   * Number of bytes in the message, in big-endian format.
+   */
+  uint16_t size;
+
+  /**
+   * Offset of the message from the start of the body of the batch,
+   * in big-endian format.
+   */
+  uint16_t offset;
+
+};
+
+
+/**
+ * Number of bytes in a MAC.
+ */
+#define MAC_ADDR_SIZE 6
+
+
+/**
+ * A MAC Address.
+ */
+struct MacAddress
+{
+  uint8_t mac[MAC_ADDR_SIZE];
+};
+
+
+_Pragma("pack(pop)")
+
+
+/**
+ * Environment variable in which network-driver offers the
+ * shared-memory transport to the child, as
+ * "MEMFD,DRIVER_EVENTFD,CHILD_EVENTFD".
+ */
+#define GLAB_SHM_ENV "GLAB_SHM"
+
+/**
+ * Magic number at the start of the shared-memory region.
+ */
+#define GLAB_SHM_MAGIC 0x474c4142
+
+/**
+ * Number of descriptors per ring, must be a power of two.
+ */
+#define GLAB_RING_SLOTS 4096
+
+/**
+ * Number of bytes of frame data per ring, must be a power of two.
+ */
+#define GLAB_RING_DATA_SIZE (4 * 1024 * 1024)
+
+
+/**
+ * Message in a shared-memory ring.
+ */
+struct GLAB_RingDescriptor
+{
+  /**
+   * Position of the message in the data ring (modulo
+   * #GLAB_RING_DATA_SIZE).
+   */
+  uint32_t offset;
+
+  /**
+   * Number of bytes in the message.
+   */
+  uint32_t size;
+
+  /**
+   * Type of the message, as in `struct GLAB_MessageHeader`.
+   */
+  uint16_t type;
+
+  /**
+   * Always zero.
+   */
+  uint16_t reserved;
+};
+
+
+/**
+ * Single-producer/single-consumer ring in shared memory.  Indices
+ * are free-running counters; fields written by different sides live
+ * in different cache lines.
+ */
+struct GLAB_RingShared
+{
+  /**
+   * Number of descriptors published by the producer.
+   */
+  _Alignas (64) _Atomic uint32_t head;
+
+  /**
+   * Number of descriptors released by the consumer.
+   */
+  _Alignas (64) _Atomic uint32_t tail;
+
+  /**
+   * End of the data released by the consumer.
+   */
+  _Atomic uint32_t data_tail;
+
+  /**
+   * Set by the consumer before it sleeps on its eventfd.
+   */
+  _Alignas (64) _Atomic uint32_t consumer_waiting;
+
+  /**
+   * Set by the producer before it sleeps on its eventfd.
+   */
+  _Atomic uint32_t producer_waiting;
+
+  /**
+   * The descriptors.
+   */
+  _Alignas (64) struct GLAB_RingDescriptor desc[GLAB_RING_SLOTS];
+
+  /**
+   * The frame data.
+   */
+  _Alignas (64) unsigned char data[GLAB_RING_DATA_SIZE];
+};
+
+
+/**
+ * Layout of the shared-memory region.
+ */
+struct GLAB_ShmRegion
+{
+  /**
+   * #GLAB_SHM_MAGIC.
+   */
+  uint32_t magic;
+
+  /**
+   * sizeof (struct GLAB_ShmRegion), to detect mismatching builds.
+   */
+  uint32_t size;
+
+  /**
+   * Frames from the driver to the child.
+   */
+  struct GLAB_RingShared to_child;
+
+  /**
+   * Frames from the child to the driver.
+   */
+  struct GLAB_RingShared to_driver;
+};
+
+
+/**
+ * One side's view of a shared-memory ring.
+ */
+struct GLAB_Ring
+{
+  /**
+   * The ring.
+   */
+  struct GLAB_RingShared *shared;
+
+  /**
+   * Producer: number of descriptors written (published or not).
+   * Consumer: number of descriptors taken (released or not).
+   */
+  uint32_t pos;
+
+  /**
+   * Producer: end of the data written.
+   * Consumer: end of the data taken.
+   */
+  uint32_t data_pos;
+
+  /**
+   * Producer: last known tail.  Consumer: last known head.
+   */
+  uint32_t peer_pos;
+
+  /**
+   * Producer: last known data tail.
+   */
+  uint32_t peer_data_pos;
+
+  /**
+   * eventfd to ring the other side's doorbell.
+   */
+  int peer_fd;
+};
+
+
+/**
+ * Shared-memory transport, as seen by one side.
+ */
+struct GLAB_Shm
+{
+  /**
+   * The mapped region.
+   */
+  struct GLAB_ShmRegion *region;
+
+  /**
+   * Ring we consume from.
+   */
+  struct GLAB_Ring rx;
+
+  /**
+   * Ring we produce into.
+   */
+  struct GLAB_Ring tx;
+
+  /**
+   * memfd backing @e region.
+   */
+  int memfd;
+
+  /**
+   * Our doorbell: eventfd that becomes readable when the other side
+   * produced into @e rx or released space in @e tx while we waited.
+   */
+  int wait_fd;
+};
+
+
+/**
+ * Process frame received from @a interface.
+ *
+ * @param interface number of the interface on which we received @a frame
+ * @param frame the frame
+ * @param frame_size number of bytes in @a frame
+ */
+typedef void
+(*FrameHandler)(uint16_t interface,
+                const void *frame,
+                size_t frame_size);
+
+/**
+ * Frame received from an interface, as passed to a #FrameBatchHandler.
+ */
+struct FrameDescriptor
+{
+  /**
+   * The frame.  Remains valid until the handler returns.
+   */
+  const void *frame;
+
+  /**
+   * Number of bytes in @e frame.
+   */
+  size_t frame_size;
+
+  /**
+   * Number of the interface on which we received @e frame.
+   */
+  uint16_t interface;
+};
+
+
+/**
+ * Process a batch of frames, in the order they were received.
+ *
+ * @param frames the frames
+ * @param num_frames number of entries in @a frames
+ */
+typedef void
+(*FrameBatchHandler)(const struct FrameDescriptor *frames,
+                     unsigned int num_frames);
+
+/**
+ * Handle control message @a cmd.
+ *
+ * @param cmd text the user entered
+ * @param cmd_len length of @a cmd
+ */
+typedef void
+(*ControlHandler)(char *cmd,
+                  size_t cmd_len);
+
+/**
+ * Handle MAC information @a mac
+ *
+ * @param ifc_num number of the interface with @a mac
+ * @param mac the MAC address at @a ifc_num
+ */
+typedef void
+(*MacHandler)(uint16_t ifc_num,
+              const struct MacAddress *mac);
+
+
+struct Timer;
+
+/**
+ * Function called when a timer expires.
+ *
+ * @param t the timer that expired (no longer scheduled)
+ */
+typedef void
+(*TimerCallback)(struct Timer *t);
+
+
+/**
+ * Timer serviced by loop().  Embed into the structure that
+ * needs the timeout; must be zero-initialized before first use.
+ */
+struct Timer
+{
+  /**
+   * Next timer in the same slot of the wheel.
+   */
+  struct Timer *next;
+
+  /**
+   * Pointer to the pointer pointing to us, NULL if not scheduled.
+   */
+  struct Timer **pprev;
+
+  /**
+   * When does the timer expire (in ticks of the wheel)?
+   */
+  uint64_t expires;
+
+  /**
+   * Function to call on expiration.
+   */
+  TimerCallback cb;
+};
+
+
+/**
+ * Get the current time.
+ *
+ * @return monotonic time in milliseconds
+ */
+uint64_t
+timer_now (void);
+
+
+/**
+ * Schedule @a t to call @a cb at time @a expires.  If @a t is
+ * already scheduled, it is moved.
+ *
+ * @param t timer to schedule
+ * @param expires absolute time (see timer_now()) in milliseconds
+ * @param cb function to call once @a t expires
+ */
+void
+timer_schedule (struct Timer *t,
+                uint64_t expires,
+                TimerCallback cb);
+
+
+/**
+ * Cancel @a t.  Does nothing if @a t is not scheduled.
+ *
+ * @param t timer to cancel
+ */
+void
+timer_cancel (struct Timer *t);
+
+
+/**
+ * Run all timers that have expired by now.
+ */
+void
+timer_run (void);
+
+
+/**
+ * Compute how long loop() may block before timer_run() must be called.
+ *
+ * @return timeout in milliseconds, -1 if no timers are scheduled
+ */
+int
+timer_next_timeout (void);
+
+
+/**
+ * Sample main loop.  Reads packets from STDIN_FILENO and calls fh(),
+ * ch() or mh() on each depending on the type.  Expired timers
+ * are run between reads.
+ */
+void
+loop (FrameHandler fh,
+      ControlHandler ch,
+      MacHandler mh);
+
+
+/**
+ * Main loop handing frames to the application in batches.  Reads
+ * packets from STDIN_FILENO and calls fbh() with all frames parsed
+ * from one read (up to a limit), ch() or mh() depending on the type.
+ * Frames received before a control message are always passed to
+ * fbh() before ch() is called.  Output is flushed after each batch
+ * of input.  Expired timers are run between reads.
+ */
+void
+loop_batch (FrameBatchHandler fbh,
+            ControlHandler ch,
+            MacHandler mh);
+
+
+/**
+ * Helper function to deal with partial writes.
+ * Fails hard (calls exit() on failures)!
+ *
+ * @param fd where to write to
+ * @param buf what to write
+ * @param buf_size number of bytes in @a buf
+ */
+void
+write_all (int fd,
+           const void *buf,
+           size_t buf_size);
+
+
+/**
+ * Helper function to deal with partial writes of a gather write.
+ * Fails hard (calls exit() on failures)!
+ *
+ * @param fd where to write to
+ * @param iov buffers to write, modified to track progress
+ * @param iovcnt number of entries in @a iov
+ */
+void
+writev_all (int fd,
+            struct iovec *iov,
+            int iovcnt);
+
+
+/**
+ * Queue a frame for interface @a ifc_num (0 for a control message).
+ * The frame consists of @a head followed by @a body.  @a head is
+ * copied, @a body is only referenced and must remain valid until
+ * output_flush() is called.  loop() flushes after processing each
+ * batch of input and before reusing its buffer, so frames received
+ * from loop() may be passed as @a body.  The batch is also flushed
+ * whenever it fills up.
+ *
+ * @param ifc_num interface to send the frame out on
+ * @param head first part of the frame, may be NULL
+ * @param head_size number of bytes in @a head
+ * @param body second part of the frame, may be NULL
+ * @param body_size number of bytes in @a body
+ */
+void
+output_frame (uint16_t ifc_num,
+              const void *head,
+              size_t head_size,
+              const void *body,
+              size_t body_size);
+
+
+/**
+ * Write all queued frames to the parent with as few system
+ * calls as possible.
+ */
+void
+output_flush (void);
+
+
+/**
+ * Create the shared-memory region and doorbells (driver side).
+ *
+ * @param shm[out] set to the driver's view of the transport
+ * @return 0 on success, -1 on error
+ */
+int
+shm_create (struct GLAB_Shm *shm);
+
+
+/**
+ * Offer @a shm to a child about to be exec'ed by setting
+ * #GLAB_SHM_ENV.
+ *
+ * @param shm transport from shm_create()
+ * @return 0 on success, -1 on error
+ */
+int
+shm_offer (const struct GLAB_Shm *shm);
+
+
+/**
+ * Attach to the region offered in #GLAB_SHM_ENV (child side).
+ *
+ * @param shm[out] set to the child's view of the transport
+ * @return 0 on success, -1 if no (usable) region was offered
+ */
+int
+shm_attach (struct GLAB_Shm *shm);
+
+
+/**
+ * Set up the other side's view of @a shm in this process, for
+ * rings between threads.  Only @a shm must be destroyed.
+ *
+ * @param shm transport from shm_create()
+ * @param peer[out] set to the other side's view of @a shm
+ */
+void
+shm_peer (const struct GLAB_Shm *shm,
+          struct GLAB_Shm *peer);
+
+
+/**
+ * Unmap @a shm and close its file descriptors.
+ *
+ * @param shm transport to release
+ */
+void
+shm_destroy (struct GLAB_Shm *shm);
+
+
+/**
+ * Clear our doorbell after waking up from it.
+ *
+ * @param shm transport whose doorbell rang
+ */
+void
+shm_drain (struct GLAB_Shm *shm);
+
+
+/**
+ * Reserve room for a message of @a size bytes in @a r.
+ *
+ * @param r ring to produce into
+ * @param size number of bytes needed
+ * @return where to put the message, NULL if @a r is full
+ */
+void *
+ring_reserve (struct GLAB_Ring *r,
+              uint32_t size);
+
+
+/**
+ * Add the message written to the last ring_reserve() to @a r.
+ * It is visible to the consumer after ring_publish().
+ *
+ * @param r ring to produce into
+ * @param type message type
+ * @param size actual number of bytes, at most what was reserved
+ */
+void
+ring_commit (struct GLAB_Ring *r,
+             uint16_t type,
+             uint32_t size);
+
+
+/**
+ * Make all committed messages visible to the consumer, and ring its
+ * doorbell if it is waiting.
+ *
+ * @param r ring to produce into
+ */
+void
+ring_publish (struct GLAB_Ring *r);
+
+
+/**
+ * Take the next message from @a r.  Its data remains valid until
+ * ring_release().
+ *
+ * @param r ring to consume from
+ * @param type[out] message type
+ * @param size[out] number of bytes at @a data
+ * @return the message, NULL if @a r is empty
+ */
+void *
+ring_pop (struct GLAB_Ring *r,
+          uint16_t *type,
+          uint32_t *size);
+
+
+/**
+ * Return the space of all messages taken so far to the producer,
+ * and ring its doorbell if it is waiting.
+ *
+ * @param r ring to consume from
+ */
+void
+ring_release (struct GLAB_Ring *r);
+
+
+/**
+ * Announce that the consumer of @a r is about to sleep.
+ *
+ * @param r ring to consume from
+ * @return true if @a r is empty and the caller should wait for its
+ *         doorbell, false if messages arrived in the meantime
+ */
+bool
+ring_consumer_sleep (struct GLAB_Ring *r);
+
+
+/**
+ * Announce that the producer of @a r is about to sleep until
+ * @a size bytes are available.
+ *
+ * @param r ring to produce into
+ * @param size number of bytes needed
+ * @return true if @a r is still full and the caller should wait for
+ *         its doorbell, false if space became available
+ */
+bool
+ring_producer_sleep (struct GLAB_Ring *r,
+                     uint32_t size);
+
+
+/**
+ * Send output through the rings of @a shm instead of STDOUT_FILENO.
+ *
+ * @param shm attached transport
+ */
+void
+output_use_shm (struct GLAB_Shm *shm);
+
+
+/**
+ * Send frames to the parent in #GLAB_TYPE_BATCH messages.
+ */
+void
+output_use_batches (void);
+
+
+/**
+ * Set up the ARP cache of arp and router (see arp-cache.c).
+ *
+ * @param num_ifc number of interfaces
+ * @param reachable_ms how long (in ms) a neighbour is considered
+ *        reachable after it confirmed its address, 0 for the
+ *        default; the other timers of the cache scale with it
+ * @return 0 on success, -1 if we are out of memory
+ */
+int
+arp_cache_init (unsigned int num_ifc,
+                unsigned int reachable_ms);
+
+
+/**
+ * Tell the ARP cache about interface @a ifc_num.
+ *
+ * @param ifc_num number of the interface
+ * @param name name of the interface, must remain valid until
+ *        arp_cache_destroy()
+ * @param ip our IPv4 address on the interface
+ */
+void
+arp_cache_interface (uint16_t ifc_num,
+                     const char *name,
+                     struct in_addr ip);
+
+
+/**
+ * Tell the ARP cache the MAC address @a mac of interface @a ifc_num.
+ *
+ * @param ifc_num number of the interface
+ * @param mac our MAC address on the interface
+ */
+void
+arp_cache_mac (uint16_t ifc_num,
+               const struct MacAddress *mac);
+
+
+/**
+ * Release the ARP cache and drop all held packets.
+ */
+void
+arp_cache_destroy (void);
+
+
+/**
+ * Look up the MAC address of @a ip on @a ifc_num for sending a frame
+ * there.  Using a stale entry makes us confirm it.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @return NULL if @a ip is not in the cache
+ */
+const struct MacAddress *
+arp_resolve (uint16_t ifc_num,
+             struct in_addr ip);
+
+
+/**
+ * Broadcast a request for the MAC address of @a ip on @a ifc_num.
+ *
+ * @param ifc_num interface to send the request out on
+ * @param ip IPv4 address to resolve
+ */
+void
+arp_request (uint16_t ifc_num,
+             struct in_addr ip);
+
+
+/**
+ * Hold an IPv4 packet for @a ip on @a ifc_num until we know its
+ * address, then send it in an Ethernet frame.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param ip IPv4 address of the neighbour
+ * @param head start of the packet
+ * @param head_size number of bytes in @a head
+ * @param data rest of the packet
+ * @param data_size number of bytes in @a data
+ */
+void
+arp_hold (uint16_t ifc_num,
+          struct in_addr ip,
+          const void *head,
+          size_t head_size,
+          const void *data,
+          size_t data_size);
+
+
+/**
+ * Print out the ARP cache.
+ */
+void
+arp_print (void);
+
+
+/**
+ * Process ARP message received on @a ifc_num: answer requests for
+ * our address and learn the addresses of our neighbours.
+ *
+ * @param ifc_num interface we received the message from
+ * @param msg the ARP message (behind the Ethernet header)
+ * @param msg_size number of bytes in @a msg
+ */
+void
+arp_handle (uint16_t ifc_num,
+            const void *msg,
+            size_t msg_size);
+
+
+/**
+ * Print message to the user by sending to parent.
+ *
+ * @param fmt format string
+ * @param ... arguments for @a fmt
+ */
+void
+print (const char *fmt,
+       ...)  __attribute__ ((format (gnu_printf, 1, 2)));
+
+/**
+ * Calculate the checksum of a buffer in one step.
+ *
+ * @param buf buffer to  calculate CRC over (must be 16-bit aligned)
+ * @param len number of bytes in hdr, must be multiple of 2
+ * @return crc16 value
+ */
+uint16_t
+GNUNET_CRYPTO_crc16_n (const void *buf, size_t len);
+
+
+#endif
@@ -1,7 +1,7 @@
-#include <stdio.h>
-int
-main ()
-{
-  printf ("Hello world!\n");
-  return 0;
-}
+#include <stdio.h>
+int
+main ()
+{
+  printf ("Hello world!\n");
+  return 0;
+}
@@ -1,102 +1,485 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file loop.c
- * @brief Sample implementation of the main loop for interacting with the parent
- * @author Christian Grothoff
- */
-#include "glab.h"
-#include <stdlib.h>
-#include <stdio.h>
-
-/**
- * Sample main loop.  Reads packets from STDIN_FILENO
- * and calls handle_mac(), handle_control() or handle_frame()
- * on each depending on the type.
- */
-void
-loop (FrameHandler fh,
-      ControlHandler ch,
-      MacHandler mh)
-{
-  char buf[UINT16_MAX];
-  size_t off;
-  ssize_t ret;
-  int have_mac;
-
-  off = 0;
-  have_mac = 0;
-  while (-1 != (ret = read (STDIN_FILENO,
-                            &buf[off],
-                            sizeof (buf) - off)))
-  {
-    struct GLAB_MessageHeader hdr;
-    uint16_t size;
-
-    if (0 >= ret)
-      break;
-    off += ret;
-    while (off > sizeof (struct GLAB_MessageHeader))
-    {
-      memcpy (&hdr,
-              buf,
-              sizeof (hdr));
-      size = ntohs (hdr.size);
-      if (off < size)
-        break;
-      if (size < sizeof (struct GLAB_MessageHeader))
-        abort ();
-      switch (ntohs (hdr.type))
-      {
-      case 0: /* control */
-        if (0 == have_mac)
-        {
-          for (unsigned int i = 0; i<(size - sizeof (hdr)) / sizeof (struct
-                                                                     MacAddress);
-               i++)
-          {
-            struct MacAddress mac;
-
-            memcpy (&mac,
-                    &buf[sizeof (hdr) + i * sizeof (struct MacAddress)],
-                    sizeof (struct MacAddress));
-            mh (i + 1,
-                &mac);
-          }
-          have_mac = 1;
-        }
-        else
-        {
-          ch (&buf[sizeof (hdr)],
-              size - sizeof (hdr));
-        }
-        break;
-      default:
-        fh (ntohs (hdr.type),
-            (const void *) &buf[sizeof (hdr)],
-            size - sizeof (hdr));
-        break;
-      }
-      memmove (buf,
-               &buf[size],
-               off - size);
-      off -= size;
-    }
-  }
-}
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file loop.c
+ * @brief Sample implementation of the main loop for interacting with the parent
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <poll.h>
+
+
+/**
+ * Size of the input buffer.  Much larger than a single message, so that
+ * one read() can pick up a whole burst of frames.
+ */
+#define LOOP_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Maximum number of frames passed to the #FrameBatchHandler at once.
+ */
+#define LOOP_MAX_BATCH 256
+
+
+/**
+ * Per-frame handler used by loop().
+ */
+static FrameHandler frame_handler;
+
+
+/**
+ * State of loop_batch().
+ */
+struct LoopContext
+{
+  /**
+   * Frames parsed but not yet passed to @e fbh.
+   */
+  struct FrameDescriptor batch[LOOP_MAX_BATCH];
+
+  /**
+   * Handler for frames.
+   */
+  FrameBatchHandler fbh;
+
+  /**
+   * Handler for control messages.
+   */
+  ControlHandler ch;
+
+  /**
+   * Handler for the MAC addresses.
+   */
+  MacHandler mh;
+
+  /**
+   * Shared-memory transport offered by the parent, if any.
+   */
+  struct GLAB_Shm shm;
+
+  /**
+   * Number of entries used in @e batch.
+   */
+  unsigned int batch_len;
+
+  /**
+   * Did we get the MAC addresses already?
+   */
+  int have_mac;
+
+  /**
+   * Did we attach to @e shm?
+   */
+  int have_shm;
+};
+
+
+/**
+ * Wait until input is available, running timers that expire in the
+ * meantime.  With @a shm, input is a message in its ring; otherwise
+ * (or if STDIN_FILENO becomes readable, i.e. closed), STDIN_FILENO.
+ *
+ * @param shm shared-memory transport, NULL to wait for the pipe
+ * @return 0 once input is available, -1 on error
+ */
+static int
+wait_for_input (struct GLAB_Shm *shm)
+{
+  struct pollfd pfd[2] = {
+    {
+      .fd = STDIN_FILENO,
+      .events = POLLIN
+    },
+    {
+      .fd = (NULL != shm) ? shm->wait_fd : -1,
+      .events = POLLIN
+    }
+  };
+
+  while (1)
+  {
+    int ret;
+
+    if ( (NULL != shm) &&
+         (! ring_consumer_sleep (&shm->rx)) )
+    {
+      timer_run ();
+      output_flush ();
+      return 0;
+    }
+    ret = poll (pfd,
+                2,
+                timer_next_timeout ());
+    if (-1 == ret)
+    {
+      if (EINTR == errno)
+        continue;
+      return -1;
+    }
+    timer_run ();
+    output_flush ();
+    if (0 != (pfd[0].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)))
+      return (NULL != shm) ? -1 : 0;
+    if (0 != (pfd[1].revents & POLLIN))
+      shm_drain (shm);
+  }
+}
+
+
+/**
+ * Pass the frames collected so far to the application.
+ *
+ * @param lc loop state
+ */
+static void
+deliver_batch (struct LoopContext *lc)
+{
+  if (0 == lc->batch_len)
+    return;
+  lc->fbh (lc->batch,
+           lc->batch_len);
+  lc->batch_len = 0;
+}
+
+
+/**
+ * Process message of @a type from the parent.  Frames are
+ * collected into the batch, which must be delivered before
+ * @a body becomes invalid.
+ *
+ * @param lc loop state
+ * @param type type of the message
+ * @param body payload of the message
+ * @param body_size number of bytes in @a body
+ * @return 1 if the parent switched to the shared-memory rings, 0 otherwise
+ */
+static int
+handle_message (struct LoopContext *lc,
+                uint16_t type,
+                char *body,
+                size_t body_size)
+{
+  if (type >= GLAB_TYPE_RESERVED)
+  {
+    if ( (GLAB_TYPE_SHM != type) ||
+         (! lc->have_shm) )
+      return 0;
+    deliver_batch (lc);
+    return 1;
+  }
+  if (0 != type)
+  {
+    lc->batch[lc->batch_len].frame = body;
+    lc->batch[lc->batch_len].frame_size = body_size;
+    lc->batch[lc->batch_len].interface = type;
+    if (LOOP_MAX_BATCH == ++lc->batch_len)
+      deliver_batch (lc);
+    return 0;
+  }
+  /* keep frames and control messages in order */
+  deliver_batch (lc);
+  if (lc->have_mac)
+  {
+    lc->ch (body,
+            body_size);
+    return 0;
+  }
+  for (unsigned int i = 0; i<body_size / sizeof (struct MacAddress); i++)
+  {
+    struct MacAddress mac;
+
+    memcpy (&mac,
+            &body[i * sizeof (struct MacAddress)],
+            sizeof (struct MacAddress));
+    lc->mh (i + 1,
+            &mac);
+  }
+  lc->have_mac = 1;
+  /* the MAC addresses may be followed by the parent's capabilities */
+  if ( (! lc->have_shm) &&
+       (body_size % sizeof (struct MacAddress) >= sizeof (uint16_t)) )
+  {
+    uint16_t caps;
+
+    memcpy (&caps,
+            &body[body_size - body_size % sizeof (struct MacAddress)],
+            sizeof (caps));
+    if (0 != (ntohs (caps) & GLAB_CAP_BATCH))
+    {
+      /* an empty batch tells the parent we accept batches */
+      output_frame (GLAB_TYPE_BATCH,
+                    NULL,
+                    0,
+                    NULL,
+                    0);
+      output_use_batches ();
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * Process the messages of a #GLAB_TYPE_BATCH message from the parent.
+ *
+ * @param lc loop state
+ * @param body payload of the batch
+ * @param body_size number of bytes in @a body
+ */
+static void
+handle_batch (struct LoopContext *lc,
+              char *body,
+              size_t body_size)
+{
+  struct GLAB_BatchHeader bh;
+  size_t head;
+  uint16_t count;
+
+  if (body_size < sizeof (bh))
+    abort ();
+  memcpy (&bh,
+          body,
+          sizeof (bh));
+  count = ntohs (bh.count);
+  head = sizeof (bh) + count * sizeof (struct GLAB_BatchDescriptor);
+  if (body_size < head)
+    abort ();
+  for (unsigned int i = 0; i<count; i++)
+  {
+    struct GLAB_BatchDescriptor d;
+    uint16_t size;
+    uint16_t offset;
+
+    memcpy (&d,
+            &body[sizeof (bh) + i * sizeof (d)],
+            sizeof (d));
+    size = ntohs (d.size);
+    offset = ntohs (d.offset);
+    if ( (offset < head) ||
+         (offset + size > body_size) ||
+         (ntohs (d.type) >= GLAB_TYPE_RESERVED) )
+      abort ();
+    (void) handle_message (lc,
+                           ntohs (d.type),
+                           &body[offset],
+                           size);
+  }
+}
+
+
+/**
+ * Process messages from STDIN_FILENO.
+ *
+ * @param lc loop state
+ * @return 1 if the parent switched to the shared-memory rings,
+ *         0 on end of input
+ */
+static int
+loop_pipe (struct LoopContext *lc)
+{
+  char *buf;
+  /* end of the data read so far */
+  size_t off;
+  /* start of the first message not yet processed */
+  size_t pos;
+  ssize_t ret;
+  int switched;
+
+  buf = malloc (LOOP_BUFFER_SIZE);
+  if (NULL == buf)
+    abort ();
+  off = 0;
+  pos = 0;
+  switched = 0;
+  while ( (! switched) &&
+          (0 == wait_for_input (NULL)) &&
+          (-1 != (ret = read (STDIN_FILENO,
+                              &buf[off],
+                              LOOP_BUFFER_SIZE - off))) )
+  {
+    struct GLAB_MessageHeader hdr;
+    uint16_t size;
+
+    if (0 >= ret)
+      break;
+    off += ret;
+    /* process all complete messages in place */
+    while ( (! switched) &&
+            (off - pos >= sizeof (struct GLAB_MessageHeader)) )
+    {
+      char *msg = &buf[pos];
+
+      memcpy (&hdr,
+              msg,
+              sizeof (hdr));
+      size = ntohs (hdr.size);
+      if (off - pos < size)
+        break;
+      if (size < sizeof (struct GLAB_MessageHeader))
+        abort ();
+      if ( (GLAB_TYPE_BATCH == ntohs (hdr.type)) &&
+           (size > sizeof (hdr)) )
+        handle_batch (lc,
+                      &msg[sizeof (hdr)],
+                      size - sizeof (hdr));
+      else
+        switched = handle_message (lc,
+                                   ntohs (hdr.type),
+                                   &msg[sizeof (hdr)],
+                                   size - sizeof (hdr));
+      pos += size;
+    }
+    deliver_batch (lc);
+    /* frames queued for output may point into 'buf' */
+    output_flush ();
+    if (pos == off)
+    {
+      /* everything consumed, start over without copying */
+      pos = 0;
+      off = 0;
+    }
+    else if (LOOP_BUFFER_SIZE - off < UINT16_MAX)
+    {
+      /* not enough room left for a maximum-size message,
+         move the (partial) remainder to the front */
+      memmove (buf,
+               &buf[pos],
+               off - pos);
+      off -= pos;
+      pos = 0;
+    }
+  }
+  output_flush ();
+  free (buf);
+  return switched;
+}
+
+
+/**
+ * Process messages from the shared-memory ring until the parent
+ * closes STDIN_FILENO.  Frames are passed to the application
+ * straight from the ring.
+ *
+ * @param lc loop state
+ */
+static void
+loop_shm (struct LoopContext *lc)
+{
+  struct GLAB_Ring *rx = &lc->shm.rx;
+
+  while (0 == wait_for_input (&lc->shm))
+  {
+    void *msg;
+    uint16_t type;
+    uint32_t size;
+
+    for (unsigned int i = 0; i<LOOP_MAX_BATCH; i++)
+    {
+      msg = ring_pop (rx,
+                      &type,
+                      &size);
+      if (NULL == msg)
+        break;
+      (void) handle_message (lc,
+                             type,
+                             msg,
+                             size);
+    }
+    deliver_batch (lc);
+    output_flush ();
+    ring_release (rx);
+  }
+}
+
+
+/**
+ * Main loop handing frames to the application in batches.  Reads
+ * packets from STDIN_FILENO and calls fbh() with all frames parsed
+ * from one read (up to a limit), ch() or mh() depending on the type.
+ * Frames received before a control message are always passed to
+ * fbh() before ch() is called.  Output is flushed after each batch
+ * of input.  Expired timers are run between reads.
+ *
+ * If the parent offers shared-memory rings (see #GLAB_SHM_ENV), we
+ * accept them and continue on the rings once the parent confirms.
+ */
+void
+loop_batch (FrameBatchHandler fbh,
+            ControlHandler ch,
+            MacHandler mh)
+{
+  static struct LoopContext lc;
+
+  lc.fbh = fbh;
+  lc.ch = ch;
+  lc.mh = mh;
+  lc.batch_len = 0;
+  lc.have_mac = 0;
+  lc.have_shm = (0 == shm_attach (&lc.shm));
+  if (lc.have_shm)
+  {
+    /* accept the offer, all our output goes through the ring now */
+    output_frame (GLAB_TYPE_SHM,
+                  NULL,
+                  0,
+                  NULL,
+                  0);
+    output_use_shm (&lc.shm);
+  }
+  if (1 == loop_pipe (&lc))
+    loop_shm (&lc);
+  output_flush ();
+}
+
+
+/**
+ * Pass each frame of a batch to the #frame_handler given to loop().
+ *
+ * @param frames the frames
+ * @param num_frames number of entries in @a frames
+ */
+static void
+dispatch_frames (const struct FrameDescriptor *frames,
+                 unsigned int num_frames)
+{
+  for (unsigned int i = 0; i<num_frames; i++)
+    frame_handler (frames[i].interface,
+                   frames[i].frame,
+                   frames[i].frame_size);
+}
+
+
+/**
+ * Sample main loop.  Reads packets from STDIN_FILENO
+ * and calls handle_mac(), handle_control() or handle_frame()
+ * on each depending on the type.  Expired timers are run
+ * between reads.
+ */
+void
+loop (FrameHandler fh,
+      ControlHandler ch,
+      MacHandler mh)
+{
+  frame_handler = fh;
+  loop_batch (&dispatch_frames,
+              ch,
+              mh);
+}
@@ -1,994 +1,3813 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2010, 2012, 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file network-driver.c
- * @brief Opens a set of virtual network-interfaces,
- * sends data received on the if to stdout, sends data received on stdin to the
- * interfaces
- * @author Philipp Tölke
- * @author Christian Grothoff
- */
-#include <string.h>
-#include <errno.h>
-#include <stdio.h>
-#include <unistd.h>
-#include <signal.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <arpa/inet.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <linux/if.h>
-#include <linux/llc.h>
-#include <linux/sockios.h>
-#include <linux/ethtool.h>
-#include <linux/if_packet.h>
-#include "glab.h"
-
-
-/**
- * Should we print (interesting|debug) messages that can happen during
- * normal operation?
- */
-#define DEBUG 0
-
-/**
- * Maximum size of a message.
- */
-#define MAX_SIZE (65536 + sizeof (struct GLAB_MessageHeader))
-
-/**
- * Should we filter packets by MAC and only pass on packets for
- * this interface (or multicast)?
- */
-#define FILTER_BY_MAC 0
-
-/**
- * Where is the VLAN tag in the Ethernet frame?
- */
-#define VLAN_OFFSET (2 * MAC_ADDR_SIZE)
-
-struct vlan_tag
-{
-  uint16_t vlan_tpid;     /* ETH_P_8021Q */
-  uint16_t vlan_tci;    /* VLAN TCI */
-};
-
-/**
- * Check if VLAN TCI provided is valid.
- */
-#define VLAN_VALID(hdr, hv) ((hv)->tp_vlan_tci != 0 || ((hdr)->tp_status \
-                                                        & TP_STATUS_VLAN_VALID))
-
-/**
- * Compute the TPID given the AUX Data.
- */
-#define VLAN_TPID(hdr, hv) (((hv)->tp_vlan_tpid || ((hdr)->tp_status \
-                                                    & TP_STATUS_VLAN_TPID_VALID)) \
-  ? (hv)->tp_vlan_tpid : ETH_P_8021Q)
-
-
-#ifndef _LINUX_IN6_H
-/**
- * This is in linux/include/net/ipv6.h, but not always exported...
- */
-struct in6_ifreq
-{
-  struct in6_addr ifr6_addr;
-  uint32_t ifr6_prefixlen;
-  unsigned int ifr6_ifindex;
-};
-#endif
-
-#define MAC_ADDR_SIZE 6
-
-#define MAX(a,b) ((a) > (b))?(a):(b)
-
-/**
- * Information about an interface.
- */
-struct Interface
-{
-
-  /**
-   * Set to our MAC address.
-   */
-  uint8_t my_mac[MAC_ADDR_SIZE];
-
-  /**
-   * File descriptor for the interface.
-   */
-  int fd;
-
-  /**
-   * The buffer filled by reading from @e fd. Plus some extra
-   * space for VLAN tag synthesis.
-   */
-  unsigned char buftun[MAX_SIZE + sizeof (struct vlan_tag)];
-
-  /**
-   * Current offset into @e buftun for writing to #child_stdin.
-   */
-  unsigned char *buftun_off;
-
-  /**
-   * Number of bytes in @e buftun (offset for reading more),
-   * may start at an offset!
-   */
-  size_t buftun_size;
-
-  /**
-   * Number of bytes READY in @e buftun_off for current ready message.
-   * Equals @e buftun_size for normal interfaces, but may differ for
-   * control (cmd_line).
-   */
-  size_t buftun_end;
-
-  /**
-   * index of interface
-   */
-  struct ifreq if_idx;
-
-};
-
-
-/**
- * STDIN of child process (to be written to).
- */
-static int child_stdin;
-
-/**
- * STDOUT of child process (to be read from).
- */
-static int child_stdout;
-
-/**
- * Child PID
- */
-static pid_t chld;
-
-
-/**
- * Creates a tun-interface called dev;
- *
- * @param dev is asumed to point to a char[IFNAMSIZ]
- *        if *dev == '\\0', uses the name supplied by the kernel;
- * @param ifc[out] initialized interface struct
- * @return 0 on success, or -1 on error
- */
-static int
-init_tun (char *dev,
-          struct Interface *ifc)
-{
-  struct ifreq ifr;
-  int fd;
-  struct ifreq if_mac;
-  struct ifreq ifopts;
-  struct ifreq so;
-  struct ethtool_value ev;
-
-  if (NULL == dev)
-  {
-    errno = EINVAL;
-    return -1;
-  }
-
-  if (-1 == (fd = socket (AF_PACKET,
-                          SOCK_RAW,
-                          htons (ETH_P_ALL))))
-  {
-    fprintf (stderr,
-             "Error opening socket: %s\n",
-             strerror (errno));
-    return -1;
-  }
-
-  if (fd >= FD_SETSIZE)
-  {
-    fprintf (stderr,
-             "File descriptor to large: %d",
-             fd);
-    (void) close (fd);
-    return -1;
-  }
-  /* only take traffic of 'dev' */
-  if (0 !=
-      setsockopt (fd,
-                  SOL_SOCKET,
-                  SO_BINDTODEVICE,
-                  dev,
-                  strlen (dev) + 1))
-  {
-    fprintf (stderr,
-             "Failed to limit myself to `%s' for inbound traffic: %s\n",
-             dev,
-             strerror (errno));
-    (void) close (fd);
-    return -1;
-  }
-
-  /* Enable grabbing auxiliary data, including VLAN information */
-  {
-    int val = 1;
-
-    if (0 != setsockopt (fd,
-                         SOL_PACKET,
-                         PACKET_AUXDATA,
-                         &val,
-                         sizeof(val)))
-    {
-      fprintf (stderr,
-               "Failed to activate PACKET_AUXDATA: %s\n",
-               strerror (errno));
-      (void) close (fd);
-      return -1;
-    }
-  }
-
-  memset (&ifr,
-          0,
-          sizeof (ifr));
-
-  /* Get the index of the interface to send on */
-  memset (&ifc->if_idx,
-          0,
-          sizeof (struct ifreq));
-  strncpy (ifc->if_idx.ifr_name,
-           dev,
-           IFNAMSIZ - 1);
-  if (ioctl (fd,
-             SIOCGIFINDEX,
-             &ifc->if_idx) < 0)
-  {
-    fprintf (stderr,
-             "Could not use interface `%s': %s",
-             dev,
-             strerror (errno));
-    (void) close (fd);
-    return -1;
-  }
-  /* Get the MAC address of the interface to send on */
-  memset (&if_mac,
-          0,
-          sizeof(struct ifreq));
-  strncpy (if_mac.ifr_name,
-           dev,
-           IFNAMSIZ - 1);
-  if (0 > ioctl (fd,
-                 SIOCGIFHWADDR,
-                 &if_mac))
-  {
-    fprintf (stderr,
-             "Could not obtain MAC of interface `%s': %s",
-             dev,
-             strerror (errno));
-    (void) close (fd);
-    return -1;
-  }
-  memcpy (&ifc->my_mac,
-          &if_mac.ifr_hwaddr.sa_data,
-          MAC_ADDR_SIZE);
-
-  strncpy (ifopts.ifr_name,
-           dev,
-           IFNAMSIZ - 1);
-  if (0 > ioctl (fd,
-                 SIOCGIFFLAGS,
-                 &ifopts))
-  {
-    fprintf (stderr,
-             "Could not obtain flags of interface `%s': %s",
-             dev,
-             strerror (errno));
-    (void) close (fd);
-    return -1;
-  }
-  ifopts.ifr_flags |= IFF_PROMISC;
-  if (0 > ioctl (fd,
-                 SIOCSIFFLAGS,
-                 &ifopts))
-  {
-    fprintf (stderr,
-             "Could not set flags of interface `%s': %s",
-             dev,
-             strerror (errno));
-    (void) close (fd);
-    return -1;
-  }
-
-  /* Disable segmentation offloads:
-     - TSO TCP Segmentation Offload
-     - GSO Generic Segmentation Offload
-     - GRO Generic Receive Offload
-     (as our clients must not be expected to deal with frames exceeding the MTU) */
-  const uint32_t ethtool_cmd[] = { ETHTOOL_STSO, ETHTOOL_SGSO, ETHTOOL_SGRO };
-  for (int i = 0; i<sizeof(ethtool_cmd) / sizeof(uint32_t); i++)
-  {
-    ev.cmd = ethtool_cmd[i];
-    ev.data = 0;
-    memset (&so,
-            0,
-            sizeof (so));
-    strncpy (so.ifr_name,
-             dev,
-             IFNAMSIZ - 1);
-    so.ifr_data = (char*) &ev;
-    if (0 > ioctl (fd,
-                   SIOCETHTOOL,
-                   &so))
-    {
-      fprintf (stderr,
-               "Could not disable offload %u on interface `%s': %s",
-               ethtool_cmd[i],
-               dev,
-               strerror (errno));
-      (void) close (fd);
-      return -1;
-    }
-  }
-
-  ifc->fd = fd;
-  return 0;
-}
-
-
-/**
- * Start forwarding to and from the tunnel.
- *
- * @param gifc array of interfaces
- * @param gifc_len length of @a gifc
- */
-static void
-run (struct Interface *gifc,
-     int gifc_len)
-{
-  /*
-   * The buffer filled by reading from child's stdout, to be passed to some fd
-   */
-  unsigned char bufin[MAX_SIZE];
-  /* bytes left to write from 'bufin_write' to 'current_write' */
-  ssize_t bufin_write_left = 0;
-  /* read stream offset in 'bufin' */
-  size_t bufin_rpos = 0;
-  /* write stream offset into 'bufin' */
-  unsigned char *bufin_write_off = NULL;
-  /* write refers to reading from child's stdout, writing to index 'current_write' */
-  struct Interface *current_write = NULL;
-  fd_set fds_w;
-  fd_set fds_r;
-  int fmax;
-  /* We treat command-line input as a special 'network interface' */
-  struct Interface cmd_line;
-
-  /* read refers to reading from fd, currently writing to child's stdin */
-  struct Interface *current_read = NULL;
-
-  memset (&cmd_line,
-          0,
-          sizeof (cmd_line));
-  /* Leave room for header! */
-  cmd_line.buftun_size = sizeof (struct GLAB_MessageHeader);
-  while (1)
-  {
-    fmax = -1;
-    FD_ZERO (&fds_w);
-    FD_ZERO (&fds_r);
-
-    /* try to write to child */
-    if (NULL != current_read)
-    {
-      /*
-       * We have a job pending to write to Child's STDIN.
-       */
-      FD_SET (child_stdin,
-              &fds_w);
-      fmax = MAX (fmax,
-                  child_stdin);
-    }
-
-    /* try to write to TUN device */
-    if (NULL != current_write)
-    {
-      /*
-       * We have a job pending to write to a TUN.
-       */
-      FD_SET (current_write->fd,
-              &fds_w);
-      fmax = MAX (fmax,
-                  current_write->fd);
-    }
-
-    /* try to read from interfaces */
-    for (unsigned int i = 0; i<gifc_len; i++)
-    {
-      struct Interface *ifc = &gifc[i];
-
-      if (0 == ifc->buftun_size)
-      {
-        /*
-         * We are able to read more into our read buffer.
-         */
-        FD_SET (ifc->fd,
-                &fds_r);
-        fmax = MAX (fmax,
-                    ifc->fd);
-      }
-    }
-
-    /* try to read from child */
-    if (bufin_rpos < MAX_SIZE)
-    {
-      /*
-       * We are able to read more into our read buffer.
-       */
-      FD_SET (child_stdout,
-              &fds_r);
-      fmax = MAX (fmax,
-                  child_stdout);
-    }
-
-    /* Also try to read from command-line */
-    if (cmd_line.buftun_size < MAX_SIZE - sizeof (struct GLAB_MessageHeader))
-    {
-      FD_SET (STDIN_FILENO,
-              &fds_r);
-      fmax = MAX (fmax,
-                  STDIN_FILENO);
-    }
-
-    int r = select (fmax + 1,
-                    &fds_r,
-                    &fds_w,
-                    NULL,
-                    NULL);
-    if (-1 == r)
-    {
-      if (EINTR == errno)
-        continue;
-      fprintf (stderr,
-               "select failed: %s\n",
-               strerror (errno));
-      return;
-    }
-
-    if (0 == r)
-      continue;
-
-    /* Read from command-line */
-    if (FD_ISSET (STDIN_FILENO,
-                  &fds_r))
-    {
-      ssize_t ret = read (STDIN_FILENO,
-                          &cmd_line.buftun[cmd_line.buftun_size],
-                          MAX_SIZE - sizeof (struct GLAB_MessageHeader)
-                          - cmd_line.buftun_size);
-      if (0 >= ret)
-        return;
-      cmd_line.buftun_size += ret;
-    }
-
-    /* check if child is ready for reading (so we can write to it) */
-    if ( (FD_ISSET (child_stdin,
-                    &fds_w)) &&
-         (NULL != current_read) )
-    {
-      ssize_t written = write (child_stdin,
-                               current_read->buftun_off,
-                               current_read->buftun_end);
-      if (-1 == written)
-      {
-        fprintf (stderr,
-                 "write-error to stdout: %s\n",
-                 strerror (errno));
-        return;
-      }
-      if (0 == written)
-      {
-        fprintf (stderr,
-                 "write returned 0!?\n");
-        return;
-      }
-      current_read->buftun_end -= written;
-      current_read->buftun_off += written;
-      if (0 == current_read->buftun_end)
-      {
-        size_t total_w = (current_read->buftun_off - current_read->buftun);
-        size_t move_off = 0;
-
-        if (current_read == &cmd_line)
-        {
-          /* don't count the header, preserve space for it! */
-          total_w -= sizeof (struct GLAB_MessageHeader);
-          move_off += sizeof (struct GLAB_MessageHeader);
-        }
-        memmove (&current_read->buftun[move_off],
-                 current_read->buftun_off,
-                 current_read->buftun_size - total_w);
-        current_read->buftun_size -= total_w;
-        current_read->buftun_off = NULL;
-        current_read = NULL;     /* we're done with forwarding from this ifc */
-      }
-    }
-
-    /* Forward child's stream to network interface, if possible */
-    if ( (NULL != current_write) &&
-         (FD_ISSET (current_write->fd,
-                    &fds_w)) )
-    {
-      struct sockaddr_ll sadr_ll;
-
-      sadr_ll.sll_ifindex = current_write->if_idx.ifr_ifindex;
-      sadr_ll.sll_halen = MAC_ADDR_SIZE;
-      memcpy (&sadr_ll.sll_addr[0],
-              bufin_write_off,
-              sizeof (struct MacAddress));
-
-      ssize_t written = sendto (current_write->fd,
-                                bufin_write_off,
-                                bufin_write_left,
-                                0,
-                                (const struct sockaddr *) &sadr_ll,
-                                sizeof (struct sockaddr_ll));
-
-      if (-1 == written)
-      {
-        fprintf (stderr,
-                 "write-error to tun: %s\n",
-                 strerror (errno));
-        return;
-      }
-      if (0 == written)
-      {
-        fprintf (stderr,
-                 "write returned 0!?\n");
-        return;
-      }
-      bufin_write_left -= written;
-      bufin_write_off += written;
-      if (0 == bufin_write_left)
-      {
-        memmove (bufin,
-                 bufin_write_off,
-                 bufin_rpos - (bufin_write_off - bufin));
-        bufin_rpos -= (bufin_write_off - bufin);
-        bufin_write_off = NULL;
-        current_write = NULL;     /* done! */
-      }
-    }
-
-    if (NULL == current_read)
-    {
-      unsigned char *nl;
-
-      nl = memchr (&cmd_line.buftun[sizeof (struct GLAB_MessageHeader)],
-                   '\n',
-                   cmd_line.buftun_size - sizeof (struct GLAB_MessageHeader));
-      if (NULL != nl)
-      {
-        struct GLAB_MessageHeader hd;
-
-        hd.type = htons (0);
-        hd.size = htons (1 + nl - cmd_line.buftun);
-        memcpy (&cmd_line.buftun,
-                &hd,
-                sizeof (hd));
-        current_read = &cmd_line;
-        current_read->buftun_end = 1 + nl - cmd_line.buftun;
-        current_read->buftun_off = cmd_line.buftun;
-      }
-    }
-
-    /* Read from child's stream for forwarding to network, if possible */
-    if (FD_ISSET (child_stdout,
-                  &fds_r))
-    {
-      ssize_t ret;
-
-      ret = read (child_stdout,
-                  &bufin[bufin_rpos],
-                  MAX_SIZE - bufin_rpos);
-      if (-1 == ret)
-      {
-        fprintf (stderr,
-                 "read-error: %s\n",
-                 strerror (errno));
-        return;
-      }
-      if (0 == ret)
-      {
-        fprintf (stderr,
-                 "EOF from child\n");
-        return;
-      }
-      bufin_rpos += ret;
-    }
-
-    /* Handle data in 'bufin' (from child's stdout), if complete and possible */
-rbuf_again:
-    if ( (NULL == current_write) &&
-         (bufin_rpos >= sizeof (struct GLAB_MessageHeader)) )
-    {
-      struct GLAB_MessageHeader hd;
-      uint16_t s;
-
-      memcpy (&hd,
-              bufin,
-              sizeof (hd));
-      s = ntohs (hd.size);
-      if (s <= bufin_rpos)
-      {
-        uint16_t n = ntohs (hd.type);
-
-        if (0 == n)
-        {
-          fprintf (stdout,
-                   "%.*s",
-                   (int) (s - sizeof (hd)),
-                   &bufin[sizeof(hd)]);
-          fflush (stdout);
-          memmove (bufin,
-                   &bufin[s],
-                   bufin_rpos - s);
-          bufin_rpos -= s;
-          goto rbuf_again;       /* stdout doesn't wait in select() */
-        }
-        if (n > gifc_len)
-        {
-          fprintf (stderr,
-                   "Invalid interface %u specified in message\n",
-                   (unsigned int) n);
-          return;
-        }
-        /* Got a complete message! */
-        current_write = &gifc[n - 1];
-        bufin_write_left = s - sizeof (hd);
-        bufin_write_off = &bufin[sizeof (hd)];
-      }
-    }
-
-    /* read from network interfaces, if possible */
-    for (unsigned int i = 0; i<gifc_len; i++)
-    {
-      struct Interface *ifc = &gifc[i];
-
-      if (FD_ISSET (ifc->fd,
-                    &fds_r) &&
-          (0 == ifc->buftun_size))
-      {
-        struct GLAB_MessageHeader hdr;
-        ssize_t ret;
-        struct sockaddr_ll sadr_ll;
-        struct cmsghdr *cmsg;
-        union
-        {
-          struct cmsghdr cmsg;
-          char buf[CMSG_SPACE (sizeof (struct tpacket_auxdata))];
-        } cmsg_buf;
-        struct msghdr msg;
-        struct iovec iov = {
-          .iov_base = ifc->buftun + sizeof (struct GLAB_MessageHeader),
-          .iov_len = MAX_SIZE
-        };
-
-        memset (&msg,
-                0,
-                sizeof (msg));
-        msg.msg_iov = &iov;
-        msg.msg_iovlen = 1;
-        msg.msg_name = &sadr_ll;
-        msg.msg_namelen = sizeof (sadr_ll);
-        msg.msg_control = &cmsg_buf;
-        msg.msg_controllen = sizeof (cmsg_buf);
-        memset (iov.iov_base,
-                0,
-                MAX_SIZE);
-        ret = recvmsg (ifc->fd,
-                       &msg,
-                       0 /* flags */);
-        if (-1 == ret)
-        {
-          fprintf (stderr,
-                   "read-error: %s\n",
-                   strerror (errno));
-          return;
-        }
-        if (sadr_ll.sll_ifindex != ifc->if_idx.ifr_ifindex)
-        {
-#if DEBUG
-          fprintf (stderr,
-                   "recvfrom for different interface, discarding\n");
-#endif
-          continue;
-        }
-        if (0 == ret)
-        {
-          fprintf (stderr,
-                   "EOF on tun\n");
-          return;
-        }
-
-        for (cmsg = CMSG_FIRSTHDR (&msg);
-             NULL != cmsg;
-             cmsg = CMSG_NXTHDR (&msg, cmsg))
-        {
-          struct tpacket_auxdata *aux;
-          struct vlan_tag *tag;
-
-          if ((cmsg->cmsg_len < CMSG_LEN (sizeof(struct tpacket_auxdata))) ||
-              (cmsg->cmsg_level != SOL_PACKET) ||
-              (cmsg->cmsg_type != PACKET_AUXDATA) )
-          {
-            /*
-             * This isn't a PACKET_AUXDATA auxiliary
-             * data item.
-             */
-            continue;
-          }
-
-          aux = (struct tpacket_auxdata *) CMSG_DATA (cmsg);
-          if (! VLAN_VALID (aux, aux))
-          {
-            /*
-             * There is no VLAN information in the
-             * auxiliary data.
-             */
-            continue;
-          }
-
-          if (ret < (size_t) VLAN_OFFSET)
-            break;     /* awkward... */
-          tag = iov.iov_base + VLAN_OFFSET;
-          memmove (&tag[1],
-                   tag,
-                   ret - VLAN_OFFSET);
-          tag->vlan_tpid = htons (VLAN_TPID (aux, aux));
-          tag->vlan_tci = htons (aux->tp_vlan_tci);
-          ret += sizeof (*tag);
-        }
-
-        ifc->buftun_size = (size_t) ret + sizeof (struct GLAB_MessageHeader);
-        hdr.type = htons (i + 1);
-        hdr.size = htons (ifc->buftun_size);
-        memcpy (ifc->buftun,
-                &hdr,
-                sizeof (hdr));
-        if (FILTER_BY_MAC &&
-            (0 != memcmp (ifc->my_mac,
-                          ifc->buftun + sizeof (struct GLAB_MessageHeader),
-                          sizeof (ifc->my_mac))) &&
-            (0 == (0x80 & ifc->buftun[sizeof (struct GLAB_MessageHeader)])) )
-        {
-          /* Not unicast to me and not multicast, ignore! */
-          ifc->buftun_size = 0;
-        }
-        else
-        {
-          /* read to send message */
-          ifc->buftun_end = ifc->buftun_size;
-        }
-      }
-
-      /* If child is ready for another packet, and this interface is ready,
-         queue the job */
-      if ( (NULL == current_read) &&
-           (0 != ifc->buftun_size) )
-      {
-        current_read = ifc;
-        current_read->buftun_off = ifc->buftun;
-      }
-    }   /* end for(ifc) */
-  }
-}
-
-
-/**
- * Open network interfaces and pass traffic from/to child process.
- *
- * @param argc number of arguments in @a argv
- * @param argv 0: binary name (network-driver)
- *             1..n: network interface name (e.g. eth0)
- *             n+1: "-"
- *             n+2: child program to launch
- */
-int
-main (int argc,
-      char **argv)
-{
-  struct Interface *gifc;
-  int global_ret;
-  int end;
-
-  for (end = 1; NULL != argv[end]; end++)
-    if (0 == strcmp ("-",
-                     argv[end]))
-      break;
-  if (2 > end)
-  {
-    fprintf (stderr,
-             "Fatal: must supply network interface names!\n");
-    return 1;
-  }
-  if (end == argc)
-  {
-    fprintf (stderr,
-             "Fatal: must supply child process to launch!\n");
-    return 1;
-  }
-
-  /* Launch child process */
-  {
-    int cin[2];
-    int cout[2];
-
-    if (0 != pipe (cin))
-    {
-      perror ("pipe");
-      return 1;
-    }
-    if (0 != pipe (cout))
-    {
-      perror ("pipe");
-      return 1;
-    }
-    chld = fork ();
-    if (-1 == chld)
-    {
-      perror ("fork");
-      return 1;
-    }
-    if (0 == chld)
-    {
-      close (STDIN_FILENO);
-      close (STDOUT_FILENO);
-      close (cin[1]);
-      close (cout[0]);
-      if (-1 == dup2 (cin[0],
-                      STDIN_FILENO))
-      {
-        perror ("dup2");
-        exit (1);
-      }
-      if (-1 == dup2 (cout[1],
-                      STDOUT_FILENO))
-      {
-        perror ("dup2");
-        exit (1);
-      }
-      execvp (argv[end + 1],
-              &argv[end + 1]);
-      perror ("execvp");
-      exit (1);
-    }
-    close (cin[0]);
-    close (cout[1]);
-    child_stdin = cin[1];
-    child_stdout = cout[0];
-  } /* end launch child */
-
-  gifc = calloc (end - 1,
-                 sizeof (struct Interface));
-  if (NULL == gifc)
-    abort ();
-  for (unsigned int i = 1; i<end; i++)
-    gifc[i - 1].fd = -1;
-  for (unsigned int i = 1; i<end; i++)
-  {
-    struct Interface *ifc = &gifc[i - 1];
-    char dev[IFNAMSIZ];
-
-    strncpy (dev,
-             argv[i],
-             IFNAMSIZ);
-    dev[IFNAMSIZ - 1] = '\0';
-    if (-1 == init_tun (dev,
-                        ifc))
-    {
-      fprintf (stderr,
-               "Fatal: could not initialize interface `%s'\n",
-               dev);
-      global_ret = 4;
-      goto cleanup;
-    }
-  }
-
-  {
-    struct GLAB_MessageHeader gh;
-    char *mbuf;
-    size_t size;
-
-    size = sizeof (struct GLAB_MessageHeader) + (end - 1) * MAC_ADDR_SIZE;
-    mbuf = malloc (size);
-    if (NULL == mbuf)
-      abort ();
-    gh.size = htons  (size);
-    gh.type = htons (0);
-    memcpy (mbuf,
-            &gh,
-            sizeof (gh));
-    for (unsigned int i = 1; i<end; i++)
-      memcpy (&mbuf[sizeof (struct GLAB_MessageHeader) + (i - 1)
-                    * MAC_ADDR_SIZE],
-              gifc[i - 1].my_mac,
-              MAC_ADDR_SIZE);
-    if (size !=
-        write (child_stdin,
-               mbuf,
-               size))
-    {
-      fprintf (stderr,
-               "Failed to send my MACs to application: %s",
-               strerror (errno));
-      free (mbuf);
-      global_ret = 4;
-      goto cleanup;
-    }
-    free (mbuf);
-  }
-
-  {
-    uid_t uid = getuid ();
-#ifdef HAVE_SETRESUID
-    if (0 != setresuid (uid,
-                        uid,
-                        uid))
-    {
-      fprintf (stderr,
-               "Failed to setresuid: %s\n",
-               strerror (errno));
-      global_ret = 2;
-      goto cleanup;
-    }
-#else
-    if (0 != (setuid (uid) | seteuid (uid)))
-    {
-      fprintf (stderr,
-               "Failed to setuid: %s\n",
-               strerror (errno));
-      global_ret = 2;
-      goto cleanup;
-    }
-#endif
-  }
-
-  if (SIG_ERR ==
-      signal (SIGPIPE,
-              SIG_IGN))
-  {
-    fprintf (stderr,
-             "Failed to protect against SIGPIPE: %s\n",
-             strerror (errno));
-    /* no exit, we might as well die with SIGPIPE should it ever happen */
-  }
-  fprintf (stderr,
-           "Starting main loop\n");
-  run (gifc,
-       end - 1);
-  kill (chld,
-        SIGKILL);
-  global_ret = 0;
-cleanup:
-  for (unsigned int i = 1; i<end; i++)
-    if (-1 != gifc[i - 1].fd)
-      close (gifc[i - 1].fd);
-  free (gifc);
-  return global_ret;
-}
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2010, 2012, 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file network-driver.c
+ * @brief Opens a set of virtual network-interfaces,
+ * sends data received on the if to stdout, sends data received on stdin to the
+ * interfaces
+ * @author Philipp Tölke
+ * @author Christian Grothoff
+ */
+/* for recvmmsg(), sendmmsg() and pthread_setaffinity_np();
+   glab.h comes too late */
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/if.h>
+#include <linux/llc.h>
+#include <linux/sockios.h>
+#include <linux/ethtool.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include "glab.h"
+
+
+/**
+ * Should we print (interesting|debug) messages that can happen during
+ * normal operation?
+ */
+#define DEBUG 0
+
+/**
+ * Maximum size of a message.
+ */
+#define MAX_SIZE (65536 + sizeof (struct GLAB_MessageHeader))
+
+/**
+ * Maximum number of VLANs or EtherTypes in a socket filter, limited
+ * by the 8-bit jump offsets of classic BPF.
+ */
+#define FILTER_MAX_LIST 255
+
+/**
+ * Number of instructions of the MAC check of a socket filter.
+ */
+#define FILTER_MAC_CODE 7
+
+/**
+ * Maximum number of instructions of the VLAN check of a socket
+ * filter: loading the VLAN id, the list and the return.
+ */
+#define FILTER_VLAN_CODE (4 + FILTER_MAX_LIST + 1)
+
+/**
+ * Maximum number of instructions of the EtherType check of a socket
+ * filter: loading the EtherType, the list and the return.
+ */
+#define FILTER_TYPE_CODE (1 + FILTER_MAX_LIST + 1)
+
+/**
+ * Maximum number of instructions of a socket filter: the MAC, VLAN
+ * and EtherType checks and the final return.
+ */
+#define FILTER_MAX_CODE (FILTER_MAC_CODE + FILTER_VLAN_CODE \
+                         + FILTER_TYPE_CODE + 1)
+
+/**
+ * Return value of a socket filter to accept the whole frame.
+ */
+#define FILTER_ACCEPT 0xFFFFFFFF
+
+/**
+ * Where is the VLAN tag in the Ethernet frame?
+ */
+#define VLAN_OFFSET (2 * MAC_ADDR_SIZE)
+
+struct vlan_tag
+{
+  uint16_t vlan_tpid;     /* ETH_P_8021Q */
+  uint16_t vlan_tci;    /* VLAN TCI */
+};
+
+/**
+ * Check if VLAN TCI provided is valid.
+ */
+#define VLAN_VALID(hdr, hv) ((hv)->tp_vlan_tci != 0 || ((hdr)->tp_status \
+                                                        & TP_STATUS_VLAN_VALID))
+
+/**
+ * Compute the TPID given the AUX Data.
+ */
+#define VLAN_TPID(hdr, hv) (((hv)->tp_vlan_tpid || ((hdr)->tp_status \
+                                                    & TP_STATUS_VLAN_TPID_VALID)) \
+  ? (hv)->tp_vlan_tpid : ETH_P_8021Q)
+
+
+#ifndef _LINUX_IN6_H
+/**
+ * This is in linux/include/net/ipv6.h, but not always exported...
+ */
+struct in6_ifreq
+{
+  struct in6_addr ifr6_addr;
+  uint32_t ifr6_prefixlen;
+  unsigned int ifr6_ifindex;
+};
+#endif
+
+#define MAC_ADDR_SIZE 6
+
+#define MAX(a,b) ((a) > (b))?(a):(b)
+
+/**
+ * Largest frame we can pass to the child (including a re-inserted
+ * VLAN tag), limited by the 16-bit size of a GLAB message.
+ */
+#define MAX_FRAME_SIZE (UINT16_MAX - sizeof (struct GLAB_MessageHeader))
+
+/**
+ * Size of the buffer for messages to the child's STDIN.
+ */
+#define TO_CHILD_BUFFER_SIZE (16 * MAX_SIZE)
+
+/**
+ * Maximum number of messages in a batch to the child.
+ */
+#define TO_CHILD_BATCH_MAX 64
+
+/**
+ * Room we reserve for the start of a batch to the child: message
+ * header, batch header and descriptors.
+ */
+#define TO_CHILD_BATCH_HEAD (sizeof (struct GLAB_MessageHeader)     \
+                             + sizeof (struct GLAB_BatchHeader)     \
+                             + TO_CHILD_BATCH_MAX                   \
+                             * sizeof (struct GLAB_BatchDescriptor))
+
+/**
+ * Size of a block of the TPACKET_V3 receive ring.  Must hold a
+ * maximum-size frame.
+ */
+#define RX_BLOCK_SIZE (1 << 17)
+
+/**
+ * Default number of blocks in the receive ring of an interface.
+ */
+#define RX_DEFAULT_BLOCKS 16
+
+/**
+ * Frame size we tell the kernel for the receive ring.  TPACKET_V3
+ * packs frames of any size into a block, this only has to be
+ * consistent with #RX_BLOCK_SIZE.
+ */
+#define RX_FRAME_SIZE 2048
+
+/**
+ * Milliseconds after which the kernel hands us a partially filled
+ * block of the receive ring.
+ */
+#define RX_BLOCK_TIMEOUT_MS 1
+
+/**
+ * Maximum number of frames we pass on from one interface before
+ * looking at the others.
+ */
+#define RX_BUDGET 64
+
+/**
+ * Minimum size of a slot of the transmit ring.
+ */
+#define TX_MIN_FRAME_SIZE 2048
+
+/**
+ * Size of a block of the transmit ring (unless a slot is larger).
+ */
+#define TX_BLOCK_SIZE (1 << 17)
+
+/**
+ * Default number of slots in the transmit ring of an interface.
+ */
+#define TX_DEFAULT_FRAMES 256
+
+/**
+ * Offset of the frame data in a slot of the transmit ring.
+ */
+#define TX_DATA_OFFSET (TPACKET3_HDRLEN - sizeof (struct sockaddr_ll))
+
+/**
+ * Maximum number of frames we take from the child before
+ * kicking the transmit rings.
+ */
+#define TX_BUDGET 256
+
+/**
+ * Default number of frames per recvmmsg() or sendmmsg() call.
+ */
+#define BATCH_DEFAULT_SIZE 32
+
+/**
+ * Default number of frames we queue per interface.
+ */
+#define TX_QUEUE_DEFAULT_DEPTH 256
+
+/**
+ * Maximum number of events we take from one epoll_wait().
+ */
+#define MAX_EVENTS 64
+
+
+/**
+ * What an event from epoll_wait() is about.  Events for the
+ * interface at index i carry #EVENT_INTERFACE + i.
+ */
+enum EventSource
+{
+  /**
+   * Input on our STDIN (commands for the child).
+   */
+  EVENT_COMMANDS,
+
+  /**
+   * The child's STDIN became writable.
+   */
+  EVENT_CHILD_STDIN,
+
+  /**
+   * Input on the child's STDOUT.
+   */
+  EVENT_CHILD_STDOUT,
+
+  /**
+   * Doorbell of the shared-memory rings (in a worker: of the rings
+   * to the main thread).
+   */
+  EVENT_SHM,
+
+  /**
+   * Doorbell of the rings from one of the workers.
+   */
+  EVENT_WORKERS,
+
+  /**
+   * First interface.
+   */
+  EVENT_INTERFACE
+};
+
+
+/**
+ * TPACKET_V3 receive ring of an interface.
+ */
+struct RxRing
+{
+
+  /**
+   * The mapped ring, NULL if we receive with recvmsg().
+   */
+  uint8_t *map;
+
+  /**
+   * Number of blocks in @e map.
+   */
+  unsigned int block_nr;
+
+  /**
+   * Block we are currently consuming.
+   */
+  unsigned int block;
+
+  /**
+   * Next frame to consume in @e block, NULL if we did not
+   * get @e block from the kernel yet.
+   */
+  struct tpacket3_hdr *frame;
+
+  /**
+   * Number of frames left in @e block, including @e frame.
+   */
+  uint32_t frames_left;
+
+};
+
+
+/**
+ * TPACKET_V3 transmit ring of an interface.
+ */
+struct TxRing
+{
+
+  /**
+   * The mapped ring, NULL if we send with sendto().
+   */
+  uint8_t *map;
+
+  /**
+   * Number of bytes per slot.
+   */
+  unsigned int frame_size;
+
+  /**
+   * Number of slots.
+   */
+  unsigned int frame_nr;
+
+  /**
+   * Next slot to fill.
+   */
+  unsigned int head;
+
+  /**
+   * Set if we filled slots since we last asked the kernel to send.
+   */
+  int unsent;
+
+};
+
+
+/**
+ * Frames from the child waiting for room on their interface.
+ */
+struct TxQueue
+{
+
+  /**
+   * #tx_queue_depth slots of @e slot_size bytes each.
+   */
+  uint8_t *buf;
+
+  /**
+   * Number of bytes per slot, the largest frame the interface takes.
+   */
+  size_t slot_size;
+
+  /**
+   * Size of the frame in each slot.
+   */
+  uint16_t *size;
+
+  /**
+   * Slot of the oldest frame.
+   */
+  unsigned int head;
+
+  /**
+   * Number of queued frames.
+   */
+  unsigned int count;
+
+  /**
+   * Number of frames we dropped for this interface.
+   */
+  unsigned long long dropped;
+
+};
+
+
+/**
+ * Room for the PACKET_AUXDATA of a received frame.
+ */
+union AuxBuffer
+{
+  struct cmsghdr cmsg;
+  char buf[CMSG_SPACE (sizeof (struct tpacket_auxdata))];
+};
+
+
+/**
+ * Frames received with one recvmmsg() call, used if we have
+ * no receive ring.
+ */
+struct RxBatch
+{
+
+  /**
+   * Buffers for the frames, @e slot_size bytes each.
+   */
+  uint8_t *buf;
+
+  /**
+   * Number of bytes per buffer.
+   */
+  size_t slot_size;
+
+  /**
+   * Message headers for recvmmsg().
+   */
+  struct mmsghdr *msgs;
+
+  /**
+   * One iovec per message, pointing into @e buf.
+   */
+  struct iovec *iov;
+
+  /**
+   * Control data per message.
+   */
+  union AuxBuffer *aux;
+
+  /**
+   * Number of frames we got from the last recvmmsg().
+   */
+  unsigned int count;
+
+  /**
+   * Next frame to pass to the child.
+   */
+  unsigned int next;
+
+};
+
+
+/**
+ * Headers for one sendmmsg() call, used if we have no transmit ring.
+ */
+struct TxBatch
+{
+
+  /**
+   * Message headers for sendmmsg().
+   */
+  struct mmsghdr *msgs;
+
+  /**
+   * One iovec per message, pointing into the transmit queue.
+   */
+  struct iovec *iov;
+
+};
+
+
+/**
+ * Information about an interface.
+ */
+struct Interface
+{
+
+  /**
+   * Set to our MAC address.
+   */
+  uint8_t my_mac[MAC_ADDR_SIZE];
+
+  /**
+   * File descriptor for the interface.
+   */
+  int fd;
+
+  /**
+   * Number of this interface for the child (counting from 1).
+   */
+  uint16_t ifc_num;
+
+  /**
+   * Set if there may be frames to receive on @e fd, that is we got
+   * EPOLLIN and did not run out of frames yet.  Such interfaces
+   * are in the list at #rx_head.
+   */
+  int rx_ready;
+
+  /**
+   * Next interface with @e rx_ready set.
+   */
+  struct Interface *next_rx;
+
+  /**
+   * Set if @e fd had no room for a frame; we wait for EPOLLOUT
+   * before we try again.
+   */
+  int tx_blocked;
+
+  /**
+   * Receive ring, if we could set one up.
+   */
+  struct RxRing rx;
+
+  /**
+   * Transmit ring, if we could set one up.
+   */
+  struct TxRing tx;
+
+  /**
+   * Mapping of the rings (receive ring first), NULL for none.
+   */
+  uint8_t *rings;
+
+  /**
+   * Number of bytes in @e rings.
+   */
+  size_t rings_size;
+
+  /**
+   * Frames received with recvmmsg(), if we have no receive ring.
+   */
+  struct RxBatch rxb;
+
+  /**
+   * Frames waiting for room in @e tx or on @e fd.
+   */
+  struct TxQueue txq;
+
+  /**
+   * Headers to send from @e txq with sendmmsg().
+   */
+  struct TxBatch txb;
+
+  /**
+   * Set if @e txq has frames or @e tx has frames we did not hand
+   * to the kernel yet.
+   */
+  int tx_pending;
+
+  /**
+   * Next interface with @e tx_pending set.
+   */
+  struct Interface *next_kick;
+
+  /**
+   * Worker thread that owns @e fd, NULL if the main thread does.
+   */
+  struct Worker *worker;
+
+  /**
+   * Set if this is an additional socket of the fanout group of
+   * interface @e ifc_num (see #fanout); we only receive on it.
+   */
+  int rx_only;
+
+  /**
+   * Id of the fanout group of the interface.
+   */
+  uint16_t fanout_id;
+
+  /**
+   * index of interface
+   */
+  struct ifreq if_idx;
+
+};
+
+
+/**
+ * Worker thread, which receives and transmits on its share of the
+ * interfaces.  It exchanges frames with the main thread (which
+ * talks to the child) through a pair of rings like those we share
+ * with the child, see shm_peer().
+ */
+struct Worker
+{
+
+  /**
+   * The thread.
+   */
+  pthread_t thread;
+
+  /**
+   * Main thread's end of the rings: frames from the worker in
+   * @e rx, frames for the worker in @e tx.
+   */
+  struct GLAB_Shm shm;
+
+  /**
+   * Worker's end of the rings.
+   */
+  struct GLAB_Shm peer;
+
+  /**
+   * All interfaces, including the additional sockets of fanout
+   * groups; the worker only touches those it owns.
+   */
+  struct Interface *gifc;
+
+  /**
+   * Length of @e gifc.
+   */
+  int gifc_len;
+
+  /**
+   * CPU to pin the thread to, -1 for none.
+   */
+  int cpu;
+
+  /**
+   * Worker: size of the frame for which there was no room in
+   * @e peer.tx, 0 if the last frame fit.
+   */
+  uint32_t full;
+
+  /**
+   * Main thread: frame taken from @e shm.rx for which the child
+   * had no room yet, NULL for none.  We do not release the ring
+   * while we hold it.
+   */
+  unsigned char *held;
+
+  /**
+   * Interface number of @e held.
+   */
+  uint16_t held_type;
+
+  /**
+   * Size of @e held.
+   */
+  uint32_t held_size;
+
+  /**
+   * Main thread: number of frames dropped because @e shm.tx was full.
+   */
+  unsigned long long dropped;
+
+  /**
+   * Set by the main thread to stop the worker.
+   */
+  atomic_int quit;
+
+  /**
+   * Set by the worker when it stopped because of an error.
+   */
+  atomic_int failed;
+
+};
+
+
+/**
+ * Messages queued for the child's STDIN (if we use the pipe).
+ */
+static struct
+{
+
+  /**
+   * The messages, with their headers.
+   */
+  unsigned char buf[TO_CHILD_BUFFER_SIZE];
+
+  /**
+   * Start of the data not yet written.
+   */
+  size_t off;
+
+  /**
+   * End of the data.
+   */
+  size_t end;
+
+  /**
+   * Size of the message for which there was no room, 0 if the
+   * last child_reserve() succeeded.
+   */
+  size_t full;
+
+  /**
+   * Set unless the last write() found the pipe full; we then
+   * wait for EPOLLOUT.
+   */
+  int writable;
+
+  /**
+   * Did the child agree to batches?
+   */
+  int batches;
+
+  /**
+   * Is there an open batch at @e batch?
+   */
+  int batch_open;
+
+  /**
+   * Start of the open batch in @e buf.
+   */
+  size_t batch;
+
+  /**
+   * Number of messages in the open batch.
+   */
+  unsigned int batch_count;
+
+} to_child;
+
+/**
+ * Should we try to use mmap()ed rings for the interfaces?
+ */
+static int use_mmap = 1;
+
+/**
+ * Number of blocks per receive ring.
+ */
+static unsigned int rx_blocks = RX_DEFAULT_BLOCKS;
+
+/**
+ * Number of slots per transmit ring.
+ */
+static unsigned int tx_frames = TX_DEFAULT_FRAMES;
+
+/**
+ * Number of frames per recvmmsg() or sendmmsg() call.
+ */
+static unsigned int batch_size = BATCH_DEFAULT_SIZE;
+
+/**
+ * Number of frames we queue per interface.
+ */
+static unsigned int tx_queue_depth = TX_QUEUE_DEFAULT_DEPTH;
+
+/**
+ * Should a full transmit queue drop its oldest frame instead
+ * of the new one?
+ */
+static int tx_drop_head;
+
+/**
+ * Number of sockets per interface.  If larger than 1, the sockets
+ * of an interface form a PACKET_FANOUT group that spreads the
+ * received flows over them.  The additional sockets follow the
+ * first socket of each interface in the array of interfaces.
+ */
+static unsigned int fanout = 1;
+
+/**
+ * Should the kernel only pass on frames for the MAC of the interface
+ * (or multicast)?
+ */
+static int filter_mac;
+
+/**
+ * VLANs the kernel should pass on frames of (0 for untagged frames),
+ * NULL for all.
+ */
+static uint16_t *filter_vlans;
+
+/**
+ * Length of #filter_vlans.
+ */
+static unsigned int num_filter_vlans;
+
+/**
+ * EtherTypes the kernel should pass on frames of, NULL for all.
+ */
+static uint16_t *filter_types;
+
+/**
+ * Length of #filter_types.
+ */
+static unsigned int num_filter_types;
+
+/**
+ * Number of worker threads, 0 to do everything in the main thread.
+ */
+static unsigned int num_workers;
+
+/**
+ * CPUs to pin the workers to, in order, NULL for no pinning.
+ */
+static uint16_t *worker_cpus;
+
+/**
+ * Length of @e worker_cpus.
+ */
+static unsigned int num_worker_cpus;
+
+/**
+ * The worker threads.
+ */
+static struct Worker *workers;
+
+/**
+ * Interfaces of this thread that may have frames for us.
+ */
+static __thread struct Interface *rx_head;
+
+/**
+ * Interfaces of this thread with frames we did not hand to the
+ * kernel yet.
+ */
+static __thread struct Interface *kick_head;
+
+
+/**
+ * STDIN of child process (to be written to).
+ */
+static int child_stdin;
+
+/**
+ * STDOUT of child process (to be read from).
+ */
+static int child_stdout;
+
+/**
+ * Child PID
+ */
+static pid_t chld;
+
+/**
+ * State of the shared-memory transport with the child.
+ */
+enum ShmState
+{
+  /**
+   * Not available, we use the pipes.
+   */
+  SHM_OFF,
+
+  /**
+   * Offered to the child, still using the pipes.
+   */
+  SHM_OFFERED,
+
+  /**
+   * Child accepted and writes to the ring; we still need to
+   * send #GLAB_TYPE_SHM as our last message on the pipe.
+   */
+  SHM_SWITCHING,
+
+  /**
+   * Using the rings in both directions.
+   */
+  SHM_ACTIVE
+};
+
+/**
+ * Shared-memory transport with the child.
+ */
+static struct GLAB_Shm shm;
+
+/**
+ * Where are we with @e shm?
+ */
+static enum ShmState shm_state;
+
+
+/**
+ * Determine the largest frame we may see on an interface: its
+ * MTU plus the Ethernet header and a VLAN tag.
+ *
+ * @param fd socket for the interface
+ * @param dev name of the interface
+ * @return maximum frame size in bytes
+ */
+static size_t
+max_frame_size (int fd,
+                const char *dev)
+{
+  struct ifreq ifr;
+  size_t size;
+
+  memset (&ifr,
+          0,
+          sizeof (ifr));
+  strncpy (ifr.ifr_name,
+           dev,
+           IFNAMSIZ - 1);
+  if (0 != ioctl (fd,
+                  SIOCGIFMTU,
+                  &ifr))
+    return MAX_FRAME_SIZE;
+  size = ifr.ifr_mtu + 2 * MAC_ADDR_SIZE + sizeof (uint16_t)
+         + sizeof (struct vlan_tag);
+  return (size > MAX_FRAME_SIZE) ? MAX_FRAME_SIZE : size;
+}
+
+
+/**
+ * Set up TPACKET_V3 receive and transmit rings on @a fd.  Both
+ * rings share one mapping, the receive ring comes first.  If only
+ * the transmit ring fails, we keep the receive ring and send with
+ * sendto().  Sockets we only receive on get no transmit ring.  On
+ * error no ring is left on @a fd, so that the caller can fall back
+ * to recvmmsg() and sendmmsg().
+ *
+ * @param fd packet socket, bound to @a dev
+ * @param dev name of the interface
+ * @param ifc[in,out] interface to set up the rings for
+ * @return 0 on success, -1 on error (with errno set)
+ */
+static int
+init_rings (int fd,
+            const char *dev,
+            struct Interface *ifc)
+{
+  int version = TPACKET_V3;
+  int loss = 1;
+  struct tpacket_req3 req;
+  size_t rx_size;
+  size_t tx_size;
+  unsigned int frame_size;
+  unsigned int block_size;
+
+  if (0 != setsockopt (fd,
+                       SOL_PACKET,
+                       PACKET_VERSION,
+                       &version,
+                       sizeof (version)))
+    return -1;
+  /* skip malformed frames in the transmit ring instead of stopping */
+  if (0 != setsockopt (fd,
+                       SOL_PACKET,
+                       PACKET_LOSS,
+                       &loss,
+                       sizeof (loss)))
+    return -1;
+  memset (&req,
+          0,
+          sizeof (req));
+  req.tp_block_size = RX_BLOCK_SIZE;
+  req.tp_block_nr = rx_blocks;
+  req.tp_frame_size = RX_FRAME_SIZE;
+  req.tp_frame_nr = (RX_BLOCK_SIZE / RX_FRAME_SIZE) * rx_blocks;
+  req.tp_retire_blk_tov = RX_BLOCK_TIMEOUT_MS;
+  if (0 != setsockopt (fd,
+                       SOL_PACKET,
+                       PACKET_RX_RING,
+                       &req,
+                       sizeof (req)))
+    return -1;
+  rx_size = (size_t) RX_BLOCK_SIZE * rx_blocks;
+  tx_size = 0;
+  if (! ifc->rx_only)
+  {
+    /* a slot must hold a frame of the MTU plus Ethernet and VLAN headers */
+    frame_size = TX_MIN_FRAME_SIZE;
+    while (frame_size < TX_DATA_OFFSET + max_frame_size (fd,
+                                                         dev))
+      frame_size *= 2;
+    block_size = MAX (TX_BLOCK_SIZE,
+                      frame_size);
+    memset (&req,
+            0,
+            sizeof (req));
+    req.tp_block_size = block_size;
+    req.tp_frame_size = frame_size;
+    req.tp_block_nr = (tx_frames + block_size / frame_size - 1)
+                      / (block_size / frame_size);
+    req.tp_frame_nr = req.tp_block_nr * (block_size / frame_size);
+    if (0 == setsockopt (fd,
+                         SOL_PACKET,
+                         PACKET_TX_RING,
+                         &req,
+                         sizeof (req)))
+      tx_size = (size_t) block_size * req.tp_block_nr;
+    else
+      fprintf (stderr,
+               "No transmit ring on `%s' (%s), using sendmmsg()\n",
+               dev,
+               strerror (errno));
+  }
+
+  ifc->rings_size = rx_size + tx_size;
+  ifc->rings = mmap (NULL,
+                     ifc->rings_size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     fd,
+                     0);
+  if (MAP_FAILED == ifc->rings)
+  {
+    int err = errno;
+
+    /* a zero-sized ring releases the rings again, otherwise the
+       kernel would keep filling them instead of our socket queue */
+    ifc->rings = NULL;
+    memset (&req,
+            0,
+            sizeof (req));
+    if (0 != tx_size)
+      (void) setsockopt (fd,
+                         SOL_PACKET,
+                         PACKET_TX_RING,
+                         &req,
+                         sizeof (req));
+    (void) setsockopt (fd,
+                       SOL_PACKET,
+                       PACKET_RX_RING,
+                       &req,
+                       sizeof (req));
+    errno = err;
+    return -1;
+  }
+  ifc->rx.map = ifc->rings;
+  ifc->rx.block_nr = rx_blocks;
+  ifc->rx.block = 0;
+  ifc->rx.frame = NULL;
+  ifc->rx.frames_left = 0;
+  if (0 != tx_size)
+  {
+    ifc->tx.map = ifc->rings + rx_size;
+    ifc->tx.frame_size = frame_size;
+    ifc->tx.frame_nr = req.tp_frame_nr;
+    ifc->tx.head = 0;
+  }
+  return 0;
+}
+
+
+/**
+ * Allocate the transmit queue of @a ifc (unless we only receive on
+ * it) and the buffers for recvmmsg() and sendmmsg(), which we only
+ * use without rings.
+ *
+ * @param fd packet socket
+ * @param dev name of the interface
+ * @param ifc[in,out] interface to set up the batches for
+ * @return 0 on success, -1 if we are out of memory
+ */
+static int
+init_batches (int fd,
+              const char *dev,
+              struct Interface *ifc)
+{
+  struct TxQueue *txq = &ifc->txq;
+  struct TxBatch *txb = &ifc->txb;
+  struct RxBatch *rxb = &ifc->rxb;
+  size_t slot_size;
+
+  slot_size = max_frame_size (fd,
+                              dev);
+  if (! ifc->rx_only)
+  {
+    txq->slot_size = slot_size;
+    txq->buf = malloc (tx_queue_depth * txq->slot_size);
+    txq->size = calloc (tx_queue_depth,
+                        sizeof (uint16_t));
+    if ( (NULL == txq->buf) ||
+         (NULL == txq->size) )
+      return -1;
+  }
+  if ( (! ifc->rx_only) &&
+       (NULL == ifc->tx.map) )
+  {
+    txb->msgs = calloc (batch_size,
+                        sizeof (struct mmsghdr));
+    txb->iov = calloc (batch_size,
+                       sizeof (struct iovec));
+    if ( (NULL == txb->msgs) ||
+         (NULL == txb->iov) )
+      return -1;
+    /* the socket is bound to the interface, no need for addresses */
+    for (unsigned int i = 0; i<batch_size; i++)
+    {
+      txb->msgs[i].msg_hdr.msg_iov = &txb->iov[i];
+      txb->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+  if (NULL != ifc->rx.map)
+    return 0;
+  rxb->slot_size = slot_size;
+  rxb->buf = malloc (batch_size * rxb->slot_size);
+  rxb->msgs = calloc (batch_size,
+                      sizeof (struct mmsghdr));
+  rxb->iov = calloc (batch_size,
+                     sizeof (struct iovec));
+  rxb->aux = calloc (batch_size,
+                     sizeof (union AuxBuffer));
+  if ( (NULL == rxb->buf) ||
+       (NULL == rxb->msgs) ||
+       (NULL == rxb->iov) ||
+       (NULL == rxb->aux) )
+    return -1;
+  for (unsigned int i = 0; i<batch_size; i++)
+  {
+    rxb->iov[i].iov_base = &rxb->buf[i * rxb->slot_size];
+    rxb->iov[i].iov_len = rxb->slot_size;
+    rxb->msgs[i].msg_hdr.msg_iov = &rxb->iov[i];
+    rxb->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Attach a classic BPF program to @a fd that only accepts the frames
+ * selected by #filter_mac, #filter_vlans and #filter_types, so the
+ * kernel drops the others before they cost us a copy or a wakeup.
+ * The kernel strips VLAN tags before the filter runs, so we look at
+ * the tag in the ancillary data and at the EtherType behind it.
+ *
+ * @param fd packet socket
+ * @param ifc interface of @a fd, with @e my_mac set
+ * @return 0 on success, -1 on error (with errno set)
+ */
+static int
+attach_filter (int fd,
+               const struct Interface *ifc)
+{
+  struct sock_filter code[FILTER_MAX_CODE];
+  struct sock_fprog prog;
+  unsigned int n = 0;
+
+  if ( (! filter_mac) &&
+       (0 == num_filter_vlans) &&
+       (0 == num_filter_types) )
+    return 0;
+  /* the option parser enforces this, the size of code[] relies on it */
+  if ( (num_filter_vlans > FILTER_MAX_LIST) ||
+       (num_filter_types > FILTER_MAX_LIST) )
+    abort ();
+  if (filter_mac)
+  {
+    const uint8_t *mac = ifc->my_mac;
+
+    /* multicast (and broadcast) or for us */
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_B | BPF_ABS,
+                                               0);
+    code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JSET | BPF_K,
+                                               0x01,
+                                               5,
+                                               0);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_W | BPF_ABS,
+                                               0);
+    code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K,
+                                               ((uint32_t) mac[0] << 24)
+                                               | ((uint32_t) mac[1] << 16)
+                                               | ((uint32_t) mac[2] << 8)
+                                               | mac[3],
+                                               0,
+                                               2);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_H | BPF_ABS,
+                                               4);
+    code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K,
+                                               ((uint32_t) mac[4] << 8)
+                                               | mac[5],
+                                               1,
+                                               0);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K,
+                                               0);
+  }
+  if (0 != num_filter_vlans)
+  {
+    /* VLAN id of the frame, 0 if it has no tag */
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_W | BPF_ABS,
+                                               SKF_AD_OFF
+                                               + SKF_AD_VLAN_TAG_PRESENT);
+    code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K,
+                                               0,
+                                               2,
+                                               0);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_W | BPF_ABS,
+                                               SKF_AD_OFF + SKF_AD_VLAN_TAG);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_ALU | BPF_AND | BPF_K,
+                                               0x0FFF);
+    for (unsigned int i = 0; i < num_filter_vlans; i++)
+      code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K,
+                                                 filter_vlans[i],
+                                                 num_filter_vlans - i,
+                                                 0);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K,
+                                               0);
+  }
+  if (0 != num_filter_types)
+  {
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_H | BPF_ABS,
+                                               VLAN_OFFSET);
+    for (unsigned int i = 0; i < num_filter_types; i++)
+      code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K,
+                                                 filter_types[i],
+                                                 num_filter_types - i,
+                                                 0);
+    code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K,
+                                               0);
+  }
+  code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K,
+                                             FILTER_ACCEPT);
+  if (n > FILTER_MAX_CODE)
+    abort ();
+  prog.len = n;
+  prog.filter = code;
+  return setsockopt (fd,
+                     SOL_SOCKET,
+                     SO_ATTACH_FILTER,
+                     &prog,
+                     sizeof (prog));
+}
+
+
+/**
+ * Add @a fd to the fanout group of its interface, which hashes
+ * flows to the sockets of the group.  The first socket of an
+ * interface creates the group with an id the kernel picks, the
+ * additional sockets (with @e rx_only set) join it.
+ *
+ * @param fd packet socket, bound to the interface
+ * @param ifc[in,out] socket to add; @e fanout_id is set for the
+ *        first socket and must be set for the others
+ * @return 0 on success, -1 on error (with errno set)
+ */
+static int
+join_fanout (int fd,
+             struct Interface *ifc)
+{
+  uint32_t arg;
+  socklen_t len = sizeof (arg);
+
+  if (ifc->rx_only)
+  {
+    arg = ifc->fanout_id | (PACKET_FANOUT_HASH << 16);
+    return setsockopt (fd,
+                       SOL_PACKET,
+                       PACKET_FANOUT,
+                       &arg,
+                       sizeof (arg));
+  }
+  arg = (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+  if ( (0 != setsockopt (fd,
+                         SOL_PACKET,
+                         PACKET_FANOUT,
+                         &arg,
+                         sizeof (arg))) ||
+       (0 != getsockopt (fd,
+                         SOL_PACKET,
+                         PACKET_FANOUT,
+                         &arg,
+                         &len)) )
+    return -1;
+  ifc->fanout_id = arg & 0xFFFF;
+  return 0;
+}
+
+
+/**
+ * Creates a tun-interface called dev;
+ *
+ * @param dev is asumed to point to a char[IFNAMSIZ]
+ *        if *dev == '\\0', uses the name supplied by the kernel;
+ * @param ifc[out] initialized interface struct
+ * @return 0 on success, or -1 on error
+ */
+static int
+init_tun (char *dev,
+          struct Interface *ifc)
+{
+  struct ifreq ifr;
+  int fd;
+  struct ifreq if_mac;
+  struct ifreq ifopts;
+  struct ifreq so;
+  struct ethtool_value ev;
+
+  if (NULL == dev)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (-1 == (fd = socket (AF_PACKET,
+                          SOCK_RAW,
+                          htons (ETH_P_ALL))))
+  {
+    fprintf (stderr,
+             "Error opening socket: %s\n",
+             strerror (errno));
+    return -1;
+  }
+
+  /* only take traffic of 'dev' */
+  if (0 !=
+      setsockopt (fd,
+                  SOL_SOCKET,
+                  SO_BINDTODEVICE,
+                  dev,
+                  strlen (dev) + 1))
+  {
+    fprintf (stderr,
+             "Failed to limit myself to `%s' for inbound traffic: %s\n",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+
+  /* Enable grabbing auxiliary data, including VLAN information */
+  {
+    int val = 1;
+
+    if (0 != setsockopt (fd,
+                         SOL_PACKET,
+                         PACKET_AUXDATA,
+                         &val,
+                         sizeof(val)))
+    {
+      fprintf (stderr,
+               "Failed to activate PACKET_AUXDATA: %s\n",
+               strerror (errno));
+      (void) close (fd);
+      return -1;
+    }
+  }
+
+  memset (&ifr,
+          0,
+          sizeof (ifr));
+
+  /* Get the index of the interface to send on */
+  memset (&ifc->if_idx,
+          0,
+          sizeof (struct ifreq));
+  strncpy (ifc->if_idx.ifr_name,
+           dev,
+           IFNAMSIZ - 1);
+  if (ioctl (fd,
+             SIOCGIFINDEX,
+             &ifc->if_idx) < 0)
+  {
+    fprintf (stderr,
+             "Could not use interface `%s': %s",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+  /* Get the MAC address of the interface to send on */
+  memset (&if_mac,
+          0,
+          sizeof(struct ifreq));
+  strncpy (if_mac.ifr_name,
+           dev,
+           IFNAMSIZ - 1);
+  if (0 > ioctl (fd,
+                 SIOCGIFHWADDR,
+                 &if_mac))
+  {
+    fprintf (stderr,
+             "Could not obtain MAC of interface `%s': %s",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+  memcpy (&ifc->my_mac,
+          &if_mac.ifr_hwaddr.sa_data,
+          MAC_ADDR_SIZE);
+  if (0 != attach_filter (fd,
+                          ifc))
+  {
+    fprintf (stderr,
+             "Failed to attach socket filter to `%s': %s\n",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+
+  strncpy (ifopts.ifr_name,
+           dev,
+           IFNAMSIZ - 1);
+  if (0 > ioctl (fd,
+                 SIOCGIFFLAGS,
+                 &ifopts))
+  {
+    fprintf (stderr,
+             "Could not obtain flags of interface `%s': %s",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+  ifopts.ifr_flags |= IFF_PROMISC;
+  if (0 > ioctl (fd,
+                 SIOCSIFFLAGS,
+                 &ifopts))
+  {
+    fprintf (stderr,
+             "Could not set flags of interface `%s': %s",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+
+  /* Disable segmentation offloads:
+     - TSO TCP Segmentation Offload
+     - GSO Generic Segmentation Offload
+     - GRO Generic Receive Offload
+     (as our clients must not be expected to deal with frames exceeding the MTU) */
+  const uint32_t ethtool_cmd[] = { ETHTOOL_STSO, ETHTOOL_SGSO, ETHTOOL_SGRO };
+  for (int i = 0; i<sizeof(ethtool_cmd) / sizeof(uint32_t); i++)
+  {
+    ev.cmd = ethtool_cmd[i];
+    ev.data = 0;
+    memset (&so,
+            0,
+            sizeof (so));
+    strncpy (so.ifr_name,
+             dev,
+             IFNAMSIZ - 1);
+    so.ifr_data = (char*) &ev;
+    if (0 > ioctl (fd,
+                   SIOCETHTOOL,
+                   &so))
+    {
+      fprintf (stderr,
+               "Could not disable offload %u on interface `%s': %s",
+               ethtool_cmd[i],
+               dev,
+               strerror (errno));
+      (void) close (fd);
+      return -1;
+    }
+  }
+
+  /* only receive from 'dev', this also applies to the ring */
+  {
+    struct sockaddr_ll sll;
+
+    memset (&sll,
+            0,
+            sizeof (sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons (ETH_P_ALL);
+    sll.sll_ifindex = ifc->if_idx.ifr_ifindex;
+    if (0 != bind (fd,
+                   (const struct sockaddr *) &sll,
+                   sizeof (sll)))
+    {
+      fprintf (stderr,
+               "Failed to bind to `%s': %s\n",
+               dev,
+               strerror (errno));
+      (void) close (fd);
+      return -1;
+    }
+  }
+
+  if ( (use_mmap) &&
+       (0 != init_rings (fd,
+                         dev,
+                         ifc)) )
+    fprintf (stderr,
+             "No packet rings on `%s' (%s), using recvmmsg()/sendmmsg()\n",
+             dev,
+             strerror (errno));
+  if (0 != init_batches (fd,
+                         dev,
+                         ifc))
+  {
+    fprintf (stderr,
+             "Out of memory for frame batches of `%s'\n",
+             dev);
+    (void) close (fd);
+    return -1;
+  }
+  if ( (1 < fanout) &&
+       (0 != join_fanout (fd,
+                          ifc)) )
+  {
+    fprintf (stderr,
+             "Failed to set up fanout on `%s': %s\n",
+             dev,
+             strerror (errno));
+    (void) close (fd);
+    return -1;
+  }
+
+  ifc->fd = fd;
+  return 0;
+}
+
+
+/**
+ * Finish the open batch to the child, if any: fill in the headers
+ * now that we know the number of messages.
+ */
+static void
+close_batch (void)
+{
+  struct GLAB_MessageHeader hdr;
+  struct GLAB_BatchHeader bh;
+
+  if (! to_child.batch_open)
+    return;
+  to_child.batch_open = 0;
+  if (0 == to_child.batch_count)
+  {
+    to_child.end = to_child.batch;
+    return;
+  }
+  hdr.size = htons (to_child.end - to_child.batch);
+  hdr.type = htons (GLAB_TYPE_BATCH);
+  bh.count = htons (to_child.batch_count);
+  memcpy (&to_child.buf[to_child.batch],
+          &hdr,
+          sizeof (hdr));
+  memcpy (&to_child.buf[to_child.batch + sizeof (hdr)],
+          &bh,
+          sizeof (bh));
+}
+
+
+/**
+ * Reserve room for a message of @a size bytes to the child.
+ * If there is no room, @e to_child.full is set to @a size.
+ * Once the child agreed to batches, the message goes into the
+ * open batch, which is started if necessary.  Only frames and
+ * commands are sent that way: the child never accepts both the
+ * batches and the shared-memory rings.
+ *
+ * @param size number of bytes in the body of the message
+ * @return where to put the body, NULL if there is no room right now
+ */
+static void *
+child_reserve (size_t size)
+{
+  size_t need = sizeof (struct GLAB_MessageHeader) + size;
+  int batch = 0;
+  void *dst;
+
+  if (SHM_ACTIVE == shm_state)
+  {
+    dst = ring_reserve (&shm.tx,
+                        size);
+    to_child.full = (NULL == dst) ? size : 0;
+    return dst;
+  }
+  if ( (to_child.batches) &&
+       (TO_CHILD_BATCH_HEAD + size <= UINT16_MAX) )
+  {
+    batch = 1;
+    if ( (to_child.batch_open) &&
+         ( (TO_CHILD_BATCH_MAX == to_child.batch_count) ||
+           (to_child.end - to_child.batch + size > UINT16_MAX) ) )
+      close_batch ();
+    need = size;
+    if (! to_child.batch_open)
+      need += TO_CHILD_BATCH_HEAD;
+  }
+  else
+  {
+    close_batch ();
+  }
+  if (to_child.end + need > TO_CHILD_BUFFER_SIZE)
+  {
+    if (to_child.end - to_child.off + need > TO_CHILD_BUFFER_SIZE)
+    {
+      to_child.full = size;
+      return NULL;
+    }
+    memmove (to_child.buf,
+             &to_child.buf[to_child.off],
+             to_child.end - to_child.off);
+    to_child.end -= to_child.off;
+    to_child.batch -= to_child.off;
+    to_child.off = 0;
+  }
+  to_child.full = 0;
+  if (! batch)
+    return &to_child.buf[to_child.end + sizeof (struct GLAB_MessageHeader)];
+  if (! to_child.batch_open)
+  {
+    /* unused descriptors just stay in front of the data */
+    to_child.batch_open = 1;
+    to_child.batch = to_child.end;
+    to_child.batch_count = 0;
+    to_child.end += TO_CHILD_BATCH_HEAD;
+  }
+  return &to_child.buf[to_child.end];
+}
+
+
+/**
+ * Queue the message written to the last child_reserve().
+ *
+ * @param type message type
+ * @param size actual number of bytes in the body, at most what
+ *        was reserved
+ */
+static void
+child_commit (uint16_t type,
+              size_t size)
+{
+  struct GLAB_MessageHeader hdr;
+
+  if (SHM_ACTIVE == shm_state)
+  {
+    ring_commit (&shm.tx,
+                 type,
+                 size);
+    return;
+  }
+  if (to_child.batch_open)
+  {
+    struct GLAB_BatchDescriptor d;
+
+    d.type = htons (type);
+    d.size = htons (size);
+    d.offset = htons (to_child.end - to_child.batch - sizeof (hdr));
+    memcpy (&to_child.buf[to_child.batch + sizeof (hdr)
+                          + sizeof (struct GLAB_BatchHeader)
+                          + to_child.batch_count * sizeof (d)],
+            &d,
+            sizeof (d));
+    to_child.batch_count++;
+    to_child.end += size;
+    return;
+  }
+  hdr.size = htons (sizeof (hdr) + size);
+  hdr.type = htons (type);
+  memcpy (&to_child.buf[to_child.end],
+          &hdr,
+          sizeof (hdr));
+  to_child.end += sizeof (hdr) + size;
+}
+
+
+/**
+ * Write as much of the queued messages to the child's STDIN
+ * as possible.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int
+child_write (void)
+{
+  close_batch ();
+  while (to_child.end > to_child.off)
+  {
+    ssize_t written;
+
+    written = write (child_stdin,
+                     &to_child.buf[to_child.off],
+                     to_child.end - to_child.off);
+    if ( (-1 == written) &&
+         ( (EAGAIN == errno) ||
+           (EWOULDBLOCK == errno) ) )
+    {
+      to_child.writable = 0;
+      return 0;
+    }
+    if (-1 == written)
+    {
+      fprintf (stderr,
+               "write-error to stdout: %s\n",
+               strerror (errno));
+      return -1;
+    }
+    if (0 == written)
+    {
+      fprintf (stderr,
+               "write returned 0!?\n");
+      return -1;
+    }
+    to_child.off += written;
+  }
+  to_child.off = 0;
+  to_child.end = 0;
+  return 0;
+}
+
+
+/**
+ * Pass complete lines from the command line to the child.
+ *
+ * @param buf command-line input
+ * @param size[in,out] number of bytes in @a buf
+ */
+static void
+forward_commands (unsigned char *buf,
+                  size_t *size)
+{
+  unsigned char *nl;
+
+  while (NULL != (nl = memchr (buf,
+                               '\n',
+                               *size)))
+  {
+    size_t len = 1 + nl - buf;
+    void *dst;
+
+    dst = child_reserve (len);
+    if (NULL == dst)
+      return;
+    memcpy (dst,
+            buf,
+            len);
+    child_commit (0,
+                  len);
+    memmove (buf,
+             &buf[len],
+             *size - len);
+    *size -= len;
+  }
+}
+
+
+/**
+ * Pass @a frame received on @a ifc to the child, re-inserting the
+ * VLAN tag the kernel stripped (if any).  If a worker owns @a ifc,
+ * the frame goes to the main thread instead.
+ *
+ * The tag is spliced in while we copy the frame to the child, which
+ * we have to do anyway: besides that copy, a tagged frame only costs
+ * us the 4 bytes of the tag, no matter how large it is.  Keep it
+ * that way, do not shift frames in the receive buffers.
+ *
+ * @param ifc interface we got the frame on
+ * @param frame the frame
+ * @param size number of bytes in @a frame
+ * @param tag VLAN tag to insert after the MAC addresses, NULL for none
+ * @return 0 if the frame was passed on (or dropped), 1 if there is no
+ *         room for it right now
+ */
+static int
+frame_to_child (struct Interface *ifc,
+                const uint8_t *frame,
+                size_t size,
+                const struct vlan_tag *tag)
+{
+  size_t total = size + ((NULL != tag) ? sizeof (*tag) : 0);
+  uint8_t *dst;
+
+  if ( (total > MAX_FRAME_SIZE) ||
+       (size < VLAN_OFFSET) )
+    return 0;
+  if (NULL != ifc->worker)
+  {
+    dst = ring_reserve (&ifc->worker->peer.tx,
+                        total);
+    ifc->worker->full = (NULL == dst) ? total : 0;
+  }
+  else
+  {
+    dst = child_reserve (total);
+  }
+  if (NULL == dst)
+    return 1;
+  if (NULL == tag)
+  {
+    memcpy (dst,
+            frame,
+            size);
+  }
+  else
+  {
+    memcpy (dst,
+            frame,
+            VLAN_OFFSET);
+    memcpy (&dst[VLAN_OFFSET],
+            tag,
+            sizeof (*tag));
+    memcpy (&dst[VLAN_OFFSET + sizeof (*tag)],
+            &frame[VLAN_OFFSET],
+            size - VLAN_OFFSET);
+  }
+  if (NULL != ifc->worker)
+    ring_commit (&ifc->worker->peer.tx,
+                 ifc->ifc_num,
+                 total);
+  else
+    child_commit (ifc->ifc_num,
+                  total);
+  return 0;
+}
+
+
+/**
+ * Pass frames from the receive ring of @a ifc to the child.
+ *
+ * @param ifc interface to receive from
+ * @return 0 if the ring is empty, 1 if there may be more frames
+ */
+static int
+receive_from_ring (struct Interface *ifc)
+{
+  struct RxRing *rx = &ifc->rx;
+
+  for (unsigned int n = 0; n < RX_BUDGET; n++)
+  {
+    struct tpacket3_hdr *hdr;
+    struct vlan_tag tag;
+    int have_tag;
+
+    if (NULL == rx->frame)
+    {
+      struct tpacket_block_desc *bd;
+
+      bd = (struct tpacket_block_desc *) &rx->map[(size_t) rx->block
+                                                  * RX_BLOCK_SIZE];
+      if (0 == (__atomic_load_n (&bd->hdr.bh1.block_status,
+                                 __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        return 0;
+      rx->frames_left = bd->hdr.bh1.num_pkts;
+      rx->frame = (struct tpacket3_hdr *) ((uint8_t *) bd
+                                           + bd->hdr.bh1.offset_to_first_pkt);
+    }
+    hdr = rx->frame;
+    if (0 != rx->frames_left)
+    {
+      have_tag = VLAN_VALID (hdr, &hdr->hv1);
+      if (have_tag)
+      {
+        tag.vlan_tpid = htons (VLAN_TPID (hdr, &hdr->hv1));
+        tag.vlan_tci = htons (hdr->hv1.tp_vlan_tci);
+      }
+      if ( (hdr->tp_snaplen == hdr->tp_len) &&
+           (1 == frame_to_child (ifc,
+                                 (const uint8_t *) hdr + hdr->tp_mac,
+                                 hdr->tp_snaplen,
+                                 have_tag ? &tag : NULL)) )
+        return 1;
+      rx->frames_left--;
+      rx->frame = (struct tpacket3_hdr *) ((uint8_t *) hdr
+                                           + hdr->tp_next_offset);
+    }
+    if (0 == rx->frames_left)
+    {
+      struct tpacket_block_desc *bd;
+
+      /* return the block to the kernel */
+      bd = (struct tpacket_block_desc *) &rx->map[(size_t) rx->block
+                                                  * RX_BLOCK_SIZE];
+      __atomic_store_n (&bd->hdr.bh1.block_status,
+                        TP_STATUS_KERNEL,
+                        __ATOMIC_RELEASE);
+      rx->block = (rx->block + 1) % rx->block_nr;
+      rx->frame = NULL;
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * Receive frames from @a ifc with recvmmsg() and pass them to
+ * the child.  Frames that do not fit into the child's buffer
+ * right now stay in @e rxb for the next call.
+ *
+ * @param ifc interface to receive from
+ * @return 0 if there are no more frames, 1 if there may be more
+ *         frames, -1 on error
+ */
+static int
+receive_from_socket (struct Interface *ifc)
+{
+  struct RxBatch *rxb = &ifc->rxb;
+
+  for (unsigned int n = 0; n < RX_BUDGET; n++)
+  {
+    struct msghdr *msg;
+    struct cmsghdr *cmsg;
+    struct vlan_tag tag;
+    int have_tag;
+
+    if (rxb->next == rxb->count)
+    {
+      int ret;
+
+      for (unsigned int i = 0; i<batch_size; i++)
+      {
+        rxb->msgs[i].msg_hdr.msg_control = &rxb->aux[i];
+        rxb->msgs[i].msg_hdr.msg_controllen = sizeof (union AuxBuffer);
+      }
+      ret = recvmmsg (ifc->fd,
+                      rxb->msgs,
+                      batch_size,
+                      MSG_DONTWAIT,
+                      NULL);
+      if (-1 == ret)
+      {
+        if ( (EAGAIN == errno) ||
+             (EWOULDBLOCK == errno) )
+          return 0;
+        fprintf (stderr,
+                 "read-error: %s\n",
+                 strerror (errno));
+        return -1;
+      }
+      rxb->count = ret;
+      rxb->next = 0;
+      if (0 == ret)
+        return 0;
+    }
+    msg = &rxb->msgs[rxb->next].msg_hdr;
+    if (0 != (msg->msg_flags & MSG_TRUNC))
+    {
+      rxb->next++;
+      continue;
+    }
+
+    have_tag = 0;
+    for (cmsg = CMSG_FIRSTHDR (msg);
+         NULL != cmsg;
+         cmsg = CMSG_NXTHDR (msg, cmsg))
+    {
+      struct tpacket_auxdata *aux;
+
+      if ((cmsg->cmsg_len < CMSG_LEN (sizeof(struct tpacket_auxdata))) ||
+          (cmsg->cmsg_level != SOL_PACKET) ||
+          (cmsg->cmsg_type != PACKET_AUXDATA) )
+      {
+        /*
+         * This isn't a PACKET_AUXDATA auxiliary
+         * data item.
+         */
+        continue;
+      }
+
+      aux = (struct tpacket_auxdata *) CMSG_DATA (cmsg);
+      if (! VLAN_VALID (aux, aux))
+      {
+        /*
+         * There is no VLAN information in the
+         * auxiliary data.
+         */
+        continue;
+      }
+      tag.vlan_tpid = htons (VLAN_TPID (aux, aux));
+      tag.vlan_tci = htons (aux->tp_vlan_tci);
+      have_tag = 1;
+    }
+
+    if (1 == frame_to_child (ifc,
+                             msg->msg_iov->iov_base,
+                             rxb->msgs[rxb->next].msg_len,
+                             have_tag ? &tag : NULL))
+      return 1;
+    rxb->next++;
+  }
+  return 1;
+}
+
+
+/**
+ * Pass frames received on @a ifc to the child.
+ *
+ * @param ifc interface to receive from
+ * @return 0 if there are no more frames, 1 if there may be more
+ *         frames, -1 on error
+ */
+static int
+receive_frames (struct Interface *ifc)
+{
+  if (NULL != ifc->rx.map)
+    return receive_from_ring (ifc);
+  return receive_from_socket (ifc);
+}
+
+
+/**
+ * Remember that @a ifc has frames to hand to the kernel.
+ *
+ * @param ifc interface with queued frames
+ */
+static void
+queue_kick (struct Interface *ifc)
+{
+  if (ifc->tx_pending)
+    return;
+  ifc->tx_pending = 1;
+  ifc->next_kick = kick_head;
+  kick_head = ifc;
+}
+
+
+/**
+ * Copy a frame into the next slot of the transmit ring of @a ifc.
+ *
+ * @param ifc interface to transmit on
+ * @param frame the frame
+ * @param size number of bytes in @a frame
+ * @return 0 on success, 1 if @a ifc has no (free) slot for it;
+ *         @e tx_blocked is set if the ring is full
+ */
+static int
+ring_frame (struct Interface *ifc,
+            const unsigned char *frame,
+            size_t size)
+{
+  struct TxRing *tx = &ifc->tx;
+  struct tpacket3_hdr *hdr;
+
+  if ( (NULL == tx->map) ||
+       (size > tx->frame_size - TX_DATA_OFFSET) )
+    return 1;
+  hdr = (struct tpacket3_hdr *) &tx->map[(size_t) tx->head
+                                         * tx->frame_size];
+  if (TP_STATUS_AVAILABLE != __atomic_load_n (&hdr->tp_status,
+                                              __ATOMIC_ACQUIRE))
+  {
+    ifc->tx_blocked = 1;
+    return 1;
+  }
+  memcpy ((uint8_t *) hdr + TX_DATA_OFFSET,
+          frame,
+          size);
+  hdr->tp_len = size;
+  hdr->tp_snaplen = size;
+  hdr->tp_next_offset = 0;
+  __atomic_store_n (&hdr->tp_status,
+                    TP_STATUS_SEND_REQUEST,
+                    __ATOMIC_RELEASE);
+  tx->head = (tx->head + 1) % tx->frame_nr;
+  tx->unsent = 1;
+  return 0;
+}
+
+
+/**
+ * Move frames from the transmit queue of @a ifc to the transmit
+ * ring, or send them with sendmmsg() if there is no ring, until
+ * the queue is empty or @a ifc has no room.
+ *
+ * @param ifc interface to transmit on
+ * @return 0 on success (@e tx_blocked is set if frames are left),
+ *         -1 on fatal errors
+ */
+static int
+drain_queue (struct Interface *ifc)
+{
+  struct TxQueue *txq = &ifc->txq;
+  struct TxBatch *txb = &ifc->txb;
+
+  if (NULL != ifc->tx.map)
+  {
+    while ( (0 != txq->count) &&
+            (0 == ring_frame (ifc,
+                              &txq->buf[(size_t) txq->head
+                                        * txq->slot_size],
+                              txq->size[txq->head])) )
+    {
+      txq->head = (txq->head + 1) % tx_queue_depth;
+      txq->count--;
+    }
+    return 0;
+  }
+  while (0 != txq->count)
+  {
+    unsigned int n;
+    int ret;
+
+    for (n = 0; (n < batch_size) && (n < txq->count); n++)
+    {
+      unsigned int slot = (txq->head + n) % tx_queue_depth;
+
+      txb->iov[n].iov_base = &txq->buf[(size_t) slot * txq->slot_size];
+      txb->iov[n].iov_len = txq->size[slot];
+    }
+    ret = sendmmsg (ifc->fd,
+                    txb->msgs,
+                    n,
+                    MSG_DONTWAIT);
+    if (-1 == ret)
+    {
+      if ( (EAGAIN == errno) ||
+           (EWOULDBLOCK == errno) )
+      {
+        ifc->tx_blocked = 1;
+        return 0;
+      }
+      if (ENOBUFS != errno)
+      {
+        fprintf (stderr,
+                 "write-error to tun: %s\n",
+                 strerror (errno));
+        return -1;
+      }
+      /* dropped by the queueing discipline, like on the wire */
+      txq->dropped++;
+      ret = 1;
+    }
+    txq->head = (txq->head + ret) % tx_queue_depth;
+    txq->count -= ret;
+  }
+  return 0;
+}
+
+
+/**
+ * Hand the frames queued for @a ifc to the kernel, as far as it
+ * takes them.
+ *
+ * @param ifc interface to transmit on
+ * @return 0 on success, -1 on fatal errors
+ */
+static int
+flush_interface (struct Interface *ifc)
+{
+  if ( (! ifc->tx_blocked) &&
+       (0 != drain_queue (ifc)) )
+    return -1;
+  while (ifc->tx.unsent)
+  {
+    unsigned int queued = ifc->txq.count;
+
+    if (-1 == send (ifc->fd,
+                    NULL,
+                    0,
+                    MSG_DONTWAIT))
+    {
+      if ( (EAGAIN != errno) &&
+           (EWOULDBLOCK != errno) &&
+           (ENOBUFS != errno) )
+      {
+        fprintf (stderr,
+                 "write-error to tun: %s\n",
+                 strerror (errno));
+        return -1;
+      }
+      /* the kernel stopped early, some frames are still marked
+         for sending; we have to try again */
+      return 0;
+    }
+    ifc->tx.unsent = 0;
+    if (0 == queued)
+      return 0;
+    /* the kernel may have freed slots already, refill them */
+    ifc->tx_blocked = 0;
+    if (0 != drain_queue (ifc))
+      return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * Queue a frame from the child for transmission on @a ifc.  If
+ * nothing is waiting before it, the frame goes straight into the
+ * transmit ring; otherwise it is copied to the transmit queue,
+ * which drops a frame if it is full (see #tx_drop_head) and
+ * @a ifc cannot take any frames right now.  Otherwise the kernel
+ * only sees the frames in kick_transmit().
+ *
+ * @param ifc interface to transmit on
+ * @param frame the frame
+ * @param size number of bytes in @a frame
+ * @return 0 on success (also if we dropped the frame), -1 on
+ *         fatal errors
+ */
+static int
+transmit_frame (struct Interface *ifc,
+                const unsigned char *frame,
+                size_t size)
+{
+  struct TxQueue *txq = &ifc->txq;
+  unsigned int slot;
+
+  queue_kick (ifc);
+  if ( (0 == txq->count) &&
+       (! ifc->tx_blocked) &&
+       (0 == ring_frame (ifc,
+                         frame,
+                         size)) )
+    return 0;
+  if (size > txq->slot_size)
+  {
+    /* larger than the MTU, the kernel would refuse it anyway */
+    txq->dropped++;
+    return 0;
+  }
+  if ( (tx_queue_depth == txq->count) &&
+       (0 != flush_interface (ifc)) )
+    return -1;
+  if (tx_queue_depth == txq->count)
+  {
+    txq->dropped++;
+    if (! tx_drop_head)
+      return 0;
+    txq->head = (txq->head + 1) % tx_queue_depth;
+    txq->count--;
+  }
+  slot = (txq->head + txq->count) % tx_queue_depth;
+  memcpy (&txq->buf[(size_t) slot * txq->slot_size],
+          frame,
+          size);
+  txq->size[slot] = size;
+  txq->count++;
+  return 0;
+}
+
+
+/**
+ * Hand the frames queued by transmit_frame() to the kernel, with
+ * one system call per interface and transmit ring or batch.
+ *
+ * @return 0 on success, -1 on fatal errors
+ */
+static int
+kick_transmit (void)
+{
+  struct Interface *again = NULL;
+  struct Interface *ifc;
+
+  while (NULL != (ifc = kick_head))
+  {
+    kick_head = ifc->next_kick;
+    if (0 != flush_interface (ifc))
+      return -1;
+    if ( (ifc->tx.unsent) ||
+         (0 != ifc->txq.count) )
+    {
+      ifc->next_kick = again;
+      again = ifc;
+      continue;
+    }
+    ifc->tx_pending = 0;
+  }
+  kick_head = again;
+  return 0;
+}
+
+
+/**
+ * Check if kick_transmit() may make progress without an event from
+ * the kernel, which gives no signal when to retry a kick.
+ *
+ * @return 1 if an interface of this thread may make progress, 0 if
+ *         we have to wait for EPOLLOUT
+ */
+static int
+kick_possible (void)
+{
+  for (struct Interface *ifc = kick_head;
+       NULL != ifc;
+       ifc = ifc->next_kick)
+    if ( (! ifc->tx_blocked) ||
+         (ifc->tx.unsent) )
+      return 1;
+  return 0;
+}
+
+
+/**
+ * Find message @a pos of a #GLAB_TYPE_BATCH message from the child.
+ *
+ * @param body body of the batch
+ * @param body_size number of bytes in @a body
+ * @param pos index of the message
+ * @param type[out] set to the type of the message
+ * @param data[out] set to the message
+ * @param size[out] set to the size of the message
+ * @return 1 if we found the message, 0 if the batch has no more
+ *         messages, -1 if the batch is malformed
+ */
+static int
+batch_message (unsigned char *body,
+               size_t body_size,
+               unsigned int pos,
+               uint16_t *type,
+               unsigned char **data,
+               size_t *size)
+{
+  struct GLAB_BatchHeader bh;
+  struct GLAB_BatchDescriptor d;
+  size_t head;
+  uint16_t count;
+  uint16_t offset;
+
+  if (body_size < sizeof (bh))
+    return -1;
+  memcpy (&bh,
+          body,
+          sizeof (bh));
+  count = ntohs (bh.count);
+  head = sizeof (bh) + count * sizeof (d);
+  if (body_size < head)
+    return -1;
+  if (pos >= count)
+    return 0;
+  memcpy (&d,
+          &body[sizeof (bh) + pos * sizeof (d)],
+          sizeof (d));
+  *type = ntohs (d.type);
+  *size = ntohs (d.size);
+  offset = ntohs (d.offset);
+  if ( (offset < head) ||
+       (offset + *size > body_size) ||
+       (*type >= GLAB_TYPE_RESERVED) )
+    return -1;
+  *data = &body[offset];
+  return 1;
+}
+
+
+/**
+ * Find the next frame from the child in @a bufin, handling the
+ * other messages on the way.  Messages are consumed as we return
+ * their frame, a batch once we returned its last frame.
+ *
+ * @param gifc array of interfaces
+ * @param gifc_len length of @a gifc
+ * @param bufin data read from the child's STDOUT
+ * @param bufin_rpos number of bytes in @a bufin
+ * @param bufin_roff[in,out] offset of the first message not yet handled
+ * @param batch_pos[in,out] number of messages already handled of the
+ *        batch at @a bufin_roff
+ * @param current_write[out] set to the interface to write to, NULL if
+ *        there is no complete frame
+ * @param write_off[out] set to the frame in @a bufin
+ * @param write_left[out] set to the size of the frame
+ * @return 0 on success, -1 on protocol violations
+ */
+static int
+pipe_receive_from_child (struct Interface *gifc,
+                         int gifc_len,
+                         unsigned char *bufin,
+                         size_t bufin_rpos,
+                         size_t *bufin_roff,
+                         unsigned int *batch_pos,
+                         struct Interface **current_write,
+                         unsigned char **write_off,
+                         ssize_t *write_left)
+{
+  *current_write = NULL;
+  while ( (SHM_SWITCHING > shm_state) &&
+          (bufin_rpos - *bufin_roff >= sizeof (struct GLAB_MessageHeader)) )
+  {
+    unsigned char *msg = &bufin[*bufin_roff];
+    struct GLAB_MessageHeader hd;
+    unsigned char *body;
+    size_t body_size;
+    uint16_t s;
+    uint16_t n;
+
+    memcpy (&hd,
+            msg,
+            sizeof (hd));
+    s = ntohs (hd.size);
+    if (s > bufin_rpos - *bufin_roff)
+      return 0;
+    if (s < sizeof (hd))
+    {
+      fprintf (stderr,
+               "Invalid message size %u\n",
+               (unsigned int) s);
+      return -1;
+    }
+    n = ntohs (hd.type);
+    body = &msg[sizeof (hd)];
+    body_size = s - sizeof (hd);
+    if ( (GLAB_TYPE_BATCH == n) &&
+         (0 == body_size) )
+    {
+      /* child accepted batches */
+      *bufin_roff += s;
+      to_child.batches = 1;
+      continue;
+    }
+    if (GLAB_TYPE_BATCH == n)
+    {
+      int ret;
+
+      ret = batch_message (body,
+                           s - sizeof (hd),
+                           (*batch_pos)++,
+                           &n,
+                           &body,
+                           &body_size);
+      if (-1 == ret)
+      {
+        fprintf (stderr,
+                 "Malformed batch from child\n");
+        return -1;
+      }
+      if (0 == ret)
+      {
+        *bufin_roff += s;
+        *batch_pos = 0;
+        continue;
+      }
+    }
+    else
+    {
+      *bufin_roff += s;
+    }
+    if (0 == n)
+    {
+      fprintf (stdout,
+               "%.*s",
+               (int) body_size,
+               body);
+      fflush (stdout);
+      continue;
+    }
+    if (GLAB_TYPE_SHM == n)
+    {
+      /* child accepted the shared-memory rings */
+      if (SHM_OFFERED == shm_state)
+        shm_state = SHM_SWITCHING;
+      continue;
+    }
+    if (n > gifc_len)
+    {
+      fprintf (stderr,
+               "Invalid interface %u specified in message\n",
+               (unsigned int) n);
+      return -1;
+    }
+    *current_write = &gifc[n - 1];
+    *write_off = body;
+    *write_left = body_size;
+    return 0;
+  }
+  return 0;
+}
+
+
+/**
+ * Take the next frame the child wants us to send from the
+ * shared-memory ring.  Control messages are printed right away.
+ * The caller returns the space of all messages taken with
+ * ring_release() once the kernel has their frames.
+ *
+ * @param gifc array of interfaces
+ * @param gifc_len length of @a gifc
+ * @param current_write[out] set to the interface to write to, NULL if
+ *        there is nothing to send
+ * @param write_off[out] set to the frame, valid until ring_release()
+ * @param write_left[out] set to the size of the frame
+ * @return 0 on success, -1 on protocol violations
+ */
+static int
+shm_receive_from_child (struct Interface *gifc,
+                        int gifc_len,
+                        struct Interface **current_write,
+                        unsigned char **write_off,
+                        ssize_t *write_left)
+{
+  unsigned char *msg;
+  uint16_t n;
+  uint32_t s;
+
+  while (NULL != (msg = ring_pop (&shm.rx,
+                                  &n,
+                                  &s)))
+  {
+    /* the child wrote the descriptor, it must stay within the ring
+       and be no larger than a message on the pipe */
+    if ( (s > MAX_SIZE - sizeof (struct GLAB_MessageHeader)) ||
+         ((size_t) (msg - shm.rx.shared->data) + s > GLAB_RING_DATA_SIZE) )
+    {
+      fprintf (stderr,
+               "Invalid message of %u bytes in ring from child\n",
+               (unsigned int) s);
+      return -1;
+    }
+    if (n >= GLAB_TYPE_RESERVED)
+      continue;
+    if (0 == n)
+    {
+      fprintf (stdout,
+               "%.*s",
+               (int) s,
+               msg);
+      fflush (stdout);
+      continue;
+    }
+    if (n > gifc_len)
+    {
+      fprintf (stderr,
+               "Invalid interface %u specified in message\n",
+               (unsigned int) n);
+      return -1;
+    }
+    *current_write = &gifc[n - 1];
+    *write_off = msg;
+    *write_left = s;
+    return 0;
+  }
+  *current_write = NULL;
+  return 0;
+}
+
+
+/**
+ * Add @a ifc to the interfaces that may have frames for us.
+ *
+ * @param ifc interface to receive from
+ */
+static void
+schedule_receive (struct Interface *ifc)
+{
+  if (ifc->rx_ready)
+    return;
+  ifc->rx_ready = 1;
+  ifc->next_rx = rx_head;
+  rx_head = ifc;
+}
+
+
+/**
+ * Receive from the interfaces of this thread that may have frames
+ * for us.
+ *
+ * @return 0 if there are no more frames, 1 if some interface may
+ *         have more frames, -1 on error
+ */
+static int
+receive_scheduled (void)
+{
+  struct Interface *pending = rx_head;
+  int more = 0;
+
+  rx_head = NULL;
+  while (NULL != pending)
+  {
+    struct Interface *ifc = pending;
+    int ret;
+
+    pending = ifc->next_rx;
+    ifc->rx_ready = 0;
+    ret = receive_frames (ifc);
+    if (-1 == ret)
+      return -1;
+    if (1 == ret)
+    {
+      schedule_receive (ifc);
+      more = 1;
+    }
+  }
+  return more;
+}
+
+
+/**
+ * Register @a fd with the epoll instance @a ep.
+ *
+ * @param ep epoll instance
+ * @param fd file descriptor to watch
+ * @param events events to watch for
+ * @param source what to report in the event, see `enum EventSource`
+ * @return 0 on success, -1 on error (with errno set)
+ */
+static int
+watch_fd (int ep,
+          int fd,
+          uint32_t events,
+          uint64_t source)
+{
+  struct epoll_event ev;
+
+  memset (&ev,
+          0,
+          sizeof (ev));
+  ev.events = events;
+  ev.data.u64 = source;
+  return epoll_ctl (ep,
+                    EPOLL_CTL_ADD,
+                    fd,
+                    &ev);
+}
+
+
+/**
+ * Ring the doorbell @a fd of another thread.
+ *
+ * @param fd eventfd the thread waits on
+ */
+static void
+wake_up (int fd)
+{
+  uint64_t one = 1;
+
+  /* EAGAIN means the counter is saturated, the doorbell rings anyway */
+  (void) ! write (fd,
+                  &one,
+                  sizeof (one));
+}
+
+
+/**
+ * Pass a frame from the child to the worker that owns @a ifc.  If
+ * the worker is too far behind, we drop the frame.
+ *
+ * @param ifc interface to transmit on
+ * @param frame the frame
+ * @param size number of bytes in @a frame
+ */
+static void
+worker_transmit (struct Interface *ifc,
+                 const unsigned char *frame,
+                 size_t size)
+{
+  struct Worker *w = ifc->worker;
+  void *dst;
+
+  dst = ring_reserve (&w->shm.tx,
+                      size);
+  if (NULL == dst)
+  {
+    w->dropped++;
+    return;
+  }
+  memcpy (dst,
+          frame,
+          size);
+  ring_commit (&w->shm.tx,
+               ifc->ifc_num,
+               size);
+}
+
+
+/**
+ * Pass the frames the workers received to the child, as far as it
+ * has room.
+ *
+ * @return 0 if the workers have no more frames for us, 1 if they
+ *         may have more
+ */
+static int
+workers_to_child (void)
+{
+  static unsigned int first;
+  int more = 0;
+
+  /* start with a different worker each time, in case the child
+     runs out of room */
+  first = (first + 1) % num_workers;
+  for (unsigned int i = 0; i < num_workers; i++)
+  {
+    struct Worker *w = &workers[(first + i) % num_workers];
+    unsigned int n;
+
+    for (n = 0; n < RX_BUDGET; n++)
+    {
+      void *dst;
+
+      if ( (NULL == w->held) &&
+           (NULL == (w->held = ring_pop (&w->shm.rx,
+                                         &w->held_type,
+                                         &w->held_size))) )
+        break;
+      dst = child_reserve (w->held_size);
+      if (NULL == dst)
+        return 1;
+      memcpy (dst,
+              w->held,
+              w->held_size);
+      child_commit (w->held_type,
+                    w->held_size);
+      w->held = NULL;
+    }
+    ring_release (&w->shm.rx);
+    if (RX_BUDGET == n)
+      more = 1;
+  }
+  return more;
+}
+
+
+/**
+ * Receive and transmit on the interfaces of a worker until the main
+ * thread stops us or something goes wrong.
+ *
+ * @param cls the `struct Worker`
+ * @return NULL
+ */
+static void *
+worker_loop (void *cls)
+{
+  struct Worker *w = cls;
+  struct epoll_event events[MAX_EVENTS];
+  int ep;
+
+  ep = epoll_create1 (EPOLL_CLOEXEC);
+  if ( (-1 == ep) ||
+       (0 != watch_fd (ep,
+                       w->peer.wait_fd,
+                       EPOLLIN | EPOLLET,
+                       EVENT_SHM)) )
+  {
+    fprintf (stderr,
+             "Failed to set up epoll for worker: %s\n",
+             strerror (errno));
+    goto fail;
+  }
+  for (int i = 0; i < w->gifc_len; i++)
+  {
+    if (w != w->gifc[i].worker)
+      continue;
+    if (0 != watch_fd (ep,
+                       w->gifc[i].fd,
+                       EPOLLIN | EPOLLOUT | EPOLLET,
+                       EVENT_INTERFACE + i))
+    {
+      fprintf (stderr,
+               "epoll_ctl failed: %s\n",
+               strerror (errno));
+      goto fail;
+    }
+    schedule_receive (&w->gifc[i]);
+  }
+  while (! atomic_load (&w->quit))
+  {
+    int timeout = -1;
+    int tx_more = 0;
+    int more;
+    int nev;
+
+    /* Pass frames from our interfaces to the main thread */
+    more = receive_scheduled ();
+    if (-1 == more)
+      goto fail;
+    ring_publish (&w->peer.tx);
+
+    /* Sort frames from the main thread into the interface queues */
+    for (unsigned int n = 0; ; n++)
+    {
+      unsigned char *frame;
+      uint16_t type;
+      uint32_t size;
+
+      if (TX_BUDGET == n)
+      {
+        tx_more = 1;
+        break;
+      }
+      frame = ring_pop (&w->peer.rx,
+                        &type,
+                        &size);
+      if (NULL == frame)
+        break;
+      if (0 != transmit_frame (&w->gifc[type - 1],
+                               frame,
+                               size))
+        goto fail;
+    }
+    ring_release (&w->peer.rx);
+    if (-1 == kick_transmit ())
+      goto fail;
+
+    /* Sleep only if nothing can make progress right now */
+    if (0 != w->full)
+    {
+      /* wait for the main thread to make room */
+      if (! ring_producer_sleep (&w->peer.tx,
+                                 w->full))
+        timeout = 0;
+    }
+    else if (more)
+    {
+      timeout = 0;
+    }
+    if (tx_more)
+      timeout = 0;
+    else if (! ring_consumer_sleep (&w->peer.rx))
+      timeout = 0;
+    if (kick_possible ())
+      timeout = 0;
+
+    nev = epoll_wait (ep,
+                      events,
+                      MAX_EVENTS,
+                      timeout);
+    if (-1 == nev)
+    {
+      if (EINTR == errno)
+        continue;
+      fprintf (stderr,
+               "epoll_wait failed: %s\n",
+               strerror (errno));
+      goto fail;
+    }
+    for (int i = 0; i < nev; i++)
+    {
+      struct Interface *ifc;
+
+      if (EVENT_SHM == events[i].data.u64)
+      {
+        shm_drain (&w->peer);
+        continue;
+      }
+      ifc = &w->gifc[events[i].data.u64 - EVENT_INTERFACE];
+      if (0 != (events[i].events & (EPOLLIN | EPOLLERR)))
+        schedule_receive (ifc);
+      if (0 != (events[i].events & EPOLLOUT))
+        ifc->tx_blocked = 0;
+    }
+  }
+  (void) close (ep);
+  return NULL;
+fail:
+  if (-1 != ep)
+    (void) close (ep);
+  atomic_store (&w->failed,
+                1);
+  wake_up (w->peer.tx.peer_fd);
+  return NULL;
+}
+
+
+/**
+ * Stop the first @a started workers, and release all of them.
+ *
+ * @param started number of workers whose thread is running
+ */
+static void
+stop_workers (unsigned int started)
+{
+  for (unsigned int i = 0; i < started; i++)
+  {
+    atomic_store (&workers[i].quit,
+                  1);
+    wake_up (workers[i].shm.tx.peer_fd);
+  }
+  for (unsigned int i = 0; i < started; i++)
+    pthread_join (workers[i].thread,
+                  NULL);
+  for (unsigned int i = 0; i < num_workers; i++)
+  {
+    if (0 != workers[i].dropped)
+      fprintf (stderr,
+               "Dropped %llu frames for worker %u\n",
+               workers[i].dropped,
+               i);
+    shm_destroy (&workers[i].shm);
+  }
+  free (workers);
+  workers = NULL;
+}
+
+
+/**
+ * Hand the interfaces round-robin to #num_workers worker threads
+ * and start them.  The sockets of a fanout group go to different
+ * workers, as far as we have enough.
+ *
+ * @param gifc array of interfaces, followed by the additional
+ *        sockets of the fanout groups
+ * @param gifc_len number of interfaces
+ * @return 0 on success, -1 on error
+ */
+static int
+start_workers (struct Interface *gifc,
+               int gifc_len)
+{
+  if (num_workers > gifc_len * fanout)
+    num_workers = gifc_len * fanout;
+  workers = calloc (num_workers,
+                    sizeof (struct Worker));
+  if (NULL == workers)
+    abort ();
+  for (unsigned int i = 0; i < num_workers; i++)
+  {
+    struct Worker *w = &workers[i];
+
+    w->gifc = gifc;
+    w->gifc_len = gifc_len * fanout;
+    w->cpu = (0 == num_worker_cpus) ? -1 : worker_cpus[i % num_worker_cpus];
+    if (0 != shm_create (&w->shm))
+    {
+      fprintf (stderr,
+               "Failed to create rings for worker: %s\n",
+               strerror (errno));
+      num_workers = i;
+      stop_workers (0);
+      return -1;
+    }
+    shm_peer (&w->shm,
+              &w->peer);
+  }
+  for (int i = 0; i < gifc_len * fanout; i++)
+    gifc[i].worker = &workers[(i % gifc_len + i / gifc_len) % num_workers];
+  for (unsigned int i = 0; i < num_workers; i++)
+  {
+    struct Worker *w = &workers[i];
+    int err;
+
+    err = pthread_create (&w->thread,
+                          NULL,
+                          &worker_loop,
+                          w);
+    if (0 != err)
+    {
+      fprintf (stderr,
+               "Failed to start worker: %s\n",
+               strerror (err));
+      stop_workers (i);
+      return -1;
+    }
+    if (-1 != w->cpu)
+    {
+      cpu_set_t set;
+
+      CPU_ZERO (&set);
+      CPU_SET (w->cpu,
+               &set);
+      err = pthread_setaffinity_np (w->thread,
+                                    sizeof (set),
+                                    &set);
+      if (0 != err)
+        fprintf (stderr,
+                 "Failed to pin worker %u to CPU %d: %s\n",
+                 i,
+                 w->cpu,
+                 strerror (err));
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * Forward traffic until something goes wrong.
+ *
+ * @param ep epoll instance watching all our file descriptors
+ * @param cmd_always set if STDIN cannot be watched, we then read
+ *        from it whenever we have room
+ * @param gifc array of interfaces, followed by the additional
+ *        sockets of the fanout groups
+ * @param gifc_len number of interfaces
+ */
+static void
+event_loop (int ep,
+            int cmd_always,
+            struct Interface *gifc,
+            int gifc_len)
+{
+  /*
+   * The buffer filled by reading from child's stdout, to be passed to some fd
+   */
+  unsigned char bufin[MAX_SIZE];
+  /* read stream offset in 'bufin' */
+  size_t bufin_rpos = 0;
+  /* offset of the first message in 'bufin' not yet handled */
+  size_t bufin_roff = 0;
+  /* messages already handled of the batch at 'bufin_roff' */
+  unsigned int bufin_batch = 0;
+  /* command-line input not yet passed to the child */
+  unsigned char cmd_line[MAX_SIZE];
+  size_t cmd_line_size = 0;
+  /* set if epoll reported input on STDIN */
+  int cmd_ready = 0;
+  /* set while STDIN is watched, that is while 'cmd_line' has room */
+  int cmd_watched = 1;
+  /* set if there may be input from the child's STDOUT */
+  int child_stdout_ready = 1;
+  struct epoll_event events[MAX_EVENTS];
+
+  while (1)
+  {
+    int timeout = -1;
+    int more = 0;
+    int tx_more = 0;
+    int nev;
+
+    /* Read from command-line */
+    if ( (cmd_ready || cmd_always) &&
+         (cmd_line_size < MAX_SIZE) )
+    {
+      ssize_t ret = read (STDIN_FILENO,
+                          &cmd_line[cmd_line_size],
+                          MAX_SIZE - cmd_line_size);
+      if (0 >= ret)
+        return;
+      cmd_line_size += ret;
+      cmd_ready = 0; /* level-triggered, epoll tells us about the rest */
+    }
+
+    /* Read from child's stream for forwarding to network, as far as possible */
+    while (child_stdout_ready &&
+           ( (SHM_SWITCHING <= shm_state) ||
+             (bufin_rpos < MAX_SIZE) ) )
+    {
+      ssize_t ret;
+
+      if (SHM_SWITCHING <= shm_state)
+      {
+        /* child writes to the ring now, only watch for EOF */
+        unsigned char junk[256];
+
+        ret = read (child_stdout,
+                    junk,
+                    sizeof (junk));
+        if (0 < ret)
+        {
+          fprintf (stderr,
+                   "Ignoring %d bytes from child on pipe\n",
+                   (int) ret);
+          continue;
+        }
+      }
+      else
+      {
+        ret = read (child_stdout,
+                    &bufin[bufin_rpos],
+                    MAX_SIZE - bufin_rpos);
+        if (0 < ret)
+        {
+          bufin_rpos += ret;
+          continue;
+        }
+      }
+      if ( (-1 == ret) &&
+           ( (EAGAIN == errno) ||
+             (EWOULDBLOCK == errno) ) )
+      {
+        child_stdout_ready = 0;
+        break;
+      }
+      if (-1 == ret)
+      {
+        fprintf (stderr,
+                 "read-error: %s\n",
+                 strerror (errno));
+        return;
+      }
+      fprintf (stderr,
+               "EOF from child\n");
+      return;
+    }
+
+    if ( (SHM_SWITCHING == shm_state) &&
+         (NULL != child_reserve (0)) )
+    {
+      /* Tell the child to continue on the ring */
+      child_commit (GLAB_TYPE_SHM,
+                    0);
+      shm_state = SHM_ACTIVE;
+    }
+
+    /* Pass commands and frames to the child, as far as it has room */
+    forward_commands (cmd_line,
+                      &cmd_line_size);
+    if ( (! cmd_always) &&
+         (cmd_watched != (cmd_line_size < MAX_SIZE)) )
+    {
+      struct epoll_event ev;
+
+      /* STDIN is level-triggered, stop watching it while we are full */
+      cmd_watched = ! cmd_watched;
+      memset (&ev,
+              0,
+              sizeof (ev));
+      ev.events = cmd_watched ? EPOLLIN : 0;
+      ev.data.u64 = EVENT_COMMANDS;
+      if (0 != epoll_ctl (ep,
+                          EPOLL_CTL_MOD,
+                          STDIN_FILENO,
+                          &ev))
+      {
+        fprintf (stderr,
+                 "epoll_ctl failed: %s\n",
+                 strerror (errno));
+        return;
+      }
+    }
+    more = receive_scheduled ();
+    if (-1 == more)
+      return;
+    if ( (0 != num_workers) &&
+         (0 != workers_to_child ()) )
+      more = 1;
+    if (SHM_ACTIVE == shm_state)
+      ring_publish (&shm.tx);
+    if ( (to_child.writable) &&
+         (0 != child_write ()) )
+      return;
+
+    /* Sort frames from the child into the queues of their interfaces */
+    for (unsigned int n = 0; ; n++)
+    {
+      struct Interface *dst;
+      unsigned char *frame;
+      ssize_t size;
+      int ret;
+
+      if (TX_BUDGET == n)
+      {
+        tx_more = 1;
+        break;
+      }
+      if (SHM_SWITCHING <= shm_state)
+        ret = shm_receive_from_child (gifc,
+                                      gifc_len,
+                                      &dst,
+                                      &frame,
+                                      &size);
+      else
+        ret = pipe_receive_from_child (gifc,
+                                       gifc_len,
+                                       bufin,
+                                       bufin_rpos,
+                                       &bufin_roff,
+                                       &bufin_batch,
+                                       &dst,
+                                       &frame,
+                                       &size);
+      if (-1 == ret)
+        return;
+      if (NULL == dst)
+        break;
+      if (NULL != dst->worker)
+        worker_transmit (dst,
+                         frame,
+                         size);
+      else if (0 != transmit_frame (dst,
+                                    frame,
+                                    size))
+        return;
+    }
+    /* the frames were copied, the child may reuse their space */
+    if (SHM_SWITCHING <= shm_state)
+      ring_release (&shm.rx);
+    for (unsigned int i = 0; i < num_workers; i++)
+      ring_publish (&workers[i].shm.tx);
+    if (0 != bufin_roff)
+    {
+      memmove (bufin,
+               &bufin[bufin_roff],
+               bufin_rpos - bufin_roff);
+      bufin_rpos -= bufin_roff;
+      bufin_roff = 0;
+    }
+    if (-1 == kick_transmit ())
+      return;
+
+    /* Sleep only if nothing can make progress right now */
+    if (0 != to_child.full)
+    {
+      /* wait for the child to make room */
+      if (SHM_ACTIVE != shm_state)
+      {
+        if (to_child.writable)
+          timeout = 0; /* we wrote everything, there is room now */
+      }
+      else if (! ring_producer_sleep (&shm.tx,
+                                      to_child.full))
+        timeout = 0;
+    }
+    else if (more)
+    {
+      /* more frames to receive, only poll */
+      timeout = 0;
+    }
+    if (tx_more)
+    {
+      /* more frames from the child, only poll */
+      timeout = 0;
+    }
+    else if ( (SHM_SWITCHING <= shm_state) &&
+              (! ring_consumer_sleep (&shm.rx)) )
+      timeout = 0;
+    for (unsigned int i = 0; i < num_workers; i++)
+      if (! ring_consumer_sleep (&workers[i].shm.rx))
+        timeout = 0;
+    if (kick_possible ())
+      timeout = 0;
+    if ( (child_stdout_ready) &&
+         (bufin_rpos < MAX_SIZE) )
+      timeout = 0;
+    if ( (cmd_always) &&
+         (cmd_line_size < MAX_SIZE) )
+      timeout = 0;
+
+    nev = epoll_wait (ep,
+                      events,
+                      MAX_EVENTS,
+                      timeout);
+    if (-1 == nev)
+    {
+      if (EINTR == errno)
+        continue;
+      fprintf (stderr,
+               "epoll_wait failed: %s\n",
+               strerror (errno));
+      return;
+    }
+    for (int i = 0; i < nev; i++)
+    {
+      struct Interface *ifc;
+
+      switch (events[i].data.u64)
+      {
+      case EVENT_COMMANDS:
+        cmd_ready = 1;
+        break;
+      case EVENT_CHILD_STDIN:
+        to_child.writable = 1;
+        break;
+      case EVENT_CHILD_STDOUT:
+        child_stdout_ready = 1;
+        break;
+      case EVENT_SHM:
+        shm_drain (&shm);
+        break;
+      case EVENT_WORKERS:
+        for (unsigned int j = 0; j < num_workers; j++)
+        {
+          shm_drain (&workers[j].shm);
+          if (atomic_load (&workers[j].failed))
+            return;
+        }
+        break;
+      default:
+        ifc = &gifc[events[i].data.u64 - EVENT_INTERFACE];
+        if (0 != (events[i].events & (EPOLLIN | EPOLLERR)))
+          schedule_receive (ifc);
+        if (0 != (events[i].events & EPOLLOUT))
+          ifc->tx_blocked = 0;
+        break;
+      }
+    }
+  }
+}
+
+
+/**
+ * Start forwarding to and from the tunnel.
+ *
+ * @param gifc array of interfaces, followed by the additional
+ *        sockets of the fanout groups
+ * @param gifc_len number of interfaces
+ */
+static void
+run (struct Interface *gifc,
+     int gifc_len)
+{
+  int cmd_always = 0;
+  int ep;
+
+  ep = epoll_create1 (EPOLL_CLOEXEC);
+  if (-1 == ep)
+  {
+    fprintf (stderr,
+             "epoll_create1 failed: %s\n",
+             strerror (errno));
+    return;
+  }
+  /* STDIN may be a regular file, which is always readable */
+  if (0 != watch_fd (ep,
+                     STDIN_FILENO,
+                     EPOLLIN,
+                     EVENT_COMMANDS))
+  {
+    if (EPERM != errno)
+      goto fail;
+    cmd_always = 1;
+  }
+  if ( (0 != watch_fd (ep,
+                       child_stdin,
+                       EPOLLOUT | EPOLLET,
+                       EVENT_CHILD_STDIN)) ||
+       (0 != watch_fd (ep,
+                       child_stdout,
+                       EPOLLIN | EPOLLET,
+                       EVENT_CHILD_STDOUT)) ||
+       ( (SHM_OFF != shm_state) &&
+         (0 != watch_fd (ep,
+                         shm.wait_fd,
+                         EPOLLIN | EPOLLET,
+                         EVENT_SHM)) ) )
+    goto fail;
+  if (0 != num_workers)
+  {
+    /* the workers watch the interfaces */
+    if (0 != start_workers (gifc,
+                            gifc_len))
+    {
+      (void) close (ep);
+      return;
+    }
+    for (unsigned int i = 0; i<num_workers; i++)
+      if (0 != watch_fd (ep,
+                         workers[i].shm.wait_fd,
+                         EPOLLIN | EPOLLET,
+                         EVENT_WORKERS))
+        goto fail;
+  }
+  else
+  {
+    for (unsigned int i = 0; i<gifc_len * fanout; i++)
+    {
+      if (0 != watch_fd (ep,
+                         gifc[i].fd,
+                         EPOLLIN | EPOLLOUT | EPOLLET,
+                         EVENT_INTERFACE + i))
+        goto fail;
+      schedule_receive (&gifc[i]);
+    }
+  }
+  to_child.writable = 1;
+  event_loop (ep,
+              cmd_always,
+              gifc,
+              gifc_len);
+  if (0 != num_workers)
+    stop_workers (num_workers);
+  (void) close (ep);
+  return;
+fail:
+  fprintf (stderr,
+           "epoll_ctl failed: %s\n",
+           strerror (errno));
+  if (0 != num_workers)
+    stop_workers (num_workers);
+  (void) close (ep);
+}
+
+
+/**
+ * Parse a comma-separated list of numbers.
+ *
+ * @param arg the list
+ * @param max largest number we accept
+ * @param list[out] set to the numbers, to be freed by the caller
+ * @param len[out] set to the length of @a list
+ * @return 0 on success, -1 if @a arg is malformed
+ */
+static int
+parse_list (const char *arg,
+            unsigned long max,
+            uint16_t **list,
+            unsigned int *len)
+{
+  const char *pos = arg;
+
+  free (*list);
+  *list = NULL;
+  *len = 0;
+  while (1)
+  {
+    unsigned long val;
+    char *end;
+
+    errno = 0;
+    val = strtoul (pos,
+                   &end,
+                   0);
+    if ( (0 != errno) ||
+         (end == pos) ||
+         (val > max) ||
+         ( (',' != *end) &&
+           ('\0' != *end) ) )
+      return -1;
+    *list = realloc (*list,
+                     (*len + 1) * sizeof (uint16_t));
+    if (NULL == *list)
+      abort ();
+    (*list)[(*len)++] = (uint16_t) val;
+    if ('\0' == *end)
+      return 0;
+    pos = end + 1;
+  }
+}
+
+
+/**
+ * Print how to invoke us.
+ *
+ * @param binary name of the binary
+ */
+static void
+print_usage (const char *binary)
+{
+  fprintf (stderr,
+           "Usage: %s [OPTIONS] IFC... - PROGRAM [ARGS...]\n"
+           "  -M, --no-mmap        do not use mmap()ed packet rings\n"
+           "  -b, --rx-blocks=N    use N blocks of %u KiB per receive ring (default: %u)\n"
+           "  -t, --tx-frames=N    use N slots per transmit ring (default: %u)\n"
+           "  -n, --batch=N        pass up to N frames per recvmmsg()/sendmmsg() (default: %u)\n"
+           "  -q, --tx-queue=N     queue up to N frames per interface (default: %u)\n"
+           "  -d, --tx-drop=WHICH  if a queue is full, drop the new frame (`tail', default)\n"
+           "                       or the oldest one (`head')\n"
+           "  -f, --fanout=N       receive with N sockets per interface, which share\n"
+           "                       the flows of the interface (default: 1)\n"
+           "  -w, --workers=N      receive and transmit in N threads (default: 0, do\n"
+           "                       everything in the main thread)\n"
+           "  -c, --cpus=LIST      pin the workers to the comma-separated CPUs in LIST\n"
+           "  -m, --filter-mac     only receive frames for the MAC of the interface,\n"
+           "                       multicast and broadcast\n"
+           "  -V, --filter-vlan=LIST  only receive frames of the VLANs in LIST\n"
+           "                       (0 for untagged frames)\n"
+           "  -e, --filter-type=LIST  only receive frames of the EtherTypes in LIST\n",
+           binary,
+           (unsigned int) (RX_BLOCK_SIZE / 1024),
+           (unsigned int) RX_DEFAULT_BLOCKS,
+           (unsigned int) TX_DEFAULT_FRAMES,
+           (unsigned int) BATCH_DEFAULT_SIZE,
+           (unsigned int) TX_QUEUE_DEFAULT_DEPTH);
+}
+
+
+/**
+ * Open network interfaces and pass traffic from/to child process.
+ *
+ * @param argc number of arguments in @a argv
+ * @param argv 0: binary name (network-driver)
+ *             1..k: options (see print_usage())
+ *             k+1..n: network interface name (e.g. eth0)
+ *             n+1: "-"
+ *             n+2: child program to launch
+ */
+int
+main (int argc,
+      char **argv)
+{
+  static const struct option options[] = {
+    { "no-mmap", no_argument, NULL, 'M' },
+    { "rx-blocks", required_argument, NULL, 'b' },
+    { "tx-frames", required_argument, NULL, 't' },
+    { "batch", required_argument, NULL, 'n' },
+    { "tx-queue", required_argument, NULL, 'q' },
+    { "tx-drop", required_argument, NULL, 'd' },
+    { "fanout", required_argument, NULL, 'f' },
+    { "workers", required_argument, NULL, 'w' },
+    { "cpus", required_argument, NULL, 'c' },
+    { "filter-mac", no_argument, NULL, 'm' },
+    { "filter-vlan", required_argument, NULL, 'V' },
+    { "filter-type", required_argument, NULL, 'e' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  struct Interface *gifc;
+  int global_ret;
+  int first;
+  int end;
+  int c;
+
+  /* '+': stop at the first interface name */
+  while (-1 != (c = getopt_long (argc,
+                                 argv,
+                                 "+Mb:t:n:q:d:f:w:c:mV:e:h",
+                                 options,
+                                 NULL)))
+  {
+    switch (c)
+    {
+    case 'M':
+      use_mmap = 0;
+      break;
+    case 'b':
+      if ( (1 != sscanf (optarg,
+                         "%u",
+                         &rx_blocks)) ||
+           (0 == rx_blocks) )
+      {
+        fprintf (stderr,
+                 "Invalid number of receive blocks `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      if ( (1 != sscanf (optarg,
+                         "%u",
+                         &tx_frames)) ||
+           (0 == tx_frames) )
+      {
+        fprintf (stderr,
+                 "Invalid number of transmit frames `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'n':
+      if ( (1 != sscanf (optarg,
+                         "%u",
+                         &batch_size)) ||
+           (0 == batch_size) ||
+           (batch_size > UIO_MAXIOV) )
+      {
+        fprintf (stderr,
+                 "Invalid batch size `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'q':
+      if ( (1 != sscanf (optarg,
+                         "%u",
+                         &tx_queue_depth)) ||
+           (0 == tx_queue_depth) )
+      {
+        fprintf (stderr,
+                 "Invalid transmit queue depth `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'd':
+      if (0 == strcmp (optarg,
+                       "head"))
+        tx_drop_head = 1;
+      else if (0 == strcmp (optarg,
+                            "tail"))
+        tx_drop_head = 0;
+      else
+      {
+        fprintf (stderr,
+                 "Invalid drop policy `%s', use `head' or `tail'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'f':
+      if ( (1 != sscanf (optarg,
+                         "%u",
+                         &fanout)) ||
+           (0 == fanout) )
+      {
+        fprintf (stderr,
+                 "Invalid number of sockets per interface `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'w':
+      if (1 != sscanf (optarg,
+                       "%u",
+                       &num_workers))
+      {
+        fprintf (stderr,
+                 "Invalid number of workers `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'c':
+      if (0 != parse_list (optarg,
+                           CPU_SETSIZE - 1,
+                           &worker_cpus,
+                           &num_worker_cpus))
+      {
+        fprintf (stderr,
+                 "Invalid CPU list `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'm':
+      filter_mac = 1;
+      break;
+    case 'V':
+      if ( (0 != parse_list (optarg,
+                             0x0FFF,
+                             &filter_vlans,
+                             &num_filter_vlans)) ||
+           (num_filter_vlans > FILTER_MAX_LIST) )
+      {
+        fprintf (stderr,
+                 "Invalid VLAN list `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'e':
+      if ( (0 != parse_list (optarg,
+                             UINT16_MAX,
+                             &filter_types,
+                             &num_filter_types)) ||
+           (num_filter_types > FILTER_MAX_LIST) )
+      {
+        fprintf (stderr,
+                 "Invalid EtherType list `%s'\n",
+                 optarg);
+        return 1;
+      }
+      break;
+    case 'h':
+      print_usage (argv[0]);
+      return 0;
+    default:
+      print_usage (argv[0]);
+      return 1;
+    }
+  }
+  first = optind;
+  for (end = first; NULL != argv[end]; end++)
+    if (0 == strcmp ("-",
+                     argv[end]))
+      break;
+  if (first + 1 > end)
+  {
+    fprintf (stderr,
+             "Fatal: must supply network interface names!\n");
+    return 1;
+  }
+  if (end == argc)
+  {
+    fprintf (stderr,
+             "Fatal: must supply child process to launch!\n");
+    return 1;
+  }
+
+  /* Offer the shared-memory transport, fall back to the pipes */
+  shm_state = (0 == shm_create (&shm)) ? SHM_OFFERED : SHM_OFF;
+
+  /* Launch child process */
+  {
+    int cin[2];
+    int cout[2];
+
+    if (0 != pipe (cin))
+    {
+      perror ("pipe");
+      return 1;
+    }
+    if (0 != pipe (cout))
+    {
+      perror ("pipe");
+      return 1;
+    }
+    chld = fork ();
+    if (-1 == chld)
+    {
+      perror ("fork");
+      return 1;
+    }
+    if (0 == chld)
+    {
+      close (STDIN_FILENO);
+      close (STDOUT_FILENO);
+      close (cin[1]);
+      close (cout[0]);
+      if (-1 == dup2 (cin[0],
+                      STDIN_FILENO))
+      {
+        perror ("dup2");
+        exit (1);
+      }
+      if (-1 == dup2 (cout[1],
+                      STDOUT_FILENO))
+      {
+        perror ("dup2");
+        exit (1);
+      }
+      if ( (SHM_OFFERED == shm_state) &&
+           (0 != shm_offer (&shm)) )
+        perror ("setenv");
+      execvp (argv[end + 1],
+              &argv[end + 1]);
+      perror ("execvp");
+      exit (1);
+    }
+    close (cin[0]);
+    close (cout[1]);
+    child_stdin = cin[1];
+    child_stdout = cout[0];
+    /* we wait for both pipes with edge-triggered epoll */
+    if ( (-1 == fcntl (child_stdin,
+                       F_SETFL,
+                       O_NONBLOCK)) ||
+         (-1 == fcntl (child_stdout,
+                       F_SETFL,
+                       O_NONBLOCK)) )
+      perror ("fcntl");
+  } /* end launch child */
+
+  gifc = calloc ((end - first) * fanout,
+                 sizeof (struct Interface));
+  if (NULL == gifc)
+    abort ();
+  for (unsigned int i = 1; i<=(end - first) * fanout; i++)
+    gifc[i - 1].fd = -1;
+  for (unsigned int i = 1; i<=(end - first) * fanout; i++)
+  {
+    struct Interface *ifc = &gifc[i - 1];
+    char dev[IFNAMSIZ];
+
+    /* the additional sockets of the fanout groups come last */
+    if (i > end - first)
+    {
+      const struct Interface *primary = &gifc[(i - 1) % (end - first)];
+
+      ifc->ifc_num = primary->ifc_num;
+      ifc->rx_only = 1;
+      ifc->fanout_id = primary->fanout_id;
+    }
+    else
+    {
+      ifc->ifc_num = i;
+    }
+    strncpy (dev,
+             argv[first + ifc->ifc_num - 1],
+             IFNAMSIZ);
+    dev[IFNAMSIZ - 1] = '\0';
+    if (-1 == init_tun (dev,
+                        ifc))
+    {
+      fprintf (stderr,
+               "Fatal: could not initialize interface `%s'\n",
+               dev);
+      global_ret = 4;
+      goto cleanup;
+    }
+  }
+
+  {
+    struct GLAB_MessageHeader gh;
+    uint16_t caps;
+    char *mbuf;
+    size_t size;
+
+    /* our MACs, followed by the capabilities */
+    size = sizeof (struct GLAB_MessageHeader) + (end - first) * MAC_ADDR_SIZE
+           + sizeof (caps);
+    mbuf = malloc (size);
+    if (NULL == mbuf)
+      abort ();
+    gh.size = htons  (size);
+    gh.type = htons (0);
+    caps = htons (GLAB_CAP_BATCH);
+    memcpy (mbuf,
+            &gh,
+            sizeof (gh));
+    for (unsigned int i = 1; i<=end - first; i++)
+      memcpy (&mbuf[sizeof (struct GLAB_MessageHeader) + (i - 1)
+                    * MAC_ADDR_SIZE],
+              gifc[i - 1].my_mac,
+              MAC_ADDR_SIZE);
+    memcpy (&mbuf[size - sizeof (caps)],
+            &caps,
+            sizeof (caps));
+    if (size !=
+        write (child_stdin,
+               mbuf,
+               size))
+    {
+      fprintf (stderr,
+               "Failed to send my MACs to application: %s",
+               strerror (errno));
+      free (mbuf);
+      global_ret = 4;
+      goto cleanup;
+    }
+    free (mbuf);
+  }
+
+  {
+    uid_t uid = getuid ();
+#ifdef HAVE_SETRESUID
+    if (0 != setresuid (uid,
+                        uid,
+                        uid))
+    {
+      fprintf (stderr,
+               "Failed to setresuid: %s\n",
+               strerror (errno));
+      global_ret = 2;
+      goto cleanup;
+    }
+#else
+    if (0 != (setuid (uid) | seteuid (uid)))
+    {
+      fprintf (stderr,
+               "Failed to setuid: %s\n",
+               strerror (errno));
+      global_ret = 2;
+      goto cleanup;
+    }
+#endif
+  }
+
+  if (SIG_ERR ==
+      signal (SIGPIPE,
+              SIG_IGN))
+  {
+    fprintf (stderr,
+             "Failed to protect against SIGPIPE: %s\n",
+             strerror (errno));
+    /* no exit, we might as well die with SIGPIPE should it ever happen */
+  }
+  fprintf (stderr,
+           "Starting main loop\n");
+  run (gifc,
+       end - first);
+  kill (chld,
+        SIGKILL);
+  global_ret = 0;
+cleanup:
+  for (unsigned int i = 1; i<=(end - first) * fanout; i++)
+  {
+    if (0 != gifc[i - 1].txq.dropped)
+      fprintf (stderr,
+               "Dropped %llu frames for `%s'\n",
+               gifc[i - 1].txq.dropped,
+               gifc[i - 1].if_idx.ifr_name);
+    if (NULL != gifc[i - 1].rings)
+      munmap (gifc[i - 1].rings,
+              gifc[i - 1].rings_size);
+    free (gifc[i - 1].rxb.buf);
+    free (gifc[i - 1].rxb.msgs);
+    free (gifc[i - 1].rxb.iov);
+    free (gifc[i - 1].rxb.aux);
+    free (gifc[i - 1].txb.msgs);
+    free (gifc[i - 1].txb.iov);
+    free (gifc[i - 1].txq.buf);
+    free (gifc[i - 1].txq.size);
+    if (-1 != gifc[i - 1].fd)
+      close (gifc[i - 1].fd);
+  }
+  free (gifc);
+  free (worker_cpus);
+  free (filter_vlans);
+  free (filter_types);
+  if (SHM_OFF != shm_state)
+    shm_destroy (&shm);
+  return global_ret;
+}
@@ -0,0 +1,440 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file output.c
+ * @brief Batched output of frames to the parent
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+#include <limits.h>
+#include <poll.h>
+
+
+/**
+ * Maximum number of buffers we pass to a single writev().
+ */
+#define OUTPUT_MAX_IOV IOV_MAX
+
+/**
+ * Number of buffers a single frame may need (header, head, body).
+ */
+#define OUTPUT_IOV_PER_FRAME 3
+
+/**
+ * Size of the arena holding message headers and copied data.
+ */
+#define OUTPUT_ARENA_SIZE (2 * 65536)
+
+/**
+ * Maximum number of frames in a #GLAB_TYPE_BATCH message.
+ */
+#define OUTPUT_BATCH_MAX 64
+
+/**
+ * Room we reserve in the arena for the start of a batch: message
+ * header, batch header and descriptors.
+ */
+#define OUTPUT_BATCH_HEAD (sizeof (struct GLAB_MessageHeader)     \
+                           + sizeof (struct GLAB_BatchHeader)     \
+                           + OUTPUT_BATCH_MAX                     \
+                           * sizeof (struct GLAB_BatchDescriptor))
+
+
+/**
+ * Output queued for the parent.
+ */
+static struct
+{
+  /**
+   * Buffers to write, in order.
+   */
+  struct iovec iov[OUTPUT_MAX_IOV];
+
+  /**
+   * Message headers and copies of (small) data.
+   */
+  char arena[OUTPUT_ARENA_SIZE];
+
+  /**
+   * Number of entries used in @e iov.
+   */
+  unsigned int iovcnt;
+
+  /**
+   * Number of bytes used in @e arena.
+   */
+  size_t arena_used;
+
+  /**
+   * Shared-memory transport to write to instead of STDOUT_FILENO,
+   * NULL if we use the pipe.
+   */
+  struct GLAB_Shm *shm;
+
+  /**
+   * Start of the open batch in @e arena, NULL for none.  Its entry
+   * in @e iov only gets its length once we close the batch.
+   */
+  char *batch;
+
+  /**
+   * Entry of @e batch in @e iov.
+   */
+  unsigned int batch_iov;
+
+  /**
+   * Number of frames in @e batch.
+   */
+  unsigned int batch_count;
+
+  /**
+   * Number of bytes of frame data in @e batch.
+   */
+  size_t batch_data;
+
+  /**
+   * Did the parent agree to batches?
+   */
+  int batches;
+
+} out;
+
+
+/**
+ * Send output through the rings of @a shm instead of STDOUT_FILENO.
+ *
+ * @param shm attached transport
+ */
+void
+output_use_shm (struct GLAB_Shm *shm)
+{
+  output_flush ();
+  out.shm = shm;
+}
+
+
+/**
+ * Reserve @a size bytes in the ring to the parent, waiting for the
+ * parent to make room if necessary.
+ *
+ * @param size number of bytes needed
+ * @return where to put the message
+ */
+static void *
+reserve_shm (size_t size)
+{
+  struct GLAB_Ring *tx = &out.shm->tx;
+  void *dst;
+
+  while (NULL == (dst = ring_reserve (tx,
+                                      size)))
+  {
+    struct pollfd pfd = {
+      .fd = out.shm->wait_fd,
+      .events = POLLIN
+    };
+
+    /* let the parent see what we have so far before we wait */
+    ring_publish (tx);
+    if (! ring_producer_sleep (tx,
+                               size))
+      continue;
+    if ( (-1 == poll (&pfd,
+                      1,
+                      -1)) &&
+         (EINTR != errno) )
+    {
+      fprintf (stderr,
+               "poll failed: %s\n",
+               strerror (errno));
+      exit (1);
+    }
+    shm_drain (out.shm);
+  }
+  return dst;
+}
+
+
+/**
+ * Append @a size bytes at @a data to the batch.  Merges with
+ * the previous buffer if the two are adjacent in memory.
+ *
+ * @param data bytes to append
+ * @param size number of bytes in @a data
+ */
+static void
+append (const void *data,
+        size_t size)
+{
+  struct iovec *last;
+
+  if (0 == size)
+    return;
+  /* the length of an open batch is not known yet */
+  if ( (0 != out.iovcnt) &&
+       ( (NULL == out.batch) ||
+         (out.batch_iov != out.iovcnt - 1) ) )
+  {
+    last = &out.iov[out.iovcnt - 1];
+    if ((char *) last->iov_base + last->iov_len == (const char *) data)
+    {
+      last->iov_len += size;
+      return;
+    }
+  }
+  last = &out.iov[out.iovcnt++];
+  last->iov_base = (void *) data;
+  last->iov_len = size;
+}
+
+
+/**
+ * Copy @a size bytes at @a data into the arena and append them
+ * to the batch.  The caller must have checked that there is room.
+ *
+ * @param data bytes to copy
+ * @param size number of bytes in @a data
+ */
+static void
+append_copy (const void *data,
+             size_t size)
+{
+  char *dst = &out.arena[out.arena_used];
+
+  memcpy (dst,
+          data,
+          size);
+  out.arena_used += size;
+  append (dst,
+          size);
+}
+
+
+/**
+ * Finish the open batch: now that we know the number of frames,
+ * fill in the headers and move the offsets behind the descriptors.
+ */
+static void
+close_batch (void)
+{
+  struct GLAB_MessageHeader hdr;
+  struct GLAB_BatchHeader bh;
+  size_t head = sizeof (bh) + out.batch_count
+                * sizeof (struct GLAB_BatchDescriptor);
+  char *desc;
+
+  if (NULL == out.batch)
+    return;
+  desc = &out.batch[sizeof (hdr) + sizeof (bh)];
+  for (unsigned int i = 0; i<out.batch_count; i++)
+  {
+    struct GLAB_BatchDescriptor d;
+
+    memcpy (&d,
+            &desc[i * sizeof (d)],
+            sizeof (d));
+    d.offset = htons (ntohs (d.offset) + head);
+    memcpy (&desc[i * sizeof (d)],
+            &d,
+            sizeof (d));
+  }
+  hdr.size = htons ((uint16_t) (sizeof (hdr) + head + out.batch_data));
+  hdr.type = htons (GLAB_TYPE_BATCH);
+  bh.count = htons ((uint16_t) out.batch_count);
+  memcpy (out.batch,
+          &hdr,
+          sizeof (hdr));
+  memcpy (&out.batch[sizeof (hdr)],
+          &bh,
+          sizeof (bh));
+  out.iov[out.batch_iov].iov_len = sizeof (hdr) + head;
+  out.batch = NULL;
+}
+
+
+/**
+ * Queue a frame for interface @a ifc_num in a batch.
+ *
+ * @param ifc_num interface to send the frame out on
+ * @param head first part of the frame, may be NULL
+ * @param head_size number of bytes in @a head
+ * @param body second part of the frame, may be NULL
+ * @param body_size number of bytes in @a body
+ */
+static void
+batch_frame (uint16_t ifc_num,
+             const void *head,
+             size_t head_size,
+             const void *body,
+             size_t body_size)
+{
+  struct GLAB_BatchDescriptor d;
+  size_t size = head_size + body_size;
+
+  if ( (NULL != out.batch) &&
+       ( (OUTPUT_BATCH_MAX == out.batch_count) ||
+         (sizeof (struct GLAB_MessageHeader)
+          + sizeof (struct GLAB_BatchHeader)
+          + (out.batch_count + 1) * sizeof (d)
+          + out.batch_data + size > UINT16_MAX) ) )
+    close_batch ();
+  if ( (out.iovcnt + OUTPUT_IOV_PER_FRAME > OUTPUT_MAX_IOV) ||
+       (out.arena_used + OUTPUT_BATCH_HEAD + head_size > OUTPUT_ARENA_SIZE) )
+    output_flush ();
+  if (NULL == out.batch)
+  {
+    out.batch = &out.arena[out.arena_used];
+    out.arena_used += OUTPUT_BATCH_HEAD;
+    out.batch_iov = out.iovcnt++;
+    out.iov[out.batch_iov].iov_base = out.batch;
+    out.iov[out.batch_iov].iov_len = 0;
+    out.batch_count = 0;
+    out.batch_data = 0;
+  }
+  /* offset relative to the data for now, see close_batch() */
+  d.type = htons (ifc_num);
+  d.size = htons ((uint16_t) size);
+  d.offset = htons ((uint16_t) out.batch_data);
+  memcpy (&out.batch[sizeof (struct GLAB_MessageHeader)
+                     + sizeof (struct GLAB_BatchHeader)
+                     + out.batch_count * sizeof (d)],
+          &d,
+          sizeof (d));
+  out.batch_count++;
+  out.batch_data += size;
+  if (NULL != head)
+    append_copy (head,
+                 head_size);
+  if (NULL != body)
+    append (body,
+            body_size);
+}
+
+
+/**
+ * Send frames to the parent in #GLAB_TYPE_BATCH messages.
+ */
+void
+output_use_batches (void)
+{
+  output_flush ();
+  out.batches = 1;
+}
+
+
+/**
+ * Queue a frame for interface @a ifc_num (0 for a control message).
+ * The frame consists of @a head followed by @a body.  @a head is
+ * copied, @a body is only referenced and must remain valid until
+ * output_flush() is called.  loop() flushes after processing each
+ * batch of input and before reusing its buffer, so frames received
+ * from loop() may be passed as @a body.  The batch is also flushed
+ * whenever it fills up.
+ *
+ * @param ifc_num interface to send the frame out on
+ * @param head first part of the frame, may be NULL
+ * @param head_size number of bytes in @a head
+ * @param body second part of the frame, may be NULL
+ * @param body_size number of bytes in @a body
+ */
+void
+output_frame (uint16_t ifc_num,
+              const void *head,
+              size_t head_size,
+              const void *body,
+              size_t body_size)
+{
+  struct GLAB_MessageHeader hdr;
+  size_t total = sizeof (hdr) + head_size + body_size;
+
+  if (total > UINT16_MAX)
+  {
+    fprintf (stderr,
+             "Refusing to send oversized message (%u bytes)\n",
+             (unsigned int) total);
+    return;
+  }
+  if (NULL != out.shm)
+  {
+    /* copy into the ring right away, publish on flush */
+    char *dst = reserve_shm (head_size + body_size);
+
+    if (NULL != head)
+      memcpy (dst,
+              head,
+              head_size);
+    if (NULL != body)
+      memcpy (&dst[head_size],
+              body,
+              body_size);
+    ring_commit (&out.shm->tx,
+                 ifc_num,
+                 head_size + body_size);
+    return;
+  }
+  if ( (out.batches) &&
+       (ifc_num < GLAB_TYPE_RESERVED) &&
+       (OUTPUT_BATCH_HEAD + head_size + body_size <= UINT16_MAX) )
+  {
+    batch_frame (ifc_num,
+                 head,
+                 head_size,
+                 body,
+                 body_size);
+    return;
+  }
+  close_batch ();
+  hdr.size = htons ((uint16_t) total);
+  hdr.type = htons (ifc_num);
+  if ( (out.iovcnt + OUTPUT_IOV_PER_FRAME > OUTPUT_MAX_IOV) ||
+       (out.arena_used + sizeof (hdr) + head_size > OUTPUT_ARENA_SIZE) )
+    output_flush ();
+  append_copy (&hdr,
+               sizeof (hdr));
+  if (NULL != head)
+    append_copy (head,
+                 head_size);
+  if (NULL != body)
+    append (body,
+            body_size);
+}
+
+
+/**
+ * Write all queued frames to the parent with as few system
+ * calls as possible.  With the shared-memory transport, make
+ * them visible to the parent instead.
+ */
+void
+output_flush (void)
+{
+  if (NULL != out.shm)
+  {
+    ring_publish (&out.shm->tx);
+    return;
+  }
+  close_batch ();
+  if (0 == out.iovcnt)
+    return;
+  writev_all (STDOUT_FILENO,
+              out.iov,
+              out.iovcnt);
+  out.iovcnt = 0;
+  out.arena_used = 0;
+}
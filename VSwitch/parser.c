@@ -1,81 +1,81 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file sample_parser.c
- * @brief Parses output of network-driver
- * @author Christian Grothoff
- */
-#include "glab.h"
-
-
-/**
- * Process frame received from @a interface.
- *
- * @param interface number of the interface on which we received @a frame
- * @param frame the frame
- * @param frame_size number of bytes in @a frame
- */
-static void
-handle_frame (uint16_t interface,
-              const void *frame,
-              size_t frame_size)
-{
-  /* fill me in! */
-}
-
-
-/**
- * Handle control message @a cmd.
- *
- * @param cmd text the user entered
- * @param cmd_len length of @a cmd
- */
-static void
-handle_control (char *cmd,
-                size_t cmd_len)
-{
-  cmd[cmd_len - 1] = '\0';
-  print ("Received command `%s'\n",
-         cmd);
-}
-
-
-/**
- * Handle MAC information @a mac
- *
- * @param ifc_num number of the interface with @a mac
- * @param mac the MAC address at @a ifc_num
- */
-static void
-handle_mac (uint16_t ifc_num,
-            const struct MacAddress *mac)
-{
-  /* Fill me in! */
-}
-
-
-int
-main (int argc,
-      char **argv)
-{
-  loop (&handle_frame,
-        &handle_control,
-        &handle_mac);
-  return 0;
-}
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file sample_parser.c
+ * @brief Parses output of network-driver
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+
+
+/**
+ * Process frame received from @a interface.
+ *
+ * @param interface number of the interface on which we received @a frame
+ * @param frame the frame
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+handle_frame (uint16_t interface,
+              const void *frame,
+              size_t frame_size)
+{
+  /* fill me in! */
+}
+
+
+/**
+ * Handle control message @a cmd.
+ *
+ * @param cmd text the user entered
+ * @param cmd_len length of @a cmd
+ */
+static void
+handle_control (char *cmd,
+                size_t cmd_len)
+{
+  cmd[cmd_len - 1] = '\0';
+  print ("Received command `%s'\n",
+         cmd);
+}
+
+
+/**
+ * Handle MAC information @a mac
+ *
+ * @param ifc_num number of the interface with @a mac
+ * @param mac the MAC address at @a ifc_num
+ */
+static void
+handle_mac (uint16_t ifc_num,
+            const struct MacAddress *mac)
+{
+  /* Fill me in! */
+}
+
+
+int
+main (int argc,
+      char **argv)
+{
+  loop (&handle_frame,
+        &handle_control,
+        &handle_mac);
+  return 0;
+}
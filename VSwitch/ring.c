@@ -0,0 +1,493 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file ring.c
+ * @brief Shared-memory rings between network-driver and the child
+ * @author Christian Grothoff
+ *
+ * The region holds one ring per direction.  Each ring has a
+ * descriptor array and a byte ring for the frame data; a message
+ * never wraps around the end of the data ring (the producer skips
+ * to the start instead).  Each side has an eventfd as doorbell,
+ * which is only rung if the other side announced that it sleeps.
+ */
+#include "glab.h"
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <stdatomic.h>
+
+
+/**
+ * Alignment of messages in the data ring.
+ */
+#define RING_ALIGN 8
+
+
+/**
+ * Round @a size up to a multiple of #RING_ALIGN.
+ *
+ * @param size number of bytes
+ * @return space taken in the data ring
+ */
+static uint32_t
+ring_align (uint32_t size)
+{
+  return (size + RING_ALIGN - 1) & ~(uint32_t) (RING_ALIGN - 1);
+}
+
+
+/**
+ * Ring the doorbell @a fd.
+ *
+ * @param fd eventfd of the other side
+ */
+static void
+ring_kick (int fd)
+{
+  uint64_t one = 1;
+
+  /* EAGAIN means the counter is saturated, the doorbell rings anyway */
+  (void) ! write (fd,
+                  &one,
+                  sizeof (one));
+}
+
+
+/**
+ * Initialize @a shm's rings from its region.
+ *
+ * @param shm transport with @e region set
+ * @param rx ring to consume from
+ * @param tx ring to produce into
+ * @param peer_fd doorbell of the other side
+ */
+static void
+shm_setup (struct GLAB_Shm *shm,
+           struct GLAB_RingShared *rx,
+           struct GLAB_RingShared *tx,
+           int peer_fd)
+{
+  memset (&shm->rx,
+          0,
+          sizeof (shm->rx));
+  memset (&shm->tx,
+          0,
+          sizeof (shm->tx));
+  shm->rx.shared = rx;
+  shm->rx.peer_fd = peer_fd;
+  shm->tx.shared = tx;
+  shm->tx.peer_fd = peer_fd;
+}
+
+
+/**
+ * Create the shared-memory region and doorbells (driver side).
+ *
+ * @param shm[out] set to the driver's view of the transport
+ * @return 0 on success, -1 on error
+ */
+int
+shm_create (struct GLAB_Shm *shm)
+{
+  int child_fd;
+
+  shm->memfd = memfd_create ("glab",
+                             0);
+  if (-1 == shm->memfd)
+    return -1;
+  if (0 != ftruncate (shm->memfd,
+                      sizeof (struct GLAB_ShmRegion)))
+  {
+    close (shm->memfd);
+    return -1;
+  }
+  shm->region = mmap (NULL,
+                      sizeof (struct GLAB_ShmRegion),
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      shm->memfd,
+                      0);
+  if (MAP_FAILED == shm->region)
+  {
+    close (shm->memfd);
+    return -1;
+  }
+  shm->wait_fd = eventfd (0,
+                          EFD_NONBLOCK);
+  child_fd = eventfd (0,
+                      EFD_NONBLOCK);
+  if ( (-1 == shm->wait_fd) ||
+       (-1 == child_fd) )
+  {
+    if (-1 != shm->wait_fd)
+      close (shm->wait_fd);
+    if (-1 != child_fd)
+      close (child_fd);
+    munmap (shm->region,
+            sizeof (struct GLAB_ShmRegion));
+    close (shm->memfd);
+    return -1;
+  }
+  /* ftruncate() zeroed the rings */
+  shm->region->magic = GLAB_SHM_MAGIC;
+  shm->region->size = sizeof (struct GLAB_ShmRegion);
+  shm_setup (shm,
+             &shm->region->to_driver,
+             &shm->region->to_child,
+             child_fd);
+  return 0;
+}
+
+
+/**
+ * Offer @a shm to a child about to be exec'ed by setting
+ * #GLAB_SHM_ENV.
+ *
+ * @param shm transport from shm_create()
+ * @return 0 on success, -1 on error
+ */
+int
+shm_offer (const struct GLAB_Shm *shm)
+{
+  char spec[64];
+
+  snprintf (spec,
+            sizeof (spec),
+            "%d,%d,%d",
+            shm->memfd,
+            shm->wait_fd,
+            shm->tx.peer_fd);
+  return setenv (GLAB_SHM_ENV,
+                 spec,
+                 1);
+}
+
+
+/**
+ * Attach to the region offered in #GLAB_SHM_ENV (child side).
+ *
+ * @param shm[out] set to the child's view of the transport
+ * @return 0 on success, -1 if no (usable) region was offered
+ */
+int
+shm_attach (struct GLAB_Shm *shm)
+{
+  const char *spec;
+  int driver_fd;
+  struct stat st;
+
+  spec = getenv (GLAB_SHM_ENV);
+  if (NULL == spec)
+    return -1;
+  if (3 != sscanf (spec,
+                   "%d,%d,%d",
+                   &shm->memfd,
+                   &driver_fd,
+                   &shm->wait_fd))
+    return -1;
+  /* do not pass the offer on to our own children */
+  unsetenv (GLAB_SHM_ENV);
+  if ( (0 != fstat (shm->memfd,
+                    &st)) ||
+       (st.st_size != sizeof (struct GLAB_ShmRegion)) )
+    return -1;
+  shm->region = mmap (NULL,
+                      sizeof (struct GLAB_ShmRegion),
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      shm->memfd,
+                      0);
+  if (MAP_FAILED == shm->region)
+    return -1;
+  if ( (GLAB_SHM_MAGIC != shm->region->magic) ||
+       (sizeof (struct GLAB_ShmRegion) != shm->region->size) )
+  {
+    munmap (shm->region,
+            sizeof (struct GLAB_ShmRegion));
+    return -1;
+  }
+  shm_setup (shm,
+             &shm->region->to_child,
+             &shm->region->to_driver,
+             driver_fd);
+  return 0;
+}
+
+
+/**
+ * Set up the other side's view of @a shm in this process, for
+ * rings between threads.  Only @a shm must be destroyed.
+ *
+ * @param shm transport from shm_create()
+ * @param peer[out] set to the other side's view of @a shm
+ */
+void
+shm_peer (const struct GLAB_Shm *shm,
+          struct GLAB_Shm *peer)
+{
+  peer->region = shm->region;
+  peer->memfd = shm->memfd;
+  peer->wait_fd = shm->tx.peer_fd;
+  shm_setup (peer,
+             &shm->region->to_child,
+             &shm->region->to_driver,
+             shm->wait_fd);
+}
+
+
+/**
+ * Unmap @a shm and close its file descriptors.
+ *
+ * @param shm transport to release
+ */
+void
+shm_destroy (struct GLAB_Shm *shm)
+{
+  munmap (shm->region,
+          sizeof (struct GLAB_ShmRegion));
+  close (shm->memfd);
+  close (shm->wait_fd);
+  close (shm->tx.peer_fd);
+}
+
+
+/**
+ * Clear our doorbell after waking up from it.
+ *
+ * @param shm transport whose doorbell rang
+ */
+void
+shm_drain (struct GLAB_Shm *shm)
+{
+  uint64_t count;
+
+  (void) ! read (shm->wait_fd,
+                 &count,
+                 sizeof (count));
+}
+
+
+/**
+ * Check if @a r has room for a message of @a size bytes, based on
+ * the last known position of the consumer.
+ *
+ * @param r ring to produce into
+ * @param size number of bytes needed
+ * @param pad[out] set to the number of bytes to skip to avoid wrapping
+ * @return true if the message fits
+ */
+static bool
+ring_fits (const struct GLAB_Ring *r,
+           uint32_t size,
+           uint32_t *pad)
+{
+  uint32_t idx = r->data_pos & (GLAB_RING_DATA_SIZE - 1);
+
+  *pad = (idx + size > GLAB_RING_DATA_SIZE) ? GLAB_RING_DATA_SIZE - idx : 0;
+  return (r->pos - r->peer_pos < GLAB_RING_SLOTS) &&
+         (r->data_pos + *pad + ring_align (size) - r->peer_data_pos
+          <= GLAB_RING_DATA_SIZE);
+}
+
+
+/**
+ * Reserve room for a message of @a size bytes in @a r.
+ *
+ * @param r ring to produce into
+ * @param size number of bytes needed
+ * @return where to put the message, NULL if @a r is full
+ */
+void *
+ring_reserve (struct GLAB_Ring *r,
+              uint32_t size)
+{
+  uint32_t pad;
+
+  if (size > GLAB_RING_DATA_SIZE / 2)
+    return NULL;
+  if (! ring_fits (r,
+                   size,
+                   &pad))
+  {
+    /* only now look at the consumer's cache line */
+    r->peer_pos = atomic_load_explicit (&r->shared->tail,
+                                        memory_order_acquire);
+    r->peer_data_pos = atomic_load_explicit (&r->shared->data_tail,
+                                             memory_order_acquire);
+    if (! ring_fits (r,
+                     size,
+                     &pad))
+      return NULL;
+  }
+  r->data_pos += pad;
+  return &r->shared->data[r->data_pos & (GLAB_RING_DATA_SIZE - 1)];
+}
+
+
+/**
+ * Add the message written to the last ring_reserve() to @a r.
+ * It is visible to the consumer after ring_publish().
+ *
+ * @param r ring to produce into
+ * @param type message type
+ * @param size actual number of bytes, at most what was reserved
+ */
+void
+ring_commit (struct GLAB_Ring *r,
+             uint16_t type,
+             uint32_t size)
+{
+  struct GLAB_RingDescriptor *d;
+
+  d = &r->shared->desc[r->pos & (GLAB_RING_SLOTS - 1)];
+  d->offset = r->data_pos;
+  d->size = size;
+  d->type = type;
+  d->reserved = 0;
+  r->data_pos += ring_align (size);
+  r->pos++;
+}
+
+
+/**
+ * Make all committed messages visible to the consumer, and ring its
+ * doorbell if it is waiting.
+ *
+ * @param r ring to produce into
+ */
+void
+ring_publish (struct GLAB_Ring *r)
+{
+  if (atomic_load_explicit (&r->shared->head,
+                            memory_order_relaxed) == r->pos)
+    return;
+  /* seq_cst store: must not be reordered with the load of the flag */
+  atomic_store (&r->shared->head,
+                r->pos);
+  if ( (0 != atomic_load (&r->shared->consumer_waiting)) &&
+       (0 != atomic_exchange (&r->shared->consumer_waiting,
+                              0)) )
+    ring_kick (r->peer_fd);
+}
+
+
+/**
+ * Take the next message from @a r.  Its data remains valid until
+ * ring_release().
+ *
+ * @param r ring to consume from
+ * @param type[out] message type
+ * @param size[out] number of bytes at @a data
+ * @return the message, NULL if @a r is empty
+ */
+void *
+ring_pop (struct GLAB_Ring *r,
+          uint16_t *type,
+          uint32_t *size)
+{
+  const struct GLAB_RingDescriptor *d;
+
+  if (r->pos == r->peer_pos)
+  {
+    r->peer_pos = atomic_load_explicit (&r->shared->head,
+                                        memory_order_acquire);
+    if (r->pos == r->peer_pos)
+      return NULL;
+  }
+  d = &r->shared->desc[r->pos & (GLAB_RING_SLOTS - 1)];
+  *type = d->type;
+  *size = d->size;
+  r->data_pos = d->offset + ring_align (d->size);
+  r->pos++;
+  return &r->shared->data[d->offset & (GLAB_RING_DATA_SIZE - 1)];
+}
+
+
+/**
+ * Return the space of all messages taken so far to the producer,
+ * and ring its doorbell if it is waiting.
+ *
+ * @param r ring to consume from
+ */
+void
+ring_release (struct GLAB_Ring *r)
+{
+  if (atomic_load_explicit (&r->shared->tail,
+                            memory_order_relaxed) == r->pos)
+    return;
+  atomic_store_explicit (&r->shared->data_tail,
+                         r->data_pos,
+                         memory_order_release);
+  atomic_store (&r->shared->tail,
+                r->pos);
+  if ( (0 != atomic_load (&r->shared->producer_waiting)) &&
+       (0 != atomic_exchange (&r->shared->producer_waiting,
+                              0)) )
+    ring_kick (r->peer_fd);
+}
+
+
+/**
+ * Announce that the consumer of @a r is about to sleep.
+ *
+ * @param r ring to consume from
+ * @return true if @a r is empty and the caller should wait for its
+ *         doorbell, false if messages arrived in the meantime
+ */
+bool
+ring_consumer_sleep (struct GLAB_Ring *r)
+{
+  atomic_store (&r->shared->consumer_waiting,
+                1);
+  r->peer_pos = atomic_load (&r->shared->head);
+  if (r->pos == r->peer_pos)
+    return true;
+  atomic_store (&r->shared->consumer_waiting,
+                0);
+  return false;
+}
+
+
+/**
+ * Announce that the producer of @a r is about to sleep until
+ * @a size bytes are available.
+ *
+ * @param r ring to produce into
+ * @param size number of bytes needed
+ * @return true if @a r is still full and the caller should wait for
+ *         its doorbell, false if space became available
+ */
+bool
+ring_producer_sleep (struct GLAB_Ring *r,
+                     uint32_t size)
+{
+  uint32_t pad;
+
+  atomic_store (&r->shared->producer_waiting,
+                1);
+  r->peer_pos = atomic_load (&r->shared->tail);
+  r->peer_data_pos = atomic_load (&r->shared->data_tail);
+  if (! ring_fits (r,
+                   size,
+                   &pad))
+    return true;
+  atomic_store (&r->shared->producer_waiting,
+                0);
+  return false;
+}
@@ -1,961 +1,3048 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file router.c
- * @brief IPv4 router
- * @author Christian Grothoff
- */
-#include "glab.h"
-
-
-/* see http://www.iana.org/assignments/ethernet-numbers */
-#ifndef ETH_P_IPV4
-/**
- * Number for IPv4
- */
-#define ETH_P_IPV4 0x0800
-#endif
-
-#ifndef ETH_P_ARP
-/**
- * Number for ARP
- */
-#define ETH_P_ARP 0x0806
-#endif
-
-
-/**
- * gcc 4.x-ism to pack structures (to be used before structs);
- * Using this still causes structs to be unaligned on the stack on Sparc
- * (See #670578 from Debian).
- */
-_Pragma("pack(push)") _Pragma("pack(1)")
-
-struct EthernetHeader
-{
-  struct MacAddress dst;
-  struct MacAddress src;
-
-  /**
-   * See ETH_P-values.
-   */
-  uint16_t tag;
-};
-
-
-/**
- * ARP header for Ethernet-IPv4.
- */
-struct ArpHeaderEthernetIPv4
-{
-  /**
-   * Must be #ARP_HTYPE_ETHERNET.
-   */
-  uint16_t htype;
-
-  /**
-   * Protocol type, must be #ARP_PTYPE_IPV4
-   */
-  uint16_t ptype;
-
-  /**
-   * HLEN.  Must be #MAC_ADDR_SIZE.
-   */
-  uint8_t hlen;
-
-  /**
-   * PLEN.  Must be sizeof (struct in_addr) (aka 4).
-   */
-  uint8_t plen;
-
-  /**
-   * Type of the operation.
-   */
-  uint16_t oper;
-
-  /**
-   * HW address of sender. We only support Ethernet.
-   */
-  struct MacAddress sender_ha;
-
-  /**
-   * Layer3-address of sender. We only support IPv4.
-   */
-  struct in_addr sender_pa;
-
-  /**
-   * HW address of target. We only support Ethernet.
-   */
-  struct MacAddress target_ha;
-
-  /**
-   * Layer3-address of target. We only support IPv4.
-   */
-  struct in_addr target_pa;
-};
-
-
-/* some systems use one underscore only, and mingw uses no underscore... */
-#ifndef __BYTE_ORDER
-#ifdef _BYTE_ORDER
-#define __BYTE_ORDER _BYTE_ORDER
-#else
-#ifdef BYTE_ORDER
-#define __BYTE_ORDER BYTE_ORDER
-#endif
-#endif
-#endif
-#ifndef __BIG_ENDIAN
-#ifdef _BIG_ENDIAN
-#define __BIG_ENDIAN _BIG_ENDIAN
-#else
-#ifdef BIG_ENDIAN
-#define __BIG_ENDIAN BIG_ENDIAN
-#endif
-#endif
-#endif
-#ifndef __LITTLE_ENDIAN
-#ifdef _LITTLE_ENDIAN
-#define __LITTLE_ENDIAN _LITTLE_ENDIAN
-#else
-#ifdef LITTLE_ENDIAN
-#define __LITTLE_ENDIAN LITTLE_ENDIAN
-#endif
-#endif
-#endif
-
-
-#define IP_FLAGS_RESERVED 1
-#define IP_FLAGS_DO_NOT_FRAGMENT 2
-#define IP_FLAGS_MORE_FRAGMENTS 4
-#define IP_FLAGS 7
-
-#define IP_FRAGMENT_MULTIPLE 8
-
-/**
- * Standard IPv4 header.
- */
-struct IPv4Header
-{
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-  unsigned int header_length : 4;
-  unsigned int version : 4;
-#elif __BYTE_ORDER == __BIG_ENDIAN
-  unsigned int version : 4;
-  unsigned int header_length : 4;
-#else
-  #error byteorder undefined
-#endif
-  uint8_t diff_serv;
-
-  /**
-   * Length of the packet, including this header.
-   */
-  uint16_t total_length;
-
-  /**
-   * Unique random ID for matching up fragments.
-   */
-  uint16_t identification;
-
-  /**
-   * Fragmentation flags and fragmentation offset.
-   */
-  uint16_t fragmentation_info;
-
-  /**
-   * How many more hops can this packet be forwarded?
-   */
-  uint8_t ttl;
-
-  /**
-   * L4-protocol, for example, IPPROTO_UDP or IPPROTO_TCP.
-   */
-  uint8_t protocol;
-
-  /**
-   * Checksum.
-   */
-  uint16_t checksum;
-
-  /**
-   * Origin of the packet.
-   */
-  struct in_addr source_address;
-
-  /**
-   * Destination of the packet.
-   */
-  struct in_addr destination_address;
-};
-
-
-#define ICMPTYPE_DESTINATION_UNREACHABLE 3
-#define ICMPTYPE_TIME_EXCEEDED 11
-
-#define ICMPCODE_NETWORK_UNREACHABLE 0
-#define ICMPCODE_HOST_UNREACHABLE 1
-#define ICMPCODE_FRAGMENTATION_REQUIRED 4
-
-/**
- * ICMP header.
- */
-struct IcmpHeader
-{
-  uint8_t type;
-  uint8_t code;
-  uint16_t crc;
-
-  union
-  {
-    /**
-     * Payload for #ICMPTYPE_DESTINATION_UNREACHABLE (RFC 1191)
-     */
-    struct ih_pmtu
-    {
-      uint16_t empty;
-      uint16_t next_hop_mtu;
-    } destination_unreachable;
-
-    /**
-     * Unused bytes for #ICMPTYPE_TIME_EXCEEDED.
-     */
-    uint32_t time_exceeded_unused;
-
-  } quench;
-
-  /* followed by original IP header + first 8 bytes of original IP datagram
-     (at least for the two ICMP message types we care about here) */
-
-};
-_Pragma("pack(pop)")
-
-
-/**
- * Per-interface context.
- */
-struct Interface
-{
-  /**
-   * MAC of interface.
-   */
-  struct MacAddress mac;
-
-  /**
-   * IPv4 address of interface (we only support one IP per interface!)
-   */
-  struct in_addr ip;
-
-  /**
-   * IPv4 netmask of interface.
-   */
-  struct in_addr netmask;
-
-  /**
-   * Name of the interface.
-   */
-  char *name;
-
-  /**
-   * Number of this interface.
-   */
-  uint16_t ifc_num;
-
-  /**
-   * MTU to enforce for this interface.
-   */
-  uint16_t mtu;
-};
-
-
-/**
- * Number of available contexts.
- */
-static unsigned int num_ifc;
-
-/**
- * All the contexts.
- */
-static struct Interface *gifc;
-
-
-/**
- * Forward @a frame to interface @a dst.
- *
- * @param dst target interface to send the frame out on
- * @param frame the frame to forward
- * @param frame_size number of bytes in @a frame
- */
-static void
-forward_to (struct Interface *dst,
-            const void *frame,
-            size_t frame_size)
-{
-  char iob[frame_size + sizeof (struct GLAB_MessageHeader)];
-  struct GLAB_MessageHeader hdr;
-
-  if (frame_size > dst->mtu)
-    abort ();
-  hdr.size = htons (sizeof (iob));
-  hdr.type = htons (dst->ifc_num);
-  memcpy (iob,
-          &hdr,
-          sizeof (hdr));
-  memcpy (&iob[sizeof (hdr)],
-          frame,
-          frame_size);
-  write_all (STDOUT_FILENO,
-             iob,
-             sizeof (iob));
-}
-
-
-/**
- * Create Ethernet frame and forward it via @a ifc to @a target_ha.
- *
- * @param ifc interface to send frame out on
- * @param target destination MAC
- * @param tag Ethernet tag to use
- * @param frame_payload payload to use in frame
- * @param frame_payload_size number of bytes in @a frame_payload
- */
-static void
-forward_frame_payload_to (struct Interface *ifc,
-                          const struct MacAddress *target_ha,
-                          uint16_t tag,
-                          const void *frame_payload,
-                          size_t frame_payload_size)
-{
-  char frame[sizeof (struct EthernetHeader) + frame_payload_size];
-  struct EthernetHeader eh;
-
-  if (frame_payload_size + sizeof (struct EthernetHeader) > ifc->mtu)
-    abort ();
-  eh.dst = *target_ha;
-  eh.src = ifc->mac;
-  eh.tag = ntohs (tag);
-  memcpy (frame,
-          &eh,
-          sizeof (eh));
-  memcpy (&frame[sizeof (eh)],
-          frame_payload,
-          frame_payload_size);
-  forward_to (ifc,
-              frame,
-              sizeof (frame));
-}
-
-
-/**
- * Route the @a ip packet with its @a payload.
- *
- * @param origin interface we received the packet from
- * @param ip IP header
- * @param payload IP packet payload
- * @param payload_size number of bytes in @a payload
- */
-static void
-route (struct Interface *origin,
-       const struct IPv4Header *ip,
-       const void *payload,
-       size_t payload_size)
-{
-  /* TODO: do work here */
-}
-
-
-/**
- * Process ARP (request or response!)
- *
- * @param ifc interface we received the ARP request from
- * @param eh ethernet header
- * @param ah ARP header
- */
-static void
-handle_arp (struct Interface *ifc,
-            const struct EthernetHeader *eh,
-            const struct ArpHeaderEthernetIPv4 *ah)
-{
-  /* TODO: do work here */
-}
-
-
-/**
- * Parse and process frame received on @a ifc.
- *
- * @param ifc interface we got the frame on
- * @param frame raw frame data
- * @param frame_size number of bytes in @a frame
- */
-static void
-parse_frame (struct Interface *ifc,
-             const void *frame,
-             size_t frame_size)
-{
-  struct EthernetHeader eh;
-  const char *cframe = frame;
-
-  if (frame_size < sizeof (eh))
-  {
-    fprintf (stderr,
-             "Malformed frame\n");
-    return;
-  }
-  memcpy (&eh,
-          frame,
-          sizeof (eh));
-  switch (ntohs (eh.tag))
-  {
-  case ETH_P_IPV4:
-    {
-      struct IPv4Header ip;
-
-      if (frame_size < sizeof (struct EthernetHeader) + sizeof (struct
-                                                                IPv4Header))
-      {
-        fprintf (stderr,
-                 "Malformed frame\n");
-        return;
-      }
-      memcpy (&ip,
-              &cframe[sizeof (struct EthernetHeader)],
-              sizeof (struct IPv4Header));
-      /* TODO: possibly do work here (ARP learning) */
-      route (ifc,
-             &ip,
-             &cframe[sizeof (struct EthernetHeader) + sizeof (struct
-                                                              IPv4Header)],
-             frame_size - sizeof (struct EthernetHeader) - sizeof (struct
-                                                                   IPv4Header));
-      break;
-    }
-  case ETH_P_ARP:
-    {
-      struct ArpHeaderEthernetIPv4 ah;
-
-      if (frame_size < sizeof (struct EthernetHeader) + sizeof (struct
-                                                                ArpHeaderEthernetIPv4))
-      {
-#if DEBUG
-        fprintf (stderr,
-                 "Unsupported ARP frame\n");
-#endif
-        return;
-      }
-      memcpy (&ah,
-              &cframe[sizeof (struct EthernetHeader)],
-              sizeof (struct ArpHeaderEthernetIPv4));
-      handle_arp (ifc,
-                  &eh,
-                  &ah);
-      break;
-    }
-  default:
-#if DEBUG
-    fprintf (stderr,
-             "Unsupported Ethernet tag %04X\n",
-             ntohs (eh.tag));
-#endif
-    return;
-  }
-}
-
-
-/**
- * Process frame received from @a interface.
- *
- * @param interface number of the interface on which we received @a frame
- * @param frame the frame
- * @param frame_size number of bytes in @a frame
- */
-static void
-handle_frame (uint16_t interface,
-              const void *frame,
-              size_t frame_size)
-{
-  if (interface > num_ifc)
-    abort ();
-  parse_frame (&gifc[interface - 1],
-               frame,
-               frame_size);
-}
-
-
-/**
- * Find network interface by @a name.
- *
- * @param name name to look up by
- * @return NULL if @a name was not found
- */
-static struct Interface *
-find_interface (const char *name)
-{
-  for (unsigned int i = 0; i<num_ifc; i++)
-    if (0 == strcasecmp (name,
-                         gifc[i].name))
-      return &gifc[i];
-  return NULL;
-}
-
-
-/**
- * The user entered an "arp" command.  The remaining
- * arguments can be obtained via 'strtok()'.
- */
-static void
-process_cmd_arp ()
-{
-  const char *tok = strtok (NULL, " ");
-  struct in_addr v4;
-  struct MacAddress mac;
-  struct Interface *ifc;
-
-  if (NULL == tok)
-  {
-    // print_arp_cache ();
-    return;
-  }
-  if (1 !=
-      inet_pton (AF_INET,
-                 tok,
-                 &v4))
-  {
-    fprintf (stderr,
-             "`%s' is not a valid IPv4 address\n",
-             tok);
-    return;
-  }
-  tok = strtok (NULL, " ");
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "No network interface provided\n");
-    return;
-  }
-  ifc = find_interface (tok);
-  if (NULL == ifc)
-  {
-    fprintf (stderr,
-             "Interface `%s' unknown\n",
-             tok);
-    return;
-  }
-  /* TODO: do MAC lookup */
-}
-
-
-/**
- * Parse network specification in @a net, initializing @a network and @a netmask.
- * Format of @a net is "IP/NETMASK".
- *
- * @param network[out] network specification to initialize
- * @param netmask[out] netmask specification to initialize
- * @param arg interface specification to parse
- * @return 0 on success
- */
-static int
-parse_network (struct in_addr *network,
-               struct in_addr *netmask,
-               const char *net)
-{
-  const char *tok;
-  char *ip;
-  unsigned int mask;
-
-  tok = strchr (net, '/');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in network specification: lacks '/'\n");
-    return 1;
-  }
-  ip = strndup (net,
-                tok - net);
-  if (1 !=
-      inet_pton (AF_INET,
-                 ip,
-                 network))
-  {
-    fprintf (stderr,
-             "IP address `%s' malformed\n",
-             ip);
-    free (ip);
-    return 1;
-  }
-  free (ip);
-  tok++;
-  if (1 !=
-      sscanf (tok,
-              "%u",
-              &mask))
-  {
-    fprintf (stderr,
-             "Netmask `%s' malformed\n",
-             tok);
-    return 1;
-  }
-  if (mask > 32)
-  {
-    fprintf (stderr,
-             "Netmask invalid (too large)\n");
-    return 1;
-  }
-  netmask->s_addr = htonl (~(uint32_t) ((1LLU << (32 - mask)) - 1LLU));
-  return 0;
-}
-
-
-/**
- * Parse route from arguments in strtok() buffer.
- *
- * @param target_network[out] set to target network
- * @param target_netmask[out] set to target netmask
- * @param next_hop[out] set to next hop
- * @param ifc[out] set to target interface
- */
-static int
-parse_route (struct in_addr *target_network,
-             struct in_addr *target_netmask,
-             struct in_addr *next_hop,
-             struct Interface **ifc)
-{
-  char *tok;
-
-  tok = strtok (NULL, " ");
-  if ( (NULL == tok) ||
-       (0 != parse_network (target_network,
-                            target_netmask,
-                            tok)) )
-  {
-    fprintf (stderr,
-             "Expected network specification, not `%s'\n",
-             tok);
-    return 1;
-  }
-  tok = strtok (NULL, " ");
-  if ( (NULL == tok) ||
-       (0 != strcasecmp ("via",
-                         tok)))
-  {
-    fprintf (stderr,
-             "Expected `via', not `%s'\n",
-             tok);
-    return 1;
-  }
-  tok = strtok (NULL, " ");
-  if ( (NULL == tok) ||
-       (1 != inet_pton (AF_INET,
-                        tok,
-                        next_hop)) )
-  {
-    fprintf (stderr,
-             "Expected next hop, not `%s'\n",
-             tok);
-    return 1;
-  }
-  tok = strtok (NULL, " ");
-  if ( (NULL == tok) ||
-       (0 != strcasecmp ("dev",
-                         tok)))
-  {
-    fprintf (stderr,
-             "Expected `dev', not `%s'\n",
-             tok);
-    return 1;
-  }
-  tok = strtok (NULL, " ");
-  *ifc = find_interface (tok);
-  if (NULL == *ifc)
-  {
-    fprintf (stderr,
-             "Interface `%s' unknown\n",
-             tok);
-    return 1;
-  }
-  return 0;
-}
-
-
-/**
- * Add a route.
- */
-static void
-process_cmd_route_add ()
-{
-  struct in_addr target_network;
-  struct in_addr target_netmask;
-  struct in_addr next_hop;
-  struct Interface *ifc;
-
-  if (0 != parse_route (&target_network,
-                        &target_netmask,
-                        &next_hop,
-                        &ifc))
-    return;
-  /* TODO: Add routing table entry */
-}
-
-
-/**
- * Delete a route.
- */
-static void
-process_cmd_route_del ()
-{
-  struct in_addr target_network;
-  struct in_addr target_netmask;
-  struct in_addr next_hop;
-  struct Interface *ifc;
-
-  if (0 != parse_route (&target_network,
-                        &target_netmask,
-                        &next_hop,
-                        &ifc))
-    return;
-  /* TODO: Delete routing table entry */
-}
-
-
-/**
- * Print out the routing table.
- */
-static void
-process_cmd_route_list ()
-{
-  /* TODO: show routing table with 'print' */
-}
-
-
-/**
- * The user entered a "route" command.  The remaining
- * arguments can be obtained via 'strtok()'.
- */
-static void
-process_cmd_route ()
-{
-  char *subcommand = strtok (NULL, " ");
-
-  if (NULL == subcommand)
-    subcommand = "list";
-  if (0 == strcasecmp ("add",
-                       subcommand))
-    process_cmd_route_add ();
-  else if (0 == strcasecmp ("del",
-                            subcommand))
-    process_cmd_route_del ();
-  else if (0 == strcasecmp ("list",
-                            subcommand))
-    process_cmd_route_list ();
-  else
-    fprintf (stderr,
-             "Subcommand `%s' not understood\n",
-             subcommand);
-}
-
-
-/**
- * Parse network specification in @a net, initializing @a ifc.
- * Format of @a net is "IPV4:IP/NETMASK".
- *
- * @param ifc[out] interface specification to initialize
- * @param arg interface specification to parse
- * @return 0 on success
- */
-static int
-parse_network_arg (struct Interface *ifc,
-                   const char *net)
-{
-  if (0 !=
-      strncasecmp (net,
-                   "IPV4:",
-                   strlen ("IPV4:")))
-  {
-    fprintf (stderr,
-             "Interface specification `%s' does not start with `IPV4:'\n",
-             net);
-    return 1;
-  }
-  net += strlen ("IPV4:");
-  return parse_network (&ifc->ip,
-                        &ifc->netmask,
-                        net);
-}
-
-
-/**
- * Parse interface specification @a arg and update @a ifc.  Format is
- * "IFCNAME[IPV4:IP/NETMASK]=MTU".  The "=MTU" is optional.
- *
- * @param ifc[out] interface specification to initialize
- * @param arg interface specification to parse
- * @return 0 on success
- */
-static int
-parse_cmd_arg (struct Interface *ifc,
-               const char *arg)
-{
-  const char *tok;
-  char *nspec;
-
-  ifc->mtu = 1500 + sizeof (struct EthernetHeader); /* default in case unspecified */
-  tok = strchr (arg, '[');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in interface specification: lacks '['");
-    return 1;
-  }
-  ifc->name = strndup (arg,
-                       tok - arg);
-  arg = tok + 1;
-  tok = strchr (arg, ']');
-  if (NULL == tok)
-  {
-    fprintf (stderr,
-             "Error in interface specification: lacks ']'");
-    return 1;
-  }
-  nspec = strndup (arg,
-                   tok - arg);
-  if (0 !=
-      parse_network_arg (ifc,
-                         nspec))
-  {
-    free (nspec);
-    return 1;
-  }
-  free (nspec);
-  arg = tok + 1;
-  if ('=' == arg[0])
-  {
-    unsigned int mtu;
-
-    if (1 != (sscanf (&arg[1],
-                      "%u",
-                      &mtu)))
-    {
-      fprintf (stderr,
-               "Error in interface specification: MTU not a number\n");
-      return 1;
-    }
-    if (mtu < 400)
-    {
-      fprintf (stderr,
-               "Error in interface specification: MTU too small\n");
-      return 1;
-    }
-    if (mtu > UINT16_MAX)
-    {
-      fprintf (stderr,
-               "Error in interface specification: MTU too large\n");
-      return 1;
-    }
-    ifc->mtu = mtu + sizeof (struct EthernetHeader);
-#if DEBUG
-    fprintf (stderr,
-             "Interface %s has MTU %u\n",
-             ifc->name,
-             (unsigned int) ifc->mtu);
-#endif
-  }
-  return 0;
-}
-
-
-/**
- * Handle control message @a cmd.
- *
- * @param cmd text the user entered
- * @param cmd_len length of @a cmd
- */
-static void
-handle_control (char *cmd,
-                size_t cmd_len)
-{
-  const char *tok;
-
-  cmd[cmd_len - 1] = '\0';
-  tok = strtok (cmd,
-                " ");
-  if (NULL == tok)
-    return;
-  if (0 == strcasecmp (tok,
-                       "arp"))
-    process_cmd_arp ();
-  else if (0 == strcasecmp (tok,
-                            "route"))
-    process_cmd_route ();
-  else
-    fprintf (stderr,
-             "Unsupported command `%s'\n",
-             tok);
-}
-
-
-/**
- * Handle MAC information @a mac
- *
- * @param ifc_num number of the interface with @a mac
- * @param mac the MAC address at @a ifc_num
- */
-static void
-handle_mac (uint16_t ifc_num,
-            const struct MacAddress *mac)
-{
-  if (ifc_num > num_ifc)
-    abort ();
-  gifc[ifc_num - 1].mac = *mac;
-}
-
-
-/**
- * Launches the router.
- *
- * @param argc number of arguments in @a argv
- * @param argv binary name, followed by list of interfaces to switch between
- * @return not really
- */
-int
-main (int argc,
-      char **argv)
-{
-  struct Interface ifc[argc];
-
-  memset (ifc,
-          0,
-          sizeof (ifc));
-  num_ifc = argc - 1;
-  gifc = ifc;
-  for (unsigned int i = 1; i<argc; i++)
-  {
-    struct Interface *p = &ifc[i - 1];
-
-    ifc[i - 1].ifc_num = i;
-    if (0 !=
-        parse_cmd_arg (p,
-                       argv[i]))
-      abort ();
-  }
-  loop (&handle_frame,
-        &handle_control,
-        &handle_mac);
-  for (unsigned int i = 1; i<argc; i++)
-    free (ifc[i - 1].name);
-  return 0;
-}
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file router.c
+ * @brief IPv4 router
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+/* see http://www.iana.org/assignments/ethernet-numbers */
+#ifndef ETH_P_IPV4
+/**
+ * Number for IPv4
+ */
+#define ETH_P_IPV4 0x0800
+#endif
+
+#ifndef ETH_P_ARP
+/**
+ * Number for ARP
+ */
+#define ETH_P_ARP 0x0806
+#endif
+
+/**
+ * Number of entries of the first table of the FIB, indexed by the
+ * upper 24 bits of the destination.
+ */
+#define FIB_TBL24_SIZE (1 << 24)
+
+/**
+ * Number of entries of a group of the second table of the FIB,
+ * indexed by the lower 8 bits of the destination.
+ */
+#define FIB_TBL8_SIZE 256
+
+/**
+ * Flag of a FIB entry: a route covers the destination.
+ */
+#define FIB_VALID 0x80000000U
+
+/**
+ * Flag of an entry of the first table: the index is that of a group
+ * in the second table.
+ */
+#define FIB_EXTENDED 0x40000000U
+
+/**
+ * Position of the prefix length of the route in a FIB entry.
+ */
+#define FIB_DEPTH_SHIFT 24
+
+/**
+ * Mask for the prefix length of the route in a FIB entry.
+ */
+#define FIB_DEPTH_MASK 0x3F000000U
+
+/**
+ * Mask for the index of the next hop (or group) in a FIB entry.
+ */
+#define FIB_INDEX_MASK 0x00FFFFFFU
+
+/**
+ * Initial number of slots of the route table (a power of two).
+ */
+#define FIB_INITIAL_ROUTES 1024
+
+/**
+ * Maximum size of an IPv4 header, with options.
+ */
+#define IP_MAX_HEADER_SIZE 60
+
+/**
+ * Magic number at the start of a binary route file.
+ */
+#define ROUTE_FILE_MAGIC "GLABFIB1"
+
+/**
+ * Number of records of a binary route file we read at once.
+ */
+#define ROUTE_FILE_CHUNK 4096
+
+/**
+ * Maximum number of bytes at the start of a packet we copy when
+ * sending it: an IPv4 header, or an ICMP error message (which quotes
+ * a header and 8 bytes).
+ */
+#define IP_MAX_HEAD_SIZE (2 * IP_MAX_HEADER_SIZE + 16)
+
+/**
+ * How often (in ms) the main thread checks for the output of route
+ * commands run by the control thread.
+ */
+#define CONTROL_POLL_MS 10
+
+/**
+ * How long (in ns) the control thread sleeps while waiting for the
+ * forwarding thread to stop using an old table.
+ */
+#define FIB_GRACE_POLL_NS 50000
+
+/**
+ * Maximum number of bytes of route command output we send to the
+ * parent in one control message.
+ */
+#define PRINT_CHUNK 60000
+
+
+/**
+ * gcc 4.x-ism to pack structures (to be used before structs);
+ * Using this still causes structs to be unaligned on the stack on Sparc
+ * (See #670578 from Debian).
+ */
+_Pragma("pack(push)") _Pragma("pack(1)")
+
+struct EthernetHeader
+{
+  struct MacAddress dst;
+  struct MacAddress src;
+
+  /**
+   * See ETH_P-values.
+   */
+  uint16_t tag;
+};
+
+
+/* some systems use one underscore only, and mingw uses no underscore... */
+#ifndef __BYTE_ORDER
+#ifdef _BYTE_ORDER
+#define __BYTE_ORDER _BYTE_ORDER
+#else
+#ifdef BYTE_ORDER
+#define __BYTE_ORDER BYTE_ORDER
+#endif
+#endif
+#endif
+#ifndef __BIG_ENDIAN
+#ifdef _BIG_ENDIAN
+#define __BIG_ENDIAN _BIG_ENDIAN
+#else
+#ifdef BIG_ENDIAN
+#define __BIG_ENDIAN BIG_ENDIAN
+#endif
+#endif
+#endif
+#ifndef __LITTLE_ENDIAN
+#ifdef _LITTLE_ENDIAN
+#define __LITTLE_ENDIAN _LITTLE_ENDIAN
+#else
+#ifdef LITTLE_ENDIAN
+#define __LITTLE_ENDIAN LITTLE_ENDIAN
+#endif
+#endif
+#endif
+
+
+#define IP_FLAGS_RESERVED 4
+#define IP_FLAGS_DO_NOT_FRAGMENT 2
+#define IP_FLAGS_MORE_FRAGMENTS 1
+#define IP_FLAGS 7
+
+#define IP_FRAGMENT_MULTIPLE 8
+
+/**
+ * Standard IPv4 header.
+ */
+struct IPv4Header
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  unsigned int header_length : 4;
+  unsigned int version : 4;
+#elif __BYTE_ORDER == __BIG_ENDIAN
+  unsigned int version : 4;
+  unsigned int header_length : 4;
+#else
+  #error byteorder undefined
+#endif
+  uint8_t diff_serv;
+
+  /**
+   * Length of the packet, including this header.
+   */
+  uint16_t total_length;
+
+  /**
+   * Unique random ID for matching up fragments.
+   */
+  uint16_t identification;
+
+  /**
+   * Fragmentation flags and fragmentation offset.
+   */
+  uint16_t fragmentation_info;
+
+  /**
+   * How many more hops can this packet be forwarded?
+   */
+  uint8_t ttl;
+
+  /**
+   * L4-protocol, for example, IPPROTO_UDP or IPPROTO_TCP.
+   */
+  uint8_t protocol;
+
+  /**
+   * Checksum.
+   */
+  uint16_t checksum;
+
+  /**
+   * Origin of the packet.
+   */
+  struct in_addr source_address;
+
+  /**
+   * Destination of the packet.
+   */
+  struct in_addr destination_address;
+};
+
+
+#define ICMPTYPE_DESTINATION_UNREACHABLE 3
+#define ICMPTYPE_TIME_EXCEEDED 11
+
+#define ICMPCODE_NETWORK_UNREACHABLE 0
+#define ICMPCODE_HOST_UNREACHABLE 1
+#define ICMPCODE_FRAGMENTATION_REQUIRED 4
+
+/**
+ * ICMP header.
+ */
+struct IcmpHeader
+{
+  uint8_t type;
+  uint8_t code;
+  uint16_t crc;
+
+  union
+  {
+    /**
+     * Payload for #ICMPTYPE_DESTINATION_UNREACHABLE (RFC 1191)
+     */
+    struct ih_pmtu
+    {
+      uint16_t empty;
+      uint16_t next_hop_mtu;
+    } destination_unreachable;
+
+    /**
+     * Unused bytes for #ICMPTYPE_TIME_EXCEEDED.
+     */
+    uint32_t time_exceeded_unused;
+
+  } quench;
+
+  /* followed by original IP header + first 8 bytes of original IP datagram
+     (at least for the two ICMP message types we care about here) */
+
+};
+
+
+/**
+ * Route in a binary route file (see load_routes()).
+ */
+struct RouteRecord
+{
+  /**
+   * Target network.
+   */
+  struct in_addr network;
+
+  /**
+   * Next hop, 0.0.0.0 for the connected network.
+   */
+  struct in_addr next_hop;
+
+  /**
+   * Number of the interface, in big-endian format.
+   */
+  uint16_t ifc_num;
+
+  /**
+   * Prefix length.
+   */
+  uint8_t len;
+};
+_Pragma("pack(pop)")
+
+
+/**
+ * Per-interface context.
+ */
+struct Interface
+{
+  /**
+   * MAC of interface.
+   */
+  struct MacAddress mac;
+
+  /**
+   * IPv4 address of interface (we only support one IP per interface!)
+   */
+  struct in_addr ip;
+
+  /**
+   * IPv4 netmask of interface.
+   */
+  struct in_addr netmask;
+
+  /**
+   * Name of the interface.
+   */
+  char *name;
+
+  /**
+   * Number of this interface.
+   */
+  uint16_t ifc_num;
+
+  /**
+   * MTU to enforce for this interface.
+   */
+  uint16_t mtu;
+};
+
+
+/**
+ * Where a route sends packets.
+ */
+struct NextHop
+{
+  /**
+   * IPv4 address of the next hop, 0.0.0.0 if the destination is
+   * in the connected network of @e ifc.
+   */
+  struct in_addr ip;
+
+  /**
+   * Interface to send packets out on.
+   */
+  struct Interface *ifc;
+};
+
+
+/**
+ * A route as configured, kept to list the routes and to find the
+ * route taking over when one is deleted.
+ */
+struct Route
+{
+  /**
+   * Target network in host byte order, host bits zero.
+   */
+  uint32_t network;
+
+  /**
+   * Index of the next hop in the FIB.
+   */
+  uint32_t next_hop;
+
+  /**
+   * Length of the prefix of @e network.
+   */
+  uint8_t len;
+
+  /**
+   * Is this slot in use?
+   */
+  uint8_t used;
+
+  /**
+   * Set for the routes to the connected networks, which cannot
+   * be changed or deleted.
+   */
+  uint8_t connected;
+};
+
+
+/**
+ * Forwarding information base: a DIR-24-8 table.  The first table
+ * has an entry for each /24, which either holds the next hop directly
+ * or refers to a group of 256 entries in the second table for the
+ * /24s with longer prefixes.  A lookup thus reads one or two entries.
+ * Each entry also records the prefix length of the route it came
+ * from, so that a route only overwrites entries of shorter prefixes.
+ */
+struct Fib
+{
+  /**
+   * First table, #FIB_TBL24_SIZE entries.
+   */
+  uint32_t *tbl24;
+
+  /**
+   * Second table, @e tbl8_size groups of #FIB_TBL8_SIZE entries.
+   */
+  uint32_t *tbl8;
+
+  /**
+   * Groups of @e tbl8 that were freed again.
+   */
+  uint32_t *tbl8_free;
+
+  /**
+   * Number of groups allocated in @e tbl8.
+   */
+  uint32_t tbl8_size;
+
+  /**
+   * Number of groups of @e tbl8 handed out so far (including freed ones).
+   */
+  uint32_t tbl8_used;
+
+  /**
+   * Number of entries in @e tbl8_free.
+   */
+  uint32_t tbl8_free_count;
+
+  /**
+   * The next hops.  Next hops are never removed, there are few
+   * of them.
+   */
+  struct NextHop *next_hops;
+
+  /**
+   * Number of entries in @e next_hops.
+   */
+  uint32_t num_next_hops;
+
+  /**
+   * Number of entries allocated in @e next_hops.
+   */
+  uint32_t next_hops_size;
+
+  /**
+   * Hash table over @e next_hops (linear probing), holding the index
+   * plus one, 0 for empty slots.  Has @e next_hops_size * 2 slots.
+   */
+  uint32_t *next_hop_map;
+
+  /**
+   * The routes, open addressing with linear probing.
+   */
+  struct Route *routes;
+
+  /**
+   * Number of slots of @e routes minus one.
+   */
+  size_t routes_mask;
+
+  /**
+   * Number of routes.
+   */
+  size_t num_routes;
+};
+
+
+/**
+ * Operations on the routes, run by the control thread.
+ */
+enum RouteOp
+{
+  ROUTE_OP_ADD,
+  ROUTE_OP_DEL,
+  ROUTE_OP_LIST,
+  ROUTE_OP_LOAD,
+  ROUTE_OP_SAVE
+};
+
+
+/**
+ * Route command handed from the main thread to the control thread.
+ */
+struct RouteCommand
+{
+  /**
+   * Next command in the queue.
+   */
+  struct RouteCommand *next;
+
+  /**
+   * What to do.
+   */
+  enum RouteOp op;
+
+  /**
+   * Target network, for #ROUTE_OP_ADD and #ROUTE_OP_DEL.
+   */
+  struct in_addr network;
+
+  /**
+   * Prefix length of @e network.
+   */
+  unsigned int len;
+
+  /**
+   * Next hop, 0.0.0.0 for a directly reachable network.
+   */
+  struct in_addr next_hop;
+
+  /**
+   * Interface of the route.
+   */
+  struct Interface *ifc;
+
+  /**
+   * File name, for #ROUTE_OP_LOAD and #ROUTE_OP_SAVE.
+   */
+  char *filename;
+
+  /**
+   * Output to print, for #ROUTE_OP_LIST.
+   */
+  char *output;
+
+  /**
+   * Number of bytes in @e output.
+   */
+  size_t output_size;
+};
+
+
+/**
+ * Number of available contexts.
+ */
+static unsigned int num_ifc;
+
+/**
+ * All the contexts.
+ */
+static struct Interface *gifc;
+
+/**
+ * Our routes, as used for forwarding.  Only the control thread
+ * replaces the table (see fib_publish()); the forwarding thread
+ * reads it between fib_read_lock() and fib_read_unlock().
+ */
+static _Atomic (struct Fib *) fib;
+
+/**
+ * Copy of the routes the control thread applies changes to before
+ * publishing them.  Only used by the control thread.
+ */
+static struct Fib *shadow;
+
+/**
+ * Incremented by the control thread for each table it publishes.
+ */
+static atomic_uint_fast64_t fib_epoch = 1;
+
+/**
+ * Value of #fib_epoch when the forwarding thread started to use the
+ * table, 0 while it does not use any.
+ */
+static atomic_uint_fast64_t reader_epoch;
+
+/**
+ * State shared between the main thread and the control thread.
+ */
+static struct
+{
+  /**
+   * Protects the other fields.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when commands are queued or @e quit is set.
+   */
+  pthread_cond_t cond;
+
+  /**
+   * Commands waiting to be run by the control thread.
+   */
+  struct RouteCommand *head;
+
+  /**
+   * Where to append the next command.
+   */
+  struct RouteCommand **tail;
+
+  /**
+   * Commands with output for the main thread to print.
+   */
+  struct RouteCommand *done_head;
+
+  /**
+   * Where to append the next command with output.
+   */
+  struct RouteCommand **done_tail;
+
+  /**
+   * Number of commands with output not yet in the done list.
+   */
+  unsigned int pending_output;
+
+  /**
+   * Set to make the control thread exit once the queue is empty.
+   */
+  bool quit;
+
+  /**
+   * The control thread.
+   */
+  pthread_t thread;
+
+  /**
+   * Timer of the main thread to check for output.
+   */
+  struct Timer poll;
+
+} ctl = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .tail = &ctl.head,
+  .done_tail = &ctl.done_head
+};
+
+
+/**
+ * Compute the netmask for a prefix of length @a len.
+ *
+ * @param len prefix length, at most 32
+ * @return netmask in host byte order
+ */
+static uint32_t
+prefix_mask (unsigned int len)
+{
+  return (0 == len) ? 0 : (~(uint32_t) 0) << (32 - len);
+}
+
+
+/**
+ * Find the next hop for @a dst.
+ *
+ * @param f table to search
+ * @param dst destination address
+ * @return NULL if we have no route to @a dst
+ */
+static const struct NextHop *
+fib_lookup (const struct Fib *f,
+            struct in_addr dst)
+{
+  uint32_t addr = ntohl (dst.s_addr);
+  uint32_t e = f->tbl24[addr >> 8];
+
+  if (0 != (e & FIB_EXTENDED))
+    e = f->tbl8[(e & FIB_INDEX_MASK) * FIB_TBL8_SIZE + (addr & 0xFF)];
+  if (0 == (e & FIB_VALID))
+    return NULL;
+  return &f->next_hops[e & FIB_INDEX_MASK];
+}
+
+
+/**
+ * Hash a next hop.
+ *
+ * @param ip address of the next hop
+ * @param ifc interface of the next hop
+ * @param mask number of slots minus one
+ * @return slot to start probing at
+ */
+static uint32_t
+next_hop_slot (struct in_addr ip,
+               const struct Interface *ifc,
+               uint32_t mask)
+{
+  uint64_t key = ((uint64_t) ifc->ifc_num << 32) | ip.s_addr;
+
+  return (uint32_t) ((key * 0x9E3779B97F4A7C15LLU) >> 32) & mask;
+}
+
+
+/**
+ * Get the index of the next hop @a ip via @a ifc, adding it if needed.
+ *
+ * @param f table to use
+ * @param ip address of the next hop, 0.0.0.0 for the connected network
+ * @param ifc interface of the next hop
+ * @return index of the next hop
+ */
+static uint32_t
+fib_next_hop (struct Fib *f,
+              struct in_addr ip,
+              struct Interface *ifc)
+{
+  uint32_t mask = f->next_hops_size * 2 - 1;
+  uint32_t slot;
+
+  for (slot = next_hop_slot (ip,
+                             ifc,
+                             mask);
+       0 != f->next_hop_map[slot];
+       slot = (slot + 1) & mask)
+  {
+    const struct NextHop *nh = &f->next_hops[f->next_hop_map[slot] - 1];
+
+    if ( (nh->ip.s_addr == ip.s_addr) &&
+         (nh->ifc == ifc) )
+      return f->next_hop_map[slot] - 1;
+  }
+  if (f->num_next_hops == f->next_hops_size)
+  {
+    /* grow, keeping the hash table at most half full */
+    f->next_hops_size *= 2;
+    if (f->next_hops_size > FIB_INDEX_MASK)
+      abort ();
+    f->next_hops = realloc (f->next_hops,
+                            f->next_hops_size * sizeof (struct NextHop));
+    free (f->next_hop_map);
+    f->next_hop_map = calloc (f->next_hops_size * 2,
+                              sizeof (uint32_t));
+    if ( (NULL == f->next_hops) ||
+         (NULL == f->next_hop_map) )
+      abort ();
+    mask = f->next_hops_size * 2 - 1;
+    for (uint32_t i = 0; i<f->num_next_hops; i++)
+    {
+      for (slot = next_hop_slot (f->next_hops[i].ip,
+                                 f->next_hops[i].ifc,
+                                 mask);
+           0 != f->next_hop_map[slot];
+           slot = (slot + 1) & mask)
+        ;
+      f->next_hop_map[slot] = i + 1;
+    }
+    for (slot = next_hop_slot (ip,
+                               ifc,
+                               mask);
+         0 != f->next_hop_map[slot];
+         slot = (slot + 1) & mask)
+      ;
+  }
+  f->next_hops[f->num_next_hops].ip = ip;
+  f->next_hops[f->num_next_hops].ifc = ifc;
+  f->next_hop_map[slot] = ++f->num_next_hops;
+  return f->num_next_hops - 1;
+}
+
+
+/**
+ * Hash a route.
+ *
+ * @param f table the route is for
+ * @param network target network in host byte order
+ * @param len prefix length
+ * @return slot to start probing at
+ */
+static size_t
+route_home (const struct Fib *f,
+            uint32_t network,
+            unsigned int len)
+{
+  uint64_t key = ((uint64_t) len << 32) | network;
+
+  return (size_t) ((key * 0x9E3779B97F4A7C15LLU) >> 32) & f->routes_mask;
+}
+
+
+/**
+ * Find the slot of the route to @a network / @a len, or the free
+ * slot where it would go.
+ *
+ * @param f table to search
+ * @param network target network in host byte order
+ * @param len prefix length
+ * @return the slot
+ */
+static struct Route *
+route_slot (const struct Fib *f,
+            uint32_t network,
+            unsigned int len)
+{
+  size_t slot = route_home (f,
+                            network,
+                            len);
+
+  while ( (f->routes[slot].used) &&
+          ( (f->routes[slot].network != network) ||
+            (f->routes[slot].len != len) ) )
+    slot = (slot + 1) & f->routes_mask;
+  return &f->routes[slot];
+}
+
+
+/**
+ * Add @a r to the route table, growing it if it gets half full.
+ *
+ * @param f table to add to
+ * @param r route to add, must not be in the table yet
+ */
+static void
+route_insert (struct Fib *f,
+              const struct Route *r)
+{
+  if (2 * (f->num_routes + 1) > f->routes_mask + 1)
+  {
+    struct Route *old = f->routes;
+    size_t old_size = f->routes_mask + 1;
+
+    f->routes = calloc (old_size * 2,
+                        sizeof (struct Route));
+    if (NULL == f->routes)
+      abort ();
+    f->routes_mask = old_size * 2 - 1;
+    for (size_t i = 0; i<old_size; i++)
+      if (old[i].used)
+        *route_slot (f,
+                     old[i].network,
+                     old[i].len) = old[i];
+    free (old);
+  }
+  *route_slot (f,
+               r->network,
+               r->len) = *r;
+  f->num_routes++;
+}
+
+
+/**
+ * Remove @a r from the route table.  Moves later routes of the
+ * probe sequence back, so we need no tombstones.
+ *
+ * @param f table to remove from
+ * @param r the route, must be in the table
+ */
+static void
+route_remove (struct Fib *f,
+              struct Route *r)
+{
+  size_t hole = r - f->routes;
+  size_t slot = hole;
+
+  f->routes[hole].used = 0;
+  f->num_routes--;
+  while (1)
+  {
+    struct Route *next;
+    size_t home;
+
+    slot = (slot + 1) & f->routes_mask;
+    next = &f->routes[slot];
+    if (! next->used)
+      return;
+    home = route_home (f,
+                       next->network,
+                       next->len);
+    /* only move routes whose probe sequence passes the hole */
+    if ( ((slot - home) & f->routes_mask) <
+         ((slot - hole) & f->routes_mask) )
+      continue;
+    f->routes[hole] = *next;
+    next->used = 0;
+    hole = slot;
+  }
+}
+
+
+/**
+ * Get a free group of the second table.
+ *
+ * @param f table to use
+ * @return index of the group
+ */
+static uint32_t
+tbl8_alloc (struct Fib *f)
+{
+  if (0 != f->tbl8_free_count)
+    return f->tbl8_free[--f->tbl8_free_count];
+  if (f->tbl8_used == f->tbl8_size)
+  {
+    f->tbl8_size *= 2;
+    if (f->tbl8_size > FIB_INDEX_MASK)
+      abort ();
+    f->tbl8 = realloc (f->tbl8,
+                       (size_t) f->tbl8_size * FIB_TBL8_SIZE
+                       * sizeof (uint32_t));
+    f->tbl8_free = realloc (f->tbl8_free,
+                            f->tbl8_size * sizeof (uint32_t));
+    if ( (NULL == f->tbl8) ||
+         (NULL == f->tbl8_free) )
+      abort ();
+  }
+  return f->tbl8_used++;
+}
+
+
+/**
+ * Turn the group of the /24 at @a idx back into a single entry
+ * of the first table if no route longer than /24 is left in it.
+ *
+ * @param f table to use
+ * @param idx index into the first table, must be extended
+ */
+static void
+tbl8_collapse (struct Fib *f,
+               uint32_t idx)
+{
+  uint32_t group = f->tbl24[idx] & FIB_INDEX_MASK;
+  const uint32_t *e = &f->tbl8[group * FIB_TBL8_SIZE];
+
+  for (unsigned int i = 0; i<FIB_TBL8_SIZE; i++)
+    if ( (0 != (e[i] & FIB_VALID)) &&
+         ( (e[i] & FIB_DEPTH_MASK) > (24U << FIB_DEPTH_SHIFT)) )
+      return;
+  /* all entries came from the same route (or none) */
+  f->tbl24[idx] = e[0];
+  f->tbl8_free[f->tbl8_free_count++] = group;
+}
+
+
+/**
+ * Should the FIB entry @a e be overwritten by an update for a
+ * route of length @a len?
+ *
+ * @param e entry to check
+ * @param len prefix length of the route
+ * @param del are we deleting the route?
+ * @return true if the entry is to be updated
+ */
+static bool
+fib_affects (uint32_t e,
+             unsigned int len,
+             bool del)
+{
+  uint32_t depth = (e & FIB_DEPTH_MASK) >> FIB_DEPTH_SHIFT;
+
+  if (del)
+    return (0 != (e & FIB_VALID)) && (depth == len);
+  return (0 == (e & FIB_VALID)) || (depth <= len);
+}
+
+
+/**
+ * Set the entries for @a network / @a len to @a value, where they
+ * are not covered by longer prefixes.
+ *
+ * @param f table to update
+ * @param network target network in host byte order
+ * @param len prefix length
+ * @param value new entry
+ * @param del true to replace the entries of the route to
+ *        @a network / @a len itself (we are deleting it),
+ *        false to replace shorter prefixes (we are adding it)
+ */
+static void
+fib_update (struct Fib *f,
+            uint32_t network,
+            unsigned int len,
+            uint32_t value,
+            bool del)
+{
+  if (len <= 24)
+  {
+    uint32_t first = network >> 8;
+    uint32_t count = 1U << (24 - len);
+
+    for (uint32_t i = first; i<first + count; i++)
+    {
+      uint32_t e = f->tbl24[i];
+
+      if (0 == (e & FIB_EXTENDED))
+      {
+        if (fib_affects (e,
+                         len,
+                         del))
+          f->tbl24[i] = value;
+        continue;
+      }
+      for (unsigned int j = 0; j<FIB_TBL8_SIZE; j++)
+      {
+        uint32_t *g = &f->tbl8[(e & FIB_INDEX_MASK) * FIB_TBL8_SIZE + j];
+
+        if (fib_affects (*g,
+                         len,
+                         del))
+          *g = value;
+      }
+      if (del)
+        tbl8_collapse (f,
+                       i);
+    }
+    return;
+  }
+  {
+    uint32_t idx = network >> 8;
+    uint32_t first = network & 0xFF;
+    uint32_t count = 1U << (32 - len);
+    uint32_t *g;
+
+    if (0 == (f->tbl24[idx] & FIB_EXTENDED))
+    {
+      uint32_t group;
+
+      if (del)
+        return;
+      /* split the /24, its entries inherit the covering route */
+      group = tbl8_alloc (f);
+      g = &f->tbl8[group * FIB_TBL8_SIZE];
+      for (unsigned int j = 0; j<FIB_TBL8_SIZE; j++)
+        g[j] = f->tbl24[idx];
+      f->tbl24[idx] = FIB_EXTENDED | group;
+    }
+    g = &f->tbl8[(f->tbl24[idx] & FIB_INDEX_MASK) * FIB_TBL8_SIZE];
+    for (uint32_t j = first; j<first + count; j++)
+      if (fib_affects (g[j],
+                       len,
+                       del))
+        g[j] = value;
+    if (del)
+      tbl8_collapse (f,
+                     idx);
+  }
+}
+
+
+/**
+ * Add a route to @a network / @a len via @a ip on @a ifc, or change
+ * the next hop of an existing route.
+ *
+ * @param f table to update
+ * @param network target network, host bits are ignored
+ * @param len prefix length
+ * @param ip next hop, 0.0.0.0 for the connected network
+ * @param ifc interface to send the packets out on
+ * @param connected is this the route to the connected network of @a ifc?
+ * @return 0 on success, 1 if the route is for a connected network
+ */
+static int
+fib_add (struct Fib *f,
+         struct in_addr network,
+         unsigned int len,
+         struct in_addr ip,
+         struct Interface *ifc,
+         bool connected)
+{
+  uint32_t net = ntohl (network.s_addr) & prefix_mask (len);
+  struct Route *r = route_slot (f,
+                                net,
+                                len);
+  struct Route nr;
+
+  if ( (r->used) &&
+       (r->connected) )
+    return 1;
+  nr.network = net;
+  nr.len = len;
+  nr.next_hop = fib_next_hop (f,
+                              ip,
+                              ifc);
+  nr.used = 1;
+  nr.connected = connected;
+  if (r->used)
+    *r = nr;
+  else
+    route_insert (f,
+                  &nr);
+  fib_update (f,
+              net,
+              len,
+              FIB_VALID | ((uint32_t) len << FIB_DEPTH_SHIFT) | nr.next_hop,
+              false);
+  return 0;
+}
+
+
+/**
+ * Delete the route to @a network / @a len via @a ip on @a ifc.
+ * The destinations fall back to the next shorter matching route.
+ *
+ * @param f table to update
+ * @param network target network, host bits are ignored
+ * @param len prefix length
+ * @param ip next hop of the route
+ * @param ifc interface of the route
+ * @return 0 on success, 1 if there is no such route,
+ *         2 if the route is for a connected network
+ */
+static int
+fib_del (struct Fib *f,
+         struct in_addr network,
+         unsigned int len,
+         struct in_addr ip,
+         struct Interface *ifc)
+{
+  uint32_t net = ntohl (network.s_addr) & prefix_mask (len);
+  struct Route *r = route_slot (f,
+                                net,
+                                len);
+  const struct NextHop *nh;
+  uint32_t value = 0;
+
+  if (! r->used)
+    return 1;
+  nh = &f->next_hops[r->next_hop];
+  if ( (nh->ip.s_addr != ip.s_addr) ||
+       (nh->ifc != ifc) )
+    return 1;
+  if (r->connected)
+    return 2;
+  route_remove (f,
+                r);
+  for (int l = (int) len - 1; l >= 0; l--)
+  {
+    const struct Route *cover = route_slot (f,
+                                            net & prefix_mask (l),
+                                            l);
+
+    if (cover->used)
+    {
+      value = FIB_VALID | ((uint32_t) l << FIB_DEPTH_SHIFT) | cover->next_hop;
+      break;
+    }
+  }
+  fib_update (f,
+              net,
+              len,
+              value,
+              true);
+  return 0;
+}
+
+
+/**
+ * Create an empty FIB.
+ *
+ * @return the new table
+ */
+static struct Fib *
+fib_create (void)
+{
+  struct Fib *f;
+
+  f = calloc (1,
+              sizeof (struct Fib));
+  if (NULL == f)
+    abort ();
+  /* only the parts of the first table we write to use memory */
+  f->tbl24 = calloc (FIB_TBL24_SIZE,
+                     sizeof (uint32_t));
+  f->tbl8_size = 64;
+  f->tbl8 = malloc ((size_t) f->tbl8_size * FIB_TBL8_SIZE
+                    * sizeof (uint32_t));
+  f->tbl8_free = malloc (f->tbl8_size * sizeof (uint32_t));
+  f->next_hops_size = 16;
+  f->next_hops = malloc (f->next_hops_size * sizeof (struct NextHop));
+  f->next_hop_map = calloc (f->next_hops_size * 2,
+                            sizeof (uint32_t));
+  f->routes_mask = FIB_INITIAL_ROUTES - 1;
+  f->routes = calloc (FIB_INITIAL_ROUTES,
+                      sizeof (struct Route));
+  if ( (NULL == f->tbl24) ||
+       (NULL == f->tbl8) ||
+       (NULL == f->tbl8_free) ||
+       (NULL == f->next_hops) ||
+       (NULL == f->next_hop_map) ||
+       (NULL == f->routes) )
+    abort ();
+  return f;
+}
+
+
+/**
+ * Release @a f.
+ *
+ * @param f table to free
+ */
+static void
+fib_destroy (struct Fib *f)
+{
+  free (f->tbl24);
+  free (f->tbl8);
+  free (f->tbl8_free);
+  free (f->next_hops);
+  free (f->next_hop_map);
+  free (f->routes);
+  free (f);
+}
+
+
+/**
+ * Create a copy of @a src.
+ *
+ * @param src table to copy
+ * @return the new table
+ */
+static struct Fib *
+fib_clone (const struct Fib *src)
+{
+  struct Fib *f;
+
+  f = malloc (sizeof (struct Fib));
+  if (NULL == f)
+    abort ();
+  *f = *src;
+  f->tbl24 = calloc (FIB_TBL24_SIZE,
+                     sizeof (uint32_t));
+  f->tbl8 = malloc ((size_t) f->tbl8_size * FIB_TBL8_SIZE
+                    * sizeof (uint32_t));
+  f->tbl8_free = malloc (f->tbl8_size * sizeof (uint32_t));
+  f->next_hops = malloc (f->next_hops_size * sizeof (struct NextHop));
+  f->next_hop_map = malloc (f->next_hops_size * 2 * sizeof (uint32_t));
+  f->routes = malloc ((f->routes_mask + 1) * sizeof (struct Route));
+  if ( (NULL == f->tbl24) ||
+       (NULL == f->tbl8) ||
+       (NULL == f->tbl8_free) ||
+       (NULL == f->next_hops) ||
+       (NULL == f->next_hop_map) ||
+       (NULL == f->routes) )
+    abort ();
+  /* leave the parts of the first table without routes untouched */
+  for (size_t i = 0; i < FIB_TBL24_SIZE; i++)
+    if (0 != src->tbl24[i])
+      f->tbl24[i] = src->tbl24[i];
+  memcpy (f->tbl8,
+          src->tbl8,
+          (size_t) f->tbl8_used * FIB_TBL8_SIZE * sizeof (uint32_t));
+  memcpy (f->tbl8_free,
+          src->tbl8_free,
+          f->tbl8_free_count * sizeof (uint32_t));
+  memcpy (f->next_hops,
+          src->next_hops,
+          f->num_next_hops * sizeof (struct NextHop));
+  memcpy (f->next_hop_map,
+          src->next_hop_map,
+          f->next_hops_size * 2 * sizeof (uint32_t));
+  memcpy (f->routes,
+          src->routes,
+          (f->routes_mask + 1) * sizeof (struct Route));
+  return f;
+}
+
+
+/**
+ * The forwarding thread starts to use #fib.  Never blocks.
+ */
+static void
+fib_read_lock (void)
+{
+  atomic_store (&reader_epoch,
+                atomic_load (&fib_epoch));
+}
+
+
+/**
+ * The forwarding thread no longer uses the table it got from #fib.
+ */
+static void
+fib_read_unlock (void)
+{
+  atomic_store (&reader_epoch,
+                0);
+}
+
+
+/**
+ * Make @a f the table used for forwarding.  Waits until the
+ * forwarding thread no longer uses the previous table, which it only
+ * does while it handles a frame.
+ *
+ * @param f the new table
+ * @return the previous table, now unused
+ */
+static struct Fib *
+fib_publish (struct Fib *f)
+{
+  struct Fib *old;
+  uint_fast64_t epoch;
+  uint_fast64_t seen;
+  struct timespec ts = {
+    .tv_sec = 0,
+    .tv_nsec = FIB_GRACE_POLL_NS
+  };
+
+  old = atomic_exchange (&fib,
+                         f);
+  /* readers that started at @a epoch or later see @a f */
+  epoch = atomic_fetch_add (&fib_epoch,
+                            1) + 1;
+  while ( (0 != (seen = atomic_load (&reader_epoch))) &&
+          (seen < epoch) )
+    nanosleep (&ts,
+               NULL);
+  return old;
+}
+
+
+/**
+ * Send an IPv4 packet to the next hop @a nh.  The @a head is copied,
+ * the @a data is only referenced (see output_frame()).
+ *
+ * @param nh next hop to send the packet to
+ * @param head start of the packet, at least the complete IPv4 header
+ * @param head_size number of bytes in @a head, at most #IP_MAX_HEAD_SIZE
+ * @param data rest of the packet
+ * @param data_size number of bytes in @a data
+ */
+static void
+transmit_ip (const struct NextHop *nh,
+             const void *head,
+             size_t head_size,
+             const void *data,
+             size_t data_size)
+{
+  char buf[sizeof (struct EthernetHeader) + IP_MAX_HEAD_SIZE];
+  struct EthernetHeader eh;
+  struct IPv4Header ip;
+  struct in_addr target;
+  const struct MacAddress *mac;
+
+  if (head_size > IP_MAX_HEAD_SIZE)
+    abort ();
+  memcpy (&ip,
+          head,
+          sizeof (ip));
+  /* on the connected network, the destination is the next hop */
+  target = (0 == nh->ip.s_addr) ? ip.destination_address : nh->ip;
+  mac = arp_resolve (nh->ifc->ifc_num,
+                     target);
+  if (NULL == mac)
+  {
+    arp_hold (nh->ifc->ifc_num,
+              target,
+              head,
+              head_size,
+              data,
+              data_size);
+    return;
+  }
+  eh.dst = *mac;
+  eh.src = nh->ifc->mac;
+  eh.tag = htons (ETH_P_IPV4);
+  memcpy (buf,
+          &eh,
+          sizeof (eh));
+  memcpy (&buf[sizeof (eh)],
+          head,
+          head_size);
+  output_frame (nh->ifc->ifc_num,
+                buf,
+                sizeof (eh) + head_size,
+                data,
+                data_size);
+}
+
+
+/**
+ * Send an IPv4 packet to the next hop @a nh, fragmenting it if it
+ * does not fit the MTU.  The caller must have checked that the
+ * packet may be fragmented.
+ *
+ * @param nh next hop to send the packet to
+ * @param hdr IPv4 header, with options
+ * @param hdr_size number of bytes in @a hdr
+ * @param data payload of the packet, must remain valid until
+ *        the output is flushed
+ * @param data_size number of bytes in @a data
+ */
+static void
+forward_ip (const struct NextHop *nh,
+            const void *hdr,
+            size_t hdr_size,
+            const void *data,
+            size_t data_size)
+{
+  uint16_t buf[IP_MAX_HEADER_SIZE / 2];
+  struct IPv4Header ip;
+  size_t room = nh->ifc->mtu - sizeof (struct EthernetHeader) - hdr_size;
+  uint16_t frag;
+  size_t off = 0;
+
+  memcpy (buf,
+          hdr,
+          hdr_size);
+  memcpy (&ip,
+          hdr,
+          sizeof (ip));
+  frag = ntohs (ip.fragmentation_info);
+  if (data_size > room)
+    room -= room % IP_FRAGMENT_MULTIPLE;
+  do
+  {
+    size_t len = (data_size - off > room) ? room : data_size - off;
+    uint16_t info = frag + off / IP_FRAGMENT_MULTIPLE;
+
+    if (off + len < data_size)
+      info |= IP_FLAGS_MORE_FRAGMENTS << 13;
+    ip.total_length = htons (hdr_size + len);
+    ip.fragmentation_info = htons (info);
+    ip.checksum = 0;
+    memcpy (buf,
+            &ip,
+            sizeof (ip));
+    ip.checksum = GNUNET_CRYPTO_crc16_n (buf,
+                                         hdr_size);
+    memcpy (buf,
+            &ip,
+            sizeof (ip));
+    transmit_ip (nh,
+                 buf,
+                 hdr_size,
+                 (const char *) data + off,
+                 len);
+    off += len;
+  }
+  while (off < data_size);
+}
+
+
+/**
+ * Find our interface with the IPv4 address @a addr.
+ *
+ * @param addr address to look for
+ * @return NULL if @a addr is not ours
+ */
+static struct Interface *
+find_local (struct in_addr addr)
+{
+  for (unsigned int i = 0; i<num_ifc; i++)
+    if (gifc[i].ip.s_addr == addr.s_addr)
+      return &gifc[i];
+  return NULL;
+}
+
+
+/**
+ * Tell the sender of the @a ip packet about a problem with it.  The
+ * error goes back to the neighbour the packet came from, so it never
+ * needs a route or an ARP lookup.
+ *
+ * @param origin interface we received the packet from
+ * @param sender MAC address of the neighbour we received the packet from
+ * @param ip IP header of the packet
+ * @param payload IP packet payload, starting with the options
+ * @param payload_size number of bytes in @a payload
+ * @param type ICMP type
+ * @param code ICMP code
+ * @param mtu MTU to report for #ICMPCODE_FRAGMENTATION_REQUIRED
+ */
+static void
+send_icmp (struct Interface *origin,
+           const struct MacAddress *sender,
+           const struct IPv4Header *ip,
+           const void *payload,
+           size_t payload_size,
+           uint8_t type,
+           uint8_t code,
+           uint16_t mtu)
+{
+  uint16_t buf[IP_MAX_HEAD_SIZE / 2];
+  char *cbuf = (char *) buf;
+  char frame[sizeof (struct EthernetHeader) + IP_MAX_HEAD_SIZE];
+  struct EthernetHeader eh;
+  const uint8_t *cpayload = payload;
+  size_t opts = ip->header_length * 4 - sizeof (struct IPv4Header);
+  /* the original header and the first 8 bytes of its payload */
+  size_t quote = opts + 8;
+  size_t icmp_size;
+  struct IPv4Header reply;
+  struct IcmpHeader icmp;
+
+  /* never answer errors or later fragments with errors */
+  if (0 != (ntohs (ip->fragmentation_info) & 0x1FFF))
+    return;
+  if ( (IPPROTO_ICMP == ip->protocol) &&
+       (payload_size > opts) &&
+       ( (ICMPTYPE_DESTINATION_UNREACHABLE == cpayload[opts]) ||
+         (ICMPTYPE_TIME_EXCEEDED == cpayload[opts]) ) )
+    return;
+  if (quote > payload_size)
+    quote = payload_size;
+  icmp_size = sizeof (icmp) + sizeof (*ip) + quote;
+  memset (buf,
+          0,
+          sizeof (buf));
+  memset (&icmp,
+          0,
+          sizeof (icmp));
+  icmp.type = type;
+  icmp.code = code;
+  if (ICMPCODE_FRAGMENTATION_REQUIRED == code)
+    icmp.quench.destination_unreachable.next_hop_mtu = htons (mtu);
+  memcpy (&cbuf[sizeof (reply)],
+          &icmp,
+          sizeof (icmp));
+  memcpy (&cbuf[sizeof (reply) + sizeof (icmp)],
+          ip,
+          sizeof (*ip));
+  memcpy (&cbuf[sizeof (reply) + sizeof (icmp) + sizeof (*ip)],
+          payload,
+          quote);
+  icmp.crc = GNUNET_CRYPTO_crc16_n (&cbuf[sizeof (reply)],
+                                    icmp_size + (icmp_size % 2));
+  memcpy (&cbuf[sizeof (reply)],
+          &icmp,
+          sizeof (icmp));
+  memset (&reply,
+          0,
+          sizeof (reply));
+  reply.version = 4;
+  reply.header_length = sizeof (reply) / 4;
+  reply.total_length = htons (sizeof (reply) + icmp_size);
+  reply.ttl = 64;
+  reply.protocol = IPPROTO_ICMP;
+  reply.source_address = origin->ip;
+  reply.destination_address = ip->source_address;
+  memcpy (buf,
+          &reply,
+          sizeof (reply));
+  reply.checksum = GNUNET_CRYPTO_crc16_n (buf,
+                                          sizeof (reply));
+  memcpy (buf,
+          &reply,
+          sizeof (reply));
+  eh.dst = *sender;
+  eh.src = origin->mac;
+  eh.tag = htons (ETH_P_IPV4);
+  memcpy (frame,
+          &eh,
+          sizeof (eh));
+  memcpy (&frame[sizeof (eh)],
+          buf,
+          sizeof (reply) + icmp_size);
+  output_frame (origin->ifc_num,
+                frame,
+                sizeof (eh) + sizeof (reply) + icmp_size,
+                NULL,
+                0);
+}
+
+
+/**
+ * Route the @a ip packet with its @a payload.
+ *
+ * @param origin interface we received the packet from
+ * @param sender MAC address of the neighbour we received the packet from
+ * @param ip IP header
+ * @param payload IP packet payload, starting with the options
+ * @param payload_size number of bytes in @a payload
+ */
+static void
+route (struct Interface *origin,
+       const struct MacAddress *sender,
+       const struct IPv4Header *ip,
+       const void *payload,
+       size_t payload_size)
+{
+  uint16_t hdr[IP_MAX_HEADER_SIZE / 2];
+  size_t hdr_size = ip->header_length * 4;
+  size_t total = ntohs (ip->total_length);
+  const struct NextHop *nh;
+  struct IPv4Header fwd;
+
+  if ( (4 != ip->version) ||
+       (hdr_size < sizeof (struct IPv4Header)) ||
+       (total < hdr_size) ||
+       (total - sizeof (struct IPv4Header) > payload_size) )
+  {
+    fprintf (stderr,
+             "Malformed IPv4 packet\n");
+    return;
+  }
+  /* drop the Ethernet padding */
+  payload_size = total - sizeof (struct IPv4Header);
+  if (NULL != find_local (ip->destination_address))
+    return; /* we offer no services */
+  if (ip->ttl <= 1)
+  {
+    send_icmp (origin,
+               sender,
+               ip,
+               payload,
+               payload_size,
+               ICMPTYPE_TIME_EXCEEDED,
+               0,
+               0);
+    return;
+  }
+  nh = fib_lookup (atomic_load (&fib),
+                   ip->destination_address);
+  if (NULL == nh)
+  {
+    send_icmp (origin,
+               sender,
+               ip,
+               payload,
+               payload_size,
+               ICMPTYPE_DESTINATION_UNREACHABLE,
+               ICMPCODE_NETWORK_UNREACHABLE,
+               0);
+    return;
+  }
+  if ( (total + sizeof (struct EthernetHeader) > nh->ifc->mtu) &&
+       (0 != ((ntohs (ip->fragmentation_info) >> 13)
+              & IP_FLAGS_DO_NOT_FRAGMENT)) )
+  {
+    send_icmp (origin,
+               sender,
+               ip,
+               payload,
+               payload_size,
+               ICMPTYPE_DESTINATION_UNREACHABLE,
+               ICMPCODE_FRAGMENTATION_REQUIRED,
+               nh->ifc->mtu - sizeof (struct EthernetHeader));
+    return;
+  }
+  fwd = *ip;
+  fwd.ttl--;
+  memcpy (hdr,
+          &fwd,
+          sizeof (fwd));
+  memcpy (&hdr[sizeof (fwd) / 2],
+          payload,
+          hdr_size - sizeof (fwd));
+  forward_ip (nh,
+              hdr,
+              hdr_size,
+              (const char *) payload + hdr_size - sizeof (fwd),
+              total - hdr_size);
+}
+
+
+/**
+ * Parse and process frame received on @a ifc.
+ *
+ * @param ifc interface we got the frame on
+ * @param frame raw frame data
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+parse_frame (struct Interface *ifc,
+             const void *frame,
+             size_t frame_size)
+{
+  struct EthernetHeader eh;
+  const char *cframe = frame;
+
+  if (frame_size < sizeof (eh))
+  {
+    fprintf (stderr,
+             "Malformed frame\n");
+    return;
+  }
+  memcpy (&eh,
+          frame,
+          sizeof (eh));
+  switch (ntohs (eh.tag))
+  {
+  case ETH_P_IPV4:
+    {
+      struct IPv4Header ip;
+
+      if (frame_size < sizeof (struct EthernetHeader) + sizeof (struct
+                                                                IPv4Header))
+      {
+        fprintf (stderr,
+                 "Malformed frame\n");
+        return;
+      }
+      memcpy (&ip,
+              &cframe[sizeof (struct EthernetHeader)],
+              sizeof (struct IPv4Header));
+      /* TODO: possibly do work here (ARP learning) */
+      route (ifc,
+             &eh.src,
+             &ip,
+             &cframe[sizeof (struct EthernetHeader) + sizeof (struct
+                                                              IPv4Header)],
+             frame_size - sizeof (struct EthernetHeader) - sizeof (struct
+                                                                   IPv4Header));
+      break;
+    }
+  case ETH_P_ARP:
+    arp_handle (ifc->ifc_num,
+                &cframe[sizeof (struct EthernetHeader)],
+                frame_size - sizeof (struct EthernetHeader));
+    break;
+  default:
+#if DEBUG
+    fprintf (stderr,
+             "Unsupported Ethernet tag %04X\n",
+             ntohs (eh.tag));
+#endif
+    return;
+  }
+}
+
+
+/**
+ * Process frame received from @a interface.
+ *
+ * @param interface number of the interface on which we received @a frame
+ * @param frame the frame
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+handle_frame (uint16_t interface,
+              const void *frame,
+              size_t frame_size)
+{
+  if (interface > num_ifc)
+    abort ();
+  fib_read_lock ();
+  parse_frame (&gifc[interface - 1],
+               frame,
+               frame_size);
+  fib_read_unlock ();
+}
+
+
+/**
+ * Find network interface by @a name.
+ *
+ * @param name name to look up by
+ * @return NULL if @a name was not found
+ */
+static struct Interface *
+find_interface (const char *name)
+{
+  for (unsigned int i = 0; i<num_ifc; i++)
+    if (0 == strcasecmp (name,
+                         gifc[i].name))
+      return &gifc[i];
+  return NULL;
+}
+
+
+/**
+ * The user entered an "arp" command.  The remaining
+ * arguments can be obtained via 'strtok()'.
+ */
+static void
+process_cmd_arp ()
+{
+  const char *tok = strtok (NULL, " ");
+  struct in_addr v4;
+  const struct MacAddress *mac;
+  struct Interface *ifc;
+
+  if (NULL == tok)
+  {
+    arp_print ();
+    return;
+  }
+  if (1 !=
+      inet_pton (AF_INET,
+                 tok,
+                 &v4))
+  {
+    fprintf (stderr,
+             "`%s' is not a valid IPv4 address\n",
+             tok);
+    return;
+  }
+  tok = strtok (NULL, " ");
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "No network interface provided\n");
+    return;
+  }
+  ifc = find_interface (tok);
+  if (NULL == ifc)
+  {
+    fprintf (stderr,
+             "Interface `%s' unknown\n",
+             tok);
+    return;
+  }
+  mac = arp_resolve (ifc->ifc_num,
+                     v4);
+  if (NULL == mac)
+  {
+    arp_request (ifc->ifc_num,
+                 v4);
+    return;
+  }
+  print ("%02x:%02x:%02x:%02x:%02x:%02x\n",
+         mac->mac[0], mac->mac[1], mac->mac[2],
+         mac->mac[3], mac->mac[4], mac->mac[5]);
+}
+
+
+/**
+ * Parse network specification in @a net, initializing @a network and @a netmask.
+ * Format of @a net is "IP/NETMASK".
+ *
+ * @param network[out] network specification to initialize
+ * @param netmask[out] netmask specification to initialize
+ * @param arg interface specification to parse
+ * @return 0 on success
+ */
+static int
+parse_network (struct in_addr *network,
+               struct in_addr *netmask,
+               const char *net)
+{
+  const char *tok;
+  char *ip;
+  unsigned int mask;
+
+  tok = strchr (net, '/');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in network specification: lacks '/'\n");
+    return 1;
+  }
+  ip = strndup (net,
+                tok - net);
+  if (1 !=
+      inet_pton (AF_INET,
+                 ip,
+                 network))
+  {
+    fprintf (stderr,
+             "IP address `%s' malformed\n",
+             ip);
+    free (ip);
+    return 1;
+  }
+  free (ip);
+  tok++;
+  if (1 !=
+      sscanf (tok,
+              "%u",
+              &mask))
+  {
+    fprintf (stderr,
+             "Netmask `%s' malformed\n",
+             tok);
+    return 1;
+  }
+  if (mask > 32)
+  {
+    fprintf (stderr,
+             "Netmask invalid (too large)\n");
+    return 1;
+  }
+  netmask->s_addr = htonl (~(uint32_t) ((1LLU << (32 - mask)) - 1LLU));
+  return 0;
+}
+
+
+/**
+ * Get the prefix length of @a netmask.
+ *
+ * @param netmask a netmask as set by parse_network()
+ * @return number of leading one bits of @a netmask
+ */
+static unsigned int
+netmask_len (struct in_addr netmask)
+{
+  return __builtin_popcount (netmask.s_addr);
+}
+
+
+/**
+ * Parse route from arguments in strtok() buffer.
+ *
+ * @param target_network[out] set to target network
+ * @param target_netmask[out] set to target netmask
+ * @param next_hop[out] set to next hop
+ * @param ifc[out] set to target interface
+ */
+static int
+parse_route (struct in_addr *target_network,
+             struct in_addr *target_netmask,
+             struct in_addr *next_hop,
+             struct Interface **ifc)
+{
+  char *tok;
+
+  tok = strtok (NULL, " ");
+  if ( (NULL == tok) ||
+       (0 != parse_network (target_network,
+                            target_netmask,
+                            tok)) )
+  {
+    fprintf (stderr,
+             "Expected network specification, not `%s'\n",
+             tok);
+    return 1;
+  }
+  tok = strtok (NULL, " ");
+  if ( (NULL == tok) ||
+       (0 != strcasecmp ("via",
+                         tok)))
+  {
+    fprintf (stderr,
+             "Expected `via', not `%s'\n",
+             tok);
+    return 1;
+  }
+  tok = strtok (NULL, " ");
+  if ( (NULL == tok) ||
+       (1 != inet_pton (AF_INET,
+                        tok,
+                        next_hop)) )
+  {
+    fprintf (stderr,
+             "Expected next hop, not `%s'\n",
+             tok);
+    return 1;
+  }
+  tok = strtok (NULL, " ");
+  if ( (NULL == tok) ||
+       (0 != strcasecmp ("dev",
+                         tok)))
+  {
+    fprintf (stderr,
+             "Expected `dev', not `%s'\n",
+             tok);
+    return 1;
+  }
+  tok = strtok (NULL, " ");
+  *ifc = find_interface (tok);
+  if (NULL == *ifc)
+  {
+    fprintf (stderr,
+             "Interface `%s' unknown\n",
+             tok);
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Print @a size bytes of text in @a buf, in pieces small enough
+ * for a control message.
+ *
+ * @param buf text to print, lines ending in newlines
+ * @param size number of bytes in @a buf
+ */
+static void
+print_chunked (const char *buf,
+               size_t size)
+{
+  while (size > 0)
+  {
+    size_t chunk = size;
+
+    if (chunk > PRINT_CHUNK)
+    {
+      const char *nl = memrchr (buf,
+                                '\n',
+                                PRINT_CHUNK);
+
+      chunk = (NULL == nl) ? PRINT_CHUNK : (size_t) (nl - buf + 1);
+    }
+    print ("%.*s",
+           (int) chunk,
+           buf);
+    buf += chunk;
+    size -= chunk;
+  }
+}
+
+
+/**
+ * Print the output of the route commands the control thread
+ * finished.  Runs in the main thread.
+ *
+ * @param t the timer, re-scheduled while output is outstanding
+ */
+static void
+control_poll (struct Timer *t)
+{
+  struct RouteCommand *done;
+  bool more;
+
+  pthread_mutex_lock (&ctl.lock);
+  done = ctl.done_head;
+  ctl.done_head = NULL;
+  ctl.done_tail = &ctl.done_head;
+  more = (0 != ctl.pending_output);
+  pthread_mutex_unlock (&ctl.lock);
+  while (NULL != done)
+  {
+    struct RouteCommand *cmd = done;
+
+    done = cmd->next;
+    print_chunked (cmd->output,
+                   cmd->output_size);
+    free (cmd->output);
+    free (cmd);
+  }
+  if (more)
+    timer_schedule (t,
+                    timer_now () + CONTROL_POLL_MS,
+                    &control_poll);
+}
+
+
+/**
+ * Create a command for the control thread.
+ *
+ * @param op what to do
+ * @return the command to fill in, call control_submit() next
+ */
+static struct RouteCommand *
+control_command (enum RouteOp op)
+{
+  struct RouteCommand *cmd;
+
+  cmd = calloc (1,
+                sizeof (struct RouteCommand));
+  if (NULL == cmd)
+    abort ();
+  cmd->op = op;
+  return cmd;
+}
+
+
+/**
+ * Hand @a cmd to the control thread.  Never waits for commands
+ * that are being run.
+ *
+ * @param cmd command to run, ownership passes to the control thread
+ */
+static void
+control_submit (struct RouteCommand *cmd)
+{
+  bool output = (ROUTE_OP_LIST == cmd->op);
+
+  pthread_mutex_lock (&ctl.lock);
+  *ctl.tail = cmd;
+  ctl.tail = &cmd->next;
+  if (output)
+    ctl.pending_output++;
+  pthread_cond_signal (&ctl.cond);
+  pthread_mutex_unlock (&ctl.lock);
+  if (output)
+    timer_schedule (&ctl.poll,
+                    timer_now () + CONTROL_POLL_MS,
+                    &control_poll);
+}
+
+
+/**
+ * Have the control thread add or delete a route.
+ *
+ * @param op #ROUTE_OP_ADD or #ROUTE_OP_DEL
+ */
+static void
+process_cmd_route_change (enum RouteOp op)
+{
+  struct in_addr target_network;
+  struct in_addr target_netmask;
+  struct in_addr next_hop;
+  struct Interface *ifc;
+  struct RouteCommand *cmd;
+
+  if (0 != parse_route (&target_network,
+                        &target_netmask,
+                        &next_hop,
+                        &ifc))
+    return;
+  cmd = control_command (op);
+  cmd->network = target_network;
+  cmd->len = netmask_len (target_netmask);
+  cmd->next_hop = next_hop;
+  cmd->ifc = ifc;
+  control_submit (cmd);
+}
+
+
+/**
+ * Create a FIB with the routes to our connected networks.
+ *
+ * @return the new table
+ */
+static struct Fib *
+fib_create_connected (void)
+{
+  struct Fib *f = fib_create ();
+  struct in_addr none = { 0 };
+
+  for (unsigned int i = 0; i<num_ifc; i++)
+    (void) fib_add (f,
+                    gifc[i].ip,
+                    netmask_len (gifc[i].netmask),
+                    none,
+                    &gifc[i],
+                    true);
+  return f;
+}
+
+
+/**
+ * Skip blanks at @a pos.
+ *
+ * @param pos position in a NUL-terminated line
+ * @return first non-blank character at or after @a pos
+ */
+static const char *
+skip_blanks (const char *pos)
+{
+  while ( (' ' == *pos) ||
+          ('\t' == *pos) )
+    pos++;
+  return pos;
+}
+
+
+/**
+ * Parse a number of at most @a max at @a *pos.
+ *
+ * @param pos[in,out] position in a NUL-terminated line, moved
+ *        behind the number
+ * @param max largest number we accept
+ * @param value[out] set to the number
+ * @return 0 on success
+ */
+static int
+scan_number (const char **pos,
+             unsigned int max,
+             unsigned int *value)
+{
+  const char *p = *pos;
+  unsigned int v = 0;
+
+  if ( ('0' > *p) ||
+       ('9' < *p) )
+    return 1;
+  while ( ('0' <= *p) &&
+          ('9' >= *p) )
+  {
+    v = v * 10 + (*p++ - '0');
+    if (v > max)
+      return 1;
+  }
+  *pos = p;
+  *value = v;
+  return 0;
+}
+
+
+/**
+ * Parse a dotted-quad IPv4 address at @a *pos.
+ *
+ * @param pos[in,out] position in a NUL-terminated line, moved
+ *        behind the address
+ * @param addr[out] set to the address
+ * @return 0 on success
+ */
+static int
+scan_ipv4 (const char **pos,
+           struct in_addr *addr)
+{
+  uint32_t a = 0;
+
+  for (unsigned int i = 0; i<4; i++)
+  {
+    unsigned int octet;
+
+    if ( (0 != i) &&
+         ('.' != *(*pos)++) )
+      return 1;
+    if (0 != scan_number (pos,
+                          255,
+                          &octet))
+      return 1;
+    a = (a << 8) | octet;
+  }
+  addr->s_addr = htonl (a);
+  return 0;
+}
+
+
+/**
+ * Parse the keyword @a word at @a *pos, followed by blanks.
+ *
+ * @param pos[in,out] position in a NUL-terminated line, moved
+ *        behind the blanks
+ * @param word expected keyword
+ * @return 0 on success
+ */
+static int
+scan_keyword (const char **pos,
+              const char *word)
+{
+  size_t len = strlen (word);
+
+  if ( (0 != strncasecmp (*pos,
+                          word,
+                          len)) ||
+       ( (' ' != (*pos)[len]) &&
+         ('\t' != (*pos)[len]) ) )
+    return 1;
+  *pos = skip_blanks (*pos + len);
+  return 0;
+}
+
+
+/**
+ * Add the route in @a line of a text route file to @a f.  Lines
+ * have the format of the arguments of "route add".  Blank lines and
+ * lines starting with '#' are ignored.
+ *
+ * @param f table to add to
+ * @param line the line, without the newline
+ * @return 0 on success
+ */
+static int
+load_route_line (struct Fib *f,
+                 char *line)
+{
+  const char *pos = skip_blanks (line);
+  struct in_addr network;
+  struct in_addr next_hop;
+  struct Interface *ifc;
+  unsigned int len;
+  char *name;
+
+  if ( ('\0' == *pos) ||
+       ('#' == *pos) )
+    return 0;
+  if ( (0 != scan_ipv4 (&pos,
+                        &network)) ||
+       ('/' != *pos++) ||
+       (0 != scan_number (&pos,
+                          32,
+                          &len)) )
+    return 1;
+  pos = skip_blanks (pos);
+  if ( (0 != scan_keyword (&pos,
+                           "via")) ||
+       (0 != scan_ipv4 (&pos,
+                        &next_hop)) )
+    return 1;
+  pos = skip_blanks (pos);
+  if (0 != scan_keyword (&pos,
+                         "dev"))
+    return 1;
+  /* the interface name ends the line */
+  name = line + (pos - line);
+  name[strcspn (name,
+                " \t\r")] = '\0';
+  ifc = find_interface (name);
+  if (NULL == ifc)
+    return 1;
+  return fib_add (f,
+                  network,
+                  len,
+                  next_hop,
+                  ifc,
+                  false);
+}
+
+
+/**
+ * Add the routes of the binary route file @a fh to @a f.
+ *
+ * @param f table to add to
+ * @param fh file to read, positioned behind the magic number
+ * @param filename name of the file, for error messages
+ * @return 0 on success
+ */
+static int
+load_routes_binary (struct Fib *f,
+                    FILE *fh,
+                    const char *filename)
+{
+  static struct RouteRecord rec[ROUTE_FILE_CHUNK];
+  size_t got;
+  size_t total = 0;
+
+  /* read bytes rather than records, so that we notice a truncated
+     record at the end */
+  while (0 != (got = fread (rec,
+                            1,
+                            sizeof (rec),
+                            fh)))
+  {
+    size_t n = got / sizeof (struct RouteRecord);
+
+    for (size_t i = 0; i<n; i++)
+    {
+      uint16_t ifc_num = ntohs (rec[i].ifc_num);
+
+      if ( (0 == ifc_num) ||
+           (ifc_num > num_ifc) ||
+           (rec[i].len > 32) ||
+           (0 != fib_add (f,
+                          rec[i].network,
+                          rec[i].len,
+                          rec[i].next_hop,
+                          &gifc[ifc_num - 1],
+                          false)) )
+      {
+        fprintf (stderr,
+                 "Invalid route #%llu in `%s'\n",
+                 (unsigned long long) (total + i),
+                 filename);
+        return 1;
+      }
+    }
+    total += n;
+    if (0 != got % sizeof (struct RouteRecord))
+      break;
+  }
+  if (ferror (fh))
+  {
+    fprintf (stderr,
+             "Failed to read `%s': %s\n",
+             filename,
+             strerror (errno));
+    return 1;
+  }
+  if (0 != got % sizeof (struct RouteRecord))
+  {
+    fprintf (stderr,
+             "Invalid route file `%s': route #%llu is truncated\n",
+             filename,
+             (unsigned long long) total);
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Build a FIB from the routes in @a filename, plus the routes to our
+ * connected networks.  The file either lists the routes in the format
+ * of the arguments of "route add", one per line, or it is a binary
+ * route file as written by "route save": #ROUTE_FILE_MAGIC followed by
+ * `struct RouteRecord`s.
+ *
+ * @param filename file to load
+ * @return the new table, NULL on error
+ */
+static struct Fib *
+load_routes (const char *filename)
+{
+  char magic[sizeof (ROUTE_FILE_MAGIC) - 1];
+  struct Fib *f;
+  FILE *fh;
+  int ret = 0;
+
+  fh = fopen (filename,
+              "r");
+  if (NULL == fh)
+  {
+    fprintf (stderr,
+             "Failed to open `%s': %s\n",
+             filename,
+             strerror (errno));
+    return NULL;
+  }
+  f = fib_create_connected ();
+  if ( (sizeof (magic) == fread (magic,
+                                 1,
+                                 sizeof (magic),
+                                 fh)) &&
+       (0 == memcmp (magic,
+                     ROUTE_FILE_MAGIC,
+                     sizeof (magic))) )
+  {
+    ret = load_routes_binary (f,
+                              fh,
+                              filename);
+  }
+  else
+  {
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    unsigned long long lineno = 0;
+
+    rewind (fh);
+    while (-1 != (len = getline (&line,
+                                 &line_size,
+                                 fh)))
+    {
+      lineno++;
+      if ( (len > 0) &&
+           ('\n' == line[len - 1]) )
+        line[len - 1] = '\0';
+      if (0 != load_route_line (f,
+                                line))
+      {
+        fprintf (stderr,
+                 "Invalid route in line %llu of `%s'\n",
+                 lineno,
+                 filename);
+        ret = 1;
+        break;
+      }
+    }
+    free (line);
+  }
+  fclose (fh);
+  if (0 != ret)
+  {
+    fib_destroy (f);
+    return NULL;
+  }
+  return f;
+}
+
+
+/**
+ * Print out the routing table @a f into the output of @a cmd.
+ * Runs in the control thread.
+ *
+ * @param f table to print
+ * @param cmd the "route list" command
+ */
+static void
+route_list (const struct Fib *f,
+            struct RouteCommand *cmd)
+{
+  FILE *out;
+
+  out = open_memstream (&cmd->output,
+                        &cmd->output_size);
+  if (NULL == out)
+    abort ();
+  for (size_t i = 0; i <= f->routes_mask; i++)
+  {
+    const struct Route *r = &f->routes[i];
+    const struct NextHop *nh;
+    struct in_addr network;
+    struct in_addr netmask;
+    char nets[INET_ADDRSTRLEN];
+    char masks[INET_ADDRSTRLEN];
+    char hops[INET_ADDRSTRLEN];
+
+    if (! r->used)
+      continue;
+    nh = &f->next_hops[r->next_hop];
+    network.s_addr = htonl (r->network);
+    netmask.s_addr = htonl (prefix_mask (r->len));
+    inet_ntop (AF_INET,
+               &network,
+               nets,
+               sizeof (nets));
+    inet_ntop (AF_INET,
+               &netmask,
+               masks,
+               sizeof (masks));
+    inet_ntop (AF_INET,
+               &nh->ip,
+               hops,
+               sizeof (hops));
+    fprintf (out,
+             "%s/%s -> %s (%s)\n",
+             nets,
+             masks,
+             hops,
+             nh->ifc->name);
+  }
+  fclose (out);
+}
+
+
+/**
+ * Write the routes of @a f (except those to the connected networks)
+ * to a binary route file (see load_routes()).  Runs in the control
+ * thread.
+ *
+ * @param f table to write
+ * @param filename name of the file
+ */
+static void
+route_save (const struct Fib *f,
+            const char *filename)
+{
+  FILE *fh;
+
+  fh = fopen (filename,
+              "w");
+  if (NULL == fh)
+  {
+    fprintf (stderr,
+             "Failed to open `%s': %s\n",
+             filename,
+             strerror (errno));
+    return;
+  }
+  fwrite (ROUTE_FILE_MAGIC,
+          1,
+          sizeof (ROUTE_FILE_MAGIC) - 1,
+          fh);
+  for (size_t i = 0; i <= f->routes_mask; i++)
+  {
+    const struct Route *r = &f->routes[i];
+    struct RouteRecord rec;
+
+    if ( (! r->used) ||
+         (r->connected) )
+      continue;
+    rec.network.s_addr = htonl (r->network);
+    rec.next_hop = f->next_hops[r->next_hop].ip;
+    rec.ifc_num = htons (f->next_hops[r->next_hop].ifc->ifc_num);
+    rec.len = r->len;
+    fwrite (&rec,
+            sizeof (rec),
+            1,
+            fh);
+  }
+  if (0 != fclose (fh))
+    fprintf (stderr,
+             "Failed to write `%s': %s\n",
+             filename,
+             strerror (errno));
+}
+
+
+/**
+ * Apply the route change @a cmd to @a f.
+ *
+ * @param f table to change
+ * @param cmd a #ROUTE_OP_ADD or #ROUTE_OP_DEL command
+ * @param report true to report errors
+ * @return true if @a f changed
+ */
+static bool
+route_change (struct Fib *f,
+              const struct RouteCommand *cmd,
+              bool report)
+{
+  if (ROUTE_OP_ADD == cmd->op)
+  {
+    if (0 == fib_add (f,
+                      cmd->network,
+                      cmd->len,
+                      cmd->next_hop,
+                      cmd->ifc,
+                      false))
+      return true;
+    if (report)
+      fprintf (stderr,
+               "Cannot change the route to a connected network\n");
+    return false;
+  }
+  switch (fib_del (f,
+                   cmd->network,
+                   cmd->len,
+                   cmd->next_hop,
+                   cmd->ifc))
+  {
+  case 0:
+    return true;
+  case 1:
+    if (report)
+      fprintf (stderr,
+               "No such route\n");
+    break;
+  case 2:
+    if (report)
+      fprintf (stderr,
+               "Cannot delete the route to a connected network\n");
+    break;
+  }
+  return false;
+}
+
+
+/**
+ * Publish the route additions and deletions from @a first up to (but
+ * excluding) @a end, which were already applied to #shadow.  Once
+ * the forwarding thread has moved on, the changes are applied to the
+ * previous table as well, which becomes the new #shadow.  Runs in
+ * the control thread.
+ *
+ * @param first first command to publish
+ * @param end command after the last one to publish, NULL for all
+ * @param changed true if any of them changed #shadow
+ */
+static void
+control_commit (struct RouteCommand *first,
+                const struct RouteCommand *end,
+                bool changed)
+{
+  struct Fib *old;
+
+  if (! changed)
+    return;
+  old = fib_publish (shadow);
+  for (struct RouteCommand *cmd = first; end != cmd; cmd = cmd->next)
+    if ( (ROUTE_OP_ADD == cmd->op) ||
+         (ROUTE_OP_DEL == cmd->op) )
+      (void) route_change (old,
+                           cmd,
+                           false);
+  shadow = old;
+}
+
+
+/**
+ * Run a batch of route commands.  Consecutive additions and deletions
+ * are made to #shadow and published in one step.  They are published
+ * before any other command runs, which then uses the published
+ * table, so that a long "route list" or "route save" never delays
+ * the changes that preceded it.  Runs in the control thread.
+ *
+ * @param batch list of commands to run
+ */
+static void
+run_batch (struct RouteCommand *batch)
+{
+  struct RouteCommand *first = batch;
+  bool changed = false;
+
+  for (struct RouteCommand *cmd = batch; NULL != cmd; cmd = cmd->next)
+  {
+    if ( (ROUTE_OP_ADD == cmd->op) ||
+         (ROUTE_OP_DEL == cmd->op) )
+    {
+      if (route_change (shadow,
+                        cmd,
+                        true))
+        changed = true;
+      continue;
+    }
+    control_commit (first,
+                    cmd,
+                    changed);
+    first = cmd->next;
+    changed = false;
+    switch (cmd->op)
+    {
+    case ROUTE_OP_LIST:
+      route_list (atomic_load (&fib),
+                  cmd);
+      break;
+    case ROUTE_OP_LOAD:
+      {
+        struct Fib *f = load_routes (cmd->filename);
+
+        if (NULL == f)
+          break;
+        fib_destroy (fib_publish (f));
+        fib_destroy (shadow);
+        shadow = fib_clone (f);
+      }
+      break;
+    case ROUTE_OP_SAVE:
+      route_save (atomic_load (&fib),
+                  cmd->filename);
+      break;
+    default:
+      abort ();
+    }
+  }
+  control_commit (first,
+                  NULL,
+                  changed);
+}
+
+
+/**
+ * Main function of the control thread: runs the queued route
+ * commands, taking all commands queued so far as one batch.
+ *
+ * @param cls unused
+ * @return NULL
+ */
+static void *
+control_thread (void *cls)
+{
+  (void) cls;
+  pthread_mutex_lock (&ctl.lock);
+  while (1)
+  {
+    struct RouteCommand *batch;
+
+    while ( (NULL == ctl.head) &&
+            (! ctl.quit) )
+      pthread_cond_wait (&ctl.cond,
+                         &ctl.lock);
+    if (NULL == ctl.head)
+      break;
+    batch = ctl.head;
+    ctl.head = NULL;
+    ctl.tail = &ctl.head;
+    pthread_mutex_unlock (&ctl.lock);
+    run_batch (batch);
+    pthread_mutex_lock (&ctl.lock);
+    while (NULL != batch)
+    {
+      struct RouteCommand *cmd = batch;
+
+      batch = cmd->next;
+      if (ROUTE_OP_LIST == cmd->op)
+      {
+        cmd->next = NULL;
+        *ctl.done_tail = cmd;
+        ctl.done_tail = &cmd->next;
+        ctl.pending_output--;
+        continue;
+      }
+      free (cmd->filename);
+      free (cmd);
+    }
+  }
+  pthread_mutex_unlock (&ctl.lock);
+  return NULL;
+}
+
+
+/**
+ * Replace all routes (except those to the connected networks) by the
+ * routes in a file.  The new table is built on the side by the
+ * control thread, so the old routes remain in use if the file is
+ * invalid.
+ *
+ * @param op #ROUTE_OP_LOAD or #ROUTE_OP_SAVE
+ */
+static void
+process_cmd_route_file (enum RouteOp op)
+{
+  const char *filename = strtok (NULL, " ");
+  struct RouteCommand *cmd;
+
+  if (NULL == filename)
+  {
+    fprintf (stderr,
+             "No file name provided\n");
+    return;
+  }
+  cmd = control_command (op);
+  cmd->filename = strdup (filename);
+  if (NULL == cmd->filename)
+    abort ();
+  control_submit (cmd);
+}
+
+
+/**
+ * The user entered a "route" command.  The remaining
+ * arguments can be obtained via 'strtok()'.
+ */
+static void
+process_cmd_route ()
+{
+  char *subcommand = strtok (NULL, " ");
+
+  if (NULL == subcommand)
+    subcommand = "list";
+  if (0 == strcasecmp ("add",
+                       subcommand))
+    process_cmd_route_change (ROUTE_OP_ADD);
+  else if (0 == strcasecmp ("del",
+                            subcommand))
+    process_cmd_route_change (ROUTE_OP_DEL);
+  else if (0 == strcasecmp ("list",
+                            subcommand))
+    control_submit (control_command (ROUTE_OP_LIST));
+  else if (0 == strcasecmp ("load",
+                            subcommand))
+    process_cmd_route_file (ROUTE_OP_LOAD);
+  else if (0 == strcasecmp ("save",
+                            subcommand))
+    process_cmd_route_file (ROUTE_OP_SAVE);
+  else
+    fprintf (stderr,
+             "Subcommand `%s' not understood\n",
+             subcommand);
+}
+
+
+/**
+ * Parse network specification in @a net, initializing @a ifc.
+ * Format of @a net is "IPV4:IP/NETMASK".
+ *
+ * @param ifc[out] interface specification to initialize
+ * @param arg interface specification to parse
+ * @return 0 on success
+ */
+static int
+parse_network_arg (struct Interface *ifc,
+                   const char *net)
+{
+  if (0 !=
+      strncasecmp (net,
+                   "IPV4:",
+                   strlen ("IPV4:")))
+  {
+    fprintf (stderr,
+             "Interface specification `%s' does not start with `IPV4:'\n",
+             net);
+    return 1;
+  }
+  net += strlen ("IPV4:");
+  return parse_network (&ifc->ip,
+                        &ifc->netmask,
+                        net);
+}
+
+
+/**
+ * Parse interface specification @a arg and update @a ifc.  Format is
+ * "IFCNAME[IPV4:IP/NETMASK]=MTU".  The "=MTU" is optional.
+ *
+ * @param ifc[out] interface specification to initialize
+ * @param arg interface specification to parse
+ * @return 0 on success
+ */
+static int
+parse_cmd_arg (struct Interface *ifc,
+               const char *arg)
+{
+  const char *tok;
+  char *nspec;
+
+  ifc->mtu = 1500 + sizeof (struct EthernetHeader); /* default in case unspecified */
+  tok = strchr (arg, '[');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in interface specification: lacks '['");
+    return 1;
+  }
+  ifc->name = strndup (arg,
+                       tok - arg);
+  arg = tok + 1;
+  tok = strchr (arg, ']');
+  if (NULL == tok)
+  {
+    fprintf (stderr,
+             "Error in interface specification: lacks ']'");
+    return 1;
+  }
+  nspec = strndup (arg,
+                   tok - arg);
+  if (0 !=
+      parse_network_arg (ifc,
+                         nspec))
+  {
+    free (nspec);
+    return 1;
+  }
+  free (nspec);
+  arg = tok + 1;
+  if ('=' == arg[0])
+  {
+    unsigned int mtu;
+
+    if (1 != (sscanf (&arg[1],
+                      "%u",
+                      &mtu)))
+    {
+      fprintf (stderr,
+               "Error in interface specification: MTU not a number\n");
+      return 1;
+    }
+    if (mtu < 400)
+    {
+      fprintf (stderr,
+               "Error in interface specification: MTU too small\n");
+      return 1;
+    }
+    if (mtu > UINT16_MAX)
+    {
+      fprintf (stderr,
+               "Error in interface specification: MTU too large\n");
+      return 1;
+    }
+    ifc->mtu = mtu + sizeof (struct EthernetHeader);
+#if DEBUG
+    fprintf (stderr,
+             "Interface %s has MTU %u\n",
+             ifc->name,
+             (unsigned int) ifc->mtu);
+#endif
+  }
+  return 0;
+}
+
+
+/**
+ * Handle control message @a cmd.
+ *
+ * @param cmd text the user entered
+ * @param cmd_len length of @a cmd
+ */
+static void
+handle_control (char *cmd,
+                size_t cmd_len)
+{
+  const char *tok;
+
+  cmd[cmd_len - 1] = '\0';
+  tok = strtok (cmd,
+                " ");
+  if (NULL == tok)
+    return;
+  if (0 == strcasecmp (tok,
+                       "arp"))
+    process_cmd_arp ();
+  else if (0 == strcasecmp (tok,
+                            "route"))
+    process_cmd_route ();
+  else
+    fprintf (stderr,
+             "Unsupported command `%s'\n",
+             tok);
+}
+
+
+/**
+ * Handle MAC information @a mac
+ *
+ * @param ifc_num number of the interface with @a mac
+ * @param mac the MAC address at @a ifc_num
+ */
+static void
+handle_mac (uint16_t ifc_num,
+            const struct MacAddress *mac)
+{
+  if (ifc_num > num_ifc)
+    abort ();
+  gifc[ifc_num - 1].mac = *mac;
+  arp_cache_mac (ifc_num,
+                 mac);
+}
+
+
+/**
+ * Launches the router.
+ *
+ * @param argc number of arguments in @a argv
+ * @param argv binary name, followed by options ("--routes=FILE" to
+ *        load the routes of FILE, see load_routes(); "--arp-reachable=MS"
+ *        to set how long ARP entries stay fresh, see arp_cache_init()),
+ *        followed by list of interfaces to route between
+ * @return not really
+ */
+int
+main (int argc,
+      char **argv)
+{
+  struct Interface ifc[argc];
+
+  const char *routes = NULL;
+  unsigned int reachable = 0;
+  int first = 1;
+
+  while ( (first < argc) &&
+          (0 == strncmp (argv[first],
+                         "--",
+                         2)) )
+  {
+    if (0 == strncmp (argv[first],
+                      "--routes=",
+                      strlen ("--routes=")))
+    {
+      routes = &argv[first][strlen ("--routes=")];
+    }
+    else if (0 == strncmp (argv[first],
+                           "--arp-reachable=",
+                           strlen ("--arp-reachable=")))
+    {
+      reachable = strtoul (&argv[first][strlen ("--arp-reachable=")],
+                           NULL,
+                           10);
+    }
+    else
+    {
+      fprintf (stderr,
+               "Unsupported option `%s'\n",
+               argv[first]);
+      return 1;
+    }
+    first++;
+  }
+  memset (ifc,
+          0,
+          sizeof (ifc));
+  num_ifc = argc - first;
+  gifc = ifc;
+  if (0 != arp_cache_init (num_ifc,
+                           reachable))
+  {
+    perror ("calloc");
+    return 1;
+  }
+  for (unsigned int i = 1; i<=num_ifc; i++)
+  {
+    struct Interface *p = &ifc[i - 1];
+
+    ifc[i - 1].ifc_num = i;
+    if (0 !=
+        parse_cmd_arg (p,
+                       argv[first + i - 1]))
+      abort ();
+    arp_cache_interface (i,
+                         p->name,
+                         p->ip);
+  }
+  if (NULL == routes)
+    shadow = fib_create_connected ();
+  else if (NULL == (shadow = load_routes (routes)))
+    return 1;
+  atomic_store (&fib,
+                fib_clone (shadow));
+  if (0 != pthread_create (&ctl.thread,
+                           NULL,
+                           &control_thread,
+                           NULL))
+  {
+    fprintf (stderr,
+             "Failed to start the control thread\n");
+    return 1;
+  }
+  loop (&handle_frame,
+        &handle_control,
+        &handle_mac);
+  pthread_mutex_lock (&ctl.lock);
+  ctl.quit = true;
+  pthread_cond_signal (&ctl.cond);
+  pthread_mutex_unlock (&ctl.lock);
+  pthread_join (ctl.thread,
+                NULL);
+  /* print the output of the last commands */
+  timer_cancel (&ctl.poll);
+  control_poll (&ctl.poll);
+  fib_destroy (atomic_load (&fib));
+  fib_destroy (shadow);
+  for (unsigned int i = 1; i<=num_ifc; i++)
+    free (ifc[i - 1].name);
+  arp_cache_destroy ();
+  return 0;
+}
@@ -0,0 +1,919 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file test-arp.c
+ * @brief Testcase for the ARP cache of the 'arp' tool.  Must be linked
+ *        with harness.c.
+ */
+#include "harness.h"
+
+/**
+ * Set to 1 to enable debug statments.
+ */
+#define DEBUG 0
+
+/**
+ * How long (in ms) the tool under test considers neighbours reachable
+ * in the timing tests.  With the scaling of arp-cache.c, a used entry
+ * is refreshed after 1 s and an unused one becomes stale after 1 s
+ * and is forgotten after 3.6 s.
+ */
+#define REACHABLE_MS 1200
+
+/**
+ * Mirrors ARP_CACHE_BITS of arp-cache.c.
+ */
+#define ARP_CACHE_BITS 17
+
+/**
+ * Mirrors ARP_PROBE_WINDOW of arp-cache.c.
+ */
+#define ARP_PROBE_WINDOW 8
+
+
+/**
+ * An ARP message in an Ethernet frame.
+ */
+struct ArpFrame
+{
+  struct EthernetHeader eh;
+  struct ArpHeaderEthernetIPv4 arp;
+};
+
+
+/**
+ * Interfaces of the tool; there is one neighbour (".2") in each
+ * network.
+ */
+static char *ifcs[] = {
+  "eth0[IPV4:10.0.0.1/8]",
+  "eth1[IPV4:192.168.0.1/16]"
+};
+
+/**
+ * IP addresses of the tool on the interfaces in #ifcs.
+ */
+static const char *our_ips[] = {
+  "10.0.0.1",
+  "192.168.0.1"
+};
+
+/**
+ * IP addresses of the neighbours on the interfaces in #ifcs.
+ */
+static const char *neighbour_ips[] = {
+  "10.0.0.2",
+  "192.168.0.2"
+};
+
+
+/**
+ * Get the MAC of neighbour number @a n on interface @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param n number of the neighbour on @a ifc_num
+ * @param mac[out] set to the MAC
+ */
+static void
+neighbour_mac (uint16_t ifc_num,
+               uint8_t n,
+               struct MacAddress *mac)
+{
+  memset (mac,
+          0,
+          sizeof (*mac));
+  mac->mac[0] = 0x02;
+  mac->mac[4] = n;
+  mac->mac[5] = (uint8_t) ifc_num;
+}
+
+
+/**
+ * Parse IPv4 address @a s.
+ *
+ * @param s address to parse
+ * @return the address
+ */
+static struct in_addr
+ip (const char *s)
+{
+  struct in_addr a;
+
+  if (1 != inet_pton (AF_INET,
+                      s,
+                      &a))
+    abort ();
+  return a;
+}
+
+
+/**
+ * Format the line of the "arp" dump for neighbour number @a n with
+ * address @a a on interface @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param n number of the neighbour on @a ifc_num
+ * @param a IPv4 address of the neighbour
+ * @param line[out] where to write the line
+ * @param line_size number of bytes in @a line
+ */
+static void
+dump_line (uint16_t ifc_num,
+           uint8_t n,
+           struct in_addr a,
+           char *line,
+           size_t line_size)
+{
+  struct MacAddress mac;
+  char ips[INET_ADDRSTRLEN];
+
+  neighbour_mac (ifc_num,
+                 n,
+                 &mac);
+  inet_ntop (AF_INET,
+             &a,
+             ips,
+             sizeof (ips));
+  snprintf (line,
+            line_size,
+            "%s -> %02x:%02x:%02x:%02x:%02x:%02x (eth%u)",
+            ips,
+            mac.mac[0], mac.mac[1], mac.mac[2],
+            mac.mac[3], mac.mac[4], mac.mac[5],
+            (unsigned int) (ifc_num - 1));
+}
+
+
+/**
+ * Send control command @a cmd to the tool.
+ *
+ * @param cmd command to send, without the newline
+ * @return 0
+ */
+static int
+control (const char *cmd)
+{
+  char buf[strlen (cmd) + 1];
+
+  memcpy (buf,
+          cmd,
+          strlen (cmd));
+  buf[strlen (cmd)] = '\n';
+  tsend (0,
+         buf,
+         sizeof (buf));
+  return 0;
+}
+
+
+/**
+ * Send an ARP message from neighbour number @a n with address @a a
+ * on interface @a ifc_num to the tool.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param n number of the neighbour on @a ifc_num
+ * @param a IPv4 address of the neighbour
+ * @param oper #ARP_OP_REQUEST or #ARP_OP_REPLY
+ */
+static void
+send_arp (uint16_t ifc_num,
+          uint8_t n,
+          struct in_addr a,
+          uint16_t oper)
+{
+  struct ArpFrame af;
+
+  memset (&af,
+          0,
+          sizeof (af));
+  if (ARP_OP_REQUEST == oper)
+  {
+    memset (&af.eh.dst,
+            0xFF,
+            sizeof (af.eh.dst));
+  }
+  else
+  {
+    set_dest_mac (&af,
+                  ifc_num);
+    af.arp.target_ha = af.eh.dst;
+  }
+  neighbour_mac (ifc_num,
+                 n,
+                 &af.eh.src);
+  af.eh.tag = htons (ETH_P_ARP);
+  af.arp.htype = htons (ARP_HTYPE_ETHERNET);
+  af.arp.ptype = htons (ARP_PTYPE_IPV4);
+  af.arp.hlen = MAC_ADDR_SIZE;
+  af.arp.plen = sizeof (struct in_addr);
+  af.arp.oper = htons (oper);
+  af.arp.sender_ha = af.eh.src;
+  af.arp.sender_pa = a;
+  af.arp.target_pa = ip (our_ips[ifc_num - 1]);
+  tsend (ifc_num,
+         &af,
+         sizeof (af));
+}
+
+
+/**
+ * We expect an ARP message with operation @a cls2 on interface
+ * @a cls3, sent to @a cls1 (NULL for broadcast).  Control output is
+ * a missmatch.
+ *
+ * @param cls closure
+ * @param ifc interface we got a frame from
+ * @param msg frame we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 MAC the frame must be sent to, NULL for broadcast
+ * @param cls2 expected operation
+ * @param cls3 interface we expect to receive from
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_arp (void *cls,
+            uint16_t ifc,
+            const void *msg,
+            size_t msg_len,
+            const void *cls1,
+            ssize_t cls2,
+            uint16_t cls3)
+{
+  static const struct MacAddress broadcast = {
+    .mac = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+  };
+  const struct MacAddress *dst = (NULL == cls1) ? &broadcast : cls1;
+  struct ArpFrame af;
+
+  if ( (ifc != cls3) ||
+       (msg_len < sizeof (af)) )
+    return 1;
+  memcpy (&af,
+          msg,
+          sizeof (af));
+  if ( (ETH_P_ARP != ntohs (af.eh.tag)) ||
+       (cls2 != ntohs (af.arp.oper)) ||
+       (0 != memcmp (&af.eh.dst,
+                     dst,
+                     sizeof (*dst))) )
+  {
+#if DEBUG
+    fprintf (stderr,
+             "Unexpected ARP message on %u\n",
+             (unsigned int) ifc);
+#endif
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Have neighbour number @a n with address @a a on @a ifc_num ask the
+ * tool for its MAC, so that the tool learns the MAC of the neighbour.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param n number of the neighbour on @a ifc_num
+ * @param a IPv4 address of the neighbour
+ * @return 0 on success
+ */
+static int
+learn (uint16_t ifc_num,
+       uint8_t n,
+       struct in_addr a)
+{
+  struct MacAddress mac;
+
+  send_arp (ifc_num,
+            n,
+            a,
+            ARP_OP_REQUEST);
+  neighbour_mac (ifc_num,
+                 n,
+                 &mac);
+  return trecv (0,
+                &expect_arp,
+                NULL,
+                &mac,
+                ARP_OP_REPLY,
+                ifc_num);
+}
+
+
+/**
+ * Have the tool learn the neighbour on @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @return 0 on success
+ */
+static int
+learn_neighbour (uint16_t ifc_num)
+{
+  return learn (ifc_num,
+                0,
+                ip (neighbour_ips[ifc_num - 1]));
+}
+
+
+/**
+ * State of expect_lines().
+ */
+struct Lines
+{
+  /**
+   * Lines we expect, in any order.
+   */
+  const char **lines;
+
+  /**
+   * Number of entries in @e lines.
+   */
+  unsigned int num_lines;
+
+  /**
+   * Bitmap of the @e lines we got already.
+   */
+  uint64_t seen;
+};
+
+
+/**
+ * We expect control output with one of the lines of @a cls that we
+ * did not get yet.
+ *
+ * @param cls a `struct Lines`
+ * @param ifc interface we got a frame from
+ * @param msg text we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 unused
+ * @param cls2 unused
+ * @param cls3 unused
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_lines (void *cls,
+              uint16_t ifc,
+              const void *msg,
+              size_t msg_len,
+              const void *cls1,
+              ssize_t cls2,
+              uint16_t cls3)
+{
+  struct Lines *l = cls;
+
+  if (0 != ifc)
+    return 1;
+  for (unsigned int i = 0; i<l->num_lines; i++)
+  {
+    if (0 != (l->seen & (1LLU << i)))
+      continue;
+    if (NULL == memmem (msg,
+                        msg_len,
+                        l->lines[i],
+                        strlen (l->lines[i])))
+      continue;
+    l->seen |= (1LLU << i);
+    return 0;
+  }
+#if DEBUG
+  fprintf (stderr,
+           "Unexpected output `%.*s'\n",
+           (int) msg_len,
+           (const char *) msg);
+#endif
+  return 1;
+}
+
+
+/**
+ * Expect the tool to output all of @a lines (in any order).
+ *
+ * @param lines lines to expect
+ * @param num_lines number of entries in @a lines
+ * @return 0 on success
+ */
+static int
+expect_all_lines (const char **lines,
+                  unsigned int num_lines)
+{
+  struct Lines l = {
+    .lines = lines,
+    .num_lines = num_lines
+  };
+
+  for (unsigned int i = 0; i<num_lines; i++)
+    if (0 != trecv (0,
+                    &expect_lines,
+                    &l,
+                    NULL,
+                    0,
+                    0))
+      return 1;
+  return 0;
+}
+
+
+/**
+ * State of expect_request_or_mac().
+ */
+struct RequestOrMac
+{
+  /**
+   * MAC the request must be sent to, and the tool must print.
+   */
+  struct MacAddress mac;
+
+  /**
+   * Did we get the request?
+   */
+  bool request;
+
+  /**
+   * Did we get the MAC?
+   */
+  bool output;
+};
+
+
+/**
+ * We expect a unicast ARP request on interface @a cls3 or the MAC of
+ * the neighbour as control output, whichever of the two we did not
+ * get yet.
+ *
+ * @param cls a `struct RequestOrMac`
+ * @param ifc interface we got a frame from
+ * @param msg message we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 unused
+ * @param cls2 unused
+ * @param cls3 interface we expect the request on
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_request_or_mac (void *cls,
+                       uint16_t ifc,
+                       const void *msg,
+                       size_t msg_len,
+                       const void *cls1,
+                       ssize_t cls2,
+                       uint16_t cls3)
+{
+  struct RequestOrMac *rm = cls;
+  const uint8_t *m = rm->mac.mac;
+  char line[sizeof ("00:00:00:00:00:00")];
+
+  if (0 != ifc)
+  {
+    if ( (rm->request) ||
+         (0 != expect_arp (NULL,
+                           ifc,
+                           msg,
+                           msg_len,
+                           &rm->mac,
+                           ARP_OP_REQUEST,
+                           cls3)) )
+      return 1;
+    rm->request = true;
+    return 0;
+  }
+  snprintf (line,
+            sizeof (line),
+            "%02x:%02x:%02x:%02x:%02x:%02x",
+            m[0], m[1], m[2], m[3], m[4], m[5]);
+  if ( (rm->output) ||
+       (NULL == memmem (msg,
+                        msg_len,
+                        line,
+                        strlen (line))) )
+    return 1;
+  rm->output = true;
+  return 0;
+}
+
+
+/**
+ * Run the commands in @a cmd against the tool @a prog.
+ *
+ * @param prog command to test
+ * @param option option to pass to the tool, NULL for none
+ * @param cmd commands to run
+ * @return 0 on success, non-zero on failure
+ */
+static int
+run_arp (const char *prog,
+         char *option,
+         struct Command *cmd)
+{
+  char *argv[] = {
+    (char *) prog,
+    option,
+    ifcs[0],
+    ifcs[1],
+    NULL
+  };
+
+  int argc = (sizeof (argv) / sizeof (char *)) - 1;
+
+  if (NULL == option)
+  {
+    /* no option, move the interfaces up */
+    memmove (&argv[1],
+             &argv[2],
+             (argc - 1) * sizeof (char *));
+    argc--;
+  }
+  return meta (cmd,
+               argc,
+               argv);
+}
+
+
+/**
+ * Run test with @a prog.  "arp" lists the neighbours the tool
+ * learned, one per line.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_dump (const char *prog)
+{
+  char lines[2][64];
+  const char *want[] = { lines[0], lines[1] };
+  int
+  learn_neighbours ()
+  {
+    for (uint16_t i = 1; i <= 2; i++)
+      if (0 != learn_neighbour (i))
+        return 1;
+    return 0;
+  };
+  int
+  dump ()
+  {
+    return control ("arp");
+  };
+  int
+  expect_dump ()
+  {
+    return expect_all_lines (want,
+                             2);
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "dump cache", &dump },
+    { "expect neighbours", &expect_dump },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  for (uint16_t i = 1; i <= 2; i++)
+    dump_line (i,
+               0,
+               ip (neighbour_ips[i - 1]),
+               lines[i - 1],
+               sizeof (lines[i - 1]));
+  return run_arp (prog,
+                  NULL,
+                  cmd);
+}
+
+
+/**
+ * Run test with @a prog.  An entry that is not used ages to STALE;
+ * the tool still answers with its MAC, but asks the neighbour
+ * (unicast) to confirm it.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_stale (const char *prog)
+{
+  char option[64];
+  struct RequestOrMac rm;
+  int
+  learn_eth0 ()
+  {
+    return learn_neighbour (1);
+  };
+  int
+  age ()
+  {
+    /* past the reachable time, but well before we forget it */
+    usleep (REACHABLE_MS * 1250);
+    return 0;
+  };
+  int
+  use ()
+  {
+    char cmd[64];
+
+    snprintf (cmd,
+              sizeof (cmd),
+              "arp %s eth0",
+              neighbour_ips[0]);
+    return control (cmd);
+  };
+  int
+  expect_confirm ()
+  {
+    if (0 != trecv (0,
+                    &expect_request_or_mac,
+                    &rm,
+                    NULL,
+                    0,
+                    1))
+      return 1;
+    return trecv (0,
+                  &expect_request_or_mac,
+                  &rm,
+                  NULL,
+                  0,
+                  1);
+  };
+  int
+  confirm ()
+  {
+    send_arp (1,
+              0,
+              ip (neighbour_ips[0]),
+              ARP_OP_REPLY);
+    return 0;
+  };
+  struct Command cmd[] = {
+    { "learn neighbour", &learn_eth0 },
+    { "let entry age", &age },
+    { "use stale entry", &use },
+    { "expect MAC and unicast request", &expect_confirm },
+    { "confirm address", &confirm },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  memset (&rm,
+          0,
+          sizeof (rm));
+  neighbour_mac (1,
+                 0,
+                 &rm.mac);
+  snprintf (option,
+            sizeof (option),
+            "--arp-reachable=%u",
+            REACHABLE_MS);
+  return run_arp (prog,
+                  option,
+                  cmd);
+}
+
+
+/**
+ * Run test with @a prog.  An entry that is used is refreshed (with
+ * a unicast request) before it stops being reachable, without any
+ * further use.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_refresh (const char *prog)
+{
+  char option[64];
+  struct RequestOrMac rm;
+  int
+  learn_eth1 ()
+  {
+    return learn_neighbour (2);
+  };
+  int
+  use ()
+  {
+    char cmd[64];
+
+    snprintf (cmd,
+              sizeof (cmd),
+              "arp %s eth1",
+              neighbour_ips[1]);
+    return control (cmd);
+  };
+  int
+  expect_mac ()
+  {
+    /* the entry is reachable, so we get the MAC without a request */
+    rm.request = true;
+    return trecv (0,
+                  &expect_request_or_mac,
+                  &rm,
+                  NULL,
+                  0,
+                  2);
+  };
+  int
+  expect_refresh ()
+  {
+    return trecv (0,
+                  &expect_arp,
+                  NULL,
+                  &rm.mac,
+                  ARP_OP_REQUEST,
+                  2);
+  };
+  int
+  confirm ()
+  {
+    send_arp (2,
+              0,
+              ip (neighbour_ips[1]),
+              ARP_OP_REPLY);
+    return 0;
+  };
+  struct Command cmd[] = {
+    { "learn neighbour", &learn_eth1 },
+    { "use entry", &use },
+    { "expect MAC", &expect_mac },
+    { "expect refresh request", &expect_refresh },
+    { "confirm address", &confirm },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  memset (&rm,
+          0,
+          sizeof (rm));
+  neighbour_mac (2,
+                 0,
+                 &rm.mac);
+  snprintf (option,
+            sizeof (option),
+            "--arp-reachable=%u",
+            REACHABLE_MS);
+  return run_arp (prog,
+                  option,
+                  cmd);
+}
+
+
+/**
+ * Compute the first slot of the probe window of the ARP cache for
+ * @a a on interface @a ifc_num, like arp-cache.c does.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param a IPv4 address of the neighbour
+ * @return slot index
+ */
+static uint32_t
+arp_home (uint16_t ifc_num,
+          struct in_addr a)
+{
+  uint64_t key = ((uint64_t) a.s_addr << 16) | ifc_num;
+
+  return (key * 0x9E3779B97F4A7C15LLU) >> (64 - ARP_CACHE_BITS);
+}
+
+
+/**
+ * Run test with @a prog.  When more neighbours than fit into the
+ * probe window share a slot, the one that confirmed its address the
+ * longest time ago is evicted.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_evict (const char *prog)
+{
+  struct in_addr addrs[ARP_PROBE_WINDOW + 1];
+  char lines[ARP_PROBE_WINDOW][64];
+  const char *want[ARP_PROBE_WINDOW];
+  int
+  learn_oldest ()
+  {
+    if (0 != learn (1,
+                    0,
+                    addrs[0]))
+      return 1;
+    /* make sure the others are confirmed later */
+    usleep (20 * 1000);
+    return 0;
+  };
+  int
+  learn_others ()
+  {
+    for (unsigned int i = 1; i <= ARP_PROBE_WINDOW; i++)
+      if (0 != learn (1,
+                      (uint8_t) i,
+                      addrs[i]))
+        return 1;
+    return 0;
+  };
+  int
+  dump ()
+  {
+    return control ("arp");
+  };
+  int
+  expect_dump ()
+  {
+    return expect_all_lines (want,
+                             ARP_PROBE_WINDOW);
+  };
+  struct Command cmd[] = {
+    { "learn oldest neighbour", &learn_oldest },
+    { "learn other neighbours", &learn_others },
+    { "dump cache", &dump },
+    { "expect all but the oldest", &expect_dump },
+    { "end", &expect_silence },
+    { NULL }
+  };
+  uint32_t home;
+  unsigned int n = 0;
+
+  /* find neighbours in 10.0.0.0/8 that all hash to the same slot */
+  addrs[0] = ip ("10.1.0.1");
+  home = arp_home (1,
+                   addrs[0]);
+  for (uint32_t h = ntohl (addrs[0].s_addr) + 1;
+       n < ARP_PROBE_WINDOW;
+       h++)
+  {
+    struct in_addr a = { .s_addr = htonl (h) };
+
+    if (arp_home (1,
+                  a) != home)
+      continue;
+    addrs[++n] = a;
+    dump_line (1,
+               (uint8_t) n,
+               a,
+               lines[n - 1],
+               sizeof (lines[n - 1]));
+    want[n - 1] = lines[n - 1];
+  }
+  return run_arp (prog,
+                  NULL,
+                  cmd);
+}
+
+
+/**
+ * Call with path to the arp program to test.
+ */
+int
+main (int argc,
+      char **argv)
+{
+  unsigned int grade = 0;
+  unsigned int possible = 0;
+  struct Test
+  {
+    const char *name;
+    int (*fun)(const char *arg);
+  } tests[] = {
+    { "dump cache", &test_dump },
+    { "entries age to stale", &test_stale },
+    { "used entries are refreshed", &test_refresh },
+    { "oldest entry is evicted", &test_evict },
+    { NULL, NULL }
+  };
+
+  if (argc != 2)
+  {
+    fprintf (stderr,
+             "Call with ARP to test as 1st argument!\n");
+    return 1;
+  }
+  for (unsigned int i = 0; NULL != tests[i].fun; i++)
+  {
+    if (0 == tests[i].fun (argv[1]))
+      grade++;
+    else
+      fprintf (stdout,
+               "Failed test `%s'\n",
+               tests[i].name);
+    possible++;
+  }
+  fprintf (stdout,
+           "Final grade: %u/%u\n",
+           grade,
+           possible);
+  return grade == possible ? 0 : 1;
+}
+
+
+/* end of test-arp.c */
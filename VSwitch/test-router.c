@@ -0,0 +1,1177 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file test-router.c
+ * @brief Testcase for the 'router'.  Must be linked with harness.c.
+ */
+#include "harness.h"
+
+/**
+ * Set to 1 to enable debug statments.
+ */
+#define DEBUG 0
+
+/**
+ * Number of bytes of UDP payload in the packets we route.
+ */
+#define PAYLOAD_SIZE 64
+
+/**
+ * Interface our packets arrive on (eth3).
+ */
+#define SRC_IFC 4
+
+/**
+ * Magic number at the start of a binary route file.
+ */
+#define ROUTE_FILE_MAGIC "GLABFIB1"
+
+/**
+ * Line of "route list" for the connected network of eth0, which is
+ * always in the table.
+ */
+#define CONNECTED_ROUTE "10.0.0.0/255.0.0.0 -> 0.0.0.0 (eth0)"
+
+
+/**
+ * Standard IPv4 header.
+ */
+struct IPv4Header
+{
+  uint8_t version_and_header_length;
+  uint8_t diff_serv;
+  uint16_t total_length;
+  uint16_t identification;
+  uint16_t fragmentation_info;
+  uint8_t ttl;
+  uint8_t protocol;
+  uint16_t checksum;
+  struct in_addr source_address;
+  struct in_addr destination_address;
+};
+
+
+/**
+ * Route in a binary route file.
+ */
+struct RouteRecord
+{
+  struct in_addr network;
+  struct in_addr next_hop;
+
+  /**
+   * Number of the interface, in big-endian format.
+   */
+  uint16_t ifc_num;
+  uint8_t len;
+};
+
+
+/**
+ * An IPv4 packet in an Ethernet frame.
+ */
+struct IPFrame
+{
+  struct EthernetHeader eh;
+  struct IPv4Header ip;
+  uint8_t payload[PAYLOAD_SIZE];
+};
+
+
+/**
+ * An ARP message in an Ethernet frame.
+ */
+struct ArpFrame
+{
+  struct EthernetHeader eh;
+  struct ArpHeaderEthernetIPv4 arp;
+};
+
+
+/**
+ * Interfaces of the router; we send from a host behind eth3, and
+ * there is one neighbour (".2") in each network.
+ */
+static char *ifcs[] = {
+  "eth0[IPV4:10.0.0.1/8]",
+  "eth1[IPV4:192.168.0.1/16]",
+  "eth2[IPV4:14.25.59.1/24]",
+  "eth3[IPV4:172.16.0.1/16]"
+};
+
+/**
+ * IP addresses of the router on the interfaces in #ifcs.
+ */
+static const char *router_ips[] = {
+  "10.0.0.1",
+  "192.168.0.1",
+  "14.25.59.1",
+  "172.16.0.1"
+};
+
+/**
+ * IP addresses of the neighbours on the interfaces in #ifcs.
+ */
+static const char *neighbour_ips[] = {
+  "10.0.0.2",
+  "192.168.0.2",
+  "14.25.59.2",
+  "172.16.0.2"
+};
+
+/**
+ * The last packet we sent to the router.
+ */
+static struct IPFrame sent;
+
+
+/**
+ * Get the MAC of the neighbour on interface @a ifc_num.
+ *
+ * @param ifc_num interface of the neighbour
+ * @param mac[out] set to the MAC
+ */
+static void
+neighbour_mac (uint16_t ifc_num,
+               struct MacAddress *mac)
+{
+  memset (mac,
+          0,
+          sizeof (*mac));
+  mac->mac[0] = 0x02;
+  mac->mac[5] = (uint8_t) ifc_num;
+}
+
+
+/**
+ * Get the MAC of the router on interface @a ifc_num.
+ *
+ * @param ifc_num interface of the router
+ * @param mac[out] set to the MAC
+ */
+static void
+router_mac (uint16_t ifc_num,
+            struct MacAddress *mac)
+{
+  struct EthernetHeader eh;
+
+  set_dest_mac (&eh,
+                ifc_num);
+  *mac = eh.dst;
+}
+
+
+/**
+ * Parse IPv4 address @a s.
+ *
+ * @param s address to parse
+ * @return the address
+ */
+static struct in_addr
+ip (const char *s)
+{
+  struct in_addr a;
+
+  if (1 != inet_pton (AF_INET,
+                      s,
+                      &a))
+    abort ();
+  return a;
+}
+
+
+/**
+ * Send control command @a cmd to the router.
+ *
+ * @param cmd command to send, without the newline
+ * @return 0
+ */
+static int
+control (const char *cmd)
+{
+  char buf[strlen (cmd) + 1];
+
+  memcpy (buf,
+          cmd,
+          strlen (cmd));
+  buf[strlen (cmd)] = '\n';
+  tsend (0,
+         buf,
+         sizeof (buf));
+  return 0;
+}
+
+
+/**
+ * We expect an ARP reply on interface @a cls3.
+ *
+ * @param cls closure
+ * @param ifc interface we got a frame from
+ * @param msg frame we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 unused
+ * @param cls2 unused
+ * @param cls3 interface we expect to receive from
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_arp_reply (void *cls,
+                  uint16_t ifc,
+                  const void *msg,
+                  size_t msg_len,
+                  const void *cls1,
+                  ssize_t cls2,
+                  uint16_t cls3)
+{
+  struct ArpFrame af;
+
+  if ( (ifc != cls3) ||
+       (msg_len < sizeof (af)) )
+    return 1;
+  memcpy (&af,
+          msg,
+          sizeof (af));
+  if ( (ETH_P_ARP != ntohs (af.eh.tag)) ||
+       (ARP_OP_REPLY != ntohs (af.arp.oper)) )
+    return 1;
+  return 0;
+}
+
+
+/**
+ * We expect a broadcast ARP request for the neighbour on interface
+ * @a cls3.
+ *
+ * @param cls closure
+ * @param ifc interface we got a frame from
+ * @param msg frame we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 unused
+ * @param cls2 unused
+ * @param cls3 interface we expect to receive from
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_arp_request (void *cls,
+                    uint16_t ifc,
+                    const void *msg,
+                    size_t msg_len,
+                    const void *cls1,
+                    ssize_t cls2,
+                    uint16_t cls3)
+{
+  static const struct MacAddress broadcast = {
+    .mac = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+  };
+  struct ArpFrame af;
+
+  if ( (ifc != cls3) ||
+       (msg_len < sizeof (af)) )
+    return 1;
+  memcpy (&af,
+          msg,
+          sizeof (af));
+  if ( (ETH_P_ARP != ntohs (af.eh.tag)) ||
+       (ARP_OP_REQUEST != ntohs (af.arp.oper)) ||
+       (0 != memcmp (&af.eh.dst,
+                     &broadcast,
+                     sizeof (broadcast))) ||
+       (af.arp.target_pa.s_addr != ip (neighbour_ips[ifc - 1]).s_addr) )
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Have the neighbour on @a ifc_num answer an ARP request of the
+ * router.
+ *
+ * @param ifc_num interface of the neighbour
+ */
+static void
+send_arp_reply (uint16_t ifc_num)
+{
+  struct ArpFrame af;
+
+  memset (&af,
+          0,
+          sizeof (af));
+  router_mac (ifc_num,
+              &af.eh.dst);
+  neighbour_mac (ifc_num,
+                 &af.eh.src);
+  af.eh.tag = htons (ETH_P_ARP);
+  af.arp.htype = htons (ARP_HTYPE_ETHERNET);
+  af.arp.ptype = htons (ARP_PTYPE_IPV4);
+  af.arp.hlen = MAC_ADDR_SIZE;
+  af.arp.plen = sizeof (struct in_addr);
+  af.arp.oper = htons (ARP_OP_REPLY);
+  af.arp.sender_ha = af.eh.src;
+  af.arp.sender_pa = ip (neighbour_ips[ifc_num - 1]);
+  af.arp.target_ha = af.eh.dst;
+  af.arp.target_pa = ip (router_ips[ifc_num - 1]);
+  tsend (ifc_num,
+         &af,
+         sizeof (af));
+}
+
+
+/**
+ * Have the neighbour on @a ifc_num ask the router for its MAC, so
+ * that the router learns the MAC of the neighbour.
+ *
+ * @param ifc_num interface of the neighbour
+ * @return 0 on success
+ */
+static int
+learn_neighbour (uint16_t ifc_num)
+{
+  struct ArpFrame af;
+
+  memset (&af,
+          0,
+          sizeof (af));
+  memset (&af.eh.dst,
+          0xFF,
+          sizeof (af.eh.dst));
+  neighbour_mac (ifc_num,
+                 &af.eh.src);
+  af.eh.tag = htons (ETH_P_ARP);
+  af.arp.htype = htons (ARP_HTYPE_ETHERNET);
+  af.arp.ptype = htons (ARP_PTYPE_IPV4);
+  af.arp.hlen = MAC_ADDR_SIZE;
+  af.arp.plen = sizeof (struct in_addr);
+  af.arp.oper = htons (ARP_OP_REQUEST);
+  af.arp.sender_ha = af.eh.src;
+  af.arp.sender_pa = ip (neighbour_ips[ifc_num - 1]);
+  af.arp.target_pa = ip (router_ips[ifc_num - 1]);
+  tsend (ifc_num,
+         &af,
+         sizeof (af));
+  return trecv (0,
+                &expect_arp_reply,
+                NULL,
+                NULL,
+                0,
+                ifc_num);
+}
+
+
+/**
+ * Have the router learn all of its neighbours.
+ *
+ * @return 0 on success
+ */
+static int
+learn_neighbours (void)
+{
+  for (uint16_t i = 1; i <= sizeof (ifcs) / sizeof (ifcs[0]); i++)
+    if (0 != learn_neighbour (i))
+      return 1;
+  return 0;
+}
+
+
+/**
+ * Send a UDP packet to @a dst from the host behind eth3.
+ *
+ * @param dst destination of the packet
+ */
+static void
+send_packet (const char *dst)
+{
+  memset (&sent,
+          0,
+          sizeof (sent));
+  set_dest_mac (&sent,
+                SRC_IFC);
+  neighbour_mac (SRC_IFC,
+                 &sent.eh.src);
+  sent.eh.tag = htons (ETH_P_IPV4);
+  sent.ip.version_and_header_length = 0x45;
+  sent.ip.total_length = htons (sizeof (sent) - sizeof (sent.eh));
+  sent.ip.identification = (uint16_t) random ();
+  sent.ip.ttl = 64;
+  sent.ip.protocol = IPPROTO_UDP;
+  sent.ip.source_address = ip (neighbour_ips[SRC_IFC - 1]);
+  sent.ip.destination_address = ip (dst);
+  sent.ip.checksum = GNUNET_CRYPTO_crc16_n (&sent.ip,
+                                            sizeof (sent.ip));
+  for (unsigned int i = 0; i<PAYLOAD_SIZE; i++)
+    sent.payload[i] = (uint8_t) random ();
+  tsend (SRC_IFC,
+         &sent,
+         sizeof (sent));
+}
+
+
+/**
+ * Compute the frame the router forwards to the neighbour on
+ * @a ifc_num for the packet we last sent.
+ *
+ * @param ifc_num interface the packet must leave on
+ * @param want[out] set to the frame
+ */
+static void
+forwarded (uint16_t ifc_num,
+           struct IPFrame *want)
+{
+  *want = sent;
+  neighbour_mac (ifc_num,
+                 &want->eh.dst);
+  router_mac (ifc_num,
+              &want->eh.src);
+  want->ip.ttl--;
+  want->ip.checksum = 0;
+  want->ip.checksum = GNUNET_CRYPTO_crc16_n (&want->ip,
+                                             sizeof (want->ip));
+}
+
+
+/**
+ * Send a packet to @a dst and check that the router forwards it to
+ * the neighbour on @a ifc_num.
+ *
+ * @param dst destination of the packet
+ * @param ifc_num interface the packet must leave on
+ * @return 0 on success
+ */
+static int
+check_route (const char *dst,
+             uint16_t ifc_num)
+{
+  struct IPFrame want;
+
+  send_packet (dst);
+  forwarded (ifc_num,
+             &want);
+  return trecv (0,
+                &expect_frame,
+                NULL,
+                &want,
+                sizeof (want),
+                ifc_num);
+}
+
+
+/**
+ * We expect an ICMP "destination unreachable" on interface @a cls3.
+ *
+ * @param cls closure
+ * @param ifc interface we got a frame from
+ * @param msg frame we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 unused
+ * @param cls2 unused
+ * @param cls3 interface we expect to receive from
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_unreachable (void *cls,
+                    uint16_t ifc,
+                    const void *msg,
+                    size_t msg_len,
+                    const void *cls1,
+                    ssize_t cls2,
+                    uint16_t cls3)
+{
+  const uint8_t *b = msg;
+  struct EthernetHeader eh;
+  struct IPv4Header iph;
+
+  if (0 == ifc)
+    return 2;
+  if ( (ifc != cls3) ||
+       (msg_len < sizeof (eh) + sizeof (iph) + 1) )
+    return 1;
+  memcpy (&eh,
+          b,
+          sizeof (eh));
+  memcpy (&iph,
+          &b[sizeof (eh)],
+          sizeof (iph));
+  if ( (ETH_P_IPV4 != ntohs (eh.tag)) ||
+       (IPPROTO_ICMP != iph.protocol) ||
+       (3 != b[sizeof (eh) + (iph.version_and_header_length & 15) * 4]) )
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Send a packet to @a dst and check that the router reports that
+ * there is no route.
+ *
+ * @param dst destination of the packet
+ * @return 0 on success
+ */
+static int
+check_no_route (const char *dst)
+{
+  send_packet (dst);
+  return trecv (0,
+                &expect_unreachable,
+                NULL,
+                NULL,
+                0,
+                SRC_IFC);
+}
+
+
+/**
+ * We expect control output containing the string @a cls1.
+ *
+ * @param cls closure
+ * @param ifc interface we got a frame from
+ * @param msg text we received
+ * @param msg_len number of bytes in @a msg
+ * @param cls1 0-terminated text we expect in @a msg
+ * @param cls2 unused
+ * @param cls3 unused
+ * @return 0 on success, 1 on missmatch
+ */
+static int
+expect_output (void *cls,
+               uint16_t ifc,
+               const void *msg,
+               size_t msg_len,
+               const void *cls1,
+               ssize_t cls2,
+               uint16_t cls3)
+{
+  if (0 != ifc)
+    return 1;
+  if (NULL == memmem (msg,
+                      msg_len,
+                      cls1,
+                      strlen (cls1)))
+  {
+#if DEBUG
+    fprintf (stderr,
+             "Output `%.*s' lacks `%s'\n",
+             (int) msg_len,
+             (const char *) msg,
+             (const char *) cls1);
+#endif
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Wait until the router published the route changes sent so far: it
+ * runs a "route list" only after the changes before it, so we wait
+ * for its output.
+ *
+ * @param line text the output must contain, such as the line of a
+ *        route that was just added
+ * @return 0 on success, 1 on failure
+ */
+static int
+sync_routes (const char *line)
+{
+  control ("route list");
+  return trecv (0,
+                &expect_output,
+                NULL,
+                line,
+                0,
+                0);
+}
+
+
+/**
+ * Run the commands in @a cmd against the router @a prog.
+ *
+ * @param prog command to test
+ * @param cmd commands to run
+ * @return 0 on success, non-zero on failure
+ */
+static int
+run_router (const char *prog,
+            struct Command *cmd)
+{
+  char *argv[] = {
+    (char *) prog,
+    ifcs[0],
+    ifcs[1],
+    ifcs[2],
+    ifcs[3],
+    NULL
+  };
+
+  return meta (cmd,
+               (sizeof (argv) / sizeof (char *)) - 1,
+               argv);
+}
+
+
+/**
+ * Run test with @a prog.  Add and delete overlapping /8, /24 and /32
+ * routes; the longest prefix wins, and after a deletion the next
+ * shorter one.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_lpm (const char *prog)
+{
+  int
+  add_routes ()
+  {
+    control ("route add 20.0.0.0/8 via 10.0.0.2 dev eth0");
+    control ("route add 20.1.2.0/24 via 192.168.0.2 dev eth1");
+    control ("route add 20.1.2.3/32 via 14.25.59.2 dev eth2");
+    return sync_routes ("20.1.2.3/255.255.255.255 -> 14.25.59.2 (eth2)");
+  };
+  int
+  check_32 ()
+  {
+    return check_route ("20.1.2.3",
+                        3);
+  };
+  int
+  check_24 ()
+  {
+    return check_route ("20.1.2.4",
+                        2);
+  };
+  int
+  check_8 ()
+  {
+    return check_route ("20.9.9.9",
+                        1);
+  };
+  int
+  del_32 ()
+  {
+    control ("route del 20.1.2.3/32 via 14.25.59.2 dev eth2");
+    return sync_routes (CONNECTED_ROUTE);
+  };
+  int
+  check_32_via_24 ()
+  {
+    return check_route ("20.1.2.3",
+                        2);
+  };
+  int
+  del_24 ()
+  {
+    control ("route del 20.1.2.0/24 via 192.168.0.2 dev eth1");
+    return sync_routes (CONNECTED_ROUTE);
+  };
+  int
+  check_32_via_8 ()
+  {
+    return check_route ("20.1.2.3",
+                        1);
+  };
+  int
+  del_8 ()
+  {
+    control ("route del 20.0.0.0/8 via 10.0.0.2 dev eth0");
+    return sync_routes (CONNECTED_ROUTE);
+  };
+  int
+  check_gone ()
+  {
+    return check_no_route ("20.1.2.3");
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "add routes", &add_routes },
+    { "check /32", &check_32 },
+    { "check /24", &check_24 },
+    { "check /8", &check_8 },
+    { "delete /32", &del_32 },
+    { "check fallback to /24", &check_32_via_24 },
+    { "delete /24", &del_24 },
+    { "check fallback to /8", &check_32_via_8 },
+    { "delete /8", &del_8 },
+    { "check no route", &check_gone },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  return run_router (prog,
+                     cmd);
+}
+
+
+/**
+ * Run test with @a prog.  Adding an existing route again changes its
+ * next hop.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_modify (const char *prog)
+{
+  int
+  add_route ()
+  {
+    control ("route add 30.0.0.0/16 via 10.0.0.2 dev eth0");
+    return sync_routes ("30.0.0.0/255.255.0.0 -> 10.0.0.2 (eth0)");
+  };
+  int
+  check_old ()
+  {
+    return check_route ("30.0.1.1",
+                        1);
+  };
+  int
+  modify_route ()
+  {
+    control ("route add 30.0.0.0/16 via 14.25.59.2 dev eth2");
+    return sync_routes ("30.0.0.0/255.255.0.0 -> 14.25.59.2 (eth2)");
+  };
+  int
+  check_new ()
+  {
+    return check_route ("30.0.1.1",
+                        3);
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "add route", &add_route },
+    { "check route", &check_old },
+    { "modify route", &modify_route },
+    { "check modified route", &check_new },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  return run_router (prog,
+                     cmd);
+}
+
+
+/**
+ * Run test with @a prog.  The routes to the connected networks can
+ * be neither deleted nor changed.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_connected (const char *prog)
+{
+  int
+  del_connected ()
+  {
+    control ("route del 10.0.0.0/8 via 0.0.0.0 dev eth0");
+    control ("route add 192.168.0.0/16 via 10.0.0.2 dev eth0");
+    return sync_routes (CONNECTED_ROUTE);
+  };
+  int
+  check_eth0 ()
+  {
+    return check_route ("10.0.0.2",
+                        1);
+  };
+  int
+  check_eth1 ()
+  {
+    return check_route ("192.168.0.2",
+                        2);
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "change connected routes", &del_connected },
+    { "check eth0 still connected", &check_eth0 },
+    { "check eth1 still connected", &check_eth1 },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  return run_router (prog,
+                     cmd);
+}
+
+
+/**
+ * Run test with @a prog.  Packets to a neighbour whose MAC is not
+ * known yet are held; one request is sent, and the reply releases
+ * all held packets in order.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_hold (const char *prog)
+{
+  struct IPFrame want[3];
+  int
+  send_packets ()
+  {
+    for (unsigned int i = 0; i<3; i++)
+    {
+      send_packet (neighbour_ips[0]);
+      forwarded (1,
+                 &want[i]);
+    }
+    return 0;
+  };
+  int
+  expect_request ()
+  {
+    return trecv (0,
+                  &expect_arp_request,
+                  NULL,
+                  NULL,
+                  0,
+                  1);
+  };
+  int
+  reply ()
+  {
+    send_arp_reply (1);
+    return 0;
+  };
+  int
+  expect_burst ()
+  {
+    for (unsigned int i = 0; i<3; i++)
+      if (0 != trecv (0,
+                      &expect_frame,
+                      NULL,
+                      &want[i],
+                      sizeof (want[i]),
+                      1))
+        return 1;
+    return 0;
+  };
+  struct Command cmd[] = {
+    { "send packets to unknown neighbour", &send_packets },
+    { "expect one ARP request", &expect_request },
+    { "answer ARP request", &reply },
+    { "expect held packets", &expect_burst },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  return run_router (prog,
+                     cmd);
+}
+
+
+/**
+ * Create a temporary file with @a size bytes of @a data.
+ *
+ * @param data contents of the file
+ * @param size number of bytes in @a data
+ * @return name of the file, to be unlinked and freed by the caller
+ */
+static char *
+write_temp (const void *data,
+            size_t size)
+{
+  char *fn = strdup ("/tmp/test-router-XXXXXX");
+  int fd;
+
+  if (NULL == fn)
+    abort ();
+  fd = mkstemp (fn);
+  if (-1 == fd)
+  {
+    perror ("mkstemp");
+    abort ();
+  }
+  write_all (fd,
+             data,
+             size);
+  close (fd);
+  return fn;
+}
+
+
+/**
+ * Run test with @a prog.  "route load" replaces the routes by those
+ * in file @a fn; we check for the routes of #load_routes_text().
+ *
+ * @param prog command to test
+ * @param fn route file to load
+ * @return 0 on success, non-zero on failure
+ */
+static int
+test_load (const char *prog,
+           const char *fn)
+{
+  int
+  add_route ()
+  {
+    control ("route add 50.0.0.0/8 via 10.0.0.2 dev eth0");
+    return sync_routes ("50.0.0.0/255.0.0.0 -> 10.0.0.2 (eth0)");
+  };
+  int
+  load ()
+  {
+    char cmd[strlen ("route load ") + strlen (fn) + 1];
+
+    sprintf (cmd,
+             "route load %s",
+             fn);
+    control (cmd);
+    /* "route list" runs after the load, so its output tells us
+       that the new routes are in place */
+    return control ("route list");
+  };
+  int
+  expect_list ()
+  {
+    return trecv (0,
+                  &expect_output,
+                  NULL,
+                  "40.1.0.0/255.255.0.0 -> 14.25.59.2 (eth2)",
+                  0,
+                  0);
+  };
+  int
+  check_16 ()
+  {
+    return check_route ("40.1.2.3",
+                        3);
+  };
+  int
+  check_8 ()
+  {
+    return check_route ("40.2.0.1",
+                        2);
+  };
+  int
+  check_replaced ()
+  {
+    return check_no_route ("50.0.0.1");
+  };
+  int
+  check_connected ()
+  {
+    return check_route ("10.0.0.2",
+                        1);
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "add route", &add_route },
+    { "load routes", &load },
+    { "expect route list", &expect_list },
+    { "check /16", &check_16 },
+    { "check /8", &check_8 },
+    { "check old route is gone", &check_replaced },
+    { "check connected route", &check_connected },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  return run_router (prog,
+                     cmd);
+}
+
+
+/**
+ * Run test with @a prog.  Load routes from a text file.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+load_routes_text (const char *prog)
+{
+  static const char routes[] =
+    "# routes for test-router\n"
+    "40.0.0.0/8 via 192.168.0.2 dev eth1\n"
+    "\n"
+    "40.1.0.0/16 via 14.25.59.2 dev eth2\n";
+  char *fn = write_temp (routes,
+                         strlen (routes));
+  int ret;
+
+  ret = test_load (prog,
+                   fn);
+  unlink (fn);
+  free (fn);
+  return ret;
+}
+
+
+/**
+ * Create a binary route file with the routes of #load_routes_text(),
+ * cut off after @a size bytes.
+ *
+ * @param size number of bytes to write, at most the whole file
+ * @return name of the file, to be unlinked and freed by the caller
+ */
+static char *
+write_binary_routes (size_t size)
+{
+  char buf[strlen (ROUTE_FILE_MAGIC) + 2 * sizeof (struct RouteRecord)];
+  struct RouteRecord rec[2];
+
+  if (size > sizeof (buf))
+    abort ();
+  memset (rec,
+          0,
+          sizeof (rec));
+  rec[0].network = ip ("40.0.0.0");
+  rec[0].next_hop = ip ("192.168.0.2");
+  rec[0].ifc_num = htons (2);
+  rec[0].len = 8;
+  rec[1].network = ip ("40.1.0.0");
+  rec[1].next_hop = ip ("14.25.59.2");
+  rec[1].ifc_num = htons (3);
+  rec[1].len = 16;
+  memcpy (buf,
+          ROUTE_FILE_MAGIC,
+          strlen (ROUTE_FILE_MAGIC));
+  memcpy (&buf[strlen (ROUTE_FILE_MAGIC)],
+          rec,
+          sizeof (rec));
+  return write_temp (buf,
+                     size);
+}
+
+
+/**
+ * Run test with @a prog.  Load routes from a binary route file.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+load_routes_binary (const char *prog)
+{
+  char *fn = write_binary_routes (strlen (ROUTE_FILE_MAGIC)
+                                  + 2 * sizeof (struct RouteRecord));
+  int ret;
+
+  ret = test_load (prog,
+                   fn);
+  unlink (fn);
+  free (fn);
+  return ret;
+}
+
+
+/**
+ * Run test with @a prog.  A binary route file that ends within a
+ * route is rejected as a whole, and the old routes stay in place.
+ *
+ * @param prog command to test
+ * @return 0 on success, non-zero on failure
+ */
+static int
+load_routes_truncated (const char *prog)
+{
+  char *fn = write_binary_routes (strlen (ROUTE_FILE_MAGIC)
+                                  + 3 * sizeof (struct RouteRecord) / 2);
+  int ret;
+  int
+  add_route ()
+  {
+    control ("route add 50.0.0.0/8 via 10.0.0.2 dev eth0");
+    return sync_routes ("50.0.0.0/255.0.0.0 -> 10.0.0.2 (eth0)");
+  };
+  int
+  load ()
+  {
+    char cmd[strlen ("route load ") + strlen (fn) + 1];
+
+    sprintf (cmd,
+             "route load %s",
+             fn);
+    control (cmd);
+    return sync_routes ("50.0.0.0/255.0.0.0 -> 10.0.0.2 (eth0)");
+  };
+  int
+  check_kept ()
+  {
+    return check_route ("50.0.0.1",
+                        1);
+  };
+  int
+  check_not_loaded ()
+  {
+    return check_no_route ("40.2.0.1");
+  };
+  struct Command cmd[] = {
+    { "learn neighbours", &learn_neighbours },
+    { "add route", &add_route },
+    { "load truncated routes", &load },
+    { "check old route is kept", &check_kept },
+    { "check first route was not loaded", &check_not_loaded },
+    { "end", &expect_silence },
+    { NULL }
+  };
+
+  ret = run_router (prog,
+                    cmd);
+  unlink (fn);
+  free (fn);
+  return ret;
+}
+
+
+/**
+ * Call with path to the router program to test.
+ */
+int
+main (int argc,
+      char **argv)
+{
+  unsigned int grade = 0;
+  unsigned int possible = 0;
+  struct Test
+  {
+    const char *name;
+    int (*fun)(const char *arg);
+  } tests[] = {
+    { "longest prefix match", &test_lpm },
+    { "modify route", &test_modify },
+    { "connected routes are fixed", &test_connected },
+    { "hold packets until ARP reply", &test_hold },
+    { "load text route file", &load_routes_text },
+    { "load binary route file", &load_routes_binary },
+    { "reject truncated route file", &load_routes_truncated },
+    { NULL, NULL }
+  };
+
+  if (argc != 2)
+  {
+    fprintf (stderr,
+             "Call with ROUTER to test as 1st argument!\n");
+    return 1;
+  }
+  for (unsigned int i = 0; NULL != tests[i].fun; i++)
+  {
+    if (0 == tests[i].fun (argv[1]))
+      grade++;
+    else
+      fprintf (stdout,
+               "Failed test `%s'\n",
+               tests[i].name);
+    possible++;
+  }
+  fprintf (stdout,
+           "Final grade: %u/%u\n",
+           grade,
+           possible);
+  return grade == possible ? 0 : 1;
+}
@@ -1,237 +1,577 @@
-/**
- * @file test-vswitch.c
- * @brief Testcase for the 'vswitch'.  Must be linked with harness.c.
- * @author Christian Schmidhalter, Roman Schneiter
- */
-#include "harness.h"
-
-/**
- * Set to 1 to enable debug statments.
- */
-#define DEBUG 1
-#define TAGGED_HEADER_SIZE 16
-#define UNTAGGED_HEADER_SIZE 12
-#define PAYLOAD_SIZE 512
-
-// Untagged Frame
-struct UTFrame
-{
-    struct MacAddress src;
-    struct MacAddress dst;
-};
-
-// Tagged Frame
-struct TFrame
-{
-    struct MacAddress src;
-    struct MacAddress dst;
-    struct Tag
-    {
-        uint16_t tpid;
-        uint16_t tci;
-    } tag;
-};
-
-/*
-Generates an untagged and a tagged frame for testing
-*/
-void generate_frames(uint8_t *TFrame, uint8_t *UTFrame)
-{
-    // Tagged:   src mac + dst mac (12 byte) + tag (4byte) + payload (n byte)
-    // Untagged: src mac + dst mac (12 byte)               + payload (n byte)
-
-    // Sample source and destintion mac
-    struct MacAddress srcMac = {{0x00, 0x11, 0x22, 0xAA, 0xBB, 0xCC}};
-    struct MacAddress dstMac = {{0x00, 0xAA, 0x88, 0x66, 0x44, 0x22}};
-
-    // Build tagged and untagged header
-    struct UTFrame UTHeader;
-    struct TFrame THeader;
-
-    // Add Mac source and destination mac to header
-    for (int i = 0; i < 6; i++) 
-    {
-        UTHeader.src.mac[i] = srcMac.mac[i];
-        UTHeader.dst.mac[i] = dstMac.mac[i];
-        THeader.src.mac[i] = srcMac.mac[i];
-        THeader.dst.mac[i] = dstMac.mac[i];
-    }
-    THeader.tag.tpid = htons(0x8100); //Tag Protocol Identifier: fix value 8100
-    THeader.tag.tci = htons(0x1); // Tag Control Information
-
-    // Add Header to frame
-    for (int i = 0; i < sizeof(struct TFrame); i++) 
-    {
-        TFrame[i] = *((uint8_t*)&THeader + i);
-
-        if(i < sizeof(struct UTFrame))
-        {
-        UTFrame[i] = *((uint8_t*)&UTHeader + i);
-        }
-    }
-
-    // Populate random payload
-    uint8_t payload[PAYLOAD_SIZE];
-    for (unsigned int i = 0; i < PAYLOAD_SIZE; i++)
-    {
-        payload[i] = random();
-    }
-
-    // Add payload to frame
-    for (unsigned int i = 0; i < PAYLOAD_SIZE; i++)
-    {
-        TFrame[i + TAGGED_HEADER_SIZE] = payload[i]; 
-        UTFrame[i + UNTAGGED_HEADER_SIZE] = payload[i];
-    }
-}
-
-
-/*
-Removal of tag.
-Sends from tagged source. Expects untagged frame.
-*/
-static int remove_tag(const char *prog)
-{
-
-    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE]; 
-    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
-    generate_frames(TFrame, UTFrame);
-   
-    int send_tagged_frame()
-    {
-        tsend(1, TFrame, sizeof(TFrame));
-        return 0;
-    };
-
-    int expect_untagged_frame()
-    {
-        uint64_t ifc = (1 << 1);
-        return trecv(
-            1,
-            &expect_multicast,
-            &ifc,
-            UTFrame,
-            sizeof(UTFrame),
-            UINT16_MAX);
-    };
-
-    char *argv[] = {(char *)prog, "eth0[T:1]", "eth1[U:1]", "eth2[U:2]", "eth3[U:3]", NULL};
-
-    struct Command cmd[] = {
-        {"send tagged frame", &send_tagged_frame},
-        {"check untagged frame", &expect_untagged_frame},
-        {"end", &expect_silence},
-        {NULL}};
-
-    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
-
-}
-
-/*
-Adding a tag.
-Sends from untagged source. Expects tagged frame.
-*/
-static int add_tag(const char *prog)
-{
-    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
-    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
-    generate_frames(TFrame, UTFrame);
-
-    int send_untagged_frame()
-    {
-        tsend(1, UTFrame, sizeof(UTFrame));
-        return 0;
-    };
-
-    int expect_tagged_frame()
-    {
-        uint64_t ifc = (1 << 1);
-        return trecv(
-            1,
-            &expect_multicast,
-            &ifc,
-            TFrame,
-            sizeof(TFrame),
-            UINT16_MAX);
-    };
-
-    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[T:1]", "eth2[U:2]", "eth3[U:3]", NULL};
-
-    struct Command cmd[] = {
-        {"send untagged frame", &send_untagged_frame},
-        {"check tagged frame", &expect_tagged_frame},
-        {"end", &expect_silence},
-        {NULL}};
-
-    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
-}
-
-/*
-Incorrect forwarding.
-Sends tagged frame from untagged source. Expects silence.
-*/
-static int send_incorrect(const char *prog)
-{
-
-    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
-    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
-    generate_frames(TFrame, UTFrame);
-
-    int send_tagged_frame()
-    {
-        tsend(1, TFrame, sizeof(TFrame));
-        return 0;
-    };
-
-    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[T:1]", "eth2[U:2]", "eth3[U:3]", NULL};
-
-    struct Command cmd[] = {
-        {"send tagged frame", &send_tagged_frame},
-        {"expect silence, end", &expect_silence},
-        {NULL}};
-
-    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
-}
-
-/**
- * Call with path to the switch program to test.
- */
-int main(int argc,
-         char **argv)
-{
-    unsigned int grade = 0;
-    unsigned int possible = 0;
-    struct Test
-    {
-        const char *name;
-        int (*fun)(const char *arg);
-    } tests[] = {
-         {"Remove tag from frame", &remove_tag}, // bug1
-         {"Add tag to frame", &add_tag}, // bug2
-         {"Send tagged frame from untagged source", &send_incorrect}, // bug3
-         {NULL, NULL}
-    };
-
-    if (argc != 2)
-    {
-        fprintf(stderr,
-                "Call with VSWITCH to test as 1st argument!\n");
-        return 1;
-    }
-    for (unsigned int i = 0; NULL != tests[i].fun; i++)
-    {
-        if (0 == tests[i].fun(argv[1]))
-            grade++;
-        else
-            fprintf(stdout,
-                    "Failed test `%s'\n",
-                    tests[i].name);
-        possible++;
-    }
-    fprintf(stdout,
-            "Final grade: %u/%u\n",
-            grade,
-            possible);
-    
-    return grade != possible ? 1 : 0;
+/**
+ * @file test-vswitch.c
+ * @brief Testcase for the 'vswitch'.  Must be linked with harness.c.
+ * @author Christian Schmidhalter, Roman Schneiter
+ */
+#include "harness.h"
+
+/**
+ * Set to 1 to enable debug statments.
+ */
+#define DEBUG 1
+#define TAGGED_HEADER_SIZE 16
+#define UNTAGGED_HEADER_SIZE 12
+#define PAYLOAD_SIZE 512
+
+// Untagged Frame
+struct UTFrame
+{
+    struct MacAddress src;
+    struct MacAddress dst;
+};
+
+// Tagged Frame
+struct TFrame
+{
+    struct MacAddress src;
+    struct MacAddress dst;
+    struct Tag
+    {
+        uint16_t tpid;
+        uint16_t tci;
+    } tag;
+};
+
+/*
+Generates an untagged and a tagged frame for testing
+*/
+void generate_frames(uint8_t *TFrame, uint8_t *UTFrame)
+{
+    // Tagged:   src mac + dst mac (12 byte) + tag (4byte) + payload (n byte)
+    // Untagged: src mac + dst mac (12 byte)               + payload (n byte)
+
+    // Sample source and destintion mac
+    struct MacAddress srcMac = {{0x00, 0x11, 0x22, 0xAA, 0xBB, 0xCC}};
+    struct MacAddress dstMac = {{0x00, 0xAA, 0x88, 0x66, 0x44, 0x22}};
+
+    // Build tagged and untagged header
+    struct UTFrame UTHeader;
+    struct TFrame THeader;
+
+    // Add Mac source and destination mac to header
+    for (int i = 0; i < 6; i++) 
+    {
+        UTHeader.src.mac[i] = srcMac.mac[i];
+        UTHeader.dst.mac[i] = dstMac.mac[i];
+        THeader.src.mac[i] = srcMac.mac[i];
+        THeader.dst.mac[i] = dstMac.mac[i];
+    }
+    THeader.tag.tpid = htons(0x8100); //Tag Protocol Identifier: fix value 8100
+    THeader.tag.tci = htons(0x1); // Tag Control Information
+
+    // Add Header to frame
+    for (int i = 0; i < sizeof(struct TFrame); i++) 
+    {
+        TFrame[i] = *((uint8_t*)&THeader + i);
+
+        if(i < sizeof(struct UTFrame))
+        {
+        UTFrame[i] = *((uint8_t*)&UTHeader + i);
+        }
+    }
+
+    // Populate random payload
+    uint8_t payload[PAYLOAD_SIZE];
+    for (unsigned int i = 0; i < PAYLOAD_SIZE; i++)
+    {
+        payload[i] = random();
+    }
+
+    // Add payload to frame
+    for (unsigned int i = 0; i < PAYLOAD_SIZE; i++)
+    {
+        TFrame[i + TAGGED_HEADER_SIZE] = payload[i]; 
+        UTFrame[i + UNTAGGED_HEADER_SIZE] = payload[i];
+    }
+}
+
+
+/*
+Removal of tag.
+Sends from tagged source. Expects untagged frame.
+*/
+static int remove_tag(const char *prog)
+{
+
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE]; 
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+   
+    int send_tagged_frame()
+    {
+        tsend(1, TFrame, sizeof(TFrame));
+        return 0;
+    };
+
+    int expect_untagged_frame()
+    {
+        uint64_t ifc = (1 << 1);
+        return trecv(
+            1,
+            &expect_multicast,
+            &ifc,
+            UTFrame,
+            sizeof(UTFrame),
+            UINT16_MAX);
+    };
+
+    char *argv[] = {(char *)prog, "eth0[T:1]", "eth1[U:1]", "eth2[U:2]", "eth3[U:3]", NULL};
+
+    struct Command cmd[] = {
+        {"send tagged frame", &send_tagged_frame},
+        {"check untagged frame", &expect_untagged_frame},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+
+}
+
+/*
+Adding a tag.
+Sends from untagged source. Expects tagged frame.
+*/
+static int add_tag(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    int send_untagged_frame()
+    {
+        tsend(1, UTFrame, sizeof(UTFrame));
+        return 0;
+    };
+
+    int expect_tagged_frame()
+    {
+        uint64_t ifc = (1 << 1);
+        return trecv(
+            1,
+            &expect_multicast,
+            &ifc,
+            TFrame,
+            sizeof(TFrame),
+            UINT16_MAX);
+    };
+
+    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[T:1]", "eth2[U:2]", "eth3[U:3]", NULL};
+
+    struct Command cmd[] = {
+        {"send untagged frame", &send_untagged_frame},
+        {"check tagged frame", &expect_tagged_frame},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+Incorrect forwarding.
+Sends tagged frame from untagged source. Expects silence.
+*/
+static int send_incorrect(const char *prog)
+{
+
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    int send_tagged_frame()
+    {
+        tsend(1, TFrame, sizeof(TFrame));
+        return 0;
+    };
+
+    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[T:1]", "eth2[U:2]", "eth3[U:3]", NULL};
+
+    struct Command cmd[] = {
+        {"send tagged frame", &send_tagged_frame},
+        {"expect silence, end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+Learning.
+Sends from a host, then replies to it from another interface.
+Expects the reply only on the interface the host was learned on.
+*/
+static int learn_unicast(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t reply[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    // Reply swaps the first and the second MAC of the untagged frame
+    memcpy(reply, UTFrame, sizeof(reply));
+    memcpy(&reply[0], &UTFrame[6], 6);
+    memcpy(&reply[6], &UTFrame[0], 6);
+
+    int send_untagged_frame()
+    {
+        tsend(1, UTFrame, sizeof(UTFrame));
+        return 0;
+    };
+
+    int expect_flood()
+    {
+        uint64_t ifc = (1 << 1) | (1 << 2);
+        return trecv(
+            2,
+            &expect_multicast,
+            &ifc,
+            UTFrame,
+            sizeof(UTFrame),
+            UINT16_MAX);
+    };
+
+    int send_reply()
+    {
+        tsend(2, reply, sizeof(reply));
+        return 0;
+    };
+
+    int expect_unicast()
+    {
+        return trecv(
+            0,
+            &expect_frame,
+            NULL,
+            reply,
+            sizeof(reply),
+            1);
+    };
+
+    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[U:1]", "eth2[U:1]", NULL};
+
+    struct Command cmd[] = {
+        {"send untagged frame", &send_untagged_frame},
+        {"check flooded frame", &expect_flood},
+        {"send reply", &send_reply},
+        {"check unicast reply", &expect_unicast},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+Aging.
+Learns a host with an aging time of 1 s, waits until the entry expired,
+then replies to it from another interface.
+Expects the reply to be flooded again.
+*/
+// Entries live up to aging time + 1 s, plus the second we round to
+#define AGING_WAIT 4
+
+static int aged_unicast(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t reply[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    // Reply swaps the first and the second MAC of the untagged frame
+    memcpy(reply, UTFrame, sizeof(reply));
+    memcpy(&reply[0], &UTFrame[6], 6);
+    memcpy(&reply[6], &UTFrame[0], 6);
+
+    int send_untagged_frame()
+    {
+        tsend(1, UTFrame, sizeof(UTFrame));
+        return 0;
+    };
+
+    int expect_flood()
+    {
+        uint64_t ifc = (1 << 1) | (1 << 2);
+        return trecv(
+            2,
+            &expect_multicast,
+            &ifc,
+            UTFrame,
+            sizeof(UTFrame),
+            UINT16_MAX);
+    };
+
+    int wait_aging()
+    {
+        sleep(AGING_WAIT);
+        return 0;
+    };
+
+    int send_reply()
+    {
+        tsend(2, reply, sizeof(reply));
+        return 0;
+    };
+
+    int expect_reply_flood()
+    {
+        uint64_t ifc = (1 << 0) | (1 << 2);
+        return trecv(
+            2,
+            &expect_multicast,
+            &ifc,
+            reply,
+            sizeof(reply),
+            UINT16_MAX);
+    };
+
+    char *argv[] = {(char *)prog, "--aging=1", "eth0[U:1]", "eth1[U:1]", "eth2[U:1]", NULL};
+
+    struct Command cmd[] = {
+        {"send untagged frame", &send_untagged_frame},
+        {"check flooded frame", &expect_flood},
+        {"wait until the host aged out", &wait_aging},
+        {"send reply", &send_reply},
+        {"check flooded reply", &expect_reply_flood},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+VLAN isolation of learning.
+Learns a host in VLAN 1, then sends to it from VLAN 2.
+Expects the frame to stay in VLAN 2.
+*/
+static int learn_per_vlan(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t reply[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    // Reply swaps the first and the second MAC of the untagged frame
+    memcpy(reply, UTFrame, sizeof(reply));
+    memcpy(&reply[0], &UTFrame[6], 6);
+    memcpy(&reply[6], &UTFrame[0], 6);
+
+    int send_untagged_frame()
+    {
+        tsend(1, UTFrame, sizeof(UTFrame));
+        return 0;
+    };
+
+    int send_reply()
+    {
+        tsend(2, reply, sizeof(reply));
+        return 0;
+    };
+
+    int expect_vlan_flood()
+    {
+        return trecv(
+            0,
+            &expect_frame,
+            NULL,
+            reply,
+            sizeof(reply),
+            3);
+    };
+
+    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[U:2]", "eth2[U:2]", NULL};
+
+    struct Command cmd[] = {
+        {"send untagged frame in VLAN 1", &send_untagged_frame},
+        {"send reply in VLAN 2", &send_reply},
+        {"check reply stays in VLAN 2", &expect_vlan_flood},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+Trunk with several VLANs.
+Sends tagged frame for the second VLAN of a trunk.
+Expects untagged frame only on the access port of that VLAN.
+*/
+static int trunk_vlans(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    // Move tagged frame to VLAN 2
+    uint16_t tci = htons(0x2);
+    memcpy(&TFrame[14], &tci, sizeof(tci));
+
+    int send_tagged_frame()
+    {
+        tsend(1, TFrame, sizeof(TFrame));
+        return 0;
+    };
+
+    int expect_untagged_frame()
+    {
+        return trecv(
+            0,
+            &expect_frame,
+            NULL,
+            UTFrame,
+            sizeof(UTFrame),
+            2);
+    };
+
+    char *argv[] = {(char *)prog, "eth0[T:1,2,3]", "eth1[U:2]", "eth2[U:3]", "eth3[U:1]", NULL};
+
+    struct Command cmd[] = {
+        {"send tagged frame in VLAN 2", &send_tagged_frame},
+        {"check untagged frame in VLAN 2", &expect_untagged_frame},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/*
+Burst of frames.
+Learns a host, then sends it several frames of different sizes back
+to back. Expects all of them intact and in the order they were sent,
+however the switch batches its output.
+*/
+#define BURST_SIZE 8
+
+static int burst_in_order(const char *prog)
+{
+    uint8_t TFrame[TAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t UTFrame[UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    uint8_t burst[BURST_SIZE][UNTAGGED_HEADER_SIZE + PAYLOAD_SIZE];
+    generate_frames(TFrame, UTFrame);
+
+    // Each frame of the burst goes back to the host, with its own payload
+    for (unsigned int i = 0; i < BURST_SIZE; i++)
+    {
+        memcpy(&burst[i][0], &UTFrame[6], 6);
+        memcpy(&burst[i][6], &UTFrame[0], 6);
+        for (unsigned int j = UNTAGGED_HEADER_SIZE; j < sizeof(burst[i]); j++)
+            burst[i][j] = random();
+    }
+
+    // Frame i has i * 37 bytes less payload
+    size_t burst_len(unsigned int i)
+    {
+        return sizeof(burst[i]) - i * 37;
+    };
+
+    int send_untagged_frame()
+    {
+        tsend(1, UTFrame, sizeof(UTFrame));
+        return 0;
+    };
+
+    int expect_flood()
+    {
+        uint64_t ifc = (1 << 1) | (1 << 2);
+        return trecv(
+            2,
+            &expect_multicast,
+            &ifc,
+            UTFrame,
+            sizeof(UTFrame),
+            UINT16_MAX);
+    };
+
+    int send_burst()
+    {
+        for (unsigned int i = 0; i < BURST_SIZE; i++)
+            tsend(2, burst[i], burst_len(i));
+        return 0;
+    };
+
+    int expect_burst()
+    {
+        for (unsigned int i = 0; i < BURST_SIZE; i++)
+            if (0 != trecv(
+                    0,
+                    &expect_frame,
+                    NULL,
+                    burst[i],
+                    burst_len(i),
+                    1))
+                return 1;
+        return 0;
+    };
+
+    char *argv[] = {(char *)prog, "eth0[U:1]", "eth1[U:1]", "eth2[U:1]", NULL};
+
+    struct Command cmd[] = {
+        {"send untagged frame", &send_untagged_frame},
+        {"check flooded frame", &expect_flood},
+        {"send burst", &send_burst},
+        {"check burst", &expect_burst},
+        {"end", &expect_silence},
+        {NULL}};
+
+    return meta(cmd, (sizeof(argv) / sizeof(char *)) - 1, argv);
+}
+
+/**
+ * Call with path to the switch program to test.
+ */
+int main(int argc,
+         char **argv)
+{
+    unsigned int grade = 0;
+    unsigned int possible = 0;
+    struct Test
+    {
+        const char *name;
+        int (*fun)(const char *arg);
+    } tests[] = {
+         {"Remove tag from frame", &remove_tag}, // bug1
+         {"Add tag to frame", &add_tag}, // bug2
+         {"Send tagged frame from untagged source", &send_incorrect}, // bug3
+         {"Unicast to learned MAC", &learn_unicast},
+         {"Flood to aged out MAC", &aged_unicast},
+         {"Learning is per VLAN", &learn_per_vlan},
+         {"Trunk carries all its VLANs", &trunk_vlans},
+         {"Burst arrives intact and in order", &burst_in_order},
+         {NULL, NULL}
+    };
+
+    struct
+    {
+        const char *name;
+        enum Transport transport;
+    } transports[] = {
+        {"pipe", TRANSPORT_PIPE},
+        {"shared memory", TRANSPORT_SHM},
+        {"batches", TRANSPORT_BATCH},
+        {NULL, TRANSPORT_PIPE}
+    };
+
+    if (argc != 2)
+    {
+        fprintf(stderr,
+                "Call with VSWITCH to test as 1st argument!\n");
+        return 1;
+    }
+    for (unsigned int t = 0; NULL != transports[t].name; t++)
+    {
+        set_transport(transports[t].transport);
+        for (unsigned int i = 0; NULL != tests[i].fun; i++)
+        {
+            if (0 == tests[i].fun(argv[1]))
+                grade++;
+            else
+                fprintf(stdout,
+                        "Failed test `%s' (%s)\n",
+                        tests[i].name,
+                        transports[t].name);
+            possible++;
+        }
+    }
+    fprintf(stdout,
+            "Final grade: %u/%u\n",
+            grade,
+            possible);
+    
+    return grade != possible ? 1 : 0;
 }
\ No newline at end of file
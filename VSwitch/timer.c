@@ -0,0 +1,347 @@
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file timer.c
+ * @brief Hierarchical timer wheel serviced by loop()
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+
+
+/**
+ * Granularity of the wheel in milliseconds.
+ */
+#define TIMER_TICK_MS 10
+
+/**
+ * log2 of the number of slots per level.
+ */
+#define TIMER_SLOT_BITS 6
+
+/**
+ * Number of slots per level.  Must match the number of
+ * bits in the occupancy bitmap of a level.
+ */
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+/**
+ * Number of levels.  With 10 ms ticks, 5 levels of 64 slots
+ * cover more than 100 days.
+ */
+#define TIMER_LEVELS 5
+
+/**
+ * Largest distance (in ticks) we can represent; timers further
+ * in the future are clamped to this.
+ */
+#define TIMER_MAX_DELTA ((1LLU << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)
+
+
+/**
+ * The timer wheel.
+ */
+static struct
+{
+  /**
+   * Lists of timers, per level and slot.
+   */
+  struct Timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+
+  /**
+   * Which slots of each level are non-empty?
+   */
+  uint64_t occupied[TIMER_LEVELS];
+
+  /**
+   * Tick the wheel has been advanced to.
+   */
+  uint64_t tick;
+
+  /**
+   * Number of scheduled timers.
+   */
+  size_t count;
+
+  /**
+   * Set once @e tick has been initialized.
+   */
+  int initialized;
+
+} wheel;
+
+
+/**
+ * Get the current time.
+ *
+ * @return monotonic time in milliseconds
+ */
+uint64_t
+timer_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC,
+                 &ts);
+  return (uint64_t) ts.tv_sec * 1000LLU + ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * Make sure the wheel's notion of the current tick is initialized.
+ */
+static void
+wheel_init (void)
+{
+  if (wheel.initialized)
+    return;
+  wheel.tick = timer_now () / TIMER_TICK_MS;
+  wheel.initialized = 1;
+}
+
+
+/**
+ * Insert @a t into the slot matching its expiration tick.
+ * Timers that are already due go into the slot of the current tick.
+ *
+ * @param t timer to insert
+ */
+static void
+wheel_insert (struct Timer *t)
+{
+  uint64_t delta;
+  unsigned int level;
+  unsigned int idx;
+  struct Timer **head;
+
+  if (t->expires < wheel.tick)
+    t->expires = wheel.tick;
+  delta = t->expires - wheel.tick;
+  if (delta > TIMER_MAX_DELTA)
+  {
+    delta = TIMER_MAX_DELTA;
+    t->expires = wheel.tick + delta;
+  }
+  level = 0;
+  while (delta >= (1LLU << (TIMER_SLOT_BITS * (level + 1))))
+    level++;
+  idx = (t->expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+  head = &wheel.slots[level][idx];
+  t->next = *head;
+  if (NULL != t->next)
+    t->next->pprev = &t->next;
+  t->pprev = head;
+  *head = t;
+  wheel.occupied[level] |= (1LLU << idx);
+}
+
+
+/**
+ * Remove @a t from whatever list it is in.
+ *
+ * @param t timer to unlink, must be pending
+ */
+static void
+wheel_unlink (struct Timer *t)
+{
+  struct Timer **first = &wheel.slots[0][0];
+
+  *t->pprev = t->next;
+  if (NULL != t->next)
+    t->next->pprev = t->pprev;
+  /* If @a t was the only entry of a slot, the slot is now empty */
+  if ( (t->pprev >= first) &&
+       (t->pprev < first + TIMER_LEVELS * TIMER_SLOTS) &&
+       (NULL == *t->pprev) )
+  {
+    size_t off = t->pprev - first;
+
+    wheel.occupied[off / TIMER_SLOTS] &= ~(1LLU << (off % TIMER_SLOTS));
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+
+/**
+ * Detach all timers of slot @a idx at @a level into a local list.
+ *
+ * @param level level of the slot
+ * @param idx index of the slot
+ * @param list[out] set to the detached timers
+ */
+static void
+wheel_detach (unsigned int level,
+              unsigned int idx,
+              struct Timer **list)
+{
+  *list = wheel.slots[level][idx];
+  wheel.slots[level][idx] = NULL;
+  wheel.occupied[level] &= ~(1LLU << idx);
+  if (NULL != *list)
+    (*list)->pprev = list;
+}
+
+
+/**
+ * Advance the wheel by one tick: cascade timers from higher
+ * levels whose slot is due, then fire the timers of the tick.
+ */
+static void
+wheel_step (void)
+{
+  struct Timer *list;
+  uint64_t tick;
+
+  tick = ++wheel.tick;
+  for (unsigned int level = TIMER_LEVELS - 1; level > 0; level--)
+  {
+    if (0 != (tick & ((1LLU << (TIMER_SLOT_BITS * level)) - 1)))
+      continue;
+    wheel_detach (level,
+                  (tick >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1),
+                  &list);
+    while (NULL != list)
+    {
+      struct Timer *t = list;
+
+      wheel_unlink (t);
+      wheel_insert (t);
+    }
+  }
+  wheel_detach (0,
+                tick & (TIMER_SLOTS - 1),
+                &list);
+  while (NULL != list)
+  {
+    struct Timer *t = list;
+
+    /* unlink first: the callback may re-schedule @a t, or cancel
+       other timers that are still on @a list */
+    wheel_unlink (t);
+    wheel.count--;
+    t->cb (t);
+  }
+}
+
+
+/**
+ * Schedule @a t to call @a cb at time @a expires.  If @a t is
+ * already scheduled, it is moved.
+ *
+ * @param t timer to schedule
+ * @param expires absolute time (see timer_now()) in milliseconds
+ * @param cb function to call once @a t expires
+ */
+void
+timer_schedule (struct Timer *t,
+                uint64_t expires,
+                TimerCallback cb)
+{
+  wheel_init ();
+  if (NULL != t->pprev)
+    timer_cancel (t);
+  t->cb = cb;
+  t->expires = (expires + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  /* the current tick has already been processed */
+  if (t->expires <= wheel.tick)
+    t->expires = wheel.tick + 1;
+  wheel_insert (t);
+  wheel.count++;
+}
+
+
+/**
+ * Cancel @a t.  Does nothing if @a t is not scheduled.
+ *
+ * @param t timer to cancel
+ */
+void
+timer_cancel (struct Timer *t)
+{
+  if (NULL == t->pprev)
+    return;
+  wheel_unlink (t);
+  wheel.count--;
+}
+
+
+/**
+ * Run all timers that have expired by now.
+ */
+void
+timer_run (void)
+{
+  uint64_t target;
+
+  if (! wheel.initialized)
+    return;
+  target = timer_now () / TIMER_TICK_MS;
+  while (wheel.tick < target)
+  {
+    uint64_t next_cascade;
+
+    if (0 == wheel.count)
+    {
+      wheel.tick = target;
+      break;
+    }
+    if (0 == wheel.occupied[0])
+    {
+      /* nothing can fire before the next cascade, skip ahead */
+      next_cascade = (wheel.tick | (TIMER_SLOTS - 1));
+      if (next_cascade >= target)
+      {
+        wheel.tick = target;
+        break;
+      }
+      wheel.tick = next_cascade;
+    }
+    wheel_step ();
+  }
+}
+
+
+/**
+ * Compute how long loop() may block before timer_run() must be called.
+ *
+ * @return timeout in milliseconds, -1 if no timers are scheduled
+ */
+int
+timer_next_timeout (void)
+{
+  uint64_t now;
+  uint64_t due;
+  uint64_t pending;
+  unsigned int cur;
+
+  if (0 == wheel.count)
+    return -1;
+  cur = (wheel.tick + 1) & (TIMER_SLOTS - 1);
+  pending = wheel.occupied[0];
+  pending = (pending >> cur) | ((0 == cur) ? 0 : (pending << (TIMER_SLOTS
+                                                              - cur)));
+  if (0 != pending)
+    due = wheel.tick + 1 + __builtin_ctzll (pending);
+  else
+    due = (wheel.tick | (TIMER_SLOTS - 1)) + 1; /* next cascade */
+  now = timer_now ();
+  if (due * TIMER_TICK_MS <= now)
+    return 0;
+  return (int) (due * TIMER_TICK_MS - now);
+}
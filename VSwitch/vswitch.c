@@ -1,727 +1,1120 @@
-/*
-     This file (was) part of GNUnet.
-     Copyright (C) 2018 Christian Grothoff
-
-     GNUnet is free software: you can redistribute it and/or modify it
-     under the terms of the GNU Affero General Public License as published
-     by the Free Software Foundation, either version 3 of the License,
-     or (at your option) any later version.
-
-     GNUnet is distributed in the hope that it will be useful, but
-     WITHOUT ANY WARRANTY; without even the implied warranty of
-     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
-     Affero General Public License for more details.
-
-     You should have received a copy of the GNU Affero General Public License
-     along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-/**
- * @file vswitch.c
- * @brief Ethernet switch
- * @author Christian Grothoff
- */
-#include "glab.h"
-#include <stdbool.h>
-#include <stdio.h>
-
-/**
- * Maximum number of VLANs supported per interface.
- * (and also by the 802.1Q standard tag).
- */
-#define MAX_VLANS 4092
-
-/**
- * Value used to indicate "no VLAN" (or no more VLANs).
- */
-#define NO_VLAN (-1)
-
-/**
- * Which VLAN should we assume for untagged frames on
- * interfaces without any specified tag?
- */
-#define DEFAULT_VLAN 0
-
-#define ETH_802_1Q_TAG 0x8100
-
-/**
- * Number of entries in the lookup table
- */
-#define NBR_ENTRIES 8
-
-/**
- * Interface init number to avoid undefined behaviour if a table entry has not been written yet
- */
-#define IF_NO_INIT 65535
-
-/**
- * gcc 4.x-ism to pack structures (to be used before structs);
- * Using this still causes structs to be unaligned on the stack on Sparc
- * (See #670578 from Debian).
- */
-_Pragma("pack(push)") _Pragma("pack(1)")
-
-    struct EthernetHeader
-{
-  struct MacAddress dst;
-  struct MacAddress src;
-  uint16_t tag;
-};
-
-/**
- * IEEE 802.1Q header.
- */
-struct Q
-{
-  uint16_t tpid; /* must be #ETH_802_1Q_TAG */
-  uint16_t tci;
-};
-
-_Pragma("pack(pop)")
-
-    /**
-     * Per-interface context.
-     */
-    struct Interface
-{
-  /**
-   * MAC of interface.
-   */
-  struct MacAddress mac;
-
-  /**
-   * Number of this interface.
-   */
-  uint16_t ifc_num;
-
-  /**
-   * Name of the network interface, i.e. "eth0".
-   */
-  char *ifc_name;
-
-  /**
-   * Which tagged VLANs does this interface participate in?
-   * Array terminated by #NO_VLAN entry.
-   */
-  int16_t tagged_vlans[MAX_VLANS + 1];
-
-  /**
-   * Which untagged VLAN does this interface participate in?
-   * #NO_VLAN for none.
-   */
-  int16_t untagged_vlan;
-};
-
-typedef struct LookupTable
-{
-  struct Interface table[NBR_ENTRIES];
-  int nbr_position;  // NBR of rows in table
-  int current_position;
-} LookupTable;
-
-/**
- * Number of available contexts.
- */
-static unsigned int num_ifc;
-
-/**
- * All the contexts.
- */
-static struct Interface *gifc;
-
-//Global LookupTable
-LookupTable lookupTable;
-
-//Initialize lookupTable in parse frame method
-void lookup_table_init(LookupTable *lookupTable){
-  const struct MacAddress empty_mac = {{0, 0, 0, 0, 0, 0}};
-  for (int i = 0; i < NBR_ENTRIES; i++) {
-          for (int j = 0; j < 6; j++) {
-              lookupTable->table[i].mac.mac[j] = empty_mac.mac[j];
-          }
-          lookupTable->table[i].ifc_num = IF_NO_INIT;
-      }
-  lookupTable->nbr_position = NBR_ENTRIES;
-  lookupTable->current_position = 0;
-}
-
-/**
- * Is address in LookupTable
- *
- * @param lookupTable: LookupTable
- * @param targetMac: Target Mac address
- * @param found_interface: Pointer to target mac address
- * @return int i = position // -1 = not in table
- */
-int search_lookup_table(LookupTable *lookupTable, struct MacAddress *targetMac, struct Interface *found_interface){
-   for (int i = 0; i < lookupTable->nbr_position; i++){
-        int match = 1;
-        //compare Mac at lookupTable Position with complete Mac
-        for (int j = 0; j < 6; j++){
-            if (lookupTable->table[i].mac.mac[j] != targetMac->mac[j]){
-                match = 0;
-                break;
-            }
-        }if (match && lookupTable->table[i].ifc_num != IF_NO_INIT){
-            found_interface->ifc_num = lookupTable->table[i].ifc_num;
-            for (int j = 0; j < 6; j++){
-                found_interface->mac.mac[j] = lookupTable->table[i].mac.mac[j];
-            }
-            return i;
-        }
-    }
-    return -1;
-}
-
-/**
- * Save new entry to the lookup table; also checks if entry is already saved
- *
- * @param lookupTable: Table to save entry to
- * @param new_if: Potentially new interface to learn
- * @return int 0 = learned successful // -1 = already in table
- */
-int save_to_table(LookupTable *lookupTable, struct Interface *new_if){
-  struct Interface tmp_if;
-  int noMac = -1;
-  // Check if mac is in table
-  int table_pos = search_lookup_table(lookupTable, &new_if->mac, &tmp_if);
-
-  //FOUND
-  if (noMac != table_pos){
-    // The interface is in table
-    if (tmp_if.ifc_num == new_if->ifc_num){
-      // interface has still same interface number - no learning
-      return -1;
-    }else{
-      // NBR of interface for this mac has changed - must be changed in table
-      lookupTable->table[table_pos].ifc_num = new_if->ifc_num;
-      return 0;
-    }
-
-  //NOT FOUND
-  } else {
-    // The MAC is completely new and must be learned
-    int current_position = lookupTable->current_position;
-
-    // Copy each field individually
-    lookupTable->table[current_position].ifc_num = new_if->ifc_num;
-    for (int i = 0; i < 6; i++) {
-      lookupTable->table[current_position].mac.mac[i] = new_if->mac.mac[i];
-    }
-
-    lookupTable->current_position = (current_position + 1) % lookupTable->nbr_position;
-    return 0;
-  }
-}
-
-
-/**
- * Forward @a frame to interface @a dst.
- *
- * @param dst target interface to send the frame out on
- * @param frame the frame to forward
- * @param frame_size number of bytes in @a frame
- */
-static void
-forward_to(struct Interface *dst,
-           const void *frame,
-           size_t frame_size)
-{
-  char iob[frame_size + sizeof(struct GLAB_MessageHeader)];
-  struct GLAB_MessageHeader hdr;
-
-  hdr.size = htons(sizeof(iob));
-  hdr.type = htons(dst->ifc_num);
-  memcpy(iob,
-         &hdr,
-         sizeof(hdr));
-  memcpy(&iob[sizeof(hdr)],
-         frame,
-         frame_size);
-  write_all(STDOUT_FILENO,
-            iob,
-            sizeof(iob));
-}
-
-static void
-parse_tagged_frame(struct Interface *ifc,
-            const void *frame,
-            size_t frame_size,
-            struct EthernetHeader *header
-){
-
-  if (ifc->untagged_vlan != NO_VLAN)
-  {
-    return;
-  }
-
-  // copy frame in byte structure
-  uint8_t byte_frame[frame_size];
-  memcpy(byte_frame, frame, frame_size);
-
-  // Forward to interface
-  for (int i = 0; i < num_ifc; i++)
-  {
-
-    // Same interface
-    if(gifc[i].ifc_num == ifc->ifc_num){
-      continue;
-    }
-
-    // Check tagged interfaces
-    if (gifc[i].tagged_vlans[0] == ifc->tagged_vlans[0])
-    {
-      forward_to(&gifc[i], frame, frame_size);
-      continue;
-    }
-
-    // Check untagged interfaces
-     if (gifc[i].untagged_vlan == ifc->tagged_vlans[0])
-    {
-
-      // payload without tag = frame - tag (4 byte)
-      uint8_t untagged_frame[frame_size - 4]; 
-      struct MacAddress untagged_dst = header->dst;
-      struct MacAddress untagged_src = header->src;
-
-      // Copy destination and source address. src & dst mac (6 byte each)
-      for (int i = 0; i < 6; i++) 
-      {
-          untagged_frame[i] = ((uint8_t*)&untagged_dst)[i];
-          untagged_frame[6 + i] = ((uint8_t*)&untagged_src)[i];
-      }
-
-      // Copy payload from source frame to untagged_frame
-      // Start after src and dst mac (2 * 6 byte)
-      for (int i = 12; i < frame_size; i++) 
-      {
-          untagged_frame[i] = byte_frame[i+4]; // tag size (4 byte)
-      }
-
-      forward_to(&gifc[i], untagged_frame, frame_size - 4);
-
-    }
-  }
-}
-
-static void
-parse_untagged_frame(
-            struct Interface *ifc,
-            const void *frame,
-            size_t frame_size,
-            struct EthernetHeader *header
-){
-
-  // copy frame in byte structure
-  uint8_t byte_frame[frame_size];
-  memcpy(byte_frame, frame, frame_size);
-
-  for (int i = 0; i < num_ifc; i++)
-  {
-    
-    // Same interface
-    if(gifc[i].ifc_num == ifc->ifc_num)
-    {
-      continue;
-    }
-
-    // Check untagged interfaces
-    if (gifc[i].untagged_vlan == ifc->untagged_vlan)
-    {
-      forward_to(&gifc[i], frame, frame_size);
-      continue;
-    }
-
-    // Check tagged interfaces
-    if (gifc[i].tagged_vlans[0] == ifc->untagged_vlan && gifc[i].ifc_num != ifc->ifc_num)
-    {
-
-      uint8_t tagged_frame[frame_size - 12];
-      struct MacAddress tagged_dst = header->dst;
-      struct MacAddress tagged_src = header->src;
-      struct Q tag;
-      tag.tpid = htons(0x8100);
-      tag.tci = htons(0x001);
-     
-      // Copy destination and source address. src & dst mac (6 byte each)
-      for (int i = 0; i < 6; i++) 
-      {
-          tagged_frame[i] = ((uint8_t*)&tagged_dst)[i];
-          tagged_frame[6 + i] = ((uint8_t*)&tagged_src)[i];
-      }
-
-      // Copy Tag
-      for (int i = 0; i < 4; i++) {
-          tagged_frame[12 + i] = ((uint8_t*)&tag)[i];
-      }
-
-      // Copy payload from source frame to tagged_frame
-      for (int i = 12; i < frame_size; i++) {
-          tagged_frame[i + 4] = byte_frame[i];
-      }
-
-      forward_to(&gifc[i], tagged_frame, frame_size + 4);
-    }
-  }
-}
-
-
-/**
- * Parse and process frame received on @a ifc.
- *
- * @param ifc interface we got the frame on
- * @param frame raw frame data
- * @param frame_size number of bytes in @a frame
- */
-static void
-parse_frame(struct Interface *ifc,
-            const void *frame,
-            size_t frame_size)
-{
-
-  struct EthernetHeader header;
-
-  //Initialise lookupTable
-  if (lookupTable.nbr_position == 0){
-    lookup_table_init(&lookupTable);
-  }
-
-  if (frame_size < sizeof(header)){
-    return;
-  }
-
-  //copy frames byte by byte
-  const uint8_t *frame_data = (const uint8_t *)frame;
-  uint8_t *header_data = (uint8_t *)&header;
-  for (size_t i = 0; i < sizeof(header); i++) {
-    header_data[i] = frame_data[i];
-  }
-
-  struct MacAddress src_addr;
-  struct MacAddress dst_addr;
-  //copy data from mac byte by byte
-  for (size_t i = 0; i < sizeof(struct MacAddress); i++) {
-    src_addr.mac[i] = header.src.mac[i];
-    dst_addr.mac[i] = header.dst.mac[i];
-  }
-
- // If source broadcast -> throw frame
- // Check if the first bit is 0 -> unicast
-  if ((src_addr.mac[0] & 1) !=0){
-    return;
-  }
-
-  struct Interface lkp_entry = {src_addr, ifc->ifc_num};
-  save_to_table(&lookupTable, &lkp_entry);
-
-  struct Interface found_interface;
-  int noMacFound = -1;
-  // Check for broadcast search for interface if unicast
-  if ((dst_addr.mac[0] &1)==0){
-    noMacFound = search_lookup_table(&lookupTable, &dst_addr, &found_interface);
-  }
-  uint16_t ethertype = ntohs(header.tag) & 0xFFFF;
-  if (noMacFound == -1){
-    if (ethertype == ETH_802_1Q_TAG){
-        parse_tagged_frame(ifc,frame,frame_size,&header);
-    }else{
-      if (ifc->untagged_vlan != NO_VLAN){
-        parse_untagged_frame(ifc,frame,frame_size,&header);
-      }
-    }
-  }else{
-    forward_to(&found_interface, frame, frame_size);
-  }
-}
-
-/**
- * Process frame received from @a interface.
- *
- * @param interface number of the interface on which we received @a frame
- * @param frame the frame
- * @param frame_size number of bytes in @a frame
- */
-static void
-handle_frame(uint16_t interface,
-             const void *frame,
-             size_t frame_size)
-{
-  if (interface > num_ifc)
-    abort();
-  parse_frame(&gifc[interface - 1],
-              frame,
-              frame_size);
-}
-
-/**
- * Handle control message @a cmd.
- *
- * @param cmd text the user entered
- * @param cmd_len length of @a cmd
- */
-static void
-handle_control(char *cmd,
-               size_t cmd_len)
-{
-  cmd[cmd_len - 1] = '\0';
-  fprintf(stderr,
-          "Received command `%s' (ignored)\n",
-          cmd);
-}
-
-/**
- * Handle MAC information @a mac
- *
- * @param ifc_num number of the interface with @a mac
- * @param mac the MAC address at @a ifc_num
- */
-static void
-handle_mac(uint16_t ifc_num,
-           const struct MacAddress *mac)
-{
-  if (ifc_num > num_ifc)
-    abort();
-  gifc[ifc_num - 1].mac = *mac;
-}
-
-/**
- * Parse tagged interface specification found between @a start
- * and @a end.
- *
- * @param start beginning of tagged specification, with ':'
- * @param end end of tagged specification, should point to ']'
- * @param off interface offset for error reporting
- * @param ifc[out] what to initialize
- * @return 0 on success
- */
-static int
-parse_tagged(const char *start,
-             const char *end,
-             int off,
-             struct Interface *ifc)
-{
-  char *spec;
-  unsigned int pos;
-
-  if (':' != *start)
-  {
-    fprintf(stderr,
-            "Tagged definition for interface #%d lacks ':'\n",
-            off);
-    return 1;
-  }
-  start++;
-  spec = strndup(start,
-                 end - start);
-  if (NULL == spec)
-  {
-    perror("strndup");
-    return 1;
-  }
-  pos = 0;
-  for (const char *tok = strtok(spec,
-                                ",");
-       NULL != tok;
-       tok = strtok(NULL,
-                    ","))
-  {
-    unsigned int tag;
-
-    if (pos == MAX_VLANS)
-    {
-      fprintf(stderr,
-              "Too many VLANs specified for interface #%d\n",
-              off);
-      free(spec);
-      return 1;
-    }
-    if (1 != sscanf(tok,
-                    "%u",
-                    &tag))
-    {
-      fprintf(stderr,
-              "Expected number in tagged definition for interface #%d\n",
-              off);
-      free(spec);
-      return 1;
-    }
-    if (tag > MAX_VLANS)
-    {
-      fprintf(stderr,
-              "%u is too large for a 802.1Q VLAN ID (on interface #%d)\n",
-              tag,
-              off);
-      free(spec);
-      return 1;
-    }
-    ifc->tagged_vlans[pos++] = (int16_t)tag;
-  }
-  ifc->tagged_vlans[pos] = NO_VLAN;
-  free(spec);
-  return 0;
-}
-
-/**
- * Parse untagged interface specification found between @a start
- * and @a end.
- *
- * @param start beginning of tagged specification, with ':'
- * @param end end of tagged specification, should point to ']'
- * @param off interface offset for error reporting
- * @param ifc[out] what to initialize
- * @return 0 on success
- */
-static int
-parse_untagged(const char *start,
-               const char *end,
-               int off,
-               struct Interface *ifc)
-{
-  char *spec;
-  unsigned int tag;
-
-  if (':' != *start)
-  {
-    fprintf(stderr,
-            "Untagged definition for interface #%d lacks ':'\n",
-            off);
-    return 1;
-  }
-  start++;
-  spec = strndup(start,
-                 end - start);
-  if (NULL == spec)
-  {
-    perror("strndup");
-    return 1;
-  }
-  if (1 != sscanf(spec,
-                  "%u",
-                  &tag))
-  {
-    fprintf(stderr,
-            "Expected number in untagged definition for interface #%d\n",
-            off);
-    free(spec);
-    return 1;
-  }
-  if (tag > MAX_VLANS)
-  {
-    fprintf(stderr,
-            "%u is too large for a 802.1Q VLAN ID (on interface #%d)\n",
-            tag,
-            off);
-    free(spec);
-    return 1;
-  }
-  ifc->untagged_vlan = (int16_t)tag;
-  free(spec);
-  return 0;
-}
-
-/**
- * Parse command-line argument with interface specification.
- *
- * @param arg command-line argument
- * @param off offset of @a arg for error reporting
- * @param ifc interface to initialize (ifc_name, tagged_vlans and untagged_vlan).
- * @return 0 on success
- */
-static int
-parse_vlan_args(const char *arg,
-                int off,
-                struct Interface *ifc)
-{
-  const char *openbracket;
-  const char *closebracket;
-
-  ifc->tagged_vlans[0] = NO_VLAN;
-  ifc->untagged_vlan = NO_VLAN;
-
-  openbracket = strchr(arg,
-                       (unsigned char)'[');
-
-  if (NULL == openbracket)
-  {
-    ifc->ifc_name = strdup(arg);
-    if (NULL == ifc->ifc_name)
-    {
-      perror("strdup");
-      return 1;
-    }
-    ifc->untagged_vlan = DEFAULT_VLAN;
-    return 0;
-  }
-
-  ifc->ifc_name = strndup(arg,
-                          openbracket - arg);
-  if (NULL == ifc->ifc_name)
-  {
-    perror("strndup");
-    return 1;
-  }
-  openbracket++;
-  closebracket = strchr(openbracket,
-                        (unsigned char)']');
-  if (NULL == closebracket)
-  {
-    fprintf(stderr,
-            "Interface definition #%d includes '[' but lacks ']'\n",
-            off);
-    return 1;
-  }
-  switch (*openbracket)
-  {
-  case 'T':
-    return parse_tagged(openbracket + 1,
-                        closebracket,
-                        off,
-                        ifc);
-    break;
-  case 'U':
-    return parse_untagged(openbracket + 1,
-                          closebracket,
-                          off,
-                          ifc);
-    break;
-  default:
-    fprintf(stderr,
-            "Unsupported tagged/untagged specification `%c' in interface definition #%d\n",
-            *openbracket,
-            off);
-    return 1;
-  }
-}
-
-/**
- * Launches the vswitch.
- *
- * @param argc number of arguments in @a argv
- * @param argv binary name, followed by list of interfaces to switch between
- * @return not really
- */
-int main(int argc,
-         char **argv)
-{
-  struct Interface ifc[argc - 1];
-
-  (void)print;
-
-  memset(ifc, 0, sizeof(ifc));
-
-  num_ifc = argc - 1;
-  gifc = ifc;
-
-  for (unsigned int i = 1; i < argc; i++)
-  {
-    ifc[i - 1].ifc_num = i;
-    if (0 !=
-        parse_vlan_args(argv[i],
-                        i,
-                        &ifc[i - 1]))
-      return 1;
-  }
-
-  loop(&handle_frame, &handle_control, &handle_mac);
-  return 0;
-}
\ No newline at end of file
+/*
+     This file (was) part of GNUnet.
+     Copyright (C) 2018 Christian Grothoff
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file vswitch.c
+ * @brief Ethernet switch
+ * @author Christian Grothoff
+ */
+#include "glab.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Maximum number of VLANs supported per interface.
+ * (and also by the 802.1Q standard tag).
+ */
+#define MAX_VLANS 4092
+
+/**
+ * Value used to indicate "no VLAN" (or no more VLANs).
+ */
+#define NO_VLAN (-1)
+
+/**
+ * Which VLAN should we assume for untagged frames on
+ * interfaces without any specified tag?
+ */
+#define DEFAULT_VLAN 0
+
+#define ETH_802_1Q_TAG 0x8100
+
+/**
+ * Mask for the VLAN ID in the TCI of an 802.1Q tag.
+ */
+#define VLAN_VID_MASK 0x0FFF
+
+/**
+ * Number of entries in the VLAN table (one per possible VLAN ID).
+ */
+#define VLAN_TABLE_SIZE (VLAN_VID_MASK + 1)
+
+/**
+ * Default number of entries in the forwarding database.
+ */
+#define FDB_DEFAULT_CAPACITY (1 << 20)
+
+/**
+ * Smallest forwarding database we are willing to create.
+ */
+#define FDB_MIN_CAPACITY 64
+
+/**
+ * Largest forwarding database we are willing to create.
+ */
+#define FDB_MAX_CAPACITY (1 << 28)
+
+/**
+ * Number of consecutive slots (starting at the hash position) in
+ * which an entry may live.  Lookups always inspect the whole window,
+ * so freeing a slot never requires tombstones or re-hashing.
+ */
+#define FDB_PROBE_WINDOW 8
+
+/**
+ * Default time (in seconds) after which we forget MACs that
+ * we have not seen any frames from.
+ */
+#define FDB_DEFAULT_AGING 300
+
+/**
+ * gcc 4.x-ism to pack structures (to be used before structs);
+ * Using this still causes structs to be unaligned on the stack on Sparc
+ * (See #670578 from Debian).
+ */
+_Pragma("pack(push)") _Pragma("pack(1)")
+
+    struct EthernetHeader
+{
+  struct MacAddress dst;
+  struct MacAddress src;
+  uint16_t tag;
+};
+
+/**
+ * IEEE 802.1Q header.
+ */
+struct Q
+{
+  uint16_t tpid; /* must be #ETH_802_1Q_TAG */
+  uint16_t tci;
+};
+
+_Pragma("pack(pop)")
+
+    /**
+     * Per-interface context.
+     */
+    struct Interface
+{
+  /**
+   * MAC of interface.
+   */
+  struct MacAddress mac;
+
+  /**
+   * Number of this interface.
+   */
+  uint16_t ifc_num;
+
+  /**
+   * Name of the network interface, i.e. "eth0".
+   */
+  char *ifc_name;
+
+  /**
+   * Which untagged VLAN does this interface participate in?
+   * #NO_VLAN for none.  Tagged VLANs are recorded in #vlan_table.
+   */
+  int16_t untagged_vlan;
+};
+
+/**
+ * Entry in the forwarding database.
+ */
+struct FdbEntry
+{
+  /**
+   * Timer to expire the entry once it has aged out.
+   */
+  struct Timer timer;
+
+  /**
+   * MAC address packed into the lower 48 bits, VLAN ID
+   * in the upper 16 bits.
+   */
+  uint64_t key;
+
+  /**
+   * When did we last see a frame from this MAC (monotonic seconds)?
+   */
+  uint32_t last_seen;
+
+  /**
+   * Interface the MAC was learned on, 0 if the slot is free.
+   */
+  uint16_t ifc_num;
+};
+
+/**
+ * Forwarding database: open addressing with a bounded probe window.
+ * When the window is full, the least recently seen entry is evicted.
+ */
+struct ForwardingDatabase
+{
+  /**
+   * Array of @e mask + 1 slots.
+   */
+  struct FdbEntry *slots;
+
+  /**
+   * Number of slots minus one (number of slots is a power of two).
+   */
+  uint64_t mask;
+
+  /**
+   * Shift to apply to the multiplicative hash to get a slot index.
+   */
+  unsigned int shift;
+
+  /**
+   * Number of slots in use.
+   */
+  size_t count;
+};
+
+/**
+ * Number of available contexts.
+ */
+static unsigned int num_ifc;
+
+/**
+ * All the contexts.
+ */
+static struct Interface *gifc;
+
+/**
+ * The forwarding database.
+ */
+static struct ForwardingDatabase fdb;
+
+/**
+ * Number of 64-bit words in a port bitmap.
+ */
+static unsigned int port_words;
+
+/**
+ * Per-VLAN port sets, compiled from the interface specifications.
+ * For each VLAN ID, a bitmap of the member ports is followed by a
+ * bitmap of the ports on which the VLAN is carried tagged.  Bit
+ * (n - 1) represents interface n.
+ */
+static uint64_t *vlan_table;
+
+/**
+ * Current time (monotonic seconds), updated once per frame.
+ */
+static uint32_t now;
+
+/**
+ * Time (in seconds) after which entries expire, 0 for never.
+ */
+static unsigned int aging_time = FDB_DEFAULT_AGING;
+
+/**
+ * Update #now from the monotonic clock.
+ */
+static void
+update_now(void)
+{
+  now = (uint32_t)(timer_now() / 1000);
+}
+
+/**
+ * Pack @a vid and @a mac into a 64-bit key, so that each VLAN
+ * learns independently.
+ *
+ * @param vid VLAN the address was seen on
+ * @param mac address to pack
+ * @return key for the forwarding database
+ */
+static uint64_t
+mac_to_key(uint16_t vid,
+           const struct MacAddress *mac)
+{
+  uint64_t key = 0;
+
+  memcpy(&key, mac, sizeof(*mac));
+  return key | ((uint64_t)vid << 48);
+}
+
+/**
+ * Initialize the forwarding database with room for (at least)
+ * @a capacity entries.
+ *
+ * @param capacity requested number of entries
+ * @return 0 on success
+ */
+static int
+fdb_init(size_t capacity)
+{
+  size_t size = FDB_MIN_CAPACITY;
+  unsigned int bits = 6;
+
+  while (size < capacity)
+  {
+    size <<= 1;
+    bits++;
+  }
+  fdb.slots = calloc(size, sizeof(struct FdbEntry));
+  if (NULL == fdb.slots)
+  {
+    perror("calloc");
+    return 1;
+  }
+  fdb.mask = size - 1;
+  fdb.shift = 64 - bits;
+  fdb.count = 0;
+  return 0;
+}
+
+/**
+ * Compute the first slot of the probe window for @a key.
+ *
+ * @param key packed MAC address
+ * @return slot index
+ */
+static uint64_t
+fdb_home(uint64_t key)
+{
+  return (key * 0x9E3779B97F4A7C15LLU) >> fdb.shift;
+}
+
+/**
+ * An entry's aging timer expired.  Drop the entry if no frame was
+ * seen from its MAC during the aging time, otherwise re-arm the
+ * timer for the remaining time.  As #now has a resolution of one
+ * second, entries live between #aging_time and #aging_time + 1 s.
+ *
+ * @param t timer of the entry
+ */
+static void
+fdb_expire(struct Timer *t)
+{
+  struct FdbEntry *e =
+    (struct FdbEntry *)((char *)t - offsetof(struct FdbEntry, timer));
+
+  update_now();
+  if (now - e->last_seen > aging_time)
+  {
+    e->ifc_num = 0;
+    fdb.count--;
+    return;
+  }
+  timer_schedule(t,
+                 (uint64_t)(e->last_seen + aging_time + 1) * 1000,
+                 &fdb_expire);
+}
+
+/**
+ * Hint the CPU to load the start of the probe window of @a key,
+ * so that a later fdb_lookup() or fdb_learn() does not stall.
+ *
+ * @param key packed MAC address (see mac_to_key())
+ */
+static void
+fdb_prefetch(uint64_t key)
+{
+  __builtin_prefetch(&fdb.slots[fdb_home(key)]);
+}
+
+/**
+ * Find the interface on which the MAC of @a key was learned.
+ *
+ * @param key packed VLAN and MAC address (see mac_to_key())
+ * @return interface number, 0 if the address is unknown
+ */
+static uint16_t
+fdb_lookup(uint64_t key)
+{
+  uint64_t home = fdb_home(key);
+
+  for (unsigned int i = 0; i < FDB_PROBE_WINDOW; i++)
+  {
+    const struct FdbEntry *e = &fdb.slots[(home + i) & fdb.mask];
+
+    if ((0 != e->ifc_num) && (e->key == key))
+      return e->ifc_num;
+  }
+  return 0;
+}
+
+/**
+ * Learn that the MAC of @a key is reachable in its VLAN via
+ * interface @a ifc_num.  If the probe window is full, the least
+ * recently seen entry is replaced.
+ *
+ * @param key packed VLAN and source address of a frame
+ * @param ifc_num interface the frame was received on
+ */
+static void
+fdb_learn(uint64_t key,
+          uint16_t ifc_num)
+{
+  uint64_t home = fdb_home(key);
+  struct FdbEntry *free_slot = NULL;
+  struct FdbEntry *oldest = NULL;
+
+  for (unsigned int i = 0; i < FDB_PROBE_WINDOW; i++)
+  {
+    struct FdbEntry *e = &fdb.slots[(home + i) & fdb.mask];
+
+    if (0 == e->ifc_num)
+    {
+      if (NULL == free_slot)
+        free_slot = e;
+      continue;
+    }
+    if (e->key == key)
+    {
+      e->ifc_num = ifc_num;
+      e->last_seen = now;
+      return;
+    }
+    if ((NULL == oldest) || (e->last_seen < oldest->last_seen))
+      oldest = e;
+  }
+  if (NULL != free_slot)
+  {
+    fdb.count++;
+    oldest = free_slot;
+  }
+  else
+  {
+    timer_cancel(&oldest->timer);
+  }
+  oldest->key = key;
+  oldest->ifc_num = ifc_num;
+  oldest->last_seen = now;
+  if (0 != aging_time)
+    timer_schedule(&oldest->timer,
+                   (uint64_t)(now + aging_time + 1) * 1000,
+                   &fdb_expire);
+}
+
+/**
+ * Forward @a frame to interface @a dst.  The frame is queued and
+ * must remain valid until the output is flushed (see output_frame()).
+ *
+ * @param dst target interface to send the frame out on
+ * @param frame the frame to forward
+ * @param frame_size number of bytes in @a frame
+ */
+static void
+forward_to(struct Interface *dst,
+           const void *frame,
+           size_t frame_size)
+{
+  output_frame(dst->ifc_num, NULL, 0, frame, frame_size);
+}
+
+/**
+ * Get the bitmap of ports that are members of VLAN @a vid.
+ *
+ * @param vid VLAN ID
+ * @return bitmap with #port_words words
+ */
+static uint64_t *
+vlan_members(uint16_t vid)
+{
+  return &vlan_table[(2 * (size_t)vid) * port_words];
+}
+
+/**
+ * Get the bitmap of ports that carry VLAN @a vid tagged.
+ *
+ * @param vid VLAN ID
+ * @return bitmap with #port_words words
+ */
+static uint64_t *
+vlan_tagged(uint16_t vid)
+{
+  return &vlan_table[(2 * (size_t)vid + 1) * port_words];
+}
+
+/**
+ * Test bit for interface @a ifc_num in @a bitmap.
+ *
+ * @param bitmap port bitmap
+ * @param ifc_num interface number (counting from 1)
+ * @return true if the bit is set
+ */
+static bool
+port_test(const uint64_t *bitmap,
+          uint16_t ifc_num)
+{
+  return 0 != (bitmap[(ifc_num - 1) / 64] & (1LLU << ((ifc_num - 1) % 64)));
+}
+
+/**
+ * Set bit for interface @a ifc_num in @a bitmap.
+ *
+ * @param bitmap port bitmap
+ * @param ifc_num interface number (counting from 1)
+ */
+static void
+port_set(uint64_t *bitmap,
+         uint16_t ifc_num)
+{
+  bitmap[(ifc_num - 1) / 64] |= (1LLU << ((ifc_num - 1) % 64));
+}
+
+/**
+ * Is @a ifc a tagged member of VLAN @a vid?
+ *
+ * @param ifc interface to check
+ * @param vid VLAN to check for
+ * @return true if frames in @a vid are carried tagged on @a ifc
+ */
+static bool
+is_tagged_member(const struct Interface *ifc,
+                 uint16_t vid)
+{
+  return port_test(vlan_tagged(vid), ifc->ifc_num);
+}
+
+/**
+ * Allocate an empty #vlan_table for #num_ifc interfaces.
+ *
+ * @return 0 on success
+ */
+static int
+vlan_table_init(void)
+{
+  port_words = (num_ifc + 63) / 64;
+  vlan_table = calloc((size_t)VLAN_TABLE_SIZE * 2 * port_words,
+                      sizeof(uint64_t));
+  if (NULL == vlan_table)
+  {
+    perror("calloc");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Make @a ifc a member of VLAN @a vid.
+ *
+ * @param ifc interface joining the VLAN
+ * @param vid VLAN to join
+ * @param tagged true if @a vid is to be carried tagged on @a ifc
+ */
+static void
+vlan_join(const struct Interface *ifc,
+          uint16_t vid,
+          bool tagged)
+{
+  port_set(vlan_members(vid), ifc->ifc_num);
+  if (tagged)
+    port_set(vlan_tagged(vid), ifc->ifc_num);
+}
+
+/**
+ * A received frame, classified into its VLAN.
+ */
+struct VlanFrame
+{
+  /**
+   * Interface we got the frame on.
+   */
+  struct Interface *ifc;
+
+  /**
+   * Forwarding database key of the source address.
+   */
+  uint64_t src_key;
+
+  /**
+   * Forwarding database key of the destination address.
+   */
+  uint64_t dst_key;
+
+  /**
+   * The frame as received.
+   */
+  const uint8_t *data;
+
+  /**
+   * Number of bytes in @e data.
+   */
+  size_t size;
+
+  /**
+   * VLAN the frame belongs to.
+   */
+  uint16_t vid;
+
+  /**
+   * True if @e data carries an 802.1Q tag.
+   */
+  bool tagged;
+
+  /**
+   * For untagged frames: the MAC addresses followed by the 802.1Q tag
+   * to insert when sending the frame out on a tagged port.
+   */
+  uint8_t tagged_head[2 * MAC_ADDR_SIZE + sizeof(struct Q)];
+};
+
+/**
+ * Send @a vf out on @a dst, adding or removing the 802.1Q tag as
+ * required.  Only the 12 bytes of MAC addresses (and the tag) are
+ * copied, the payload is queued for output as received.
+ *
+ * @param dst target interface to send the frame out on
+ * @param dst_tagged true if @a dst carries the VLAN of @a vf tagged
+ * @param vf frame to send
+ */
+static void
+egress(struct Interface *dst,
+       bool dst_tagged,
+       const struct VlanFrame *vf)
+{
+  if (dst_tagged == vf->tagged)
+    forward_to(dst, vf->data, vf->size);
+  else if (vf->tagged)
+    output_frame(dst->ifc_num,
+                 vf->data,
+                 2 * MAC_ADDR_SIZE,
+                 &vf->data[2 * MAC_ADDR_SIZE + sizeof(struct Q)],
+                 vf->size - 2 * MAC_ADDR_SIZE - sizeof(struct Q));
+  else
+    output_frame(dst->ifc_num,
+                 vf->tagged_head,
+                 sizeof(vf->tagged_head),
+                 &vf->data[2 * MAC_ADDR_SIZE],
+                 vf->size - 2 * MAC_ADDR_SIZE);
+}
+
+/**
+ * Forward @a vf to @a dst, adding or removing the 802.1Q tag as
+ * required by the membership of @a dst.  Does nothing if @a dst is
+ * not a member of the frame's VLAN.
+ *
+ * @param dst target interface to send the frame out on
+ * @param vf the frame to forward
+ */
+static void
+forward_in_vlan(struct Interface *dst,
+                const struct VlanFrame *vf)
+{
+  if (!port_test(vlan_members(vf->vid), dst->ifc_num))
+    return;
+  egress(dst, is_tagged_member(dst, vf->vid), vf);
+}
+
+/**
+ * Flood @a vf received on @a ifc to all other members of its VLAN,
+ * tagging or untagging it as required per port.
+ *
+ * @param ifc interface we got the frame on
+ * @param vf the frame to flood
+ */
+static void
+flood_vlan(struct Interface *ifc,
+           const struct VlanFrame *vf)
+{
+  const uint64_t *members = vlan_members(vf->vid);
+  const uint64_t *tagged_ports = vlan_tagged(vf->vid);
+
+  for (unsigned int w = 0; w < port_words; w++)
+  {
+    uint64_t ports = members[w];
+
+    // Never send back out on the interface we got the frame from
+    if (w == (ifc->ifc_num - 1) / 64)
+      ports &= ~(1LLU << ((ifc->ifc_num - 1) % 64));
+    while (0 != ports)
+    {
+      unsigned int bit = __builtin_ctzll(ports);
+
+      ports &= ports - 1;
+      egress(&gifc[w * 64 + bit],
+             0 != (tagged_ports[w] & (1LLU << bit)),
+             vf);
+    }
+  }
+}
+
+
+/**
+ * Parse frame received on @a ifc and classify it into its VLAN.
+ *
+ * @param ifc interface we got the frame on
+ * @param frame raw frame data
+ * @param frame_size number of bytes in @a frame
+ * @param vf[out] the classified frame
+ * @return 0 if the frame is to be switched, -1 to drop it
+ */
+static int
+classify_frame(struct Interface *ifc,
+               const void *frame,
+               size_t frame_size,
+               struct VlanFrame *vf)
+{
+
+  struct EthernetHeader header;
+
+  if (frame_size < sizeof(header)){
+    return -1;
+  }
+  memcpy(&header, frame, sizeof(header));
+
+ // If source broadcast -> throw frame
+ // Check if the first bit is 0 -> unicast
+  if ((header.src.mac[0] & 1) !=0){
+    return -1;
+  }
+
+  vf->ifc = ifc;
+  vf->data = frame;
+  vf->size = frame_size;
+
+  // Determine the VLAN the frame belongs to
+  vf->tagged = (ntohs(header.tag) == ETH_802_1Q_TAG);
+  if (vf->tagged){
+    struct Q tag;
+
+    if (frame_size < 2 * MAC_ADDR_SIZE + sizeof(tag)){
+      return -1;
+    }
+    memcpy(&tag, &vf->data[2 * MAC_ADDR_SIZE], sizeof(tag));
+    vf->vid = ntohs(tag.tci) & VLAN_VID_MASK;
+    if (!is_tagged_member(ifc, vf->vid)){
+      return -1;
+    }
+  }else{
+    struct Q tag;
+
+    if (ifc->untagged_vlan == NO_VLAN){
+      return -1;
+    }
+    vf->vid = (uint16_t)ifc->untagged_vlan;
+    // Tag to use on tagged ports: our VID, default priority
+    tag.tpid = htons(ETH_802_1Q_TAG);
+    tag.tci = htons(vf->vid);
+    memcpy(vf->tagged_head, vf->data, 2 * MAC_ADDR_SIZE);
+    memcpy(&vf->tagged_head[2 * MAC_ADDR_SIZE], &tag, sizeof(tag));
+  }
+  vf->src_key = mac_to_key(vf->vid, &header.src);
+  vf->dst_key = mac_to_key(vf->vid, &header.dst);
+  return 0;
+}
+
+/**
+ * Learn the source of @a vf and forward or flood it.
+ *
+ * @param vf frame classified by classify_frame()
+ */
+static void
+switch_frame(const struct VlanFrame *vf)
+{
+  fdb_learn(vf->src_key, vf->ifc->ifc_num);
+
+  uint16_t found_ifc = 0;
+  // Check for broadcast search for interface if unicast
+  if ((vf->data[0] &1)==0){
+    found_ifc = fdb_lookup(vf->dst_key);
+  }
+  if (found_ifc == vf->ifc->ifc_num){
+    // destination is on the segment the frame came from
+    return;
+  }
+  if (found_ifc != 0){
+    forward_in_vlan(&gifc[found_ifc - 1], vf);
+    return;
+  }
+  flood_vlan(vf->ifc, vf);
+}
+
+/**
+ * Process a batch of frames.  All frames are classified first and
+ * the forwarding database slots they need are prefetched, so that
+ * the cache misses of the lookups overlap instead of being taken
+ * one frame at a time.
+ *
+ * @param frames the frames
+ * @param num_frames number of entries in @a frames
+ */
+static void
+handle_frames(const struct FrameDescriptor *frames,
+              unsigned int num_frames)
+{
+  struct VlanFrame vfs[num_frames];
+  unsigned int n = 0;
+
+  update_now();
+  for (unsigned int i = 0; i < num_frames; i++)
+  {
+    if (frames[i].interface > num_ifc)
+      abort();
+    if (0 != classify_frame(&gifc[frames[i].interface - 1],
+                            frames[i].frame,
+                            frames[i].frame_size,
+                            &vfs[n]))
+      continue;
+    fdb_prefetch(vfs[n].src_key);
+    if (0 == (vfs[n].data[0] & 1))
+      fdb_prefetch(vfs[n].dst_key);
+    n++;
+  }
+  for (unsigned int i = 0; i < n; i++)
+    switch_frame(&vfs[i]);
+}
+
+/**
+ * Handle control message @a cmd.
+ *
+ * @param cmd text the user entered
+ * @param cmd_len length of @a cmd
+ */
+static void
+handle_control(char *cmd,
+               size_t cmd_len)
+{
+  cmd[cmd_len - 1] = '\0';
+  fprintf(stderr,
+          "Received command `%s' (ignored)\n",
+          cmd);
+}
+
+/**
+ * Handle MAC information @a mac
+ *
+ * @param ifc_num number of the interface with @a mac
+ * @param mac the MAC address at @a ifc_num
+ */
+static void
+handle_mac(uint16_t ifc_num,
+           const struct MacAddress *mac)
+{
+  if (ifc_num > num_ifc)
+    abort();
+  gifc[ifc_num - 1].mac = *mac;
+}
+
+/**
+ * Parse tagged interface specification found between @a start
+ * and @a end.
+ *
+ * @param start beginning of tagged specification, with ':'
+ * @param end end of tagged specification, should point to ']'
+ * @param off interface offset for error reporting
+ * @param ifc[out] what to initialize
+ * @return 0 on success
+ */
+static int
+parse_tagged(const char *start,
+             const char *end,
+             int off,
+             struct Interface *ifc)
+{
+  char *spec;
+  unsigned int pos;
+
+  if (':' != *start)
+  {
+    fprintf(stderr,
+            "Tagged definition for interface #%d lacks ':'\n",
+            off);
+    return 1;
+  }
+  start++;
+  spec = strndup(start,
+                 end - start);
+  if (NULL == spec)
+  {
+    perror("strndup");
+    return 1;
+  }
+  pos = 0;
+  for (const char *tok = strtok(spec,
+                                ",");
+       NULL != tok;
+       tok = strtok(NULL,
+                    ","))
+  {
+    unsigned int tag;
+
+    if (pos == MAX_VLANS)
+    {
+      fprintf(stderr,
+              "Too many VLANs specified for interface #%d\n",
+              off);
+      free(spec);
+      return 1;
+    }
+    if (1 != sscanf(tok,
+                    "%u",
+                    &tag))
+    {
+      fprintf(stderr,
+              "Expected number in tagged definition for interface #%d\n",
+              off);
+      free(spec);
+      return 1;
+    }
+    if (tag > MAX_VLANS)
+    {
+      fprintf(stderr,
+              "%u is too large for a 802.1Q VLAN ID (on interface #%d)\n",
+              tag,
+              off);
+      free(spec);
+      return 1;
+    }
+    vlan_join(ifc, (uint16_t)tag, true);
+    pos++;
+  }
+  free(spec);
+  return 0;
+}
+
+/**
+ * Parse untagged interface specification found between @a start
+ * and @a end.
+ *
+ * @param start beginning of tagged specification, with ':'
+ * @param end end of tagged specification, should point to ']'
+ * @param off interface offset for error reporting
+ * @param ifc[out] what to initialize
+ * @return 0 on success
+ */
+static int
+parse_untagged(const char *start,
+               const char *end,
+               int off,
+               struct Interface *ifc)
+{
+  char *spec;
+  unsigned int tag;
+
+  if (':' != *start)
+  {
+    fprintf(stderr,
+            "Untagged definition for interface #%d lacks ':'\n",
+            off);
+    return 1;
+  }
+  start++;
+  spec = strndup(start,
+                 end - start);
+  if (NULL == spec)
+  {
+    perror("strndup");
+    return 1;
+  }
+  if (1 != sscanf(spec,
+                  "%u",
+                  &tag))
+  {
+    fprintf(stderr,
+            "Expected number in untagged definition for interface #%d\n",
+            off);
+    free(spec);
+    return 1;
+  }
+  if (tag > MAX_VLANS)
+  {
+    fprintf(stderr,
+            "%u is too large for a 802.1Q VLAN ID (on interface #%d)\n",
+            tag,
+            off);
+    free(spec);
+    return 1;
+  }
+  ifc->untagged_vlan = (int16_t)tag;
+  vlan_join(ifc, (uint16_t)tag, false);
+  free(spec);
+  return 0;
+}
+
+/**
+ * Parse command-line argument with interface specification.
+ *
+ * @param arg command-line argument
+ * @param off offset of @a arg for error reporting
+ * @param ifc interface to initialize (ifc_name, untagged_vlan and the
+ *        interface's entries in #vlan_table).
+ * @return 0 on success
+ */
+static int
+parse_vlan_args(const char *arg,
+                int off,
+                struct Interface *ifc)
+{
+  const char *openbracket;
+  const char *closebracket;
+
+  ifc->untagged_vlan = NO_VLAN;
+
+  openbracket = strchr(arg,
+                       (unsigned char)'[');
+
+  if (NULL == openbracket)
+  {
+    ifc->ifc_name = strdup(arg);
+    if (NULL == ifc->ifc_name)
+    {
+      perror("strdup");
+      return 1;
+    }
+    ifc->untagged_vlan = DEFAULT_VLAN;
+    vlan_join(ifc, DEFAULT_VLAN, false);
+    return 0;
+  }
+
+  ifc->ifc_name = strndup(arg,
+                          openbracket - arg);
+  if (NULL == ifc->ifc_name)
+  {
+    perror("strndup");
+    return 1;
+  }
+  openbracket++;
+  closebracket = strchr(openbracket,
+                        (unsigned char)']');
+  if (NULL == closebracket)
+  {
+    fprintf(stderr,
+            "Interface definition #%d includes '[' but lacks ']'\n",
+            off);
+    return 1;
+  }
+  switch (*openbracket)
+  {
+  case 'T':
+    return parse_tagged(openbracket + 1,
+                        closebracket,
+                        off,
+                        ifc);
+    break;
+  case 'U':
+    return parse_untagged(openbracket + 1,
+                          closebracket,
+                          off,
+                          ifc);
+    break;
+  default:
+    fprintf(stderr,
+            "Unsupported tagged/untagged specification `%c' in interface definition #%d\n",
+            *openbracket,
+            off);
+    return 1;
+  }
+}
+
+/**
+ * Parse command-line option @a arg (starting with "--").
+ *
+ * @param arg command-line argument
+ * @param fdb_capacity[out] set to the requested forwarding database size
+ * @return 0 on success
+ */
+static int
+parse_option(const char *arg,
+             size_t *fdb_capacity)
+{
+  unsigned long long value;
+  unsigned int seconds;
+
+  if (1 == sscanf(arg,
+                  "--aging=%u",
+                  &seconds))
+  {
+    aging_time = seconds;
+    return 0;
+  }
+  if (1 == sscanf(arg,
+                  "--fdb-size=%llu",
+                  &value))
+  {
+    if ((value < FDB_MIN_CAPACITY) || (value > FDB_MAX_CAPACITY))
+    {
+      fprintf(stderr,
+              "Forwarding database size must be between %u and %u\n",
+              (unsigned int)FDB_MIN_CAPACITY,
+              (unsigned int)FDB_MAX_CAPACITY);
+      return 1;
+    }
+    *fdb_capacity = (size_t)value;
+    return 0;
+  }
+  fprintf(stderr,
+          "Unsupported option `%s'\n",
+          arg);
+  return 1;
+}
+
+/**
+ * Launches the vswitch.
+ *
+ * @param argc number of arguments in @a argv
+ * @param argv binary name, followed by options ("--fdb-size=N",
+ *        "--aging=SECONDS" where 0 disables aging),
+ *        followed by list of interfaces to switch between
+ * @return not really
+ */
+int main(int argc,
+         char **argv)
+{
+  size_t fdb_capacity = FDB_DEFAULT_CAPACITY;
+  int first = 1;
+
+  while ((first < argc) && (0 == strncmp(argv[first], "--", 2)))
+  {
+    if (0 != parse_option(argv[first], &fdb_capacity))
+      return 1;
+    first++;
+  }
+
+  struct Interface *ifc;
+
+  (void)print;
+
+  num_ifc = argc - first;
+  ifc = calloc(num_ifc, sizeof(struct Interface));
+  if (NULL == ifc)
+  {
+    perror("calloc");
+    return 1;
+  }
+  gifc = ifc;
+  if (0 != vlan_table_init())
+    return 1;
+
+  for (unsigned int i = 1; i <= num_ifc; i++)
+  {
+    ifc[i - 1].ifc_num = i;
+    if (0 !=
+        parse_vlan_args(argv[first + i - 1],
+                        i,
+                        &ifc[i - 1]))
+      return 1;
+  }
+  if (0 != fdb_init(fdb_capacity))
+    return 1;
+
+  loop_batch(&handle_frames, &handle_control, &handle_mac);
+  free(fdb.slots);
+  free(vlan_table);
+  for (unsigned int i = 0; i < num_ifc; i++)
+    free(ifc[i].ifc_name);
+  free(ifc);
+  return 0;
+}